@@ -24,6 +24,10 @@ ShowHelp()
 	printf "\tDefault is /etc/epoch.\n"
 	printf $Green"--logfile file"$EndGreen":\n\tSets the file Epoch will use as its logfile.\n"
 	printf "\tDefault is /var/log.\n"
+	printf $Green"--statedir dir"$EndGreen":\n\tSets the directory Epoch keeps runtime object changes in,\n"
+	printf "\tsuch as from 'epoch disable'. Default is /var/lib/epoch.\n"
+	printf $Green"--rundir dir"$EndGreen":\n\tSets the directory Epoch puts its control socket in.\n"
+	printf "\tDefault is /run/epoch.\n"
 	printf $Green"--binarypath path"$EndGreen":\n\tThe direct path to the Epoch binary. Default is /sbin/epoch.\n"
 	printf $Green"--env-home value"$EndGreen":\n\tDesired environment variable for \$HOME.\n"
 	printf "\tThis will be usable in Epoch start/stop commands.\n"
@@ -83,6 +87,14 @@ if [ "$#" != "0" ]; then
 			shift
 			CFLAGS=$CFLAGS" -DLOGFILE=\"$1\""
 		
+		elif [ "$1" = "--statedir" ]; then
+			shift
+			CFLAGS=$CFLAGS" -DSTATEDIR=\"$1\""
+		
+		elif [ "$1" = "--rundir" ]; then
+			shift
+			CFLAGS=$CFLAGS" -DRUNDIR=\"$1\""
+		
 		elif [ "$1" = "--env-home" ]; then
 			shift
 			CFLAGS=$CFLAGS" -DENVVAR_HOME=\"$1\""
@@ -151,11 +163,16 @@ mkdir objects
 cd objects
 
 CMD "$CC $CFLAGS -c ../src/actions.c"
+CMD "$CC $CFLAGS -c ../src/builtins.c"
+CMD "$CC $CFLAGS -c ../src/capture.c"
 CMD "$CC $CFLAGS -c ../src/config.c"
 CMD "$CC $CFLAGS -c ../src/console.c"
+CMD "$CC $CFLAGS -c ../src/control.c"
+CMD "$CC $CFLAGS -c ../src/journal.c"
 CMD "$CC $CFLAGS -c ../src/main.c"
 CMD "$CC $CFLAGS -c ../src/membus.c"
 CMD "$CC $CFLAGS -c ../src/modes.c"
+CMD "$CC $CFLAGS -c ../src/overlay.c"
 CMD "$CC $CFLAGS -c ../src/parse.c"
 CMD "$CC $CFLAGS -c ../src/utilfuncs.c"
 
@@ -165,7 +182,7 @@ mkdir -p $outdir/sbin/
 mkdir -p $outdir/bin/
 
 CMD "$CC $CFLAGS -o $outdir/sbin/epoch\
- actions.o config.o console.o main.o membus.o modes.o parse.o utilfuncs.o $LDFLAGS"
+ actions.o builtins.o capture.o config.o console.o control.o journal.o main.o membus.o modes.o overlay.o parse.o utilfuncs.o $LDFLAGS"
 
 printf "\nCreating symlinks.\n"
 cd $outdir/sbin/
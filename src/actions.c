@@ -92,6 +92,65 @@ static void MountVirtuals(void)
 	}
 }
 
+static void PrimaryLoop_Sleep(unsigned Milliseconds)
+{ /*Sleep out the rest of a pass, reading captured object output meanwhile.
+	* A membus or control socket client wakes us early and gets answered right then, not on the next big pass.*/
+	struct timespec Now, Deadline;
+	long Remaining = Milliseconds;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+	Deadline.tv_sec += Milliseconds / 1000;
+	Deadline.tv_nsec += (Milliseconds % 1000) * 1000000L;
+	
+	if (Deadline.tv_nsec >= 1000000000L)
+	{
+		++Deadline.tv_sec;
+		Deadline.tv_nsec -= 1000000000L;
+	}
+	
+	while (Remaining > 0)
+	{
+		if (Capture_Wait(Remaining, true))
+		{
+			HandleMemBusPings();
+			ParseMemBus();
+			Control_Serve();
+		}
+		
+		clock_gettime(CLOCK_MONOTONIC, &Now);
+		Remaining = (Deadline.tv_sec - Now.tv_sec) * 1000 + (Deadline.tv_nsec - Now.tv_nsec) / 1000000;
+	}
+}
+
+static void PrimaryLoop_Reap(void)
+{ /*Harvest zombies, and tell watchers when one of them was an object's process.*/
+	int RawStatus = 0;
+	pid_t Reaped;
+	
+	while ((Reaped = waitpid(-1, &RawStatus, WNOHANG)) > 0)
+	{
+		char Detail[64];
+		unsigned Inc = 0;
+		
+		/*Matching means reading every PID file, which is only worth it for someone to tell.*/
+		if (!ObjectTable || !Control_Watched()) continue;
+		
+		for (; Inc < ObjectTableSize; ++Inc)
+		{ /*Daemons that fork away from us are only known by their PID file.*/
+			if (!ObjectStates[Inc].Started) continue;
+			
+			if ((ObjectTable[Inc].Opts.HasPIDFile ? ReadPIDFile(&ObjectTable[Inc]) : ObjectStates[Inc].ObjectPID) == (unsigned)Reaped) break;
+		}
+		
+		if (Inc == ObjectTableSize) continue;
+		
+		if (WIFSIGNALED(RawStatus)) snprintf(Detail, sizeof Detail, "%ld signal %d", (long)Reaped, WTERMSIG(RawStatus));
+		else snprintf(Detail, sizeof Detail, "%ld code %d", (long)Reaped, WEXITSTATUS(RawStatus));
+		
+		Control_Event("EXITED", ObjectTable[Inc].ObjectID, Detail);
+	}
+}
+
 static void PrimaryLoop(void)
 { /*Loop that provides essentially everything we cycle through.*/
 	unsigned CurMin = 0, CurSec = 0;
@@ -99,13 +158,14 @@ static void PrimaryLoop(void)
 	struct tm TimeStruct;
 	time_t TimeCore;
 	short LoopStepper = 0, ScanStepper = 0;
+	unsigned Inc = 0;
 	
 	for (ContinuePrimaryLoop = true; ContinuePrimaryLoop; ++LoopStepper)
 	{	
 	
 		/**The line below is of critical importance. It harvests
 		 * the zombies created by all processes throughout the system.**/
-		while (waitpid(-1, NULL, WNOHANG) > 0);
+		PrimaryLoop_Reap();
 		
 		/*Do not flood the system with this big loop more than necessary.*/
 		if (LoopStepper == 5)
@@ -119,6 +179,16 @@ static void PrimaryLoop(void)
 			
 			ParseMemBus(); /*Check membus for new data.*/
 			
+			Overlay_Sync(false); /*Save runtime object changes, a batch at a time.*/
+			
+			Log_Tick(); /*Write out log lines that have been waiting a while.*/
+			
+			Journal_Tick();
+			
+			Capture_Tick(); /*Rotates captured output files that are too old.*/
+			
+			Control_Tick(); /*Opens the control socket, once there's a /run to put it in.*/
+			
 			if (HaltParams.HaltMode != -1)
 			{
 				time(&TimeCore);
@@ -172,9 +242,19 @@ static void PrimaryLoop(void)
 			
 			if (ObjectTable)
 			{
-				for (Worker = ObjectTable; Worker->Next != NULL; Worker = Worker->Next)
-				{ /*Handle objects intended for automatic restart.*/
-					if (Worker->Opts.AutoRestart && Worker->Started && !ObjectProcessRunning(Worker))
+				for (Inc = 0; Inc < ObjectTableSize; ++Inc)
+				{ /*Handle objects intended for automatic restart.
+					* We walk the state array and only reach into ObjectTable for objects we actually need to look at.*/
+					const struct _ObjState *const State = ObjectStates + Inc;
+					
+					if (!State->Started || (!State->AutoRestart && ScanStepper != 240))
+					{
+						continue;
+					}
+					
+					Worker = ObjectTable + Inc;
+					
+					if (State->AutoRestart && !ObjectProcessRunning(Worker))
 					{
 						char TmpBuf[MAX_LINE_SIZE];
 						
@@ -184,7 +264,7 @@ static void PrimaryLoop(void)
 						}
 						
 						/*Don't let us enter a restart loop.*/
-						if (Worker->StartedSince + (Worker->Opts.AutoRestart >> 1) > time(NULL))
+						if (Worker->State->StartedSince + (Worker->State->AutoRestart >> 1) > time(NULL))
 						{
 							snprintf(TmpBuf, sizeof TmpBuf,
 									"AUTORESTART: "CONSOLE_COLOR_RED "PROBLEM:\n"
@@ -194,15 +274,17 @@ static void PrimaryLoop(void)
 									Worker->ObjectID);
 									
 							WriteLogLine(TmpBuf, true);
+							Control_Event("STOPPED", Worker->ObjectID, "restartloop");
 							
-							Worker->Started = false;
-							Worker->ObjectPID = 0;
-							Worker->StartedSince = 0;
+							Worker->State->Started = false;
+							Worker->State->ObjectPID = 0;
+							Worker->State->StartedSince = 0;
 							continue;
 						}
 						
 						snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: Object %s is not running. Restarting.", Worker->ObjectID);
 						WriteLogLine(TmpBuf, true);
+						Control_Event("RESTARTING", Worker->ObjectID, NULL);
 						
 						if (ProcessConfigObject(Worker, true, false))
 						{
@@ -212,16 +294,16 @@ static void PrimaryLoop(void)
 						{
 							snprintf(TmpBuf, MAX_LINE_SIZE, "AUTORESTART: " CONSOLE_COLOR_RED "Failed" CONSOLE_ENDCOLOR
 									" to restart object %s automatically.\nMarking object stopped.", Worker->ObjectID);
-							Worker->Started = false;
-							Worker->ObjectPID = 0;
-							Worker->StartedSince = 0;
+							Worker->State->Started = false;
+							Worker->State->ObjectPID = 0;
+							Worker->State->StartedSince = 0;
 						}
 						
 						WriteLogLine(TmpBuf, true);
 					}
 					
 					/*Rescan PIDs every minute to keep them up-to-date.*/
-					if (ScanStepper == 240 && Worker->Started && !Worker->Opts.HasPIDFile)
+					if (ScanStepper == 240 && Worker->State->Started && !Worker->Opts.HasPIDFile)
 					{
 						AdvancedPIDFind(Worker, true);
 					}
@@ -236,7 +318,7 @@ static void PrimaryLoop(void)
 			++ScanStepper;
 		}
 		
-		usleep(50000); /*0.05 secs*/
+		PrimaryLoop_Sleep(50); /*0.05 secs.*/
 
 		/*Lots of brilliant code here, but I typed it in invisible pixels.*/
 	}		
@@ -248,11 +330,14 @@ void EmergencyShell(void)
 	fprintf(stderr, CONSOLE_COLOR_MAGENTA "\nPreparing to start emergency shell." CONSOLE_ENDCOLOR "\n---\n");
 	
 	fprintf(stderr, "\nSyncing disks...\n");
+	Log_Close();
+	Journal_Close();
 	sync(); /*First things first, sync disks.*/
 	
 	fprintf(stderr, "Shutting down Epoch...\n");
 	ShutdownConfig(); /*Release all memory.*/
 	ShutdownMemBus(true); /*Stop the membus.*/
+	Control_Shutdown();
 	
 	fprintf(stderr, "Launching the shell...\n");
 	
@@ -276,6 +361,8 @@ void RecoverFromReexec(Bool ViaMemBus)
 	unsigned long OurLong; /*We write unsigned int values as unsigned long to maintan compatibility with 1.1.1 and earlier.*/
 	MemBusKey = MEMKEY + 1;
 	
+	Capture_Adopt(); /*Before anything gets spawned.*/
+	
 	/*Restore any goobled up environ vars.*/
 	setenv("USER", ENVVAR_USER, true);
 	setenv("PATH", ENVVAR_PATH, true);
@@ -291,6 +378,8 @@ void RecoverFromReexec(Bool ViaMemBus)
 
 	ApplyGlobalEnvVars(); /*Set global environment variables.*/
 	
+	UseControlSocket = false; /*The data comes over the modified membus. The socket isn't ours again until the end.*/
+	
 	if (!InitMemBus(false))
 	{
 		EmulWall("Epoch: "CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
@@ -298,11 +387,11 @@ void RecoverFromReexec(Bool ViaMemBus)
 		EmergencyShell();
 	}
 	
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) MemBus_Wait(false);
 	
 	memcpy(&ChildPID, InBuf + MCodeLength, sizeof(pid_t));
 	
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) MemBus_Wait(false);
 	
 	while (!strcmp(InBuf, MCode))
 	{
@@ -312,16 +401,16 @@ void RecoverFromReexec(Bool ViaMemBus)
 			
 
 			memcpy(&OurLong, (InBuf + MCodeLength + TLength), sizeof(long));
-			CurObj->ObjectPID = OurLong;
+			CurObj->State->ObjectPID = OurLong;
 			
 			memcpy(&OurLong, (InBuf + MCodeLength + TLength + sizeof(long)), sizeof(Bool));
-			CurObj->Started = OurLong;
+			CurObj->State->Started = OurLong;
 			
 			memcpy(&OurLong, (InBuf + MCodeLength + TLength + sizeof(long) + sizeof(Bool)), sizeof(long));
-			CurObj->StartedSince = OurLong;
+			CurObj->State->StartedSince = OurLong;
 		}
 		
-		while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+		while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) MemBus_Wait(false);
 	}
 	
 	MCode = MEMBUS_CODE_RXD_OPTS;
@@ -353,11 +442,11 @@ void RecoverFromReexec(Bool ViaMemBus)
 	HaltParams.JobID = OurLong;
 	
 	/*Retrieve our important options.*/
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) MemBus_Wait(false);
 	EnableLogging = (Bool)*(InBuf + MCodeLength);
 
 	/*Retrieve the current runlevel.*/
-	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) usleep(100);
+	while (!MemBus_BinRead(InBuf, sizeof InBuf, false)) MemBus_Wait(false);
 	snprintf(CurRunlevel, sizeof CurRunlevel, "%s", InBuf + MCodeLength);
 	
 	MemBus_Write(MCode, false); /*Tell the child they can quit.*/
@@ -387,18 +476,20 @@ void RecoverFromReexec(Bool ViaMemBus)
 	if (ViaMemBus) /*Client probably wants confirmation.*/
 	{
 		/*Handle pings.*/
-		for (; !HandleMemBusPings() && TInc < 100000; ++TInc)
+		for (; !HandleMemBusPings() && TInc < 100; ++TInc)
 		{ /*Wait ten seconds.*/
-			 usleep(100);
+			MemBus_Idle(100);
 		}
 		
-		if (TInc < 100000)
+		if (TInc < 100)
 		{ /*Do not attempt this if we didn't receive a ping because it will only slow us down
 			with another ten second timeout.*/
 			/*Tell the client we are done.*/
 			MemBus_Write(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_RXD, true);
 		}
 	}
+	
+	Control_Init(); /*Only now, so that client gets its answer on the membus above.*/
 		
 	FinaliseLogStartup(false); /*Bring back logging.*/
 	LogInMemory = false;
@@ -421,6 +512,8 @@ void ReexecuteEpoch(void)
 	unsigned long OurLong; /*Compatibility with 1.1.1 and earlier.*/
 	
 	
+	Overlay_Sync(true); /*Don't lose runtime object changes to the new image.*/
+	
 	ShutdownMemBus(true); /*We are now going to use a different MemBus key.*/
 	MemBusKey = MEMKEY + 1; /*This prevents clients from interfering.*/
 		
@@ -445,6 +538,9 @@ void ReexecuteEpoch(void)
 		fclose(TestDescriptor);
 	}
 	
+	Log_Flush(); /*Or the child would take a copy of what's buffered.*/
+	Journal_Flush();
+	
 	if ((PID = fork()) == -1)
 	{
 		EmulWall("Epoch: " CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
@@ -468,6 +564,10 @@ void ReexecuteEpoch(void)
 		
 		while (shmget(MEMKEY + 1, MEMBUS_SIZE, 0660) == -1) usleep(100);
 		
+		Log_Flush();
+		Journal_Flush();
+		Capture_Handoff(true);
+		
 		/**Execute the new binary.**/ /*We pass the custom args to tell us we are re-executing.*/
 		execlp(EPOCH_BINARY_PATH, "!rxd", "REEXEC", NULL);
 		
@@ -475,6 +575,7 @@ void ReexecuteEpoch(void)
 		EmulWall(CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
 				"Failed to execute \"" EPOCH_BINARY_PATH "\"! Cannot reexec!", false);
 				
+		Capture_Handoff(false);
 		WriteLogLine(CONSOLE_COLOR_RED "Reexecution failed." CONSOLE_ENDCOLOR, true);
 		kill(PID, SIGKILL); /*Kill the failed child.*/
 		
@@ -495,6 +596,8 @@ void ReexecuteEpoch(void)
 	}
 	
 	/**The child is responsible for sending us our data.**/
+	Control_Shutdown(); /*Our copy of the socket would only swallow clients meant for the new image.*/
+	
 	if (!InitMemBus(true))
 	{
 		EmulWall("Epoch: " CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
@@ -506,7 +609,7 @@ void ReexecuteEpoch(void)
 	{ /*Wait for the re-executed parent process to connect to receive it's config.*/
 		static unsigned Counter = 0;
 	
-		usleep(1000); /*0.001 seconds.*/
+		MemBus_Idle(1); /*0.001 seconds, unless they ping sooner.*/
 		
 		if (Counter == 0) ++Counter;
 		else if (Counter >= 10000) /*Sleep ten seconds.*/
@@ -528,18 +631,18 @@ void ReexecuteEpoch(void)
 	/*PIDs and started states.
 	 * It doesn't matter if they are done eating the PID,
 	 * MemBus_*Write() blocks until they're done with the first message.*/
-	for (; Worker->Next; Worker = Worker->Next)
+	for (; Worker->ObjectID; ++Worker)
 	{
 		unsigned TLength = 0;
 		strncpy(OutBuf + MCodeLength, Worker->ObjectID, (TLength = strlen(Worker->ObjectID) + 1));
 		
-		OurLong = Worker->ObjectPID;
+		OurLong = Worker->State->ObjectPID;
 		memcpy(OutBuf + MCodeLength + TLength, &OurLong, sizeof(long));
 		
-		OurLong = Worker->Started;
+		OurLong = Worker->State->Started;
 		memcpy(OutBuf + sizeof(long) + TLength + MCodeLength, &OurLong, sizeof(Bool));
 		
-		OurLong = Worker->StartedSince;
+		OurLong = Worker->State->StartedSince;
 		memcpy(OutBuf + sizeof(long) + sizeof(Bool) + TLength + MCodeLength, &OurLong, sizeof(long));
 		
 		MemBus_BinWrite(OutBuf, sizeof OutBuf, true);
@@ -583,7 +686,7 @@ void ReexecuteEpoch(void)
 	strncpy(OutBuf + MCodeLength, CurRunlevel, strlen(CurRunlevel) + 1);
 	MemBus_BinWrite(OutBuf, sizeof OutBuf, true);
 	
-	while (!MemBus_Read(OutBuf, true)) usleep(100); /*Wait for the main process to say we can quit.*/
+	while (!MemBus_Read(OutBuf, true)) MemBus_Wait(true); /*Wait for the main process to say we can quit.*/
 	ShutdownMemBus(true); /*Nothing is deleted until the new process releases the lock, don't worry.*/
 	ShutdownConfig();
 	
@@ -632,9 +735,12 @@ void PerformExec(const char *Cmd)
 	/*Fill the last cell with nothing, as mandated by execvp().*/
 	Buffer[NumSpaces] = NULL;
 	
+	Log_Close();
+	Journal_Close();
 	sync(); /*Sync disks.*/
 	
 	ShutdownMemBus(true); /*Shutdown membus since we won't need it anymore.*/
+	Control_Shutdown();
 
 	for (Inc = 1; Inc < NSIG; ++Inc)
 	{ /*Reset signal handlers.*/
@@ -684,32 +790,15 @@ void PerformPivotRoot(const char *NewRoot, const char *OldRootDir)
 
 
 void FinaliseLogStartup(Bool BlankLog)
-{
-	if (MemLogBuffer != NULL)
-	{ /*Switch logging out of memory mode and write it's memory buffer to disk.*/		
-		if (EnableLogging)
-		{
-			FILE *Descriptor = fopen(LogFile, (BlankLog ? "w" : "a"));
-
-			LogInMemory = false;
-
-			if (!Descriptor)
-			{
-				SpitWarning("Cannot record logs to disk. Shutting down logging.");
-				EnableLogging = false;
-			}
-			else
-			{
-				fwrite(MemLogBuffer, 1, strlen(MemLogBuffer), Descriptor);
-				fflush(Descriptor);
-				fclose(Descriptor);
-			}
-			
-		}
-		
-		free(MemLogBuffer); /*Release the memory anyways.*/
-		MemLogBuffer = NULL;
+{ /*Switch logging out of memory mode and write what the log ring gathered to disk.*/
+	if (EnableLogging && !Log_Begin(BlankLog))
+	{
+		SpitWarning("Cannot record logs to disk. Shutting down logging.");
+		EnableLogging = false;
 	}
+	
+	LogInMemory = false; /*Even without the text log. The journal and captured output go to disk too.*/
+	Journal_Flush(); /*Opens the journal, with whatever it gathered so far.*/
 }
 
 void LaunchBootup(void)
@@ -858,6 +947,8 @@ void LaunchBootup(void)
 	
 	FinaliseLogStartup(BlankLogOnBoot); /*Write anything in the log's memory to disk.
 		* NOTE: It's possible for data to be in here even if logging is disabled, so don't touch.*/
+	
+	ConfigCache_Flush(); /*If / was read-only when we compiled the configuration, it probably isn't now.*/
 					
 	WriteLogLine(CONSOLE_COLOR_GREEN "Bootup complete.\n" CONSOLE_ENDCOLOR, true);
 
@@ -873,6 +964,8 @@ void LaunchBootup(void)
 		putc('\007', stderr); /*Beep.*/
 	}
 	
+	Control_Init(); /*If there's no /run yet, Control_Tick() keeps trying.*/
+	
 	PrimaryLoop(); /*Does everything after initial boot.*/
 }
 
@@ -906,9 +999,13 @@ void LaunchShutdown(int Signal)
 		WriteLogLine(LogMsg, true);
 	}
 	
+	Log_Close(); /*Don't hold the filesystem it's on busy.*/
+	Journal_Close();
 
 	EnableLogging = false; /*Prevent any additional log entries.*/
 	
+	Overlay_Sync(true); /*While the filesystems are still mounted.*/
+	
 	/*Kill any running jobs.*/
 	if (CurrentTask.Set)
 	{
@@ -936,6 +1033,8 @@ void LaunchShutdown(int Signal)
 		SpitWarning("Failed to shut down membus interface.");
 	}
 	
+	Control_Shutdown();
+	
 	if (Signal == OSCTL_HALT || Signal == OSCTL_POWEROFF)
 	{
 		printf("%s", CONSOLE_COLOR_RED "Shutting down.\n" CONSOLE_ENDCOLOR "\n");
@@ -988,9 +1087,15 @@ static void ApplyGlobalEnvVars(void)
 	
 	for (; Worker->Next; Worker = Worker->Next)
 	{
-		char OutBuf[MAX_LINE_SIZE];
+		char OutBuf[MAX_LINE_SIZE], VarName[MAX_LINE_SIZE];
+		const char *Value = strchr(Worker->EnvVar, '=');
+		
+		if (!Value) continue;
+		
+		/*Not putenv(), because the string lives in the config arena and goes away on reload.*/
+		snprintf(VarName, sizeof VarName, "%.*s", (int)(Value - Worker->EnvVar), Worker->EnvVar);
+		setenv(VarName, Value + 1, true);
 		
-		putenv(Worker->EnvVar);
 		snprintf(OutBuf, sizeof OutBuf, "Set global environment variable \"%s\"", Worker->EnvVar);
 		WriteLogLine(OutBuf, true);
 	}
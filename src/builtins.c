@@ -0,0 +1,424 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**This file has the BUILTIN actions, which objects can use as commands
+ * for the little jobs that make up most of a boot, like "BUILTIN mkdir -p /run/lock".
+ * They run right inside Epoch, so they don't cost a fork and exec each.**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mount.h>
+#include "epoch.h"
+
+struct _BuiltinAction
+{
+	const char *Name;
+	const char *Usage;
+	unsigned MinArgs; /*Not counting the name.*/
+	Bool (*Func)(char **ArgV, char *ErrBuf, size_t ErrSize);
+};
+
+static Bool Builtin_Mkdir(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Mount(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Umount(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Write(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Append(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Symlink(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Sysctl(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Chmod(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Hostname(char **ArgV, char *ErrBuf, size_t ErrSize);
+static Bool Builtin_Touch(char **ArgV, char *ErrBuf, size_t ErrSize);
+
+static const struct _BuiltinAction BuiltinActions[] = {
+	{ "mkdir", "mkdir [-p] [-m mode] directory...", 1, Builtin_Mkdir },
+	{ "mount", "mount [-t type] [-o options] source target", 2, Builtin_Mount },
+	{ "umount", "umount [-l] target...", 1, Builtin_Umount },
+	{ "write", "write file text...", 1, Builtin_Write },
+	{ "append", "append file text...", 1, Builtin_Append },
+	{ "symlink", "symlink target linkname", 2, Builtin_Symlink },
+	{ "sysctl", "sysctl name=value...", 1, Builtin_Sysctl },
+	{ "chmod", "chmod octalmode path...", 2, Builtin_Chmod },
+	{ "hostname", "hostname name", 1, Builtin_Hostname },
+	{ "touch", "touch file...", 1, Builtin_Touch },
+	{ NULL }
+};
+
+static const struct _BuiltinAction *Builtin_Lookup(const char *Name)
+{
+	const struct _BuiltinAction *Worker = BuiltinActions;
+	
+	for (; Worker->Name; ++Worker)
+	{
+		if (!strcmp(Worker->Name, Name)) return Worker;
+	}
+	
+	return NULL;
+}
+
+static unsigned Builtin_CountArgs(char **ArgV)
+{ /*Not counting the name.*/
+	unsigned Inc = 1;
+	
+	for (; ArgV[Inc]; ++Inc);
+	
+	return Inc - 1;
+}
+
+static Bool Builtin_ParseMode(const char *InStream, mode_t *OutMode)
+{ /*Octal only. Symbolic modes aren't worth it here.*/
+	char *End = NULL;
+	const unsigned long Mode = strtoul(InStream, &End, 8);
+	
+	if (!*InStream || *End || Mode > 07777) return false;
+	
+	*OutMode = Mode;
+	return true;
+}
+
+static Bool Builtin_Mkdir(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	Bool Parents = false;
+	mode_t Mode = 0755;
+	struct stat FileStat;
+	int Error = 0;
+	
+	for (++ArgV; *ArgV && **ArgV == '-'; ++ArgV)
+	{
+		if (!strcmp(*ArgV, "-p")) Parents = true;
+		else if (!strcmp(*ArgV, "-m") && ArgV[1] && Builtin_ParseMode(ArgV[1], &Mode)) ++ArgV;
+		else
+		{
+			snprintf(ErrBuf, ErrSize, "bad option \"%s\"", *ArgV);
+			return false;
+		}
+	}
+	
+	for (; *ArgV; ++ArgV)
+	{
+		char Path[MAX_LINE_SIZE], *Worker = Path;
+		
+		snprintf(Path, sizeof Path, "%s", *ArgV);
+		
+		/*Each parent on the way down, then the directory itself.*/
+		while (Parents && (Worker = strchr(Worker + 1, '/')))
+		{
+			*Worker = '\0';
+			
+			if (mkdir(Path, 0755) == -1 && errno != EEXIST)
+			{
+				snprintf(ErrBuf, ErrSize, "cannot create \"%s\": %s", Path, strerror(errno));
+				return false;
+			}
+			
+			*Worker = '/';
+		}
+		
+		if (mkdir(Path, Mode) == 0) continue;
+		
+		Error = errno;
+		
+		/*With -p, only something else being in the way is a problem.*/
+		if (Error != EEXIST || !Parents || stat(Path, &FileStat) != 0 || !S_ISDIR(FileStat.st_mode))
+		{
+			snprintf(ErrBuf, ErrSize, "cannot create \"%s\": %s", Path, strerror(Error == EEXIST && Parents ? ENOTDIR : Error));
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+static Bool Builtin_Mount(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	static const struct { const char *Name; unsigned long Set, Clear; } Flags[] = {
+		{ "defaults", 0, 0 }, { "ro", MS_RDONLY, 0 }, { "rw", 0, MS_RDONLY },
+		{ "nosuid", MS_NOSUID, 0 }, { "suid", 0, MS_NOSUID }, { "nodev", MS_NODEV, 0 }, { "dev", 0, MS_NODEV },
+		{ "noexec", MS_NOEXEC, 0 }, { "exec", 0, MS_NOEXEC }, { "sync", MS_SYNCHRONOUS, 0 }, { "async", 0, MS_SYNCHRONOUS },
+		{ "remount", MS_REMOUNT, 0 }, { "bind", MS_BIND, 0 }, { "rbind", MS_BIND | MS_REC, 0 },
+		{ "noatime", MS_NOATIME, 0 }, { "nodiratime", MS_NODIRATIME, 0 },
+		{ "relatime", MS_RELATIME, 0 }, { "strictatime", MS_STRICTATIME, 0 },
+		{ "private", MS_PRIVATE, 0 }, { "rprivate", MS_PRIVATE | MS_REC, 0 },
+		{ "shared", MS_SHARED, 0 }, { "rshared", MS_SHARED | MS_REC, 0 },
+		{ "slave", MS_SLAVE, 0 }, { "rslave", MS_SLAVE | MS_REC, 0 },
+		{ NULL } };
+	const char *Type = NULL, *Options = "";
+	char Data[MAX_LINE_SIZE] = { '\0' }, Option[MAX_LINE_SIZE];
+	unsigned long MountFlags = 0;
+	size_t DataLength = 0, Length = 0;
+	unsigned Inc = 0;
+	
+	for (++ArgV; *ArgV && **ArgV == '-' && ArgV[1]; ArgV += 2)
+	{
+		if (!strcmp(*ArgV, "-t")) Type = ArgV[1];
+		else if (!strcmp(*ArgV, "-o")) Options = ArgV[1];
+		else break;
+	}
+	
+	if (!ArgV[0] || !ArgV[1] || ArgV[2])
+	{
+		snprintf(ErrBuf, ErrSize, "needs exactly a source and a target");
+		return false;
+	}
+	
+	/*Flags the kernel knows become flags, and the rest is for the filesystem.*/
+	for (; *Options; Options += Length + (Options[Length] == ','))
+	{
+		Length = strcspn(Options, ",");
+		snprintf(Option, sizeof Option, "%.*s", (int)Length, Options);
+		
+		for (Inc = 0; Flags[Inc].Name && strcmp(Flags[Inc].Name, Option) != 0; ++Inc);
+		
+		if (Flags[Inc].Name)
+		{
+			MountFlags = (MountFlags | Flags[Inc].Set) & ~Flags[Inc].Clear;
+		}
+		else if (*Option)
+		{
+			DataLength += snprintf(Data + DataLength, sizeof Data - DataLength, DataLength ? ",%s" : "%s", Option);
+			if (DataLength >= sizeof Data) DataLength = sizeof Data - 1;
+		}
+	}
+	
+	if (!Type && !(MountFlags & (MS_BIND | MS_REMOUNT | MS_PRIVATE | MS_SHARED | MS_SLAVE)))
+	{
+		snprintf(ErrBuf, ErrSize, "needs -t, since we don't guess filesystem types");
+		return false;
+	}
+	
+	if (mount(ArgV[0], ArgV[1], Type, MountFlags, *Data ? Data : NULL) != 0)
+	{
+		snprintf(ErrBuf, ErrSize, "cannot mount \"%s\" on \"%s\": %s", ArgV[0], ArgV[1], strerror(errno));
+		return false;
+	}
+	
+	return true;
+}
+
+static Bool Builtin_Umount(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	int Flags = 0;
+	
+	if (ArgV[1] && !strcmp(ArgV[1], "-l"))
+	{
+		Flags = MNT_DETACH;
+		++ArgV;
+	}
+	
+	if (!ArgV[1])
+	{
+		snprintf(ErrBuf, ErrSize, "needs a target");
+		return false;
+	}
+	
+	for (++ArgV; *ArgV; ++ArgV)
+	{
+		if (umount2(*ArgV, Flags) != 0)
+		{
+			snprintf(ErrBuf, ErrSize, "cannot unmount \"%s\": %s", *ArgV, strerror(errno));
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+static Bool Builtin_WriteFile(const char *Path, int Flags, char **Words, char *ErrBuf, size_t ErrSize)
+{ /*The words with spaces between and a newline after, like echo gives.
+	* One write(), because lots of things in /proc and /sys only take one.*/
+	char Text[MAX_LINE_SIZE];
+	size_t Length = 0;
+	int Descriptor = 0;
+	ssize_t Written = 0;
+	
+	for (; *Words && Length < sizeof Text - 1; ++Words)
+	{
+		Length += snprintf(Text + Length, sizeof Text - Length, Length ? " %s" : "%s", *Words);
+	}
+	
+	if (Length >= sizeof Text - 1)
+	{
+		snprintf(ErrBuf, ErrSize, "text for \"%s\" is too long", Path);
+		return false;
+	}
+	
+	Text[Length++] = '\n';
+	
+	if ((Descriptor = open(Path, Flags | O_CLOEXEC | O_NOCTTY, 0644)) == -1)
+	{
+		snprintf(ErrBuf, ErrSize, "cannot open \"%s\": %s", Path, strerror(errno));
+		return false;
+	}
+	
+	Written = write(Descriptor, Text, Length);
+	
+	if (Written != (ssize_t)Length)
+	{
+		snprintf(ErrBuf, ErrSize, "cannot write \"%s\": %s", Path, Written == -1 ? strerror(errno) : "short write");
+		close(Descriptor);
+		return false;
+	}
+	
+	if (close(Descriptor) != 0)
+	{
+		snprintf(ErrBuf, ErrSize, "cannot write \"%s\": %s", Path, strerror(errno));
+		return false;
+	}
+	
+	return true;
+}
+
+static Bool Builtin_Write(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	return Builtin_WriteFile(ArgV[1], O_WRONLY | O_CREAT | O_TRUNC, ArgV + 2, ErrBuf, ErrSize);
+}
+
+static Bool Builtin_Append(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	return Builtin_WriteFile(ArgV[1], O_WRONLY | O_CREAT | O_APPEND, ArgV + 2, ErrBuf, ErrSize);
+}
+
+static Bool Builtin_Symlink(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	char Existing[MAX_LINE_SIZE];
+	ssize_t Length = 0;
+	
+	if (symlink(ArgV[1], ArgV[2]) == 0) return true;
+	
+	/*Already there and pointing the same place is fine. That's what a second boot looks like.*/
+	if (errno == EEXIST && (Length = readlink(ArgV[2], Existing, sizeof Existing - 1)) != -1)
+	{
+		Existing[Length] = '\0';
+		if (!strcmp(Existing, ArgV[1])) return true;
+		
+		errno = EEXIST;
+	}
+	
+	snprintf(ErrBuf, ErrSize, "cannot link \"%s\" to \"%s\": %s", ArgV[2], ArgV[1], strerror(errno));
+	return false;
+}
+
+static Bool Builtin_Sysctl(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	char Path[MAX_LINE_SIZE], *Worker = NULL;
+	const char *Value = NULL;
+	char *Words[2] = { NULL };
+	
+	for (++ArgV; *ArgV; ++ArgV)
+	{
+		if (!(Value = strchr(*ArgV, '=')) || Value == *ArgV)
+		{
+			snprintf(ErrBuf, ErrSize, "\"%s\" isn't name=value", *ArgV);
+			return false;
+		}
+		
+		snprintf(Path, sizeof Path, "/proc/sys/%.*s", (int)(Value - *ArgV), *ArgV);
+		
+		for (Worker = Path + sizeof "/proc/sys/" - 1; *Worker; ++Worker)
+		{
+			if (*Worker == '.') *Worker = '/';
+		}
+		
+		*Words = (char*)Value + 1;
+		
+		if (!Builtin_WriteFile(Path, O_WRONLY | O_TRUNC, Words, ErrBuf, ErrSize)) return false;
+	}
+	
+	return true;
+}
+
+static Bool Builtin_Chmod(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	mode_t Mode = 0;
+	
+	if (!Builtin_ParseMode(ArgV[1], &Mode))
+	{
+		snprintf(ErrBuf, ErrSize, "bad mode \"%s\", it must be octal", ArgV[1]);
+		return false;
+	}
+	
+	for (ArgV += 2; *ArgV; ++ArgV)
+	{
+		if (chmod(*ArgV, Mode) != 0)
+		{
+			snprintf(ErrBuf, ErrSize, "cannot chmod \"%s\": %s", *ArgV, strerror(errno));
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+static Bool Builtin_Hostname(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	if (ArgV[2] || sethostname(ArgV[1], strlen(ArgV[1])) != 0)
+	{
+		snprintf(ErrBuf, ErrSize, "cannot set hostname to \"%s\": %s", ArgV[1], ArgV[2] ? "too many arguments" : strerror(errno));
+		return false;
+	}
+	
+	return true;
+}
+
+static Bool Builtin_Touch(char **ArgV, char *ErrBuf, size_t ErrSize)
+{
+	int Descriptor = 0;
+	
+	for (++ArgV; *ArgV; ++ArgV)
+	{
+		if ((Descriptor = open(*ArgV, O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK | O_CLOEXEC, 0644)) == -1 ||
+			futimens(Descriptor, NULL) != 0)
+		{
+			snprintf(ErrBuf, ErrSize, "cannot touch \"%s\": %s", *ArgV, strerror(errno));
+			if (Descriptor != -1) close(Descriptor);
+			return false;
+		}
+		
+		close(Descriptor);
+	}
+	
+	return true;
+}
+
+Bool Builtin_Check(char **ArgV, char *OutErr, size_t OutSize)
+{ /*At load time, so typos show up then and not halfway through boot.*/
+	const struct _BuiltinAction *const Action = *ArgV ? Builtin_Lookup(*ArgV) : NULL;
+	
+	if (!Action)
+	{
+		snprintf(OutErr, OutSize, "unknown BUILTIN action \"%s\"", *ArgV ? *ArgV : "");
+		return false;
+	}
+	
+	if (Builtin_CountArgs(ArgV) < Action->MinArgs)
+	{
+		snprintf(OutErr, OutSize, "usage is BUILTIN %s", Action->Usage);
+		return false;
+	}
+	
+	return true;
+}
+
+ReturnCode Builtin_Run(char **ArgV, const char *ObjectID)
+{ /*ArgV starts with the action's name. Builtin_Check() has already been happy with it.*/
+	const struct _BuiltinAction *const Action = Builtin_Lookup(*ArgV);
+	char ErrBuf[MAX_LINE_SIZE / 2], OutBuf[MAX_LINE_SIZE];
+	
+	*ErrBuf = '\0';
+	
+	if (Action && Action->Func(ArgV, ErrBuf, sizeof ErrBuf)) return SUCCESS;
+	
+	snprintf(OutBuf, sizeof OutBuf, "BUILTIN %s for object %s failed: %s", *ArgV, ObjectID,
+			Action ? ErrBuf : "no such action");
+	SmallError(OutBuf);
+	WriteLogLine(OutBuf, true);
+	
+	return FAILURE;
+}
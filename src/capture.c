@@ -0,0 +1,454 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**This file handles objects whose output Epoch captures itself, with "ObjectStdout=CAPTURE".
+ * Each such object writes into a pipe we read from the primary loop. Lines get a timestamp
+ * and go into a small ring per object, which 'epoch logs' reads, and optionally on to a file.**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include "epoch.h"
+
+/*The longest line we keep whole. Anything longer is split.*/
+#define CAPTURE_LINE_MAX 1024
+/*How many reads one object gets each time its pipe is ready, so a flood can't starve the rest.*/
+#define CAPTURE_MAX_READS 16
+/*Where the file descriptors go across a reexec.*/
+#define CAPTURE_ENVVAR "EPOCH_CAPTURE_FDS"
+
+struct _CaptureChannel
+{
+	char *ObjectID; /*Our own copy, since we outlive configuration reloads.*/
+	int ReadFD, WriteFD; /*We keep the write end too, so the pipe is the same every time the object starts.*/
+	struct _LogRing Ring;
+	
+	char Partial[CAPTURE_LINE_MAX];
+	size_t PartialLength;
+	
+	time_t RateSecond;
+	unsigned RateCount;
+	unsigned long Suppressed;
+	
+	int FileFD; /*-1 while we aren't forwarding anywhere.*/
+	char *FilePath;
+	off_t FileSize;
+	time_t FileSince; /*For LogRotate's age limit.*/
+	
+	struct _CaptureChannel *Next;
+};
+
+static struct _CaptureChannel *Channels;
+static unsigned NumChannels;
+
+/*Lines on their way to a channel's file. Written out once per drain, or when full.*/
+static char Batch[16384];
+static size_t BatchUsed;
+
+static const struct _RotatePolicy *Capture_Policy(void)
+{ /*LogRotate if there is one, since these files are logs like any other. If not, we still don't let them grow forever.*/
+	static const struct _RotatePolicy Default = { CAPTURE_FILE_MAX, 0, 1 };
+	
+	return LogRotate.MaxSize || LogRotate.MaxAge ? &LogRotate : &Default;
+}
+
+static struct _CaptureChannel *Capture_Find(const char *ObjectID)
+{
+	struct _CaptureChannel *Worker = Channels;
+	
+	for (; Worker; Worker = Worker->Next)
+	{
+		if (!strcmp(Worker->ObjectID, ObjectID)) return Worker;
+	}
+	
+	return NULL;
+}
+
+static struct _CaptureChannel *Capture_Add(const char *ObjectID, int ReadFD, int WriteFD)
+{
+	struct _CaptureChannel *Chan = calloc(1, sizeof(struct _CaptureChannel));
+	const size_t IDLength = strlen(ObjectID) + 1;
+	
+	if (!Chan) return NULL;
+	
+	Chan->ObjectID = malloc(IDLength);
+	Chan->Ring.Data = malloc(CAPTURE_RING_SIZE);
+	
+	if (!Chan->ObjectID || !Chan->Ring.Data)
+	{
+		free(Chan->ObjectID);
+		free(Chan->Ring.Data);
+		free(Chan);
+		return NULL;
+	}
+	
+	memcpy(Chan->ObjectID, ObjectID, IDLength);
+	Chan->Ring.Size = CAPTURE_RING_SIZE;
+	Chan->ReadFD = ReadFD;
+	Chan->WriteFD = WriteFD;
+	Chan->FileFD = -1;
+	
+	/*Both ends stay out of everything we spawn, except where we hand the write end over ourselves.*/
+	fcntl(ReadFD, F_SETFD, FD_CLOEXEC);
+	fcntl(WriteFD, F_SETFD, FD_CLOEXEC);
+	fcntl(ReadFD, F_SETFL, fcntl(ReadFD, F_GETFL) | O_NONBLOCK);
+	
+	Chan->Next = Channels;
+	Channels = Chan;
+	++NumChannels;
+	
+	return Chan;
+}
+
+int Capture_Prepare(const ObjTable *InObj)
+{ /*The descriptor the object's stdout and/or stderr should be pointed at, or -1 if it isn't captured.*/
+	struct _CaptureChannel *Chan = NULL;
+	int Pipe[2];
+	
+	if (!InObj->Opts.CaptureStdout && !InObj->Opts.CaptureStderr) return -1;
+	
+	if ((Chan = Capture_Find(InObj->ObjectID)) != NULL) return Chan->WriteFD;
+	
+	if (pipe(Pipe) != 0)
+	{
+		char ErrBuf[MAX_LINE_SIZE];
+		
+		snprintf(ErrBuf, sizeof ErrBuf, "Unable to create a pipe to capture the output of object %s: %s",
+				InObj->ObjectID, strerror(errno));
+		WriteLogLine(ErrBuf, true);
+		return -1;
+	}
+	
+	if (!(Chan = Capture_Add(InObj->ObjectID, Pipe[0], Pipe[1])))
+	{
+		close(Pipe[0]);
+		close(Pipe[1]);
+		return -1;
+	}
+	
+	return Chan->WriteFD;
+}
+
+Bool Capture_Active(void)
+{
+	return Channels != NULL;
+}
+
+const struct _LogRing *Capture_Ring(const char *ObjectID)
+{
+	struct _CaptureChannel *Chan = Capture_Find(ObjectID);
+	
+	return Chan ? &Chan->Ring : NULL;
+}
+
+static void Capture_Forward(struct _CaptureChannel *Chan, const char *Path)
+{ /*Sends the batch to the object's file, rotating it first if it's due.
+	* We're the only writer, so nothing can land in the old file after the rename.*/
+	const size_t Length = BatchUsed;
+	
+	BatchUsed = 0;
+	
+	if (Chan->FileFD != -1 && (!Path || !Chan->FilePath || strcmp(Path, Chan->FilePath) != 0))
+	{ /*The configuration changed where this goes.*/
+		close(Chan->FileFD);
+		free(Chan->FilePath);
+		Chan->FileFD = -1;
+		Chan->FilePath = NULL;
+	}
+	
+	if (!Length || !Path || LogInMemory) return; /*Nowhere to put it yet, but it's still in the ring.*/
+	
+	if (Chan->FileFD != -1 && Rotate_Due(Capture_Policy(), Chan->FileSize, Length, Chan->FileSince))
+	{
+		close(Chan->FileFD);
+		Chan->FileFD = -1;
+		Rotate_Shift(Chan->FilePath, Capture_Policy()->Keep);
+	}
+	
+	if (Chan->FileFD == -1)
+	{
+		struct stat FileStat;
+		
+		if ((Chan->FileFD = open(Path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) == -1) return;
+		
+		if (Chan->FilePath != Path)
+		{
+			free(Chan->FilePath);
+			Chan->FilePath = strdup(Path);
+		}
+		
+		Chan->FileSize = fstat(Chan->FileFD, &FileStat) == 0 ? FileStat.st_size : 0;
+		Chan->FileSince = Rotate_Since(Path, time(NULL));
+	}
+	
+	if (write(Chan->FileFD, Batch, Length) > 0) Chan->FileSize += Length;
+}
+
+static void Capture_Store(struct _CaptureChannel *Chan, const char *Line, size_t Length, const char *Path)
+{ /*One finished line, without its newline.*/
+	char OutBuf[CAPTURE_LINE_MAX + 128];
+	size_t OutLength;
+	
+	OutLength = snprintf(OutBuf, sizeof OutBuf, "%s ", Log_Timestamp());
+	memcpy(OutBuf + OutLength, Line, Length);
+	OutLength += Length;
+	OutBuf[OutLength++] = '\n';
+	
+	LogRing_Append(&Chan->Ring, OutBuf, OutLength);
+	
+	if (!Path) return;
+	
+	if (BatchUsed + OutLength > sizeof Batch) Capture_Forward(Chan, Path);
+	
+	memcpy(Batch + BatchUsed, OutBuf, OutLength);
+	BatchUsed += OutLength;
+}
+
+static void Capture_Line(struct _CaptureChannel *Chan, const char *Line, size_t Length, unsigned Rate, const char *Path)
+{ /*Applies the object's rate limit. Whatever we drop is counted, and we say so once it calms down.*/
+	const time_t Now = time(NULL);
+	
+	if (Now != Chan->RateSecond)
+	{
+		Chan->RateSecond = Now;
+		Chan->RateCount = 0;
+		
+		if (Chan->Suppressed)
+		{
+			char Notice[128];
+			
+			snprintf(Notice, sizeof Notice, "[Epoch: %lu lines were suppressed by the LOGRATE limit.]", Chan->Suppressed);
+			Capture_Store(Chan, Notice, strlen(Notice), Path);
+			Chan->Suppressed = 0;
+		}
+	}
+	
+	if (Rate && Chan->RateCount >= Rate)
+	{
+		++Chan->Suppressed;
+		return;
+	}
+	
+	++Chan->RateCount;
+	Capture_Store(Chan, Line, Length, Path);
+	Journal_Write(Chan->ObjectID, JOURNAL_INFO, Line, Length);
+}
+
+static void Capture_Drain(struct _CaptureChannel *Chan)
+{
+	const ObjTable *Obj = LookupObjectInTable(Chan->ObjectID);
+	const unsigned Rate = Obj ? Obj->Opts.LogRate : 0;
+	const char *Path = Obj ? Obj->CaptureFile : NULL;
+	char InBuf[4096];
+	ssize_t Got;
+	int Inc = 0;
+	
+	for (; Inc < CAPTURE_MAX_READS && (Got = read(Chan->ReadFD, InBuf, sizeof InBuf)) > 0; ++Inc)
+	{
+		const char *Worker = InBuf, *const End = InBuf + Got;
+		
+		while (Worker < End)
+		{
+			const char *Newline = memchr(Worker, '\n', End - Worker);
+			size_t Length = (Newline ? Newline : End) - Worker;
+			
+			if (Length > sizeof Chan->Partial - Chan->PartialLength) Length = sizeof Chan->Partial - Chan->PartialLength;
+			
+			if (!Chan->PartialLength && Newline && Worker + Length == Newline)
+			{ /*The usual case, a whole line we don't need to copy first.*/
+				Capture_Line(Chan, Worker, Length, Rate, Path);
+				Worker = Newline + 1;
+				continue;
+			}
+			
+			memcpy(Chan->Partial + Chan->PartialLength, Worker, Length);
+			Chan->PartialLength += Length;
+			Worker += Length;
+			
+			if (Worker == Newline || Chan->PartialLength == sizeof Chan->Partial)
+			{
+				Capture_Line(Chan, Chan->Partial, Chan->PartialLength, Rate, Path);
+				Chan->PartialLength = 0;
+				
+				if (Worker == Newline) ++Worker;
+			}
+		}
+	}
+	
+	Capture_Forward(Chan, Path);
+}
+
+Bool Capture_Wait(unsigned Milliseconds, Bool WatchBus)
+{ /*Our sleep. We spend it reading whatever captured objects write.
+	* With WatchBus, a membus or control socket client cuts it short and we return true.*/
+	const Bool Sockets = WatchBus && Control_Active();
+	struct _CaptureChannel *Worker = Channels;
+	struct timespec Now, Deadline;
+	unsigned Inc = 0, NumPolls;
+	
+	if (!Channels && !Sockets)
+	{
+		if (WatchBus) return MemBus_Idle(Milliseconds);
+		
+		usleep(Milliseconds * 1000);
+		return false;
+	}
+	
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+	Deadline.tv_sec += Milliseconds / 1000;
+	Deadline.tv_nsec += (Milliseconds % 1000) * 1000000L;
+	
+	if (Deadline.tv_nsec >= 1000000000L)
+	{
+		++Deadline.tv_sec;
+		Deadline.tv_nsec -= 1000000000L;
+	}
+	
+	{
+		struct pollfd Polls[NumChannels + (Sockets ? CONTROL_MAX_PEERS + 1 : 0)];
+		struct _CaptureChannel *Owners[NumChannels + 1];
+		long Remaining;
+		
+		for (; Worker; Worker = Worker->Next, ++Inc)
+		{
+			Polls[Inc].fd = Worker->ReadFD;
+			Polls[Inc].events = POLLIN;
+			Owners[Inc] = Worker;
+		}
+		
+		NumPolls = NumChannels + (Sockets ? Control_PollSet(Polls + NumChannels) : 0);
+		
+		do
+		{
+			Bool Client = false;
+			
+			clock_gettime(CLOCK_MONOTONIC, &Now);
+			Remaining = (Deadline.tv_sec - Now.tv_sec) * 1000 + (Deadline.tv_nsec - Now.tv_nsec) / 1000000;
+			
+			if (Remaining < 0) Remaining = 0;
+			
+			if (Sockets)
+			{ /*Clients mostly come in on the socket now, so we sleep on that and look at the membus between slices.*/
+				if (MemBus_Pending()) return true;
+				
+				if (Remaining > CAPTURE_BUS_SLICE) Remaining = CAPTURE_BUS_SLICE;
+				
+				if (poll(Polls, NumPolls, Remaining) <= 0) continue;
+				
+				for (Inc = NumChannels; Inc < NumPolls; ++Inc)
+				{
+					if (Polls[Inc].revents) Client = true;
+				}
+			}
+			else if (WatchBus)
+			{ /*A futex can't sit in a poll set. The bus is what someone is waiting on, so we sleep on it,
+				* and empty the pipes every CAPTURE_BUS_SLICE. They hold plenty for that long.*/
+				if (Remaining > CAPTURE_BUS_SLICE) Remaining = CAPTURE_BUS_SLICE;
+				
+				if (Remaining && MemBus_Idle(Remaining)) return true;
+				
+				if (poll(Polls, NumChannels, 0) <= 0) continue;
+			}
+			else
+			{
+				switch (poll(Polls, NumChannels, Remaining))
+				{
+					case -1: /*A signal, same as usleep().*/
+						return false;
+					case 0:
+						continue;
+					default:
+						break;
+				}
+			}
+			
+			for (Inc = 0; Inc < NumChannels; ++Inc)
+			{
+				if (Polls[Inc].revents) Capture_Drain(Owners[Inc]);
+			}
+			
+			if (Client) return true;
+		} while (Remaining > 0);
+	}
+	
+	return false;
+}
+
+void Capture_Tick(void)
+{ /*Rotation by age, for objects that have gone quiet. Size is checked as we write.*/
+	struct _CaptureChannel *Worker = Channels;
+	
+	if (!LogRotate.MaxAge) return;
+	
+	for (; Worker; Worker = Worker->Next)
+	{
+		if (Worker->FileFD != -1 && Rotate_Due(&LogRotate, Worker->FileSize, 0, Worker->FileSince))
+		{
+			close(Worker->FileFD);
+			Worker->FileFD = -1;
+			Rotate_Shift(Worker->FilePath, LogRotate.Keep);
+		}
+	}
+}
+
+void Capture_Handoff(Bool Leaving)
+{ /*Lets the pipes survive a reexec, so captured objects don't lose their stdout under us.
+	* Called with false to take it back if the exec fails.*/
+	struct _CaptureChannel *Worker = Channels;
+	char *List = NULL;
+	size_t ListSize = 1;
+	
+	if (!Leaving)
+	{
+		unsetenv(CAPTURE_ENVVAR);
+	}
+	else
+	{
+		for (; Worker; Worker = Worker->Next) ListSize += strlen(Worker->ObjectID) + 32;
+		
+		if (!(List = calloc(1, ListSize))) return;
+	}
+	
+	for (Worker = Channels; Worker; Worker = Worker->Next)
+	{
+		fcntl(Worker->ReadFD, F_SETFD, Leaving ? 0 : FD_CLOEXEC);
+		fcntl(Worker->WriteFD, F_SETFD, Leaving ? 0 : FD_CLOEXEC);
+		
+		if (Leaving)
+		{
+			snprintf(List + strlen(List), ListSize - strlen(List), "%d %d %s\n", Worker->ReadFD, Worker->WriteFD, Worker->ObjectID);
+		}
+	}
+	
+	if (Leaving)
+	{
+		setenv(CAPTURE_ENVVAR, List, true);
+		free(List);
+	}
+}
+
+void Capture_Adopt(void)
+{ /*Picks up the pipes the previous image left us.*/
+	const char *Worker = getenv(CAPTURE_ENVVAR);
+	char ObjectID[MAX_LINE_SIZE];
+	int ReadFD, WriteFD, Length;
+	
+	if (!Worker) return;
+	
+	while (sscanf(Worker, "%d %d %2047s%n", &ReadFD, &WriteFD, ObjectID, &Length) == 3)
+	{
+		if (!Capture_Find(ObjectID)) Capture_Add(ObjectID, ReadFD, WriteFD);
+		
+		Worker += Length;
+	}
+	
+	unsetenv(CAPTURE_ENVVAR);
+}
@@ -13,17 +13,44 @@
 #include <signal.h>
 #include <grp.h>
 #include <pwd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <glob.h>
+#include <stddef.h>
 #include <ctype.h>
 #include "epoch.h"
 
 #define CONFIGWARNTXT "CONFIG: " CONSOLE_COLOR_YELLOW "WARNING: " CONSOLE_ENDCOLOR
 #define CONFIGERRORTXT  "CONFIG: "CONSOLE_COLOR_RED "ERROR: " CONSOLE_ENDCOLOR
 
-/*We want the only interface for this to be LookupObjectInTable().*/
+/*We want the only interface for this to be LookupObjectInTable().
+ * Both arrays are contiguous and parallel, and ObjectTable always ends with
+ * a zeroed element whose ObjectID is NULL. ObjectTableSize doesn't count that one.*/
 ObjTable *ObjectTable;
+struct _ObjState *ObjectStates;
+unsigned ObjectTableSize;
+static unsigned ObjectTableCapacity;
 char ConfigFile[MAX_LINE_SIZE] = CONFIGDIR CONF_NAME;
-char *ConfigFileList[MAX_CONFIG_FILES] = { ConfigFile };
+
+/*Entry 0 is always ConfigFile. Once imports are added, the list lives in the arena.*/
+static char *ConfigFileListRoot[1] = { ConfigFile };
+char **ConfigFileList = ConfigFileListRoot;
 int NumConfigFiles = 1;
+static unsigned ConfigFileListCapacity = 1;
+
+/*Open-addressed index of ObjectTable by ObjectID. It's synced lazily to whichever table is live,
+ * and slots hold the table index plus one, so zero is empty.*/
+static struct
+{
+	unsigned *Slots;
+	unsigned Size; /*A power of two, at least twice Count.*/
+	const ObjTable *Table;
+	unsigned Count;
+} ObjectIndex;
 
 /*Used to allow for things like 'ObjectStartPriority Services', where Services == 3, for example.*/
 static struct _PriorityAliasTree
@@ -46,6 +73,120 @@ Epoch is just a linked list of linked lists anymore.*/
 	struct _RunlevelInheritance *Prev;
 } *RunlevelInheritance;
 
+/*Everything we build out of the configuration comes from the current generation's arena.
+ * Blocks are mapped straight from the kernel, so dropping a generation hands its pages back
+ * in one go and leaves nothing behind to fragment the heap.*/
+#define CONFIG_ARENA_BLOCKSIZE (64 * 1024)
+#define CONFIG_ARENA_ALIGN (sizeof(void*) * 2)
+
+struct _ConfigArenaBlock
+{
+	struct _ConfigArenaBlock *Next;
+	size_t Size; /*Size of the whole mapping, this header included.*/
+	size_t Used; /*Bytes used, this header included.*/
+};
+
+static struct _ConfigArena
+{
+	struct _ConfigArenaBlock *Blocks; /*Newest first. We only ever allocate from the head.*/
+	void *CacheMap; /*The compiled configuration cache, if this generation was loaded from it.*/
+	size_t CacheMapSize;
+	struct _ConfigArenaStats Stats;
+	size_t LoadedSize; /*What the generation took when it was loaded. Reloading objects in place only adds to it.*/
+} ConfigArena = { NULL, NULL, 0, { 1 } };
+
+/*The compiled configuration cache. It's a snapshot of everything InitConfig() builds, laid out
+ * by offset so it can be mapped and used in place. Strings point straight into the mapping.
+ * We only trust it while every file it was built from matches by size, mtime and contents.*/
+#define CONFIG_CACHE_MAGIC "EPOCHCC"
+#define CONFIG_CACHE_VERSION 6
+#define CONFIG_CACHE_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+/*Nothing but objects, so a reload can parse it again by itself. Snapshots from before this was a flag have it clear.*/
+#define CONFIG_DEP_STANDALONE 0x1
+/*On the primary file's entry. Some object took its priority from another object, which may be in any file.*/
+#define CONFIG_DEP_PRIORITYOF 0x2
+
+struct _ConfigCacheDep
+{ /*A file the configuration was built from.*/
+	uint32_t Path;
+	uint32_t Flags; /*CONFIG_DEP_*.*/
+	uint64_t Size;
+	int64_t MTime;
+	int64_t MTimeNsec;
+	uint64_t Hash;
+};
+
+struct _ConfigCacheObject
+{ /*Strings are offsets into the string table, lists are indexes into the list array.*/
+	uint32_t Strings[11];
+	uint32_t ConfigFile; /*Index into ConfigFileList.*/
+	uint32_t UserID, GroupID;
+	uint32_t StartPriority, StopPriority;
+	uint32_t EnvVars, NumEnvVars;
+	uint32_t Runlevels, NumRunlevels;
+	uint32_t Conditions, NumConditions; /*Stored the way ObjCondition_Describe() writes them.*/
+	uint16_t AutoRestart;
+	signed char Enabled;
+	unsigned char TermSignal, ReloadCommandSignal;
+	unsigned char ExitStatuses[sizeof ((ObjTable*)0)->ExitStatuses];
+	unsigned char Opts[sizeof ((ObjTable*)0)->Opts];
+};
+
+struct _ConfigCacheHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t Layout; /*So a build with different structures never trusts a file it didn't write.*/
+	uint64_t TotalSize;
+	uint32_t NumDeps, NumObjects, NumLists, StringsSize;
+	uint32_t DepsOffset, ObjectsOffset, ListsOffset, StringsOffset;
+	uint32_t ConfigFiles, NumConfigFiles; /*ConfigFileList[1] onwards.*/
+	uint32_t GlobalEnvVars, NumGlobalEnvVars;
+	uint32_t RLInheritance, NumRLInheritance; /*Stored as inheriter/inherited pairs.*/
+	uint32_t LogFile, Hostname, Domainname, DefaultRunlevel, JournalPath;
+	struct _BootBanner BootBanner;
+	struct _StatusReportFormat StatusReportFormat;
+	struct _RotatePolicy LogRotate;
+	unsigned char AutoMountOpts[sizeof AutoMountOpts];
+	Bool DisableCAD, BlankLogOnBoot;
+	signed char EnableLogging; /*-1 if the config never said, so whatever was in effect stays.*/
+};
+
+#define CONFIG_CACHE_LAYOUT ((uint32_t)(sizeof(ObjTable) << 20 ^ sizeof(struct _ConfigCacheObject) << 10 ^ sizeof(struct _ConfigCacheHeader)))
+
+static struct _ConfigCacheDepEntry
+{ /*Every file we read while parsing, for keying the cache.*/
+	const char *Path;
+	struct _ConfigCacheDep Key;
+} *ConfigCacheDeps;
+static unsigned NumConfigCacheDeps, ConfigCacheDepsCapacity;
+static Bool ConfigCacheUnkeyable; /*Something we read can't be keyed, so don't save or trust a snapshot.*/
+
+/*A snapshot we built but couldn't write yet, because / was still read-only.*/
+static void *ConfigCachePending;
+static size_t ConfigCachePendingSize;
+
+/*Set in a background reload child, which hands its snapshot to PID 1 before writing it out.*/
+static Bool ConfigCacheWriteDeferred;
+
+/*Set while ReloadConfig_Parse() parses changed files into a table of their own.
+ * InitConfig() stops at anything that would reach outside that table.*/
+static Bool ConfigStandaloneParse;
+
+/*A reload being parsed by a child process, so PID 1 never waits on the disk for it.*/
+static struct
+{
+	pid_t PID;
+	int Pipe;
+	unsigned char *Data; /*What the child has sent us so far.*/
+	size_t Size, Capacity;
+	Bool InChild; /*Set in the child itself, where Pipe is the write end.*/
+} BackgroundReload = { 0, -1 };
+
+/*The first DefaultRunlevel we saw, even if CurRunlevel was already set from elsewhere.*/
+static char ConfigDefaultRunlevel[MAX_DESCRIPT_SIZE];
+
 /*Holds the system hostname.*/
 char Hostname[256];
 /*Holds the system domain name.*/
@@ -53,6 +194,22 @@ char Domainname[256];
 
 /*Function forward declarations for all the statics.*/
 static ObjTable *AddObjectToTable(const char *ObjectID, const char *File);
+static Bool ObjectIndex_Sync(void);
+static ObjTable *ObjectIndex_Find(const char *ObjectID);
+static char *ConfigFileList_Add(char *Path);
+static void ConfigFileList_Reset(void);
+static ReturnCode ImportConfigGlob(const char *Pattern, const char *CurConfigFile, unsigned LineNum);
+static void ConfigArena_Drop(struct _ConfigArena *Arena);
+static uint64_t ConfigCache_Hash(const void *Data, size_t Size);
+static void ConfigCache_AddDep(const char *Path, const struct stat *FileStat, uint64_t Hash);
+static void ConfigCache_AddFileDep(const char *Path);
+static struct _ConfigCacheDepEntry *ConfigCache_FindDep(const char *Path);
+static ReturnCode ConfigCache_Load(Bool *OutLogEnable);
+static ReturnCode ConfigCache_LoadImage(unsigned char *Map, size_t MapSize, Bool CheckDeps, Bool *OutLogEnable);
+static ReturnCode ConfigCache_LoadObjects(const unsigned char *Map, size_t MapSize, const unsigned *Changed, unsigned NumChanged);
+static unsigned char *ConfigCache_Build(signed char LogEnable);
+static ReturnCode ReloadConfig_Swap(unsigned char *Image, size_t ImageSize);
+static void ReloadConfig_ChildFatal(void);
 static char *NextLine(const char *InStream);
 static ReturnCode GetLineDelim(const char *InStream, char *OutStream);
 static ReturnCode ScanConfigIntegrity(void);
@@ -62,14 +219,182 @@ static void PriorityAlias_Add(const char *Alias, unsigned Target);
 static void PriorityAlias_Shutdown(void);
 static void RLInheritance_Add(const char *Inheriter, const char *Inherited);
 static Bool RLInheritance_Check(const char *Inheriter, const char *Inherited);
-static void RLInheritance_Shutdown(void);
 static unsigned PriorityOfLookup(const char *const ObjectID, Bool IsStartingMode);
+static Bool LogRotate_Value(const char *InStream, const char *Units, const unsigned long *Scales, unsigned long long *OutValue);
 
 /*Used for error handling in InitConfig() by ConfigProblem(CurConfigFile, ).*/
 enum { CONFIG_EMISSINGVAL = 1, CONFIG_EBADVAL, CONFIG_ETRUNCATED, CONFIG_EAFTER,
 	CONFIG_EBEFORE, CONFIG_ELARGENUM };
 
+/*Every attribute InitConfig() understands, in the order it handles them.*/
+enum ConfigAttr { CONFIG_ATTR_NONE,
+	CONFIG_ATTR_IMPORT, CONFIG_ATTR_GLOBALENVVAR, CONFIG_ATTR_DISABLECAD,
+	CONFIG_ATTR_BLANKLOGONBOOT, CONFIG_ATTR_ENABLELOGGING, CONFIG_ATTR_RUNLEVELINHERITS,
+	CONFIG_ATTR_DEFINEPRIORITY, CONFIG_ATTR_MOUNTVIRTUAL, CONFIG_ATTR_BOOTBANNERTEXT,
+	CONFIG_ATTR_BOOTBANNERCOLOR, CONFIG_ATTR_DEFAULTRUNLEVEL, CONFIG_ATTR_LOGFILE, CONFIG_ATTR_JOURNALPATH,
+	CONFIG_ATTR_LOGROTATE,	CONFIG_ATTR_HOSTNAME, CONFIG_ATTR_DOMAINNAME, CONFIG_ATTR_STARTINGSTATUSFORMAT,
+	CONFIG_ATTR_FINISHEDSTATUSFORMAT, CONFIG_ATTR_STATUSNAMES, CONFIG_ATTR_OBJECTID,
+	CONFIG_ATTR_OBJECTWORKINGDIRECTORY, CONFIG_ATTR_OBJECTENABLED, CONFIG_ATTR_OBJECTOPTIONS,
+	CONFIG_ATTR_OBJECTDESCRIPTION, CONFIG_ATTR_OBJECTSTARTCOMMAND,
+	CONFIG_ATTR_OBJECTPRESTARTCOMMAND, CONFIG_ATTR_OBJECTRELOADCOMMAND,
+	CONFIG_ATTR_OBJECTSTOPCOMMAND, CONFIG_ATTR_OBJECTSTARTPRIORITY, CONFIG_ATTR_OBJECTSTOPPRIORITY,
+	CONFIG_ATTR_OBJECTPIDFILE, CONFIG_ATTR_OBJECTUSER, CONFIG_ATTR_OBJECTGROUP,
+	CONFIG_ATTR_OBJECTSTDOUT, CONFIG_ATTR_OBJECTSTDERR, CONFIG_ATTR_OBJECTENVVAR,
+	CONFIG_ATTR_OBJECTRUNLEVELS, CONFIG_ATTR_OBJECTCONDITION, CONFIG_ATTR_MAX };
+
+#define CONFIG_ATTR_NAME(x) { x, sizeof x - 1 }
+static const struct _ConfigAttrName
+{
+	const char *Name;
+	unsigned char Len;
+} ConfigAttrNames[CONFIG_ATTR_MAX] = {
+	[CONFIG_ATTR_IMPORT] = CONFIG_ATTR_NAME("Import"),
+	[CONFIG_ATTR_GLOBALENVVAR] = CONFIG_ATTR_NAME("GlobalEnvVar"),
+	[CONFIG_ATTR_DISABLECAD] = CONFIG_ATTR_NAME("DisableCAD"),
+	[CONFIG_ATTR_BLANKLOGONBOOT] = CONFIG_ATTR_NAME("BlankLogOnBoot"),
+	[CONFIG_ATTR_ENABLELOGGING] = CONFIG_ATTR_NAME("EnableLogging"),
+	[CONFIG_ATTR_RUNLEVELINHERITS] = CONFIG_ATTR_NAME("RunlevelInherits"),
+	[CONFIG_ATTR_DEFINEPRIORITY] = CONFIG_ATTR_NAME("DefinePriority"),
+	[CONFIG_ATTR_MOUNTVIRTUAL] = CONFIG_ATTR_NAME("MountVirtual"),
+	[CONFIG_ATTR_BOOTBANNERTEXT] = CONFIG_ATTR_NAME("BootBannerText"),
+	[CONFIG_ATTR_BOOTBANNERCOLOR] = CONFIG_ATTR_NAME("BootBannerColor"),
+	[CONFIG_ATTR_DEFAULTRUNLEVEL] = CONFIG_ATTR_NAME("DefaultRunlevel"),
+	[CONFIG_ATTR_LOGFILE] = CONFIG_ATTR_NAME("LogFile"),
+	[CONFIG_ATTR_JOURNALPATH] = CONFIG_ATTR_NAME("JournalPath"),
+	[CONFIG_ATTR_LOGROTATE] = CONFIG_ATTR_NAME("LogRotate"),
+	[CONFIG_ATTR_HOSTNAME] = CONFIG_ATTR_NAME("Hostname"),
+	[CONFIG_ATTR_DOMAINNAME] = CONFIG_ATTR_NAME("Domainname"),
+	[CONFIG_ATTR_STARTINGSTATUSFORMAT] = CONFIG_ATTR_NAME("StartingStatusFormat"),
+	[CONFIG_ATTR_FINISHEDSTATUSFORMAT] = CONFIG_ATTR_NAME("FinishedStatusFormat"),
+	[CONFIG_ATTR_STATUSNAMES] = CONFIG_ATTR_NAME("StatusNames"),
+	[CONFIG_ATTR_OBJECTID] = CONFIG_ATTR_NAME("ObjectID"),
+	[CONFIG_ATTR_OBJECTWORKINGDIRECTORY] = CONFIG_ATTR_NAME("ObjectWorkingDirectory"),
+	[CONFIG_ATTR_OBJECTENABLED] = CONFIG_ATTR_NAME("ObjectEnabled"),
+	[CONFIG_ATTR_OBJECTOPTIONS] = CONFIG_ATTR_NAME("ObjectOptions"),
+	[CONFIG_ATTR_OBJECTDESCRIPTION] = CONFIG_ATTR_NAME("ObjectDescription"),
+	[CONFIG_ATTR_OBJECTSTARTCOMMAND] = CONFIG_ATTR_NAME("ObjectStartCommand"),
+	[CONFIG_ATTR_OBJECTPRESTARTCOMMAND] = CONFIG_ATTR_NAME("ObjectPrestartCommand"),
+	[CONFIG_ATTR_OBJECTRELOADCOMMAND] = CONFIG_ATTR_NAME("ObjectReloadCommand"),
+	[CONFIG_ATTR_OBJECTSTOPCOMMAND] = CONFIG_ATTR_NAME("ObjectStopCommand"),
+	[CONFIG_ATTR_OBJECTSTARTPRIORITY] = CONFIG_ATTR_NAME("ObjectStartPriority"),
+	[CONFIG_ATTR_OBJECTSTOPPRIORITY] = CONFIG_ATTR_NAME("ObjectStopPriority"),
+	[CONFIG_ATTR_OBJECTPIDFILE] = CONFIG_ATTR_NAME("ObjectPIDFile"),
+	[CONFIG_ATTR_OBJECTUSER] = CONFIG_ATTR_NAME("ObjectUser"),
+	[CONFIG_ATTR_OBJECTGROUP] = CONFIG_ATTR_NAME("ObjectGroup"),
+	[CONFIG_ATTR_OBJECTSTDOUT] = CONFIG_ATTR_NAME("ObjectStdout"),
+	[CONFIG_ATTR_OBJECTSTDERR] = CONFIG_ATTR_NAME("ObjectStderr"),
+	[CONFIG_ATTR_OBJECTENVVAR] = CONFIG_ATTR_NAME("ObjectEnvVar"),
+	[CONFIG_ATTR_OBJECTRUNLEVELS] = CONFIG_ATTR_NAME("ObjectRunlevels"),
+	[CONFIG_ATTR_OBJECTCONDITION] = CONFIG_ATTR_NAME("ObjectCondition")
+};
+
+/*Perfect hash over the names above: no two of them land in the same slot, so a lookup
+ * is one hash, one table load and one memcmp(). If you add an attribute, make sure it
+ * still doesn't collide, or pick new multipliers that keep them all apart.*/
+#define CONFIG_ATTR_MAXLEN (sizeof "ObjectWorkingDirectory" - 1)
+#define CONFIG_ATTR_HASHSIZE 128
+#define CONFIG_ATTR_HASH(Token, Len) (((Len) + (unsigned char)(Token)[0] + \
+	((unsigned char)(Token)[(Len) - 1] << 2) + (unsigned char)(Token)[(Len) - 2] * 22) & (CONFIG_ATTR_HASHSIZE - 1))
+
+static const unsigned char ConfigAttrHashTable[CONFIG_ATTR_HASHSIZE] = {
+	[0] = CONFIG_ATTR_FINISHEDSTATUSFORMAT,
+	[13] = CONFIG_ATTR_STARTINGSTATUSFORMAT,
+	[21] = CONFIG_ATTR_OBJECTWORKINGDIRECTORY,
+	[26] = CONFIG_ATTR_OBJECTENABLED,
+	[28] = CONFIG_ATTR_OBJECTOPTIONS,
+	[32] = CONFIG_ATTR_OBJECTCONDITION,
+	[34] = CONFIG_ATTR_OBJECTDESCRIPTION,
+	[35] = CONFIG_ATTR_BOOTBANNERCOLOR,
+	[38] = CONFIG_ATTR_RUNLEVELINHERITS,
+	[40] = CONFIG_ATTR_OBJECTGROUP,
+	[42] = CONFIG_ATTR_BLANKLOGONBOOT,
+	[45] = CONFIG_ATTR_OBJECTID,
+	[46] = CONFIG_ATTR_DEFINEPRIORITY,
+	[47] = CONFIG_ATTR_LOGFILE,
+	[49] = CONFIG_ATTR_DEFAULTRUNLEVEL,
+	[56] = CONFIG_ATTR_OBJECTPIDFILE,
+	[57] = CONFIG_ATTR_OBJECTSTDOUT,
+	[61] = CONFIG_ATTR_OBJECTSTOPPRIORITY,
+	[62] = CONFIG_ATTR_OBJECTSTARTPRIORITY,
+	[64] = CONFIG_ATTR_DOMAINNAME,
+	[66] = CONFIG_ATTR_HOSTNAME,
+	[79] = CONFIG_ATTR_OBJECTUSER,
+	[88] = CONFIG_ATTR_STATUSNAMES,
+	[95] = CONFIG_ATTR_MOUNTVIRTUAL,
+	[97] = CONFIG_ATTR_LOGROTATE,
+	[98] = CONFIG_ATTR_ENABLELOGGING,
+	[100] = CONFIG_ATTR_OBJECTSTOPCOMMAND,
+	[101] = CONFIG_ATTR_OBJECTSTARTCOMMAND,
+	[102] = CONFIG_ATTR_OBJECTRELOADCOMMAND,
+	[104] = CONFIG_ATTR_OBJECTPRESTARTCOMMAND,
+	[107] = CONFIG_ATTR_IMPORT,
+	[109] = CONFIG_ATTR_JOURNALPATH,
+	[111] = CONFIG_ATTR_OBJECTSTDERR,
+	[112] = CONFIG_ATTR_BOOTBANNERTEXT,
+	[113] = CONFIG_ATTR_GLOBALENVVAR,
+	[114] = CONFIG_ATTR_OBJECTRUNLEVELS,
+	[116] = CONFIG_ATTR_DISABLECAD,
+	[121] = CONFIG_ATTR_OBJECTENVVAR
+};
+
+/*The strings an object carries, and the attribute each one comes from.*/
+static const struct _ObjStringMember
+{
+	size_t Offset;
+	enum ConfigAttr Attr;
+} ObjStringMembers[] = {
+	{ offsetof(ObjTable, ObjectID), CONFIG_ATTR_OBJECTID },
+	{ offsetof(ObjTable, ObjectDescription), CONFIG_ATTR_OBJECTDESCRIPTION },
+	{ offsetof(ObjTable, ObjectStartCommand), CONFIG_ATTR_OBJECTSTARTCOMMAND },
+	{ offsetof(ObjTable, ObjectPrestartCommand), CONFIG_ATTR_OBJECTPRESTARTCOMMAND },
+	{ offsetof(ObjTable, ObjectStopCommand), CONFIG_ATTR_OBJECTSTOPCOMMAND },
+	{ offsetof(ObjTable, ObjectReloadCommand), CONFIG_ATTR_OBJECTRELOADCOMMAND },
+	{ offsetof(ObjTable, ObjectPIDFile), CONFIG_ATTR_OBJECTPIDFILE },
+	{ offsetof(ObjTable, ObjectWorkingDirectory), CONFIG_ATTR_OBJECTWORKINGDIRECTORY },
+	{ offsetof(ObjTable, ObjectStderr), CONFIG_ATTR_OBJECTSTDERR },
+	{ offsetof(ObjTable, ObjectStdout), CONFIG_ATTR_OBJECTSTDOUT },
+	{ offsetof(ObjTable, CaptureFile), CONFIG_ATTR_OBJECTSTDOUT } }; /*Set by either, but stdout is the usual one.*/
+
+#define ObjString(Obj, Inc) (*(char**)((char*)(Obj) + ObjStringMembers[Inc].Offset))
+
 /*Actual functions.*/
+static Bool LogRotate_Value(const char *InStream, const char *Units, const unsigned long *Scales, unsigned long long *OutValue)
+{ /*A number, then maybe one of Units, which multiplies it by the matching scale.*/
+	const char *Unit = NULL;
+	char *End = NULL;
+	
+	if (!isdigit((unsigned char)*InStream)) return false;
+	
+	*OutValue = strtoull(InStream, &End, 10);
+	
+	if (*End == '\0') return true;
+	
+	if (End[1] != '\0' || !(Unit = strchr(Units, *End))) return false;
+	
+	*OutValue *= Scales[Unit - Units];
+	return true;
+}
+
+static enum ConfigAttr ConfigAttr_Lookup(const char *InStream, const char **OutName)
+{ /*Takes the attribute token at the start of a line and tells us which one it is.*/
+	const size_t Len = strcspn(InStream, " \t=\n");
+	enum ConfigAttr Attr;
+	
+	if (Len < 2 || Len > CONFIG_ATTR_MAXLEN) return CONFIG_ATTR_NONE;
+	
+	Attr = ConfigAttrHashTable[CONFIG_ATTR_HASH(InStream, Len)];
+	
+	/*Anything that isn't an attribute can still land in an occupied slot, so check it for real.*/
+	if (Attr == CONFIG_ATTR_NONE || ConfigAttrNames[Attr].Len != Len ||
+		memcmp(InStream, ConfigAttrNames[Attr].Name, Len) != 0)
+	{
+		return CONFIG_ATTR_NONE;
+	}
+	
+	*OutName = ConfigAttrNames[Attr].Name;
+	return Attr;
+}
+
 static char *NextLine(const char *InStream)
 {
 	if (!(InStream = strchr(InStream, '\n')))
@@ -155,19 +480,40 @@ ReturnCode InitConfig(const char *CurConfigFile)
 	struct stat FileStat;
 	char *ConfigStream = NULL, *Worker = NULL;
 	ObjTable *CurObj = NULL, *ObjWorker = NULL;
+	size_t CurObjIndex = 0;
 	char DelimCurr[MAX_LINE_SIZE] = { '\0' };
 	unsigned LineNum = 1;
 	const char *CurrentAttribute = NULL;
 	Bool LongComment = false;
 	Bool TrueLogEnable = EnableLogging;
+	Bool LogEnableSet = false;
 	Bool PrevLogInMemory = LogInMemory;
 	char ErrBuf[MAX_LINE_SIZE];
 	const Bool IsPrimaryConfigFile = !strcmp(ConfigFile, CurConfigFile);
+	const unsigned long PrevProblemsReported = ProblemsReported;
+	size_t ConfigSize = 0;
+	unsigned DepIndex = 0;
+	Bool Standalone = !IsPrimaryConfigFile;
+	enum ConfigAttr Attr = CONFIG_ATTR_NONE;
 	
 	if (IsPrimaryConfigFile)
 	{
 		EnableLogging = true; /*To temporarily turn on the logging system.*/
 		LogInMemory = true;
+		
+		NumConfigCacheDeps = 0;
+		ConfigCacheUnkeyable = false;
+		*ConfigDefaultRunlevel = '\0';
+		
+		if (ConfigCache_Load(&TrueLogEnable))
+		{ /*Nothing changed since we last compiled it, so we're done.*/
+			Overlay_Apply();
+			ExecPlan_Prepare();
+			ConfigArena.LoadedSize = ConfigArena.Stats.BytesUsed + ConfigArena.CacheMapSize;
+			LogInMemory = PrevLogInMemory;
+			EnableLogging = TrueLogEnable;
+			return SUCCESS;
+		}
 	}
 	
 	/*Get the file size of the config file.*/
@@ -191,16 +537,21 @@ ReturnCode InitConfig(const char *CurConfigFile)
 		snprintf(ErrBuf, sizeof ErrBuf, CONFIGERRORTXT "Unable to open configuration file \"%s\"! Permissions?", CurConfigFile);
 		SpitError(ErrBuf);
 		if (!IsPrimaryConfigFile) WriteLogLine(ErrBuf, true);
+		if (BackgroundReload.InChild) ReloadConfig_ChildFatal();
 		EmergencyShell();
 	}
 	
 	/*Read the file into memory. I don't really trust fread(), but oh well.
 	 * People will whine if I use a loop instead.*/
-	fread(ConfigStream, 1, FileStat.st_size, Descriptor);
+	ConfigSize = fread(ConfigStream, 1, FileStat.st_size, Descriptor);
 	fclose(Descriptor); /*Close the file.*/
 
 	ConfigStream[FileStat.st_size] = '\0'; /*Null terminate.*/
 	
+	/*Key the compiled cache on exactly what we read.*/
+	DepIndex = NumConfigCacheDeps;
+	ConfigCache_AddDep(CurConfigFile, &FileStat, ConfigCache_Hash(ConfigStream, ConfigSize));
+	
 	Worker = ConfigStream;
 	
 	/*Check for non-ASCII characters.*/
@@ -284,44 +635,40 @@ ReturnCode InitConfig(const char *CurConfigFile)
 		}
 		
 		/**Global configuration begins here.**/
-		if (!strncmp(Worker, (CurrentAttribute = "Import"), sizeof "Import" - 1))
+		if ((Attr = ConfigAttr_Lookup(Worker, &CurrentAttribute)) != CONFIG_ATTR_NONE && Attr < CONFIG_ATTR_OBJECTID)
+		{ /*This file changes more than its own objects.*/
+			Standalone = false;
+			if (ConfigStandaloneParse) break;
+		}
+		
+		switch (Attr)
+		{
+		case CONFIG_ATTR_IMPORT:
 		{
+			struct stat ImportStat;
+			
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
 				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
 			
-			if (NumConfigFiles == MAX_CONFIG_FILES)
-			{
-				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Cannot import config file \"%s\", config file limit of %d has been reached!\n"
-						"Attempting to continue.", DelimCurr, MAX_CONFIG_FILES);
-				SpitWarning(ErrBuf);
-				WriteLogLine(ErrBuf, true);
-				continue;
-			}
-			
-			if (*DelimCurr == '/')
-			{ /*Absolute path?*/
-				ConfigFileList[NumConfigFiles] = malloc(strlen(DelimCurr) + 1);
-				
-				strncpy(ConfigFileList[NumConfigFiles], DelimCurr, strlen(DelimCurr) + 1);
-			}
-			else
+			if (*DelimCurr != '/')
 			{ /*A file in our config folder.*/
 				char OutBuf[MAX_LINE_SIZE];
 				
 				snprintf(OutBuf, sizeof OutBuf, CONFIGDIR "%s", DelimCurr);
-				
-				ConfigFileList[NumConfigFiles] = malloc(strlen(OutBuf) + 1);
-				
-				strncpy(ConfigFileList[NumConfigFiles], OutBuf, strlen(OutBuf) + 1);
+				snprintf(DelimCurr, sizeof DelimCurr, "%s", OutBuf);
 			}
-				
 			
-			++NumConfigFiles; /*This is incremented prior to the call to InitConfig() for a reason.*/
+			/*The imported file may grow the table and move it, so remember where our object was by index.*/
+			CurObjIndex = CurObj ? CurObj - ObjectTable : 0;
 			
-			if (!InitConfig(ConfigFileList[NumConfigFiles - 1])) /*It's very important we pass this pointer and not DelimCurr.*/
+			if (strpbrk(DelimCurr, "*?[") || (!stat(DelimCurr, &ImportStat) && S_ISDIR(ImportStat.st_mode)))
+			{ /*A pattern or a conf.d style directory.*/
+				ImportConfigGlob(DelimCurr, CurConfigFile, LineNum);
+			}
+			else if (!InitConfig(ConfigFileList_Add(ConfigArena_StrDup(DelimCurr)))) /*It's very important we pass the list's pointer and not DelimCurr.*/
 			{
 				
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGERRORTXT
@@ -331,9 +678,11 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				SpitError(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 			}
+			
+			if (CurObj) CurObj = ObjectTable + CurObjIndex;
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "GlobalEnvVar"), sizeof "GlobalEnvVar" - 1))
+		case CONFIG_ATTR_GLOBALENVVAR:
 		{
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -353,7 +702,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			EnvVarList_Add(DelimCurr, &GlobalEnvVars);
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "DisableCAD"), sizeof "DisableCAD" - 1))
+		case CONFIG_ATTR_DISABLECAD:
 		{ /*Should we disable instant reboots on CTRL-ALT-DEL?*/
 
 			if (!GetLineDelim(Worker, DelimCurr))
@@ -378,7 +727,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "BlankLogOnBoot"), sizeof "BlankLogOnBoot" - 1))
+		case CONFIG_ATTR_BLANKLOGONBOOT:
 		{ /*Should the log only hold the current boot cycle's logs?*/
 
 			if (!GetLineDelim(Worker, DelimCurr))
@@ -404,7 +753,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "EnableLogging"), sizeof "EnableLogging" - 1))
+		case CONFIG_ATTR_ENABLELOGGING:
 		{
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -429,9 +778,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
 			}
 			
+			LogEnableSet = true;
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "RunlevelInherits"), sizeof "RunlevelInherits" - 1))
+		case CONFIG_ATTR_RUNLEVELINHERITS:
 		{
 			char Inheriter[MAX_DESCRIPT_SIZE], Inherited[MAX_DESCRIPT_SIZE];
 			const char *TWorker = DelimCurr;
@@ -469,7 +819,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "DefinePriority"), sizeof "DefinePriority" - 1))
+		case CONFIG_ATTR_DEFINEPRIORITY:
 		{
 			char Alias[MAX_DESCRIPT_SIZE] = { '\0' };
 			unsigned Target = 0, TInc = 0;
@@ -553,7 +903,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 		}
 		/*This will mount /dev, /proc, /sys, /dev/pts, and /dev/shm on boot time, upon request.*/
-		else if (!strncmp(Worker, (CurrentAttribute = "MountVirtual"), strlen("MountVirtual")))
+		case CONFIG_ATTR_MOUNTVIRTUAL:
 		{
 			const char *TWorker = DelimCurr;
 			unsigned Inc = 0;
@@ -617,7 +967,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 		}
 		/*Now we get into the actual attribute tags.*/
-		else if (!strncmp(Worker, (CurrentAttribute = "BootBannerText"), sizeof "BootBannerText" - 1))
+		case CONFIG_ATTR_BOOTBANNERTEXT:
 		{ /*The text shown at boot up as a kind of greeter, before we start executing objects. Can be disabled, off by default.*/
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -642,7 +992,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "BootBannerColor"), sizeof "BootBannerColor" - 1))
+		case CONFIG_ATTR_BOOTBANNERCOLOR:
 		{ /*Color for boot banner.*/
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -659,11 +1009,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			SetBannerColor(DelimCurr); /*Function to be found elsewhere will do this for us, otherwise this loop would be even bigger.*/
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "DefaultRunlevel"), sizeof "DefaultRunlevel" - 1))
+		case CONFIG_ATTR_DEFAULTRUNLEVEL:
 		{
-			if (CurRunlevel[0] != 0)
-			{ /*If the runlevel has already been set, don't set it again.
-				* This prevents a rather nasty bug.*/
+			if (*ConfigDefaultRunlevel != '\0')
+			{ /*Only the first one counts.*/
 				continue;
 			}
 			
@@ -679,11 +1028,23 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}	
 			
-			snprintf(CurRunlevel, MAX_DESCRIPT_SIZE, "%s", DelimCurr);
+			/*We remember it even if the runlevel has already been set, so the compiled cache has it.*/
+			if (snprintf(ConfigDefaultRunlevel, sizeof ConfigDefaultRunlevel, "%s", DelimCurr) >= (int)sizeof ConfigDefaultRunlevel)
+			{ /*Cut short, it'd be a runlevel no object is in.*/
+				*ConfigDefaultRunlevel = '\0';
+				ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+				continue;
+			}
+			
+			if (CurRunlevel[0] == '\0')
+			{ /*If the runlevel has already been set, don't set it again.
+				* This prevents a rather nasty bug.*/
+				memcpy(CurRunlevel, ConfigDefaultRunlevel, sizeof ConfigDefaultRunlevel);
+			}
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "LogFile"), sizeof "LogFile" - 1))
+		case CONFIG_ATTR_LOGFILE:
 		{ //Specify a log file to use.
 			if (!GetLineDelim(Worker, DelimCurr))
 			{
@@ -696,7 +1057,59 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			strcpy(LogFile, DelimCurr);
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "Hostname"), sizeof "Hostname" - 1))
+		case CONFIG_ATTR_JOURNALPATH:
+		{ /*Turns on the binary journal. See journal.c.*/
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			snprintf(JournalPath, sizeof JournalPath, "%s", DelimCurr);
+			continue;
+		}
+		case CONFIG_ATTR_LOGROTATE:
+		{ /*Like "LogRotate=SIZE=10M AGE=7d KEEP=4". Covers our log and objects' output files.*/
+			static const unsigned long SizeScales[] = { 1024, 1024 * 1024, 1024 * 1024 * 1024 };
+			static const unsigned long AgeScales[] = { 1, 60, 60 * 60, 60 * 60 * 24 };
+			const char *TWorker = DelimCurr;
+			char CurArg[64];
+			unsigned long long Value;
+			int Length;
+			
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			memset(&LogRotate, 0, sizeof LogRotate);
+			LogRotate.Keep = 4;
+			
+			for (; sscanf(TWorker, "%63s%n", CurArg, &Length) == 1; TWorker += Length)
+			{
+				if (!strncmp(CurArg, "SIZE=", sizeof "SIZE=" - 1) &&
+					LogRotate_Value(CurArg + sizeof "SIZE=" - 1, "KMG", SizeScales, &Value))
+				{
+					LogRotate.MaxSize = Value;
+				}
+				else if (!strncmp(CurArg, "AGE=", sizeof "AGE=" - 1) &&
+						LogRotate_Value(CurArg + sizeof "AGE=" - 1, "smhd", AgeScales, &Value))
+				{
+					LogRotate.MaxAge = Value;
+				}
+				else if (!strncmp(CurArg, "KEEP=", sizeof "KEEP=" - 1) && AllNumeric(CurArg + sizeof "KEEP=" - 1))
+				{
+					LogRotate.Keep = atoi(CurArg + sizeof "KEEP=" - 1);
+				}
+				else
+				{
+					ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, CurArg, LineNum);
+				}
+			}
+			continue;
+		}
+		case CONFIG_ATTR_HOSTNAME:
 		{
 			if (CurObj != NULL)
 			{ /*What the warning says. It'd get all weird if we allowed that.*/
@@ -723,6 +1136,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				
 				for (; *TW == ' ' || *TW == '\t'; ++TW);
 				
+				ConfigCache_AddFileDep(TW);
+				
 				if (!(TDesc = fopen(TW, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Failed to set hostname from file \"%s\".\n", TW);
@@ -782,7 +1197,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "Domainname"), sizeof "Domainname" - 1))
+		case CONFIG_ATTR_DOMAINNAME:
 		{
 			if (CurObj != NULL)
 			{
@@ -811,6 +1226,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					continue;
 				}
 				
+				ConfigCache_AddFileDep(TWorker);
+				
 				if (!(TDesc = fopen(TWorker, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Failed to set domain name from file \"%s\".", TWorker);
@@ -868,7 +1285,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "StartingStatusFormat"), sizeof "StartingStatusFormat" - 1))
+		case CONFIG_ATTR_STARTINGSTATUSFORMAT:
 		{ /*The first half of our status format, before we get to Done or FAIL or something.*/
 			if (CurObj != NULL)
 			{ /*What the warning says. It'd get all weird if we allowed that.*/
@@ -902,6 +1319,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				strncpy(Filename, TW, sizeof Filename - 1);
 				Filename[sizeof Filename - 1] = '\0';
 				
+				ConfigCache_AddFileDep(Filename);
+				
 				if (stat(Filename, &FileStat) != 0 || !(Desc = fopen(Filename, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Unable to open file %s for attribute %s!", Filename, CurrentAttribute);
@@ -930,7 +1349,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "FinishedStatusFormat"), sizeof "FinishedStatusFormat" - 1))
+		case CONFIG_ATTR_FINISHEDSTATUSFORMAT:
 		{ /*The second half of our status report format, e.g. [ DONE ] (but the Done part is defined in the next one*/
 			if (CurObj != NULL)
 			{ /*What the warning says. It'd get all weird if we allowed that.*/
@@ -964,6 +1383,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				strncpy(Filename, TW, sizeof Filename - 1);
 				Filename[sizeof Filename - 1] = '\0';
 				
+				ConfigCache_AddFileDep(Filename);
+				
 				if (stat(Filename, &FileStat) != 0 || !(Desc = fopen(Filename, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Unable to open file %s for attribute %s!", Filename, CurrentAttribute);
@@ -996,7 +1417,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "StatusNames"), sizeof "StatusNames" - 1))
+		case CONFIG_ATTR_STATUSNAMES:
 		{ /*We specify our status names here, e.g. FAIL, Done, WARN.*/
 			unsigned TInc = 0, Lines = 1;
 			char *TW2 = NULL;
@@ -1034,6 +1455,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				strncpy(Filename, TW, sizeof Filename - 1);
 				Filename[sizeof Filename - 1] = '\0';
 				
+				ConfigCache_AddFileDep(Filename);
+				
 				if (stat(Filename, &FileStat) != 0 || !(Desc = fopen(Filename, "r")))
 				{
 					snprintf(ErrBuf, sizeof ErrBuf, "Unable to open file %s for attribute %s!", Filename, CurrentAttribute);
@@ -1107,7 +1530,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectID"), sizeof "ObjectID" - 1))
+		case CONFIG_ATTR_OBJECTID:
 		{ /*ASCII value used to identify this object internally, and also a kind of short name for it.*/
 			char *Temp = NULL;
 			
@@ -1141,8 +1564,16 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			if (!(CurObj = AddObjectToTable(DelimCurr, CurConfigFile))) /*Sets this as our current object.*/
 			{
-				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Duplicate ObjectID %s detected in config file %s, ignoring.",
-						DelimCurr, CurConfigFile);
+				const ObjTable *const Original = LookupObjectInTable(DelimCurr);
+				struct _ConfigCacheDepEntry *const OriginalDep = ConfigCache_FindDep(Original->ConfigFile);
+				
+				/*Which one wins depends on both files, so neither can be parsed again alone.*/
+				Standalone = false;
+				if (OriginalDep) OriginalDep->Key.Flags &= ~CONFIG_DEP_STANDALONE;
+				
+				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Duplicate ObjectID %s detected in config file %s, "
+						"line %u. It was first defined in %s. Ignoring.", DelimCurr, CurConfigFile, LineNum,
+						Original->ConfigFile);
 				SpitWarning(ErrBuf);
 				WriteLogLine(ErrBuf, true);
 				continue;
@@ -1155,7 +1586,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectWorkingDirectory"), sizeof "ObjectWorkingDirectory" - 1))
+		case CONFIG_ATTR_OBJECTWORKINGDIRECTORY:
 		{
 			if (!CurObj)
 			{
@@ -1169,16 +1600,10 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectWorkingDirectory != NULL)
-			{
-				free(CurObj->ObjectWorkingDirectory);
-			}
-			
-			CurObj->ObjectWorkingDirectory = malloc(strlen(DelimCurr) + 1);
-			
-			strncpy(CurObj->ObjectWorkingDirectory, DelimCurr, strlen(DelimCurr) + 1);	
+			CurObj->ObjectWorkingDirectory = ConfigArena_StrDup(DelimCurr);
+			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectEnabled"), sizeof "ObjectEnabled" - 1))
+		case CONFIG_ATTR_OBJECTENABLED:
 		{
 			if (!CurObj)
 			{
@@ -1195,11 +1620,11 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			if (!strcmp(DelimCurr, "true"))
 			{
-				CurObj->Enabled = true;
+				CurObj->State->Enabled = true;
 			}
 			else if (!strcmp(DelimCurr, "false"))
 			{
-				CurObj->Enabled = false;
+				CurObj->State->Enabled = false;
 			}
 			else
 			{
@@ -1208,7 +1633,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectOptions"), sizeof "ObjectOptions" - 1))
+		case CONFIG_ATTR_OBJECTOPTIONS:
 		{
 			const char *TWorker = DelimCurr;
 			unsigned Inc;
@@ -1244,7 +1669,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				
 				if (!strcmp(CurArg, "HALTONLY"))
 				{ /*Allow entries that execute on shutdown only.*/
-					CurObj->Started = true;
+					CurObj->State->Started = true;
 					CurObj->Opts.Persistent = true;
 					CurObj->Opts.HaltCmdOnly = true;
 				}
@@ -1278,7 +1703,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 							"but this is not supported on NOMMU builds. Disabling the object.", CurObj->ObjectID);
 					SpitWarning(ErrBuf);
 					WriteLogLine(ErrBuf, true);
-					CurObj->Enabled = false;
+					CurObj->State->Enabled = false;
 			#endif /*NOMMU*/
 				}
 				else if (!strcmp(CurArg, "EXEC"))
@@ -1300,18 +1725,18 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				else if (!strncmp(CurArg, "AUTORESTART", sizeof "AUTORESTART" - 1))
 				{
 					
-					CurObj->Opts.AutoRestart = true;
+					CurObj->State->AutoRestart = true;
 
 					if (CurArg[sizeof "AUTORESTART" - 1] == '=' && CurArg[sizeof "AUTORESTART"] != '\0')
 					{
 						const char *Arg = CurArg + sizeof "AUTORESTART=" - 1;
 						unsigned short MinimumRestartTime = atoi(Arg);
 						
-						CurObj->Opts.AutoRestart |= MinimumRestartTime << 1;
+						CurObj->State->AutoRestart |= MinimumRestartTime << 1;
 					}
 					else
 					{
-						CurObj->Opts.AutoRestart |= 5 << 1;
+						CurObj->State->AutoRestart |= 5 << 1;
 					}
 				}
 				else if (!strcmp(CurArg, "NOTRACK"))
@@ -1353,6 +1778,18 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					
 					CurObj->Opts.StopTimeout = atol(TWorker);
 				}
+				else if (!strncmp(CurArg, "LOGRATE", sizeof "LOGRATE" - 1))
+				{
+					const char *TWorker = CurArg + sizeof "LOGRATE" - 1;
+					
+					if (*TWorker != '=' || *(TWorker + 1) == '\0' || !AllNumeric(TWorker + 1))
+					{
+						ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, CurArg, LineNum);
+						continue;
+					}
+					
+					CurObj->Opts.LogRate = atol(TWorker + 1);
+				}
 				else if (!strncmp(CurArg, "MAPEXITSTATUS", sizeof "MAPEXITSTATUS" - 1))
 				{
 					const char *TWorker = CurArg + sizeof "MAPEXITSTATUS" - 1;
@@ -1479,7 +1916,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectDescription"), sizeof "ObjectDescription" - 1))
+		case CONFIG_ATTR_OBJECTDESCRIPTION:
 		{ /*It's description.*/
 			if (!CurObj)
 			{
@@ -1493,12 +1930,9 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectDescription != NULL) free(CurObj->ObjectDescription);
-			
 			DelimCurr[MAX_DESCRIPT_SIZE - 1] = '\0'; /*Chop it off to prevent overflow.*/
 
-			CurObj->ObjectDescription = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectDescription, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectDescription = ConfigArena_StrDup(DelimCurr);
 			
 			if ((strlen(DelimCurr) + 1) >= MAX_DESCRIPT_SIZE)
 			{
@@ -1507,7 +1941,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStartCommand"), sizeof "ObjectStartCommand" - 1))
+		case CONFIG_ATTR_OBJECTSTARTCOMMAND:
 		{ /*What we execute to start it.*/
 			if (!CurObj)
 			{
@@ -1521,10 +1955,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectStartCommand) free(CurObj->ObjectStartCommand);
-
-			CurObj->ObjectStartCommand = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectStartCommand, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectStartCommand = ConfigArena_StrDup(DelimCurr);
 
 			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
 			{
@@ -1533,7 +1964,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectPrestartCommand"), sizeof "ObjectPrestartCommand" - 1))
+		case CONFIG_ATTR_OBJECTPRESTARTCOMMAND:
 		{
 			if (!CurObj)
 			{
@@ -1547,18 +1978,16 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectPrestartCommand) free(CurObj->ObjectPrestartCommand);
-			
-			CurObj->ObjectPrestartCommand = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectPrestartCommand, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectPrestartCommand = ConfigArena_StrDup(DelimCurr);
 			
 			if (strlen(DelimCurr) + 1 >= MAX_LINE_SIZE)
 			{
 				ConfigProblem(CurConfigFile, CONFIG_ETRUNCATED, CurrentAttribute, NULL, LineNum);
 				continue;
 			}
+			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectReloadCommand"), sizeof "ObjectReloadCommand" - 1))
+		case CONFIG_ATTR_OBJECTRELOADCOMMAND:
 		{
 			if (!CurObj)
 			{
@@ -1647,10 +2076,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			else
 			{
-				if (CurObj->ObjectReloadCommand) free(CurObj->ObjectReloadCommand);
-				
-				CurObj->ObjectReloadCommand = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectReloadCommand, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->ObjectReloadCommand = ConfigArena_StrDup(DelimCurr);
 			}
 			
 			if (strlen(DelimCurr) + 1 >= MAX_LINE_SIZE)
@@ -1661,7 +2087,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStopCommand"), sizeof "ObjectStopCommand" - 1))
+		case CONFIG_ATTR_OBJECTSTOPCOMMAND:
 		{ /*If it's "PID", then we know that we need to kill the process ID only. If it's "NONE", well, self explanitory.*/
 			if (!CurObj)
 			{
@@ -1691,8 +2117,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					
 					if (*Worker != '\0')
 					{
-						CurObj->ObjectPIDFile = malloc(strlen(Worker) + 1);
-						strncpy(CurObj->ObjectPIDFile, Worker, strlen(Worker) + 1);
+						CurObj->ObjectPIDFile = ConfigArena_StrDup(Worker);
 						
 						CurObj->Opts.HasPIDFile = true;
 					}
@@ -1710,9 +2135,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			{
 				CurObj->Opts.StopMode = STOP_COMMAND;
 				
-				if (CurObj->ObjectStopCommand) free(CurObj->ObjectStopCommand);
-				CurObj->ObjectStopCommand = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectStopCommand, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->ObjectStopCommand = ConfigArena_StrDup(DelimCurr);
 			}
 			
 			if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
@@ -1722,7 +2145,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStartPriority"), sizeof "ObjectStartPriority" - 1))
+		case CONFIG_ATTR_OBJECTSTARTPRIORITY:
 		{
 			/*The order in which this item is started. If it is disabled in this runlevel, the next object in line is executed, IF
 			 * and only IF it is enabled. If not, the one after that and so on.*/
@@ -1745,6 +2168,9 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				signed int Change = 0;
 				Bool PositiveChange = false;
 				
+				Standalone = false; /*Aliases and other objects are defined elsewhere.*/
+				if (ConfigStandaloneParse) continue;
+				
 				char *Lookup = strpbrk(DelimCurr, "-+");
 				if (Lookup != NULL && AllNumeric(Lookup + 1))
 				{ //They provided an increment or decrement.
@@ -1753,10 +2179,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					Change = atoi(Lookup + 1);
 				}
 				
-				if (!(TmpTarget = PriorityAlias_Lookup(DelimCurr)) && !(TmpTarget = PriorityOfLookup(DelimCurr, true)))
+				if (!(TmpTarget = PriorityAlias_Lookup(DelimCurr)))
 				{
-					ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
-					continue;
+					if (!(TmpTarget = PriorityOfLookup(DelimCurr, true)))
+					{
+						ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+						continue;
+					}
+					
+					if (NumConfigCacheDeps) ConfigCacheDeps->Key.Flags |= CONFIG_DEP_PRIORITYOF; /*The primary file is always first.*/
 				}
 				
 				if (Change)
@@ -1770,11 +2201,11 @@ ReturnCode InitConfig(const char *CurConfigFile)
 						TmpTarget -= Change;
 					}
 				}
-				CurObj->ObjectStartPriority = TmpTarget;
+				CurObj->State->ObjectStartPriority = TmpTarget;
 				continue;
 			}
 			
-			CurObj->ObjectStartPriority = atol(DelimCurr);
+			CurObj->State->ObjectStartPriority = atol(DelimCurr);
 			
 			if (strlen(DelimCurr) >= 8)
 			{ /*An eight digit number is too high.*/
@@ -1783,7 +2214,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStopPriority"), sizeof "ObjectStopPriority" - 1))
+		case CONFIG_ATTR_OBJECTSTOPPRIORITY:
 		{
 			/*Same as above, but used for when the object is being shut down.*/
 			if (!CurObj)
@@ -1804,6 +2235,9 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				signed int Change = 0;
 				Bool PositiveChange = false;
 				
+				Standalone = false;
+				if (ConfigStandaloneParse) continue;
+				
 				char *Lookup = strpbrk(DelimCurr, "-+");
 				if (Lookup != NULL && AllNumeric(Lookup + 1))
 				{ //They provided an increment or decrement.
@@ -1813,10 +2247,15 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				}
 				
 				
-				if (!(TmpTarget = PriorityAlias_Lookup(DelimCurr)) && !(TmpTarget = PriorityOfLookup(DelimCurr, false)))
+				if (!(TmpTarget = PriorityAlias_Lookup(DelimCurr)))
 				{
-					ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
-					continue;
+					if (!(TmpTarget = PriorityOfLookup(DelimCurr, false)))
+					{
+						ConfigProblem(CurConfigFile, CONFIG_EBADVAL, CurrentAttribute, DelimCurr, LineNum);
+						continue;
+					}
+					
+					if (NumConfigCacheDeps) ConfigCacheDeps->Key.Flags |= CONFIG_DEP_PRIORITYOF; /*The primary file is always first.*/
 				}
 				
 				if (Change)
@@ -1831,11 +2270,11 @@ ReturnCode InitConfig(const char *CurConfigFile)
 					}
 				}
 				
-				CurObj->ObjectStopPriority = TmpTarget;
+				CurObj->State->ObjectStopPriority = TmpTarget;
 				continue;
 			}
 			
-			CurObj->ObjectStopPriority = atol(DelimCurr);
+			CurObj->State->ObjectStopPriority = atol(DelimCurr);
 			
 			if (strlen(DelimCurr) >= 8)
 			{ /*An eight digit number is too high.*/
@@ -1844,7 +2283,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectPIDFile"), sizeof "ObjectPIDFile" - 1))
+		case CONFIG_ATTR_OBJECTPIDFILE:
 		{ /*This really needs to be specified if Opts.StopMode is STOP_PIDFILE, or we'll reset the object to STOP_PID.*/
 			if (!CurObj)
 			{
@@ -1858,10 +2297,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectPIDFile) free(CurObj->ObjectPIDFile);
-			
-			CurObj->ObjectPIDFile = malloc(strlen(DelimCurr) + 1);
-			strncpy(CurObj->ObjectPIDFile, DelimCurr, strlen(DelimCurr) + 1);
+			CurObj->ObjectPIDFile = ConfigArena_StrDup(DelimCurr);
 			
 			CurObj->Opts.HasPIDFile = true;
 			
@@ -1872,7 +2308,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectUser"), sizeof "ObjectUser" - 1))
+		case CONFIG_ATTR_OBJECTUSER:
 		{
 			struct passwd *UserStruct = NULL;
 			
@@ -1888,6 +2324,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
+			ConfigCache_AddFileDep("/etc/passwd");
+			
 			if (!(UserStruct = getpwnam(DelimCurr)))
 			{ /*getpwnam_r() is more trouble than it's worth in single-threaded Epoch.*/
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT
@@ -1907,7 +2345,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectGroup"), sizeof "ObjectGroup" - 1))
+		case CONFIG_ATTR_OBJECTGROUP:
 		{
 			struct group *GroupStruct = NULL;
 			
@@ -1923,6 +2361,8 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
+			ConfigCache_AddFileDep("/etc/group");
+			
 			if (!(GroupStruct = getgrnam(DelimCurr)))
 			{ /*getgrnam_r() is more trouble than it's worth in single-threaded Epoch.*/
 				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT
@@ -1941,7 +2381,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStdout"), sizeof "ObjectStdout" - 1))
+		case CONFIG_ATTR_OBJECTSTDOUT:
 		{
 			if (CurObj == NULL)
 			{
@@ -1955,18 +2395,27 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectStdout) free(CurObj->ObjectStdout);
-			
-			if (!strcmp(DelimCurr, "LOG"))
+			if (!strncmp(DelimCurr, "CAPTURE", sizeof "CAPTURE" - 1) &&
+				(DelimCurr[sizeof "CAPTURE" - 1] == '\0' || isspace(DelimCurr[sizeof "CAPTURE" - 1])))
+			{ /*Epoch reads it. Anything after CAPTURE is a file we also send it to.*/
+				const char *TWorker = DelimCurr + sizeof "CAPTURE" - 1;
+				
+				while (isspace(*TWorker)) ++TWorker;
+				
+				CurObj->Opts.CaptureStdout = true;
+				CurObj->ObjectStdout = NULL;
+				
+				if (*TWorker) CurObj->CaptureFile = ConfigArena_StrDup(TWorker);
+			}
+			else if (!strcmp(DelimCurr, "LOG"))
 			{
-				CurObj->ObjectStdout = malloc(strlen(LogFile) + 1);
-
-				strncpy(CurObj->ObjectStdout, LogFile, strlen(LogFile) + 1);
+				CurObj->Opts.CaptureStdout = false;
+				CurObj->ObjectStdout = ConfigArena_StrDup(LogFile);
 			}
 			else
 			{
-				CurObj->ObjectStdout = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectStdout, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->Opts.CaptureStdout = false;
+				CurObj->ObjectStdout = ConfigArena_StrDup(DelimCurr);
 				
 				if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
 				{
@@ -1975,7 +2424,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectStderr"), sizeof "ObjectStderr" - 1))
+		case CONFIG_ATTR_OBJECTSTDERR:
 		{
 			if (CurObj == NULL)
 			{
@@ -1989,18 +2438,27 @@ ReturnCode InitConfig(const char *CurConfigFile)
 				continue;
 			}
 			
-			if (CurObj->ObjectStderr) free(CurObj->ObjectStderr);
-			
-			if (!strcmp(DelimCurr, "LOG"))
+			if (!strncmp(DelimCurr, "CAPTURE", sizeof "CAPTURE" - 1) &&
+				(DelimCurr[sizeof "CAPTURE" - 1] == '\0' || isspace(DelimCurr[sizeof "CAPTURE" - 1])))
+			{ /*Epoch reads it. Anything after CAPTURE is a file we also send it to.*/
+				const char *TWorker = DelimCurr + sizeof "CAPTURE" - 1;
+				
+				while (isspace(*TWorker)) ++TWorker;
+				
+				CurObj->Opts.CaptureStderr = true;
+				CurObj->ObjectStderr = NULL;
+				
+				if (*TWorker) CurObj->CaptureFile = ConfigArena_StrDup(TWorker);
+			}
+			else if (!strcmp(DelimCurr, "LOG"))
 			{
-				CurObj->ObjectStderr = malloc(strlen(LogFile) + 1);
-
-				strncpy(CurObj->ObjectStderr, LogFile, strlen(LogFile) + 1);
+				CurObj->Opts.CaptureStderr = false;
+				CurObj->ObjectStderr = ConfigArena_StrDup(LogFile);
 			}
 			else
 			{
-				CurObj->ObjectStderr = malloc(strlen(DelimCurr) + 1);
-				strncpy(CurObj->ObjectStderr, DelimCurr, strlen(DelimCurr) + 1);
+				CurObj->Opts.CaptureStderr = false;
+				CurObj->ObjectStderr = ConfigArena_StrDup(DelimCurr);
 				
 				if ((strlen(DelimCurr) + 1) >= MAX_LINE_SIZE)
 				{
@@ -2009,7 +2467,7 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectEnvVar"), sizeof "ObjectEnvVar" - 1))
+		case CONFIG_ATTR_OBJECTENVVAR:
 		{
 			if (!CurObj)
 			{
@@ -2035,7 +2493,30 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			EnvVarList_Add(DelimCurr, &CurObj->EnvVars);
 			continue;
 		}
-		else if (!strncmp(Worker, (CurrentAttribute = "ObjectRunlevels"), sizeof "ObjectRunlevels" - 1))
+		case CONFIG_ATTR_OBJECTCONDITION:
+		{
+			if (!CurObj)
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EBEFORE, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!GetLineDelim(Worker, DelimCurr))
+			{
+				ConfigProblem(CurConfigFile, CONFIG_EMISSINGVAL, CurrentAttribute, NULL, LineNum);
+				continue;
+			}
+			
+			if (!ObjCondition_Add(DelimCurr, CurObj))
+			{
+				snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT"Unknown or malformed condition for object %s,\n"
+						"in file \"%s\" line %u. Ignoring this condition.", CurObj->ObjectID, CurConfigFile, LineNum);
+				SpitWarning(ErrBuf);
+				WriteLogLine(ErrBuf, true);
+			}
+			continue;
+		}
+		case CONFIG_ATTR_OBJECTRUNLEVELS:
 		{ /*Runlevel.*/
 			char *TWorker;
 			char TRL[MAX_DESCRIPT_SIZE], *TRL2;
@@ -2085,13 +2566,14 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			continue;
 
 		}
-		else
+		default:
 		{ /*No big deal.*/
 			snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Unidentified attribute in %s on line %u.", CurConfigFile, LineNum);
 			SpitWarning(ErrBuf);
 			WriteLogLine(ErrBuf, true);
 			continue;
 		}
+		}
 	} while (++LineNum, (Worker = NextLine(Worker)));
 	
 	/*This is harmless, but it's bad form and could indicate human error in writing the config file.*/
@@ -2102,11 +2584,13 @@ ReturnCode InitConfig(const char *CurConfigFile)
 		WriteLogLine(ErrBuf, true);
 	}
 	
+	if (Standalone && DepIndex < NumConfigCacheDeps) ConfigCacheDeps[DepIndex].Key.Flags |= CONFIG_DEP_STANDALONE;
+	
 	if (IsPrimaryConfigFile) /*We are at the top level config file and therefore need to clean up.*/
 	{
 		PriorityAlias_Shutdown();
 		
-		for (ObjWorker = ObjectTable; ObjWorker->Next; ObjWorker = ObjWorker->Next)
+		for (ObjWorker = ObjectTable; ObjWorker && ObjWorker->ObjectID; ++ObjWorker)
 		{
 			/*We don't need to specify a description, but if we neglect to, use the ObjectID.*/
 			if (ObjWorker->ObjectDescription == NULL)
@@ -2118,6 +2602,20 @@ ReturnCode InitConfig(const char *CurConfigFile)
 		switch (ScanConfigIntegrity())
 		{
 			case SUCCESS:
+				/*Only a completely clean configuration gets compiled. Otherwise we'd stop seeing its warnings.*/
+				if (ProblemsReported == PrevProblemsReported)
+				{
+					unsigned char *const NewCache = ConfigCache_Build(LogEnableSet ? TrueLogEnable : -1);
+					
+					if (NewCache)
+					{
+						free(ConfigCachePending);
+						ConfigCachePending = NewCache;
+						ConfigCachePendingSize = ((struct _ConfigCacheHeader*)NewCache)->TotalSize;
+					}
+					
+					if (!ConfigCacheWriteDeferred) ConfigCache_Flush();
+				}
 				break;
 			case FAILURE:
 				/*We failed integrity checking.*/
@@ -2136,6 +2634,11 @@ ReturnCode InitConfig(const char *CurConfigFile)
 			}
 		}
 		
+		/*After compiling, since the cache only ever holds what the files say.*/
+		Overlay_Apply();
+		ExecPlan_Prepare();
+		ConfigArena.LoadedSize = ConfigArena.Stats.BytesUsed + ConfigArena.CacheMapSize;
+		
 		LogInMemory = PrevLogInMemory;
 		EnableLogging = TrueLogEnable;
 	}
@@ -2559,57 +3062,156 @@ ReturnCode EditConfigValue(const char *File, const char *ObjectID, const char *A
 }
 
 /*Adds an object to the table and, if the first run, sets up the table.*/
-static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
-{
-	ObjTable *Worker = ObjectTable, *Next, *Prev;
-	int Inc = 0;
-	/*See, we actually allocate two cells initially. The base and it's node.
-	 * We always keep a free one open. This is just more convenient.*/
-	if (ObjectTable == NULL)
+static char *ConfigFileList_Add(char *Path)
+{ /*Path must live as long as the generation. Returns it, for convenience.*/
+	if ((unsigned)NumConfigFiles == ConfigFileListCapacity)
+	{ /*The old copy stays in the arena until the generation goes, but doubling keeps that small.*/
+		char **const NewList = ConfigArena_Alloc(sizeof(char*) * ConfigFileListCapacity * 2);
+		
+		memcpy(NewList, ConfigFileList, sizeof(char*) * NumConfigFiles);
+		ConfigFileList = NewList;
+		ConfigFileListCapacity *= 2;
+	}
+	
+	return ConfigFileList[NumConfigFiles++] = Path;
+}
+
+static void ConfigFileList_Reset(void)
+{ /*Back to just ConfigFile. Whatever list we had belongs to its arena.*/
+	ConfigFileList = ConfigFileListRoot;
+	ConfigFileListCapacity = 1;
+	NumConfigFiles = 1;
+}
+
+static int ImportConfigGlob_Compare(const void *First, const void *Second)
+{ /*Byte order, so the result never depends on the locale.*/
+	return strcmp(*(char *const*)First, *(char *const*)Second);
+}
+
+static ReturnCode ImportConfigGlob(const char *Pattern, const char *CurConfigFile, unsigned LineNum)
+{ /*Imports every file matching Pattern, in sorted order. A directory means every *.conf inside it.*/
+	char FullPattern[MAX_LINE_SIZE], DirPath[MAX_LINE_SIZE], ErrBuf[MAX_LINE_SIZE];
+	const char *Slash = NULL;
+	glob_t Matches;
+	struct stat MatchStat;
+	size_t Inc = 0;
+	int Inc2 = 0, GlobStatus = 0;
+	
+	if (strpbrk(Pattern, "*?[")) snprintf(FullPattern, sizeof FullPattern, "%s", Pattern);
+	else snprintf(FullPattern, sizeof FullPattern, "%s%s*.conf", Pattern, Pattern[strlen(Pattern) - 1] == '/' ? "" : "/");
+	
+	/*Files coming and going only show up in the directory's mtime, so key the cache on that.
+	 * If the wildcards reach into the directories too, we can't key it at all.*/
+	Slash = strrchr(FullPattern, '/');
+	snprintf(DirPath, sizeof DirPath, "%.*s", (int)(Slash - FullPattern), FullPattern);
+	
+	if (strpbrk(DirPath, "*?[")) ConfigCacheUnkeyable = true;
+	else ConfigCache_AddFileDep(*DirPath ? DirPath : "/");
+	
+	if ((GlobStatus = glob(FullPattern, GLOB_NOSORT, NULL, &Matches)) != 0)
 	{
-		ObjectTable = malloc(sizeof(ObjTable));
-		ObjectTable->Prev = NULL;
-		ObjectTable->Next = NULL;
+		if (GlobStatus == GLOB_NOMATCH) return SUCCESS; /*An empty conf.d is perfectly normal.*/
+		
+		snprintf(ErrBuf, sizeof ErrBuf, CONFIGWARNTXT "Unable to search for config files matching \"%s\", "
+				"imported on line %u in \"%s\".", FullPattern, LineNum, CurConfigFile);
+		SpitWarning(ErrBuf);
+		WriteLogLine(ErrBuf, true);
+		return FAILURE;
+	}
+	
+	qsort(Matches.gl_pathv, Matches.gl_pathc, sizeof(char*), ImportConfigGlob_Compare);
 
-		Worker = ObjectTable;
+#ifdef POSIX_FADV_WILLNEED
+	/*Start reading them all now. The kernel can have the whole lot in flight while we parse them one by one.*/
+	for (Inc = 0; Inc < Matches.gl_pathc; ++Inc)
+	{
+		const int Descriptor = open(Matches.gl_pathv[Inc], O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+		
+		if (Descriptor == -1) continue;
+		posix_fadvise(Descriptor, 0, 0, POSIX_FADV_WILLNEED);
+		close(Descriptor);
 	}
+#endif
 	
-	for (; Worker->Next; Worker = Worker->Next)
+	for (Inc = 0; Inc < Matches.gl_pathc; ++Inc)
 	{
-		if (!strcmp(ObjectID, Worker->ObjectID))
-		{ /*Do not allow duplicate entries.*/
-			return NULL;
+		if (stat(Matches.gl_pathv[Inc], &MatchStat) != 0 || !S_ISREG(MatchStat.st_mode)) continue;
+		
+		/*A broad pattern can easily match a file that's already loaded, including the one importing it.*/
+		for (Inc2 = 0; Inc2 < NumConfigFiles; ++Inc2)
+		{
+			if (!strcmp(ConfigFileList[Inc2], Matches.gl_pathv[Inc])) break;
+		}
+		
+		if (Inc2 != NumConfigFiles) continue;
+		
+		if (!InitConfig(ConfigFileList_Add(ConfigArena_StrDup(Matches.gl_pathv[Inc]))))
+		{
+			snprintf(ErrBuf, sizeof ErrBuf, CONFIGERRORTXT
+					"Failed to load imported config file \"%s\"! File is imported on line %u in \"%s\"\n"
+					"Please correct your configuration! Attempting to continue.",
+					ConfigFileList[NumConfigFiles - 1], LineNum, CurConfigFile);
+			SpitError(ErrBuf);
+			WriteLogLine(ErrBuf, true);
 		}
 	}
+	
+	globfree(&Matches);
+	return SUCCESS;
+}
 
-	Worker->Next = malloc(sizeof(ObjTable));
-	Worker->Next->Next = NULL;
-	Worker->Next->Prev = Worker;
+static void ObjectTable_Grow(void)
+{ /*We always keep room for the terminating element, so grow when that's all that's left.*/
+	unsigned Inc = 0;
+	
+	if (ObjectTableSize + 1 < ObjectTableCapacity) return;
+	
+	ObjectTableCapacity = ObjectTableCapacity ? ObjectTableCapacity * 2 : 32;
+	
+	ObjectTable = realloc(ObjectTable, sizeof(ObjTable) * ObjectTableCapacity);
+	ObjectStates = realloc(ObjectStates, sizeof(struct _ObjState) * ObjectTableCapacity);
+	
+	/*The state array may have moved, so point everyone at their new home.*/
+	for (; Inc < ObjectTableSize; ++Inc)
+	{
+		ObjectTable[Inc].State = ObjectStates + Inc;
+	}
+}
 
-	/*These are the only two variables inside that we need to save before we wipe.*/
-	Next = Worker->Next;
-	Prev = Worker->Prev;
+static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
+{
+	ObjTable *Worker = NULL;
+	unsigned Inc = 0;
+	
+	if (LookupObjectInTable(ObjectID))
+	{ /*Do not allow duplicate entries.*/
+		return NULL;
+	}
+	
+	ObjectTable_Grow();
 	
-	memset(Worker, 0, sizeof(ObjTable)); /*Set everything that is going to be zero to zero.*/
+	Worker = ObjectTable + ObjectTableSize++;
 	
-	Worker->Next = Next;
-	Worker->Prev = Prev;
+	memset(Worker, 0, sizeof(ObjTable) * 2); /*Set everything that is going to be zero to zero, including the terminator.*/
+	memset(ObjectStates + (Worker - ObjectTable), 0, sizeof(struct _ObjState));
+	
+	Worker->State = ObjectStates + (Worker - ObjectTable);
 	
 	/*This is the first thing that must ever be initialized, because it's how we tell objects apart.*/
 	/*This and all things like it are dynamically allocated to provide aggressive memory savings.*/
-	Worker->ObjectID = malloc(strlen(ObjectID) + 1);
-	strncpy(Worker->ObjectID, ObjectID, strlen(ObjectID) + 1);
+	Worker->ObjectID = ConfigArena_StrDup(ObjectID);
 	
 	Worker->ConfigFile = File; /*Set the config file. The pointer actually points to an element in ConfigFileList.*/
 	
 	/*Initialize these to their default values. Used to test integrity before execution begins.*/
 	Worker->TermSignal = SIGTERM; /*This can be changed via config.*/
-	Worker->Enabled = 2; /*We can indeed store this in a bool you know.
+	Worker->State->Enabled = 2; /*We can indeed store this in a bool you know.
 						There's no 1 bit datatype, and in Epoch,
 						Bool is just signed char.*/
 	Worker->Opts.StopTimeout = 10; /*Ten seconds by default.*/
+	Worker->Opts.LogRate = CAPTURE_DEFAULT_RATE;
 	
-	for (; Inc < sizeof Worker->ExitStatuses / sizeof Worker->ExitStatuses[0]; ++Inc)
+	for (Inc = 0; Inc < sizeof Worker->ExitStatuses / sizeof Worker->ExitStatuses[0]; ++Inc)
 	{ /*Set these to their *special* zero.*/
 		Worker->ExitStatuses[Inc].Value = 3; /*One above what we will ever see.*/
 	}
@@ -2617,28 +3219,158 @@ static ObjTable *AddObjectToTable(const char *ObjectID, const char *File)
 	return Worker;
 }
 
-static ReturnCode ScanConfigIntegrity(void)
-{ /*Here we check common mistakes and problems.*/
+static ReturnCode ScanConfigIntegrity_Object(ObjTable *Worker)
+{ /*The checks that only need the one object. Fixes up what it can.*/
 #define IntegrityWarn(msg) WriteLogLine(msg, true), SpitWarning(msg)
-	ObjTable *Worker = ObjectTable, *TOffender;
 	char TmpBuf[1024];
 	ReturnCode RetState = SUCCESS;
-	static Bool WasRunBefore = false;
 	
-	if (ObjectTable == NULL)
-	{ /*This can happen if configuration is filled with trash and nothing valid.*/
-		SpitError("No objects found in configuration or invalid configuration.");
-		return FAILURE;
+	if (Worker->ObjectStartCommand == NULL && Worker->ObjectStopCommand == NULL && Worker->Opts.StopMode == STOP_COMMAND)
+	{
+		snprintf(TmpBuf, 1024, "Object %s has neither ObjectStopCommand nor ObjectStartCommand attributes.", Worker->ObjectID);
+		SpitError(TmpBuf);
+		RetState = FAILURE;
 	}
 	
-	if (*CurRunlevel == 0 || !ObjRL_ValidRunlevel(CurRunlevel))
-	{	
-		if (*CurRunlevel == 0)
-		{
-			SpitError("No default runlevel specified!");
-		}
-		else
-		{
+	if (!Worker->Opts.HaltCmdOnly && Worker->ObjectStartCommand == NULL)
+	{
+		snprintf(TmpBuf, 1024, "Object %s has no attribute ObjectStartCommand\nand is not set to HALTONLY.\n"
+				"Disabling.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->Opts.Exec = false; /*Just in case.*/
+		Worker->Opts.PivotRoot = false;
+		Worker->State->Enabled = false;
+		Worker->State->Started = false;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->Opts.HasPIDFile && Worker->Opts.StopMode == STOP_PID)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" is set to stop via tracked PID,\n"
+				"but a PID file has been specified! Switching to STOP_PIDFILE from STOP_PID.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->Opts.StopMode = STOP_PIDFILE;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->Opts.PivotRoot && Worker->Opts.Exec)
+	{ /*What?*/
+		snprintf(TmpBuf, 1024, "Object \"%s\" has both EXEC and PIVOT options set!\n"
+				"This makes no sense. Disabling the object.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->State->Enabled = false;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (!Worker->Opts.HasPIDFile && Worker->Opts.StopMode == STOP_PIDFILE)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" is set to stop via PID File,\n"
+				"but no PID File attribute specified! Switching to STOP_PID.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->Opts.StopMode = STOP_PID;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->State->Enabled == 2)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" has no attribute ObjectEnabled.", Worker->ObjectID);
+		SpitError(TmpBuf);
+		RetState = FAILURE;
+	}
+	
+	if (Worker->Opts.StopMode != STOP_COMMAND && Worker->Opts.HaltCmdOnly)
+	{ /*We put this here instead of InitConfig() because we can't really do anything but disable.*/
+		snprintf(TmpBuf, 1024, "Object \"%s\" has HALTONLY set,\n"
+				"but stop method is not a command!\nDisabling.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->State->Enabled = false;
+		Worker->State->Started = false;
+		Worker->Opts.StopMode = STOP_NONE;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->Opts.PivotRoot && Worker->Opts.HaltCmdOnly)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" has the PIVOT option set,\n"
+				"but has HALTONLY set as well. Disabling object.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->State->Enabled = false;
+		Worker->State->Started = false;
+		Worker->Opts.PivotRoot = false;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->Opts.Exec && Worker->Opts.HaltCmdOnly)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" has the EXEC option set,\n"
+				"but has HALTONLY set as well. Disabling object.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		Worker->Opts.Exec = false;
+		Worker->State->Enabled = false;
+		Worker->State->Started = false;
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->Opts.NoStopWait && Worker->Opts.StopTimeout != 10)
+	{ /*Why are you setting a stop timeout and then turning off the thing that uses your new value?*/
+		snprintf(TmpBuf, 1024, "Object \"%s\" has both NOSTOPWAIT and STOPTIMEOUT options set.\n"
+				"This doesn't seem very useful.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		if (RetState) RetState = WARNING;
+	}
+	
+	
+	if (Worker->Opts.PivotRoot && Worker->Opts.StopMode != STOP_NONE)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" has the PIVOT option set,\n"
+				"but ObjectStopCommand is not NONE. Setting to NONE.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		
+		Worker->Opts.StopMode = STOP_NONE;
+		Worker->State->ObjectStopPriority = 0;
+		
+		Worker->ObjectStopCommand = NULL;
+		
+		if (RetState) RetState = WARNING;
+	}
+	
+	if (Worker->Opts.PivotRoot && Worker->Opts.HasPIDFile)
+	{
+		snprintf(TmpBuf, 1024, "Object \"%s\" has the PIVOT option set,\n"
+				"but a PID file has been specified. Unsetting PID file attribute.", Worker->ObjectID);
+		IntegrityWarn(TmpBuf);
+		
+		Worker->Opts.HasPIDFile = false;
+		
+		Worker->ObjectPIDFile = NULL;
+		
+		if (RetState) RetState = WARNING;
+	}
+	
+	return RetState;
+}
+
+static ReturnCode ScanConfigIntegrity(void)
+{ /*Here we check common mistakes and problems.*/
+	ObjTable *Worker = ObjectTable;
+	char TmpBuf[1024];
+	ReturnCode RetState = SUCCESS;
+	static Bool WasRunBefore = false;
+	
+	if (ObjectTable == NULL)
+	{ /*This can happen if configuration is filled with trash and nothing valid.*/
+		SpitError("No objects found in configuration or invalid configuration.");
+		return FAILURE;
+	}
+	
+	if (*CurRunlevel == 0 || !ObjRL_ValidRunlevel(CurRunlevel))
+	{	
+		if (*CurRunlevel == 0)
+		{
+			SpitError("No default runlevel specified!");
+		}
+		else
+		{
 	
 			snprintf(TmpBuf, sizeof TmpBuf, "%sThe runlevel \"%s\" does not exist.",
 					WasRunBefore ? "A problem has occured in configuration.\n" : "Error booting to default runlevel.\n",
@@ -2690,151 +3422,21 @@ static ReturnCode ScanConfigIntegrity(void)
 			
 	}
 	
-	for (; Worker->Next != NULL; Worker = Worker->Next)
-	{		
-		if (Worker->ObjectStartCommand == NULL && Worker->ObjectStopCommand == NULL && Worker->Opts.StopMode == STOP_COMMAND)
-		{
-			snprintf(TmpBuf, 1024, "Object %s has neither ObjectStopCommand nor ObjectStartCommand attributes.", Worker->ObjectID);
-			SpitError(TmpBuf);
-			RetState = FAILURE;
-		}
-		
-		if (!Worker->Opts.HaltCmdOnly && Worker->ObjectStartCommand == NULL)
-		{
-			snprintf(TmpBuf, 1024, "Object %s has no attribute ObjectStartCommand\nand is not set to HALTONLY.\n"
-					"Disabling.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Opts.Exec = false; /*Just in case.*/
-			Worker->Opts.PivotRoot = false;
-			Worker->Enabled = false;
-			Worker->Started = false;
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Opts.HasPIDFile && Worker->Opts.StopMode == STOP_PID)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" is set to stop via tracked PID,\n"
-					"but a PID file has been specified! Switching to STOP_PIDFILE from STOP_PID.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Opts.StopMode = STOP_PIDFILE;
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Opts.PivotRoot && Worker->Opts.Exec)
-		{ /*What?*/
-			snprintf(TmpBuf, 1024, "Object \"%s\" has both EXEC and PIVOT options set!\n"
-					"This makes no sense. Disabling the object.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Enabled = false;
-			if (RetState) RetState = WARNING;
-		}
-
-		if (!Worker->Opts.HasPIDFile && Worker->Opts.StopMode == STOP_PIDFILE)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" is set to stop via PID File,\n"
-					"but no PID File attribute specified! Switching to STOP_PID.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Opts.StopMode = STOP_PID;
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Enabled == 2)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" has no attribute ObjectEnabled.", Worker->ObjectID);
-			SpitError(TmpBuf);
-			RetState = FAILURE;
-		}
-		
-		if (Worker->Opts.StopMode != STOP_COMMAND && Worker->Opts.HaltCmdOnly)
-		{ /*We put this here instead of InitConfig() because we can't really do anything but disable.*/
-			snprintf(TmpBuf, 1024, "Object \"%s\" has HALTONLY set,\n"
-					"but stop method is not a command!\nDisabling.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Enabled = false;
-			Worker->Started = false;
-			Worker->Opts.StopMode = STOP_NONE;
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Opts.PivotRoot && Worker->Opts.HaltCmdOnly)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" has the PIVOT option set,\n"
-					"but has HALTONLY set as well. Disabling object.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Enabled = false;
-			Worker->Started = false;
-			Worker->Opts.PivotRoot = false;
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Opts.Exec && Worker->Opts.HaltCmdOnly)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" has the EXEC option set,\n"
-					"but has HALTONLY set as well. Disabling object.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			Worker->Opts.Exec = false;
-			Worker->Enabled = false;
-			Worker->Started = false;
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Opts.NoStopWait && Worker->Opts.StopTimeout != 10)
-		{ /*Why are you setting a stop timeout and then turning off the thing that uses your new value?*/
-			snprintf(TmpBuf, 1024, "Object \"%s\" has both NOSTOPWAIT and STOPTIMEOUT options set.\n"
-					"This doesn't seem very useful.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			if (RetState) RetState = WARNING;
-		}
-			
-		
-		if (Worker->Opts.PivotRoot && Worker->Opts.StopMode != STOP_NONE)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" has the PIVOT option set,\n"
-					"but ObjectStopCommand is not NONE. Setting to NONE.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			
-			Worker->Opts.StopMode = STOP_NONE;
-			Worker->ObjectStopPriority = 0;
-			
-			if (Worker->ObjectStopCommand)
-			{
-				free(Worker->ObjectStopCommand);
-				Worker->ObjectStopCommand = NULL;
-			}
-			
-			if (RetState) RetState = WARNING;
-		}
-		
-		if (Worker->Opts.PivotRoot && Worker->Opts.HasPIDFile)
-		{
-			snprintf(TmpBuf, 1024, "Object \"%s\" has the PIVOT option set,\n"
-					"but a PID file has been specified. Unsetting PID file attribute.", Worker->ObjectID);
-			IntegrityWarn(TmpBuf);
-			
-			Worker->Opts.HasPIDFile = false;
-			
-			if (Worker->ObjectPIDFile)
-			{
-				free(Worker->ObjectPIDFile);
-				Worker->ObjectPIDFile = NULL;
-			}
-			
-			if (RetState) RetState = WARNING;
-		}
-		
-		/*Check for duplicate ObjectIDs.*/
-		for (TOffender = ObjectTable; TOffender->Next != NULL; TOffender = TOffender->Next)
+	for (; Worker->ObjectID != NULL; ++Worker)
+	{
+		switch (ScanConfigIntegrity_Object(Worker))
 		{
-			if (!strcmp(Worker->ObjectID, TOffender->ObjectID) && Worker != TOffender)
-			{
-				snprintf(TmpBuf, 1024, "Two objects in configuration with ObjectID \"%s\".", Worker->ObjectID);
-				SpitError(TmpBuf);
+			case FAILURE:
 				RetState = FAILURE;
-			}			
+				break;
+			case WARNING:
+				if (RetState) RetState = WARNING;
+				break;
+			default:
+				break;
 		}
 	}
-			
-			
+	
 	WasRunBefore = true;
 	
 	return RetState;
@@ -2852,7 +3454,12 @@ ObjTable *LookupObjectInTable(const char *ObjectID)
 		return NULL;
 	}
 	
-	for (; Worker->Next; Worker = Worker->Next)
+	if (ObjectIndex_Sync())
+	{
+		return ObjectIndex_Find(ObjectID);
+	}
+	
+	for (; Worker->ObjectID; ++Worker) /*Couldn't get memory for the index. Do it the slow way.*/
 	{
 		if (!strcmp(Worker->ObjectID, ObjectID))
 		{
@@ -2863,17 +3470,75 @@ ObjTable *LookupObjectInTable(const char *ObjectID)
 	return NULL;
 }
 
+static void ObjectIndex_Insert(unsigned TableIndex)
+{
+	unsigned Slot = (unsigned)ConfigCache_Hash(ObjectTable[TableIndex].ObjectID, strlen(ObjectTable[TableIndex].ObjectID));
+	
+	for (Slot &= ObjectIndex.Size - 1; ObjectIndex.Slots[Slot]; Slot = (Slot + 1) & (ObjectIndex.Size - 1));
+	
+	ObjectIndex.Slots[Slot] = TableIndex + 1;
+	++ObjectIndex.Count;
+}
+
+static Bool ObjectIndex_Sync(void)
+{ /*Bring the index up to date with the live table. Only new objects get added unless the table moved.*/
+	unsigned Inc = 0;
+	
+	if (ObjectIndex.Table != ObjectTable || ObjectIndex.Count > ObjectTableSize || ObjectIndex.Size < ObjectTableSize * 2)
+	{
+		unsigned NewSize = ObjectIndex.Size ? ObjectIndex.Size : 64;
+		
+		while (NewSize < ObjectTableSize * 2) NewSize *= 2;
+		
+		if (NewSize != ObjectIndex.Size)
+		{
+			unsigned *const NewSlots = malloc(sizeof(unsigned) * NewSize);
+			
+			if (!NewSlots) return false;
+			
+			free(ObjectIndex.Slots);
+			ObjectIndex.Slots = NewSlots;
+			ObjectIndex.Size = NewSize;
+		}
+		
+		memset(ObjectIndex.Slots, 0, sizeof(unsigned) * ObjectIndex.Size);
+		ObjectIndex.Table = ObjectTable;
+		ObjectIndex.Count = 0;
+	}
+	
+	for (Inc = ObjectIndex.Count; Inc < ObjectTableSize; ++Inc)
+	{
+		ObjectIndex_Insert(Inc);
+	}
+	
+	return true;
+}
+
+static ObjTable *ObjectIndex_Find(const char *ObjectID)
+{ /*Call ObjectIndex_Sync() first.*/
+	unsigned Slot = (unsigned)ConfigCache_Hash(ObjectID, strlen(ObjectID));
+	
+	for (Slot &= ObjectIndex.Size - 1; ObjectIndex.Slots[Slot]; Slot = (Slot + 1) & (ObjectIndex.Size - 1))
+	{
+		ObjTable *const Worker = ObjectTable + ObjectIndex.Slots[Slot] - 1;
+		
+		if (!strcmp(Worker->ObjectID, ObjectID)) return Worker;
+	}
+	
+	return NULL;
+}
+
 static unsigned PriorityOfLookup(const char *const ObjectID, Bool IsStartingMode)
 {
 	ObjTable *Worker = ObjectTable;
 	
 	if (!ObjectTable) return 0;
 	
-	for (; Worker->Next; Worker = Worker->Next)
+	for (; Worker->ObjectID; ++Worker)
 	{
 		if (!strcmp(ObjectID, Worker->ObjectID))
 		{
-			return IsStartingMode ? Worker->ObjectStartPriority : Worker->ObjectStopPriority;
+			return IsStartingMode ? Worker->State->ObjectStartPriority : Worker->State->ObjectStopPriority;
 		}
 	}
 	
@@ -2884,8 +3549,8 @@ static unsigned PriorityOfLookup(const char *const ObjectID, Bool IsStartingMode
 
 /*Get the max priority number we need to scan.*/
 unsigned GetHighestPriority(Bool WantStartPriority)
-{
-	ObjTable *Worker = ObjectTable;
+{ /*Only needs the priorities, so we walk ObjectStates and leave the rest of the table alone.*/
+	const struct _ObjState *Worker = ObjectStates, *const End = ObjectStates + ObjectTableSize;
 	unsigned CurHighest = 0;
 	unsigned TempNum;
 	
@@ -2894,7 +3559,7 @@ unsigned GetHighestPriority(Bool WantStartPriority)
 		return 0;
 	}
 	
-	for (; Worker->Next; Worker = Worker->Next)
+	for (; Worker != End; ++Worker)
 	{
 		TempNum = (WantStartPriority ? Worker->ObjectStartPriority : Worker->ObjectStopPriority);
 		
@@ -2902,10 +3567,6 @@ unsigned GetHighestPriority(Bool WantStartPriority)
 		{
 			CurHighest = TempNum;
 		}
-		else if (TempNum == 0)
-		{ /*We always skip anything with a priority of zero. That's like saying "DISABLED".*/
-			continue;
-		}
 	}
 	
 	return CurHighest;
@@ -2918,16 +3579,12 @@ void EnvVarList_Add(const char *Var, struct _EnvVarList **const List)
 	
 	if (!*List)
 	{
-		Worker = *List = malloc(sizeof(struct _EnvVarList));
-		Worker->Next = NULL;
-		Worker->Prev = NULL;
-		
+		Worker = *List = ConfigArena_Alloc(sizeof(struct _EnvVarList));
 	}
 	
 	while (Worker->Next) Worker = Worker->Next;
 	
-	Worker->Next = malloc(sizeof(struct _EnvVarList));
-	Worker->Next->Next = NULL;
+	Worker->Next = ConfigArena_Alloc(sizeof(struct _EnvVarList));
 	Worker->Next->Prev = Worker;
 	
 	/*Copy in the environment variable.*/
@@ -2957,14 +3614,12 @@ Bool EnvVarList_Del(const char *const Check, struct _EnvVarList **const List) /*
 				{
 					Worker->Next->Prev = NULL;
 					*List = Worker->Next;
-					free(Worker);
 				}
 			}
 			else
 			{
 				Worker->Next->Prev = Worker->Prev;
 				Worker->Prev->Next = Worker->Next;
-				free(Worker);
 			}
 			return true;
 		}
@@ -2974,17 +3629,9 @@ Bool EnvVarList_Del(const char *const Check, struct _EnvVarList **const List) /*
 }
 
 void EnvVarList_Shutdown(struct _EnvVarList **const List)
-{
-	struct _EnvVarList *Worker = NULL, *Del = NULL;
-	
+{ /*The nodes belong to the config arena, so all we do here is forget the list.*/
 	if (!List) return;
 	
-	for (Worker = *List; Worker; Worker = Del)
-	{
-		Del = Worker->Next;
-		free(Worker);
-	}
-	
 	*List = NULL;
 }
 
@@ -3028,17 +3675,12 @@ void ObjRL_AddRunlevel(const char *InRL, ObjTable *InObj)
 	
 	if (InObj->ObjectRunlevels == NULL)
 	{
-		InObj->ObjectRunlevels = malloc(sizeof(struct _RLTree));
-		
-		InObj->ObjectRunlevels->Prev = NULL;
-		InObj->ObjectRunlevels->Next = NULL;
-		Worker = InObj->ObjectRunlevels;
+		Worker = InObj->ObjectRunlevels = ConfigArena_Alloc(sizeof(struct _RLTree));
 	}
 	
 	while (Worker->Next != NULL) Worker = Worker->Next;
 	
-	Worker->Next = malloc(sizeof(struct _RLTree));
-	Worker->Next->Next = NULL;
+	Worker->Next = ConfigArena_Alloc(sizeof(struct _RLTree));
 	Worker->Next->Prev = Worker;
 	
 	snprintf(Worker->RL, MAX_DESCRIPT_SIZE, "%s", InRL);
@@ -3064,7 +3706,6 @@ Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj)
 				{ /*Are there other runlevels enabled, or just us?*/
 					InObj->ObjectRunlevels->Next->Prev = NULL;
 					InObj->ObjectRunlevels = InObj->ObjectRunlevels->Next;
-					free(Worker);
 				}
 				else
 				{ /*Apparently just us.*/
@@ -3077,8 +3718,6 @@ Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj)
 			/*Otherwise, do this.*/
 			Worker->Prev->Next = Worker->Next;
 			Worker->Next->Prev = Worker->Prev;	
-				
-			free(Worker);
 			
 			return true;
 		}
@@ -3092,7 +3731,7 @@ Bool ObjRL_ValidRunlevel(const char *InRL)
 	const ObjTable *Worker = ObjectTable;
 	Bool ValidRL = false;
 	
-	for (; Worker->Next; Worker = Worker->Next)
+	for (; Worker->ObjectID; ++Worker)
 	{
 		if (!Worker->Opts.HaltCmdOnly && ObjRL_CheckRunlevel(InRL, Worker, true))
 		{
@@ -3105,16 +3744,73 @@ Bool ObjRL_ValidRunlevel(const char *InRL)
 }
 
 void ObjRL_ShutdownRunlevels(ObjTable *InObj)
-{
-	struct _RLTree *Worker = InObj->ObjectRunlevels, *NDel;
+{ /*Same deal as EnvVarList_Shutdown(), the arena owns the nodes.*/
+	InObj->ObjectRunlevels = NULL;
+}
+
+/*Start conditions. The checks themselves live in parse.c, next to the code that starts things.*/
+static const char *const ObjConditionNames[COND_MAX] = {
+	[COND_PATHEXISTS] = "PathExists",
+	[COND_PATHISDIRECTORY] = "PathIsDirectory",
+	[COND_FILENOTEMPTY] = "FileNotEmpty",
+	[COND_KERNELCMDLINE] = "KernelCmdline",
+	[COND_VIRTUALIZATION] = "Virtualization",
+	[COND_FIRSTBOOT] = "FirstBoot",
+	[COND_ENVSET] = "EnvSet"
+};
+
+Bool ObjCondition_Add(const char *InStream, ObjTable *InObj)
+{ /*Takes "[!]Type [argument]" and appends it to the object's conditions.*/
+	struct _ObjCondition *Condition = NULL, **Tail = &InObj->Conditions;
+	const char *Arg = NULL;
+	size_t NameLen = 0, ArgLen = 0;
+	Bool Negate = false;
+	unsigned Inc = 0;
 	
-	for (; Worker != NULL; Worker = NDel)
+	while (*InStream == ' ' || *InStream == '\t') ++InStream;
+	
+	if (*InStream == '!')
 	{
-		NDel = Worker->Next;
-		free(Worker);
+		Negate = true;
+		++InStream;
 	}
 	
-	InObj->ObjectRunlevels = NULL;
+	for (; InStream[NameLen] && InStream[NameLen] != ' ' && InStream[NameLen] != '\t'; ++NameLen);
+	
+	for (; Inc < COND_MAX; ++Inc)
+	{
+		if (strlen(ObjConditionNames[Inc]) == NameLen && !strncmp(InStream, ObjConditionNames[Inc], NameLen)) break;
+	}
+	
+	if (Inc == COND_MAX) return false;
+	
+	for (Arg = InStream + NameLen; *Arg == ' ' || *Arg == '\t'; ++Arg);
+	
+	for (ArgLen = strlen(Arg); ArgLen && (Arg[ArgLen - 1] == ' ' || Arg[ArgLen - 1] == '\t'); --ArgLen);
+	
+	/*FirstBoot is the only one that doesn't check something we name.*/
+	if ((Inc == COND_FIRSTBOOT) != !ArgLen) return false;
+	
+	Condition = ConfigArena_Alloc(sizeof(struct _ObjCondition));
+	Condition->Type = Inc;
+	Condition->Negate = Negate;
+	
+	if (ArgLen)
+	{
+		Condition->Arg = ConfigArena_Alloc(ArgLen + 1);
+		memcpy(Condition->Arg, Arg, ArgLen);
+	}
+	
+	while (*Tail) Tail = &(*Tail)->Next;
+	*Tail = Condition;
+	
+	return true;
+}
+
+void ObjCondition_Describe(const struct _ObjCondition *Condition, char *OutStream, size_t OutSize)
+{ /*The reverse of ObjCondition_Add(). What we log, diff, and store in the cache.*/
+	snprintf(OutStream, OutSize, "%s%s%s%s", Condition->Negate ? "!" : "", ObjConditionNames[Condition->Type],
+			Condition->Arg ? " " : "", Condition->Arg ? Condition->Arg : "");
 }
 
 static void PriorityAlias_Add(const char *Alias, unsigned Target)
@@ -3187,16 +3883,14 @@ static void RLInheritance_Add(const char *Inheriter, const char *Inherited)
 	
 	if (!Worker)
 	{
-		RunlevelInheritance = malloc(sizeof(struct _RunlevelInheritance));
-		memset(RunlevelInheritance, 0, sizeof(struct _RunlevelInheritance));
+		RunlevelInheritance = ConfigArena_Alloc(sizeof(struct _RunlevelInheritance));
 		
 		Worker = RunlevelInheritance;
 	}
 	
 	while (Worker->Next) Worker = Worker->Next;
 	
-	Worker->Next = malloc(sizeof(struct _RunlevelInheritance));
-	memset(Worker->Next, 0, sizeof(struct _RunlevelInheritance));
+	Worker->Next = ConfigArena_Alloc(sizeof(struct _RunlevelInheritance));
 	
 	Worker->Next->Prev = Worker;
 	
@@ -3222,22 +3916,9 @@ static Bool RLInheritance_Check(const char *Inheriter, const char *Inherited)
 	return false;
 }
 
-static void RLInheritance_Shutdown(void)
-{
-	struct _RunlevelInheritance *Worker = RunlevelInheritance, *TDel = NULL;
-	
-	for (; Worker != NULL; Worker = TDel)
-	{
-		TDel = Worker->Next;
-		free(Worker);
-	}
-	
-	RunlevelInheritance = NULL;
-}
-
 ObjTable *GetObjectByPriority(const char *ObjectRunlevel, ObjTable *LastNode, Bool WantStartPriority, unsigned ObjectPriority)
 { /*The primary lookup function to be used when executing commands.*/
-	ObjTable *Worker = LastNode ? LastNode->Next : ObjectTable;
+	ObjTable *Worker = LastNode ? LastNode + 1 : ObjectTable;
 	unsigned WorkerPriority = 0;
 	
 	if (!ObjectTable)
@@ -3245,12 +3926,17 @@ ObjTable *GetObjectByPriority(const char *ObjectRunlevel, ObjTable *LastNode, Bo
 		return (void*)-1; /*Error.*/
 	}
 	
-	for (; Worker->Next != NULL; Worker = Worker->Next)
+	for (; Worker->ObjectID != NULL; ++Worker)
 	{
-		WorkerPriority = (WantStartPriority ? Worker->ObjectStartPriority : Worker->ObjectStopPriority);
+		WorkerPriority = (WantStartPriority ? Worker->State->ObjectStartPriority : Worker->State->ObjectStopPriority);
+		
+		if (WorkerPriority != ObjectPriority)
+		{ /*Cheap check first, the runlevel lists are a lot further away.*/
+			continue;
+		}
 		
-		if ((ObjectRunlevel == NULL || ((WantStartPriority || !Worker->Opts.HaltCmdOnly) &&
-			(ObjRL_CheckRunlevel(ObjectRunlevel, Worker, true) || (CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(Worker->ObjectID, true))) )) && WorkerPriority == ObjectPriority)
+		if (ObjectRunlevel == NULL || ((WantStartPriority || !Worker->Opts.HaltCmdOnly) &&
+			(ObjRL_CheckRunlevel(ObjectRunlevel, Worker, true) || (CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(Worker->ObjectID, true)))))
 		{
 			return Worker;
 		}
@@ -3259,171 +3945,1225 @@ ObjTable *GetObjectByPriority(const char *ObjectRunlevel, ObjTable *LastNode, Bo
 	return NULL;
 }
 
-void ShutdownConfig(void)
-{
-	ObjTable *Worker = ObjectTable, *Temp;
-	unsigned Inc = 1;
+void *ConfigArena_Alloc(size_t Size)
+{ /*Memory from here is never freed on its own. It goes away when the generation is dropped.*/
+	struct _ConfigArenaBlock *Block = ConfigArena.Blocks;
+	uintptr_t Base = 0;
 	
-	EnvVarList_Shutdown(&GlobalEnvVars);
+	Size = (Size + CONFIG_ARENA_ALIGN - 1) & ~(CONFIG_ARENA_ALIGN - 1);
 	
-	for (; Worker != NULL; Worker = Temp)
+	if (!Block || Block->Size - Block->Used < Size)
 	{
-		if (Worker->Next)
-		{
-			if (Worker->ObjectID) free(Worker->ObjectID);
-			
-			if (Worker->ObjectDescription &&
-				Worker->ObjectDescription != Worker->ObjectID) free(Worker->ObjectDescription);
-				
-			if (Worker->ObjectStartCommand) free(Worker->ObjectStartCommand);
-			if (Worker->ObjectStopCommand) free(Worker->ObjectStopCommand);
-			if (Worker->ObjectReloadCommand) free(Worker->ObjectReloadCommand);
-			if (Worker->ObjectPrestartCommand) free(Worker->ObjectPrestartCommand);
-			if (Worker->ObjectPIDFile) free(Worker->ObjectPIDFile);
-			if (Worker->ObjectWorkingDirectory) free(Worker->ObjectWorkingDirectory);
-			if (Worker->ObjectStdout) free(Worker->ObjectStdout);
-			if (Worker->ObjectStderr) free(Worker->ObjectStderr);
+		const size_t HeaderSize = (sizeof(struct _ConfigArenaBlock) + CONFIG_ARENA_ALIGN - 1) & ~(CONFIG_ARENA_ALIGN - 1);
+		size_t BlockSize = CONFIG_ARENA_BLOCKSIZE;
+		void *NewMap = NULL;
+		
+		if (HeaderSize + Size > BlockSize)
+		{ /*Oversized requests get a block of their own.*/
+			const size_t PageSize = sysconf(_SC_PAGESIZE);
 			
-			ObjRL_ShutdownRunlevels(Worker);
-			EnvVarList_Shutdown(&Worker->EnvVars);
+			BlockSize = (HeaderSize + Size + PageSize - 1) / PageSize * PageSize;
+		}
+		
+		if ((NewMap = mmap(NULL, BlockSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		{
+			SpitError("ConfigArena_Alloc(): Unable to map memory for configuration!");
+			if (BackgroundReload.InChild) ReloadConfig_ChildFatal();
+			EmergencyShell();
+		}
+		
+		Block = NewMap;
+		Block->Size = BlockSize;
+		Block->Used = HeaderSize;
+		
+		if (BlockSize != CONFIG_ARENA_BLOCKSIZE && ConfigArena.Blocks)
+		{ /*Tuck dedicated blocks behind the head, since there's no room left in them anyways.*/
+			Block->Next = ConfigArena.Blocks->Next;
+			ConfigArena.Blocks->Next = Block;
+		}
+		else
+		{
+			Block->Next = ConfigArena.Blocks;
+			ConfigArena.Blocks = Block;
 		}
 		
-		Temp = Worker->Next;
-		free(Worker);
+		++ConfigArena.Stats.NumBlocks;
+		ConfigArena.Stats.BytesReserved += BlockSize;
 	}
 	
-	RLInheritance_Shutdown();
-	ObjectTable = NULL;
+	Base = (uintptr_t)Block + Block->Used;
+	Block->Used += Size;
 	
-	/*Release all config file names.*/
-	for (; Inc < MAX_CONFIG_FILES && ConfigFileList[Inc] != NULL; ++Inc)
-	{ /*Inc is initialized to ONE. Do not try to free 0, that points to an array on the stack!*/
-		free(ConfigFileList[Inc]);
-		ConfigFileList[Inc] = NULL;
-	}
+	++ConfigArena.Stats.NumAllocs;
+	ConfigArena.Stats.BytesUsed += Size;
+	
+	return memset((void*)Base, 0, Size);
 }
 
-ReturnCode ReloadConfig(void)
-{ /*This function is somewhat hard to read, but it does the job well.*/
-	ObjTable *Worker = ObjectTable;
-	ObjTable *TRoot = malloc(sizeof(ObjTable)), *SWorker = TRoot, *Temp = NULL;
-	struct _RLTree *RLTemp1 = NULL, *RLTemp2 = NULL;
-	Bool GlobalOpts[3], ConfigOK = true;
-	struct _RunlevelInheritance *RLIRoot = NULL, *RLIWorker[2] = { NULL };
-	char RunlevelBackup[MAX_DESCRIPT_SIZE];
-	void *TempPtr = NULL, *TempPtr2 = NULL;
-	struct _EnvVarList *GlobalEnvWorker, *GlobalEnvRoot = NULL;
-	char *BackupConfigFileList[MAX_CONFIG_FILES] = { ConfigFile };
-	int Inc = 1;
-	
-	WriteLogLine("CONFIG: Reloading configuration.\n", true);
-	WriteLogLine("CONFIG: Backing up current configuration.", true);
+char *ConfigArena_StrDup(const char *InStream)
+{
+	const size_t Length = strlen(InStream) + 1;
 	
-	/*Backup the current runlevel.*/
-	snprintf(RunlevelBackup, MAX_DESCRIPT_SIZE, "%s", CurRunlevel);
+	return memcpy(ConfigArena_Alloc(Length), InStream, Length);
+}
+
+static void ConfigArena_Drop(struct _ConfigArena *Arena)
+{ /*Release an entire generation. This is the only way arena memory is ever freed.*/
+	struct _ConfigArenaBlock *Worker = Arena->Blocks, *Next = NULL;
 	
-	/*Backup the config file names.*/
-	for (; Inc < MAX_CONFIG_FILES; ++Inc)
+	for (; Worker != NULL; Worker = Next)
 	{
-		BackupConfigFileList[Inc] = ConfigFileList[Inc];
-		ConfigFileList[Inc] = NULL;
+		Next = Worker->Next;
+		munmap(Worker, Worker->Size);
 	}
 	
-	/*Backup the global environment variables.*/
-	if (GlobalEnvVars)
+	if (Arena->CacheMap)
 	{
-		for (GlobalEnvWorker = GlobalEnvVars; GlobalEnvWorker->Next; GlobalEnvWorker = GlobalEnvWorker->Next)
-		{
-			EnvVarList_Add(GlobalEnvWorker->EnvVar, &GlobalEnvRoot);
-		}
-		GlobalEnvVars = NULL;
+		munmap(Arena->CacheMap, Arena->CacheMapSize);
+		Arena->CacheMap = NULL;
+		Arena->CacheMapSize = 0;
 	}
 	
-	for (; Worker->Next != NULL; Worker = Worker->Next, SWorker = SWorker->Next)
-	{
-		*SWorker = *Worker; /*Direct as-a-unit copy of the main list node to the backup list node.*/
-		SWorker->Prev = TempPtr;
-		SWorker->Next = malloc(sizeof(ObjTable));
-		SWorker->Next->Next = NULL;
-		TempPtr = SWorker;
-		
-		/*Backup the dynamically allocated strings.*/
-		SWorker->ObjectID = Worker->ObjectID;
-		Worker->ObjectID = NULL;
-		
-		SWorker->ObjectDescription = Worker->ObjectDescription;
-		Worker->ObjectDescription = NULL;
-		
-		SWorker->ObjectStartCommand = Worker->ObjectStartCommand;
-		Worker->ObjectStartCommand = NULL;
-		
-		SWorker->ObjectStopCommand = Worker->ObjectStopCommand;
-		Worker->ObjectStopCommand = NULL;
-		
-		SWorker->ObjectPrestartCommand = Worker->ObjectPrestartCommand;
-		Worker->ObjectPrestartCommand = NULL;
-		
-		SWorker->ObjectReloadCommand = Worker->ObjectReloadCommand;
-		Worker->ObjectReloadCommand = NULL;
-		
-		SWorker->ObjectPIDFile = Worker->ObjectPIDFile;
-		Worker->ObjectPIDFile = NULL;
-		
-		SWorker->ObjectWorkingDirectory = Worker->ObjectWorkingDirectory;
-		Worker->ObjectWorkingDirectory = NULL;
-		
-		SWorker->ObjectStdout = Worker->ObjectStdout;
-		Worker->ObjectStdout = NULL;
-		
-		SWorker->ObjectStderr = Worker->ObjectStderr;
-		Worker->ObjectStderr = NULL;
+	Arena->Blocks = NULL;
+	Arena->Stats.NumBlocks = 0;
+	Arena->Stats.NumAllocs = 0;
+	Arena->Stats.BytesUsed = 0;
+	Arena->Stats.BytesReserved = 0;
+}
+
+void ConfigArena_GetStats(struct _ConfigArenaStats *OutStats)
+{
+	*OutStats = ConfigArena.Stats;
+}
+
+static uint64_t ConfigCache_Hash(const void *Data, size_t Size)
+{ /*FNV-1a. Config files are small, and this only has to notice edits, not stand up to attackers.*/
+	const unsigned char *Worker = Data, *const End = Worker + Size;
+	uint64_t Hash = 0xcbf29ce484222325ULL;
 	
-		SWorker->EnvVars = Worker->EnvVars;
-		Worker->EnvVars = NULL;
+	for (; Worker != End; ++Worker)
+	{
+		Hash = (Hash ^ *Worker) * 0x100000001b3ULL;
+	}
+	
+	return Hash;
+}
+
+static Bool ConfigCache_ReserveDeps(unsigned Count)
+{
+	struct _ConfigCacheDepEntry *NewDeps = NULL;
+	unsigned NewCapacity = ConfigCacheDepsCapacity ? ConfigCacheDepsCapacity : 32;
+	
+	if (Count <= ConfigCacheDepsCapacity) return true;
+	
+	while (NewCapacity < Count) NewCapacity *= 2;
+	
+	if (!(NewDeps = realloc(ConfigCacheDeps, sizeof *NewDeps * NewCapacity))) return false;
+	
+	ConfigCacheDeps = NewDeps;
+	ConfigCacheDepsCapacity = NewCapacity;
+	return true;
+}
+
+static void ConfigCache_AddDep(const char *Path, const struct stat *FileStat, uint64_t Hash)
+{ /*Path has to live as long as the generation does.*/
+	if (!ConfigCache_ReserveDeps(NumConfigCacheDeps + 1))
+	{ /*This can't be keyed properly, so make sure ConfigCache_Build() won't save it.*/
+		ConfigCacheUnkeyable = true;
+		return;
+	}
+	
+	ConfigCacheDeps[NumConfigCacheDeps].Path = Path;
+	ConfigCacheDeps[NumConfigCacheDeps].Key.Size = FileStat->st_size;
+	ConfigCacheDeps[NumConfigCacheDeps].Key.MTime = FileStat->st_mtim.tv_sec;
+	ConfigCacheDeps[NumConfigCacheDeps].Key.MTimeNsec = FileStat->st_mtim.tv_nsec;
+	ConfigCacheDeps[NumConfigCacheDeps].Key.Hash = Hash;
+	ConfigCacheDeps[NumConfigCacheDeps].Key.Flags = 0;
+	++NumConfigCacheDeps;
+}
+
+static Bool ConfigCache_HashFile(const char *Path, struct stat *OutStat, uint64_t *OutHash)
+{
+	void *Map = NULL;
+	const int Descriptor = open(Path, O_RDONLY | O_CLOEXEC);
+	
+	if (Descriptor == -1) return false;
+	
+	if (fstat(Descriptor, OutStat) != 0)
+	{
+		close(Descriptor);
+		return false;
+	}
+	
+	if (OutStat->st_size == 0 || S_ISDIR(OutStat->st_mode))
+	{ /*For directories, the mtime is what tells us something changed.*/
+		close(Descriptor);
+		*OutHash = ConfigCache_Hash(NULL, 0);
+		return true;
+	}
+	
+	Map = mmap(NULL, OutStat->st_size, PROT_READ, MAP_PRIVATE, Descriptor, 0);
+	close(Descriptor);
+	
+	if (Map == MAP_FAILED) return false;
+	
+	*OutHash = ConfigCache_Hash(Map, OutStat->st_size);
+	munmap(Map, OutStat->st_size);
+	
+	return true;
+}
+
+static void ConfigCache_AddFileDep(const char *Path)
+{ /*For files we consult while parsing that aren't config files, like /etc/passwd.*/
+	struct stat FileStat;
+	uint64_t Hash = 0;
+	
+	if (ConfigCache_FindDep(Path)) return;
+	
+	if (!ConfigCache_HashFile(Path, &FileStat, &Hash))
+	{ /*Still key on it, so the file showing up later counts as a change.*/
+		memset(&FileStat, 0, sizeof FileStat);
+	}
+	
+	ConfigCache_AddDep(ConfigArena_StrDup(Path), &FileStat, Hash);
+}
+
+static Bool ConfigCache_DepMatches(const char *Path, const struct _ConfigCacheDep *Key)
+{ /*Is the file still exactly what it was when we read it?*/
+	struct stat FileStat;
+	uint64_t Hash = 0;
+	
+	if (!ConfigCache_HashFile(Path, &FileStat, &Hash))
+	{ /*Same as ConfigCache_AddFileDep() does for missing files.*/
+		memset(&FileStat, 0, sizeof FileStat);
+		Hash = 0;
+	}
+	
+	return (uint64_t)FileStat.st_size == Key->Size && FileStat.st_mtim.tv_sec == Key->MTime &&
+			FileStat.st_mtim.tv_nsec == Key->MTimeNsec && Hash == Key->Hash;
+}
+
+static struct _ConfigCacheDepEntry *ConfigCache_FindDep(const char *Path)
+{
+	unsigned Inc = 0;
+	
+	for (; Inc < NumConfigCacheDeps; ++Inc)
+	{
+		if (!strcmp(ConfigCacheDeps[Inc].Path, Path)) return ConfigCacheDeps + Inc;
+	}
+	
+	return NULL;
+}
+
+static int ConfigCache_Changes(unsigned *OutChanged)
+{ /*How many of the files we read are no longer what they were, or -1 if we can't tell.
+	* OutChanged gets their indexes in ConfigCacheDeps. Without it, we stop at the first.*/
+	unsigned Inc = 0;
+	int NumChanged = 0;
+	
+	if (!NumConfigCacheDeps || ConfigCacheUnkeyable || strcmp(ConfigCacheDeps[0].Path, ConfigFile) != 0)
+	{
+		return -1;
+	}
+	
+	for (; Inc < NumConfigCacheDeps; ++Inc)
+	{
+		if (ConfigCache_DepMatches(ConfigCacheDeps[Inc].Path, &ConfigCacheDeps[Inc].Key)) continue;
+		
+		if (!OutChanged) return 1;
+		OutChanged[NumChanged++] = Inc;
+	}
+	
+	return NumChanged;
+}
+
+static ReturnCode ConfigCache_Load(Bool *OutLogEnable)
+{ /*Map the compiled configuration in place of parsing, if it's still good. Fails quietly if not.*/
+	unsigned char *Map = NULL;
+	struct stat FileStat;
+	int Descriptor = 0;
+	
+	if ((Descriptor = open(CONFIGCACHE, O_RDONLY | O_CLOEXEC)) == -1) return FAILURE;
+	
+	if (fstat(Descriptor, &FileStat) != 0 || FileStat.st_size < (off_t)sizeof(struct _ConfigCacheHeader) ||
+		(Map = mmap(NULL, FileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, Descriptor, 0)) == MAP_FAILED)
+	{ /*Private and writable, so anyone editing a string in place gets their own copy of the page.*/
+		close(Descriptor);
+		return FAILURE;
+	}
+	close(Descriptor);
+	
+	if (!ConfigCache_LoadImage(Map, FileStat.st_size, true, OutLogEnable))
+	{
+		munmap(Map, FileStat.st_size);
+		return FAILURE;
+	}
+	
+	WriteLogLine("CONFIG: Loaded compiled configuration from " CONFIGCACHE ".", true);
+	
+	return SUCCESS;
+}
+
+static Bool ConfigCache_CheckImage(const unsigned char *Map, size_t MapSize)
+{ /*Whether it's ours, and every offset in it stays inside it. Says nothing about whether it's current.*/
+	const struct _ConfigCacheHeader *const Header = (const void*)Map;
+	const struct _ConfigCacheDep *Deps = NULL;
+	const struct _ConfigCacheObject *Objects = NULL;
+	const uint32_t *Lists = NULL;
+	unsigned Inc = 0, Inc2 = 0;
+	
+	if (MapSize < sizeof(struct _ConfigCacheHeader)) return false;
+	
+	/*Check that it's ours, and that every section is inside the file.*/
+	if (memcmp(Header->Magic, CONFIG_CACHE_MAGIC, sizeof CONFIG_CACHE_MAGIC) != 0 || Header->NumDeps == 0 ||
+		Header->Version != CONFIG_CACHE_VERSION || Header->Layout != CONFIG_CACHE_LAYOUT ||
+		Header->TotalSize != MapSize ||
+		(uint64_t)Header->DepsOffset + (uint64_t)Header->NumDeps * sizeof(struct _ConfigCacheDep) > Header->TotalSize ||
+		(uint64_t)Header->ObjectsOffset + (uint64_t)Header->NumObjects * sizeof(struct _ConfigCacheObject) > Header->TotalSize ||
+		(uint64_t)Header->ListsOffset + (uint64_t)Header->NumLists * sizeof(uint32_t) > Header->TotalSize ||
+		(uint64_t)Header->StringsOffset + Header->StringsSize > Header->TotalSize || Header->StringsSize == 0 ||
+		Map[Header->StringsOffset + Header->StringsSize - 1] != '\0' ||
+		(uint64_t)Header->ConfigFiles + Header->NumConfigFiles > Header->NumLists ||
+		(uint64_t)Header->GlobalEnvVars + Header->NumGlobalEnvVars > Header->NumLists ||
+		(uint64_t)Header->RLInheritance + Header->NumRLInheritance * 2ULL > Header->NumLists)
+	{
+		return false;
+	}
+	
+	Deps = (const void*)(Map + Header->DepsOffset);
+	Objects = (const void*)(Map + Header->ObjectsOffset);
+	Lists = (const void*)(Map + Header->ListsOffset);
+	
+	/*Strings must be in the table and the ends of the file can't change, so check these once.*/
+	for (Inc = 0; Inc < Header->NumLists; ++Inc)
+	{
+		if (Lists[Inc] >= Header->StringsSize) return false;
+	}
+	
+	for (Inc = 0; Inc < Header->NumDeps; ++Inc)
+	{
+		if (Deps[Inc].Path >= Header->StringsSize) return false;
+	}
+	
+	for (Inc = 0; Inc < Header->NumObjects; ++Inc)
+	{
+		const struct _ConfigCacheObject *const CObj = Objects + Inc;
 		
-		if (!Worker->ObjectRunlevels)
+		for (Inc2 = 0; Inc2 < sizeof CObj->Strings / sizeof *CObj->Strings; ++Inc2)
 		{
-			continue;
+			if (CObj->Strings[Inc2] >= Header->StringsSize) return false;
+		}
+		
+		if (!CObj->Strings[0] || CObj->ConfigFile > Header->NumConfigFiles ||
+			(uint64_t)CObj->EnvVars + CObj->NumEnvVars > Header->NumLists ||
+			(uint64_t)CObj->Runlevels + CObj->NumRunlevels > Header->NumLists ||
+			(uint64_t)CObj->Conditions + CObj->NumConditions > Header->NumLists)
+		{
+			return false;
+		}
+	}
+	
+	return Header->LogFile < Header->StringsSize && Header->Hostname < Header->StringsSize &&
+			Header->Domainname < Header->StringsSize && Header->DefaultRunlevel < Header->StringsSize &&
+			Header->JournalPath < Header->StringsSize;
+}
+
+static Bool ConfigCache_LoadObject(const unsigned char *Map, const struct _ConfigCacheObject *CObj, ObjTable *Worker, Bool CopyStrings)
+{ /*Fills in Worker, which already has its State. Without CopyStrings, its strings point into Map.*/
+	const struct _ConfigCacheHeader *const Header = (const void*)Map;
+	const uint32_t *const Lists = (const void*)(Map + Header->ListsOffset);
+	const char *const Strings = (const char*)Map + Header->StringsOffset;
+	unsigned Inc = 0;
+	
+	for (; Inc < sizeof CObj->Strings / sizeof *CObj->Strings; ++Inc)
+	{ /*Offset zero is reserved for NULL.*/
+		if (!CObj->Strings[Inc]) ObjString(Worker, Inc) = NULL;
+		else if (!CopyStrings) ObjString(Worker, Inc) = (char*)Strings + CObj->Strings[Inc];
+		else if (Inc > 0 && CObj->Strings[Inc] == CObj->Strings[0]) ObjString(Worker, Inc) = Worker->ObjectID; /*Same as it was built from.*/
+		else ObjString(Worker, Inc) = ConfigArena_StrDup(Strings + CObj->Strings[Inc]);
+	}
+	
+	Worker->ConfigFile = ConfigFileList[CObj->ConfigFile];
+	Worker->UserID = CObj->UserID;
+	Worker->GroupID = CObj->GroupID;
+	Worker->TermSignal = CObj->TermSignal;
+	Worker->ReloadCommandSignal = CObj->ReloadCommandSignal;
+	memcpy(Worker->ExitStatuses, CObj->ExitStatuses, sizeof Worker->ExitStatuses);
+	memcpy(&Worker->Opts, CObj->Opts, sizeof Worker->Opts);
+	
+	Worker->State->ObjectStartPriority = CObj->StartPriority;
+	Worker->State->ObjectStopPriority = CObj->StopPriority;
+	Worker->State->AutoRestart = CObj->AutoRestart;
+	Worker->State->Enabled = CObj->Enabled;
+	
+	for (Inc = 0; Inc < CObj->NumEnvVars; ++Inc)
+	{
+		EnvVarList_Add(Strings + Lists[CObj->EnvVars + Inc], &Worker->EnvVars);
+	}
+	
+	for (Inc = 0; Inc < CObj->NumRunlevels; ++Inc)
+	{
+		ObjRL_AddRunlevel(Strings + Lists[CObj->Runlevels + Inc], Worker);
+	}
+	
+	for (Inc = 0; Inc < CObj->NumConditions; ++Inc)
+	{
+		if (!ObjCondition_Add(Strings + Lists[CObj->Conditions + Inc], Worker)) return false;
+	}
+	
+	return true;
+}
+
+static ReturnCode ConfigCache_LoadImage(unsigned char *Map, size_t MapSize, Bool CheckDeps, Bool *OutLogEnable)
+{ /*Builds the configuration from a mapped cache image. On success, the arena takes ownership of the mapping.*/
+	const struct _ConfigCacheHeader *const Header = (const void*)Map;
+	const struct _ConfigCacheDep *Deps = NULL;
+	const struct _ConfigCacheObject *Objects = NULL;
+	const uint32_t *Lists = NULL;
+	const char *Strings = NULL;
+	unsigned Inc = 0;
+	
+	if (!ConfigCache_CheckImage(Map, MapSize)) return FAILURE;
+	
+	Deps = (const void*)(Map + Header->DepsOffset);
+	Objects = (const void*)(Map + Header->ObjectsOffset);
+	Lists = (const void*)(Map + Header->ListsOffset);
+	Strings = (const char*)Map + Header->StringsOffset;
+	
+	/*Now see if anything we were built from has changed.*/
+	for (Inc = 0; Inc < Header->NumDeps; ++Inc)
+	{
+		/*The first one is always the primary config file, and it had better be the one we were asked for.*/
+		if (Inc == 0 && strcmp(Strings + Deps[Inc].Path, ConfigFile) != 0) return FAILURE;
+		
+		if (CheckDeps && !ConfigCache_DepMatches(Strings + Deps[Inc].Path, Deps + Inc)) return FAILURE;
+	}
+	
+	if (!ConfigCache_ReserveDeps(Header->NumDeps)) return FAILURE;
+	
+	/**It's good. Build the configuration from it.**/
+	for (Inc = 0; Inc < Header->NumDeps; ++Inc)
+	{ /*Keep the keys, so ReloadConfig() can tell if anything changed since.*/
+		ConfigCacheDeps[Inc].Path = Strings + Deps[Inc].Path;
+		ConfigCacheDeps[Inc].Key = Deps[Inc];
+	}
+	NumConfigCacheDeps = Header->NumDeps;
+	
+	for (Inc = 0; Inc < Header->NumConfigFiles; ++Inc)
+	{
+		ConfigFileList_Add((char*)Strings + Lists[Header->ConfigFiles + Inc]);
+	}
+	
+	ObjectTableCapacity = Header->NumObjects + 1;
+	ObjectTable = calloc(ObjectTableCapacity, sizeof(ObjTable));
+	ObjectStates = calloc(ObjectTableCapacity, sizeof(struct _ObjState));
+	
+	for (; ObjectTableSize < Header->NumObjects; ++ObjectTableSize)
+	{
+		ObjectTable[ObjectTableSize].State = ObjectStates + ObjectTableSize;
+		
+		if (!ConfigCache_LoadObject(Map, Objects + ObjectTableSize, ObjectTable + ObjectTableSize, false)) return FAILURE;
+	}
+	
+	for (Inc = 0; Inc < Header->NumGlobalEnvVars; ++Inc)
+	{
+		EnvVarList_Add(Strings + Lists[Header->GlobalEnvVars + Inc], &GlobalEnvVars);
+	}
+	
+	for (Inc = 0; Inc < Header->NumRLInheritance; ++Inc)
+	{
+		RLInheritance_Add(Strings + Lists[Header->RLInheritance + Inc * 2], Strings + Lists[Header->RLInheritance + Inc * 2 + 1]);
+	}
+	
+	/*Now the global options.*/
+	BootBanner = Header->BootBanner;
+	LogRotate = Header->LogRotate;
+	StatusReportFormat = Header->StatusReportFormat;
+	memcpy(AutoMountOpts, Header->AutoMountOpts, sizeof AutoMountOpts);
+	DisableCAD = Header->DisableCAD;
+	BlankLogOnBoot = Header->BlankLogOnBoot;
+	if (Header->EnableLogging != -1) *OutLogEnable = Header->EnableLogging;
+	
+	if (Header->LogFile) snprintf(LogFile, sizeof LogFile, "%s", Strings + Header->LogFile);
+	if (Header->JournalPath) snprintf(JournalPath, sizeof JournalPath, "%s", Strings + Header->JournalPath);
+	if (Header->Hostname) snprintf(Hostname, sizeof Hostname, "%s", Strings + Header->Hostname);
+	if (Header->Domainname) snprintf(Domainname, sizeof Domainname, "%s", Strings + Header->Domainname);
+	
+	if (Header->DefaultRunlevel)
+	{
+		snprintf(ConfigDefaultRunlevel, sizeof ConfigDefaultRunlevel, "%s", Strings + Header->DefaultRunlevel);
+		if (!*CurRunlevel) snprintf(CurRunlevel, sizeof CurRunlevel, "%s", ConfigDefaultRunlevel);
+	}
+	
+	/*The strings stay where they are, so the mapping lives as long as this generation does.*/
+	ConfigArena.CacheMap = Map;
+	ConfigArena.CacheMapSize = MapSize;
+	
+	return SUCCESS;
+}
+
+static ReturnCode ConfigCache_LoadObjects(const unsigned char *Map, size_t MapSize, const unsigned *Changed, unsigned NumChanged)
+{ /*Only the objects from an image a background reload built of the files that changed, into whatever table is live.
+	* It has to have been built against the files we have. We take its keys for the changed ones, and anything
+	* parsing them pulled in that we didn't have. The strings are copied into the arena, so the image can go after.*/
+	const struct _ConfigCacheHeader *const Header = (const void*)Map;
+	const struct _ConfigCacheDep *Deps = NULL;
+	const struct _ConfigCacheObject *Objects = NULL;
+	const uint32_t *Lists = NULL;
+	const char *Strings = NULL;
+	unsigned Inc = 0;
+	
+	if (!ConfigCache_CheckImage(Map, MapSize) || Header->NumDeps < NumConfigCacheDeps ||
+		Header->NumConfigFiles + 1 != (unsigned)NumConfigFiles || !ConfigCache_ReserveDeps(Header->NumDeps))
+	{
+		return FAILURE;
+	}
+	
+	Deps = (const void*)(Map + Header->DepsOffset);
+	Objects = (const void*)(Map + Header->ObjectsOffset);
+	Lists = (const void*)(Map + Header->ListsOffset);
+	Strings = (const char*)Map + Header->StringsOffset;
+	
+	for (Inc = 0; Inc < NumConfigCacheDeps; ++Inc)
+	{
+		if (strcmp(Strings + Deps[Inc].Path, ConfigCacheDeps[Inc].Path) != 0) return FAILURE;
+	}
+	
+	for (Inc = 0; Inc < Header->NumConfigFiles; ++Inc)
+	{ /*So its ConfigFile indexes mean the same to us.*/
+		if (strcmp(Strings + Lists[Header->ConfigFiles + Inc], ConfigFileList[Inc + 1]) != 0) return FAILURE;
+	}
+	
+	ObjectTableCapacity = Header->NumObjects + 1;
+	ObjectTable = calloc(ObjectTableCapacity, sizeof(ObjTable));
+	ObjectStates = calloc(ObjectTableCapacity, sizeof(struct _ObjState));
+	
+	if (!ObjectTable || !ObjectStates) return FAILURE;
+	
+	for (; ObjectTableSize < Header->NumObjects; ++ObjectTableSize)
+	{
+		ObjectTable[ObjectTableSize].State = ObjectStates + ObjectTableSize;
+		
+		if (!ConfigCache_LoadObject(Map, Objects + ObjectTableSize, ObjectTable + ObjectTableSize, true)) return FAILURE;
+	}
+	
+	for (Inc = 0; Inc < NumChanged; ++Inc)
+	{
+		ConfigCacheDeps[Changed[Inc]].Key = Deps[Changed[Inc]];
+	}
+	
+	for (; NumConfigCacheDeps < Header->NumDeps; ++NumConfigCacheDeps)
+	{ /*Like /etc/passwd, for an object that only just got an ObjectUser.*/
+		ConfigCacheDeps[NumConfigCacheDeps].Path = ConfigArena_StrDup(Strings + Deps[NumConfigCacheDeps].Path);
+		ConfigCacheDeps[NumConfigCacheDeps].Key = Deps[NumConfigCacheDeps];
+	}
+	
+	return SUCCESS;
+}
+
+/*Growable buffer for putting together a new cache image.*/
+struct _ConfigCacheBuf
+{
+	unsigned char *Data;
+	size_t Size, Capacity;
+};
+
+static uint32_t ConfigCache_Append(struct _ConfigCacheBuf *Buf, const void *Data, size_t Size)
+{
+	const uint32_t Offset = Buf->Size;
+	
+	if (Buf->Size + Size > Buf->Capacity)
+	{
+		do Buf->Capacity = Buf->Capacity ? Buf->Capacity * 2 : 4096;
+		while (Buf->Size + Size > Buf->Capacity);
+		
+		Buf->Data = realloc(Buf->Data, Buf->Capacity);
+	}
+	
+	memcpy(Buf->Data + Buf->Size, Data, Size);
+	Buf->Size += Size;
+	
+	return Offset;
+}
+
+static uint32_t ConfigCache_AddString(struct _ConfigCacheBuf *Strings, const char *InStream)
+{ /*NULL and empty strings both come back as zero.*/
+	if (!InStream || !*InStream) return 0;
+	
+	return ConfigCache_Append(Strings, InStream, strlen(InStream) + 1);
+}
+
+static uint32_t ConfigCache_AddList(struct _ConfigCacheBuf *Lists, struct _ConfigCacheBuf *Strings, const char *InStream)
+{ /*Returns the list index.*/
+	const uint32_t StringOffset = ConfigCache_AddString(Strings, InStream);
+	
+	return ConfigCache_Append(Lists, &StringOffset, sizeof StringOffset) / sizeof(uint32_t);
+}
+
+static unsigned char *ConfigCache_Build(signed char LogEnable)
+{ /*Snapshot what InitConfig() just built, so the next boot can skip the parsing. NULL if it can't be keyed.*/
+	struct _ConfigCacheHeader *Header = NULL;
+	struct _ConfigCacheObject *Objects = NULL;
+	struct _ConfigCacheBuf Lists = { NULL }, Strings = { NULL };
+	const struct _RunlevelInheritance *RLWorker = RunlevelInheritance;
+	const struct _EnvVarList *EnvWorker = GlobalEnvVars;
+	unsigned Inc = 0, Inc2 = 0;
+	unsigned char *Image = NULL;
+	size_t Offset = 0;
+	
+	if (ConfigCacheUnkeyable) return NULL;
+	
+	Header = calloc(1, sizeof(struct _ConfigCacheHeader));
+	
+	ConfigCache_Append(&Strings, "", 1); /*Offset zero means NULL.*/
+	
+	memcpy(Header->Magic, CONFIG_CACHE_MAGIC, sizeof CONFIG_CACHE_MAGIC);
+	Header->Version = CONFIG_CACHE_VERSION;
+	Header->Layout = CONFIG_CACHE_LAYOUT;
+	
+	Header->ConfigFiles = Lists.Size / sizeof(uint32_t);
+	for (Inc = 1; Inc < (unsigned)NumConfigFiles; ++Inc, ++Header->NumConfigFiles)
+	{
+		ConfigCache_AddList(&Lists, &Strings, ConfigFileList[Inc]);
+	}
+	
+	Header->GlobalEnvVars = Lists.Size / sizeof(uint32_t);
+	for (; EnvWorker && EnvWorker->Next; EnvWorker = EnvWorker->Next, ++Header->NumGlobalEnvVars)
+	{
+		ConfigCache_AddList(&Lists, &Strings, EnvWorker->EnvVar);
+	}
+	
+	Header->RLInheritance = Lists.Size / sizeof(uint32_t);
+	for (; RLWorker && RLWorker->Next; RLWorker = RLWorker->Next, ++Header->NumRLInheritance)
+	{
+		ConfigCache_AddList(&Lists, &Strings, RLWorker->Inheriter);
+		ConfigCache_AddList(&Lists, &Strings, RLWorker->Inherited);
+	}
+	
+	Objects = calloc(ObjectTableSize ? ObjectTableSize : 1, sizeof(struct _ConfigCacheObject));
+	Header->NumObjects = ObjectTableSize;
+	
+	for (Inc = 0; Inc < ObjectTableSize; ++Inc)
+	{
+		const ObjTable *const Worker = ObjectTable + Inc;
+		struct _ConfigCacheObject *const CObj = Objects + Inc;
+		const struct _RLTree *RLTWorker = Worker->ObjectRunlevels;
+		const struct _ObjCondition *CondWorker = NULL;
+		
+		for (Inc2 = 0; Inc2 < sizeof CObj->Strings / sizeof *CObj->Strings; ++Inc2)
+		{
+			if (Inc2 > 0 && ObjString(Worker, Inc2) == Worker->ObjectID)
+			{ /*Descriptions default to the ObjectID itself. Keep it that way.*/
+				CObj->Strings[Inc2] = CObj->Strings[0];
+				continue;
+			}
+			
+			/*Empty isn't NULL here, so don't let ConfigCache_AddString() fold them together.*/
+			CObj->Strings[Inc2] = ObjString(Worker, Inc2) ?
+				ConfigCache_Append(&Strings, ObjString(Worker, Inc2), strlen(ObjString(Worker, Inc2)) + 1) : 0;
+		}
+		
+		for (Inc2 = 0; Inc2 < (unsigned)NumConfigFiles; ++Inc2)
+		{
+			if (Worker->ConfigFile == ConfigFileList[Inc2])
+			{
+				CObj->ConfigFile = Inc2;
+				break;
+			}
+		}
+		
+		CObj->UserID = Worker->UserID;
+		CObj->GroupID = Worker->GroupID;
+		CObj->TermSignal = Worker->TermSignal;
+		CObj->ReloadCommandSignal = Worker->ReloadCommandSignal;
+		memcpy(CObj->ExitStatuses, Worker->ExitStatuses, sizeof CObj->ExitStatuses);
+		memcpy(CObj->Opts, &Worker->Opts, sizeof CObj->Opts);
+		
+		CObj->StartPriority = Worker->State->ObjectStartPriority;
+		CObj->StopPriority = Worker->State->ObjectStopPriority;
+		CObj->AutoRestart = Worker->State->AutoRestart;
+		CObj->Enabled = Worker->State->Enabled;
+		
+		CObj->EnvVars = Lists.Size / sizeof(uint32_t);
+		for (EnvWorker = Worker->EnvVars; EnvWorker && EnvWorker->Next; EnvWorker = EnvWorker->Next, ++CObj->NumEnvVars)
+		{
+			ConfigCache_AddList(&Lists, &Strings, EnvWorker->EnvVar);
 		}
 		
-		RLTemp2 = SWorker->ObjectRunlevels = malloc(sizeof(struct _RLTree));
+		CObj->Runlevels = Lists.Size / sizeof(uint32_t);
+		for (; RLTWorker && RLTWorker->Next; RLTWorker = RLTWorker->Next, ++CObj->NumRunlevels)
+		{
+			ConfigCache_AddList(&Lists, &Strings, RLTWorker->RL);
+		}
 		
-		TempPtr2 = NULL;
-		for (RLTemp1 = Worker->ObjectRunlevels; RLTemp1->Next; RLTemp1 = RLTemp1->Next)
+		CObj->Conditions = Lists.Size / sizeof(uint32_t);
+		for (CondWorker = Worker->Conditions; CondWorker; CondWorker = CondWorker->Next, ++CObj->NumConditions)
 		{
-			*RLTemp2 = *RLTemp1;
-			RLTemp2->Prev = TempPtr2;
-			RLTemp2->Next = malloc(sizeof(struct _RLTree));
-			RLTemp2->Next->Next = NULL;
-			TempPtr2 = RLTemp2;
+			char Condition[MAX_LINE_SIZE];
 			
-			RLTemp2 = RLTemp2->Next;
+			ObjCondition_Describe(CondWorker, Condition, sizeof Condition);
+			ConfigCache_AddList(&Lists, &Strings, Condition);
 		}
 	}
+	
+	Header->LogFile = ConfigCache_AddString(&Strings, LogFile);
+	Header->JournalPath = ConfigCache_AddString(&Strings, JournalPath);
+	Header->Hostname = ConfigCache_AddString(&Strings, Hostname);
+	Header->Domainname = ConfigCache_AddString(&Strings, Domainname);
+	Header->DefaultRunlevel = ConfigCache_AddString(&Strings, ConfigDefaultRunlevel);
+	Header->BootBanner = BootBanner;
+	Header->LogRotate = LogRotate;
+	Header->StatusReportFormat = StatusReportFormat;
+	memcpy(Header->AutoMountOpts, AutoMountOpts, sizeof AutoMountOpts);
+	Header->DisableCAD = DisableCAD;
+	Header->BlankLogOnBoot = BlankLogOnBoot;
+	Header->EnableLogging = LogEnable;
+	
+	/*The dependency paths go in last, since they need string offsets too.*/
+	Header->NumDeps = NumConfigCacheDeps;
+	Header->NumLists = Lists.Size / sizeof(uint32_t);
+	
+	for (Inc = 0; Inc < NumConfigCacheDeps; ++Inc)
+	{
+		ConfigCacheDeps[Inc].Key.Path = ConfigCache_AddString(&Strings, ConfigCacheDeps[Inc].Path);
+	}
+	
+	/*Lay it all out.*/
+	Header->DepsOffset = Offset = CONFIG_CACHE_ALIGN(sizeof(struct _ConfigCacheHeader));
+	Header->ObjectsOffset = Offset = CONFIG_CACHE_ALIGN(Offset + NumConfigCacheDeps * sizeof(struct _ConfigCacheDep));
+	Header->ListsOffset = Offset = CONFIG_CACHE_ALIGN(Offset + ObjectTableSize * sizeof(struct _ConfigCacheObject));
+	Header->StringsOffset = Offset = CONFIG_CACHE_ALIGN(Offset + Lists.Size);
+	Header->StringsSize = Strings.Size;
+	Header->TotalSize = Offset + Strings.Size;
+	
+	Image = calloc(1, Header->TotalSize);
+	
+	for (Inc = 0; Inc < NumConfigCacheDeps; ++Inc)
+	{
+		memcpy(Image + Header->DepsOffset + Inc * sizeof(struct _ConfigCacheDep), &ConfigCacheDeps[Inc].Key, sizeof(struct _ConfigCacheDep));
+	}
+	memcpy(Image + Header->ObjectsOffset, Objects, ObjectTableSize * sizeof(struct _ConfigCacheObject));
+	if (Lists.Size) memcpy(Image + Header->ListsOffset, Lists.Data, Lists.Size);
+	memcpy(Image + Header->StringsOffset, Strings.Data, Strings.Size);
+	memcpy(Image, Header, sizeof(struct _ConfigCacheHeader));
+	
+	free(Header);
+	free(Objects);
+	free(Lists.Data);
+	free(Strings.Data);
+	
+	return Image;
+}
 
-	/*Back up the runlevel inheritance table.*/
-	if (RunlevelInheritance != NULL)
+void ConfigCache_Flush(void)
+{ /*Write out a snapshot built earlier. Harmless if there's none, or if we still can't write it.*/
+	const char *const TempPath = CONFIGCACHE ".new";
+	int Descriptor = 0;
+	Bool Written = false;
+	
+	if (!ConfigCachePending) return;
+	
+	if ((Descriptor = open(TempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1)
+	{ /*Probably a read-only root. We'll get another chance.*/
+		return;
+	}
+	
+	/*Write it beside the real one and rename it over, so a crash never leaves half a cache behind.*/
+	Written = write(Descriptor, ConfigCachePending, ConfigCachePendingSize) == (ssize_t)ConfigCachePendingSize &&
+			fsync(Descriptor) == 0;
+	close(Descriptor);
+	
+	if (!Written || rename(TempPath, CONFIGCACHE) != 0)
 	{
-		RLIRoot = RLIWorker[1] = malloc(sizeof(struct _RunlevelInheritance));
-		memset(RLIWorker[1], 0, sizeof(struct _RunlevelInheritance));
-		TempPtr = NULL;
+		unlink(TempPath);
+		return;
+	}
+	
+	free(ConfigCachePending);
+	ConfigCachePending = NULL;
+	ConfigCachePendingSize = 0;
+}
+
+void ShutdownConfig(void)
+{
+	/*All the strings and lists hanging off the table live in the arena, so only the arrays need freeing.*/
+	free(ObjectTable);
+	free(ObjectStates);
+	
+	ObjectTable = NULL;
+	ObjectStates = NULL;
+	ObjectTableSize = 0;
+	ObjectTableCapacity = 0;
+	ObjectIndex.Table = NULL; /*The next table could land at the same address.*/
+	ObjectIndex.Count = 0;
+	GlobalEnvVars = NULL;
+	RunlevelInheritance = NULL;
+	NumConfigCacheDeps = 0; /*Their paths live in the arena.*/
+	ConfigCacheUnkeyable = false;
+	
+	/*Forget all config file names. Entry 0 points to the ConfigFile array.*/
+	ConfigFileList_Reset();
+	
+	ConfigArena_Drop(&ConfigArena);
+	++ConfigArena.Stats.Generation;
+}
+
+static unsigned ConfigDiff_Object(const ObjTable *Old, const ObjTable *New, char *OutList, size_t OutSize)
+{ /*Names the attributes that differ between two versions of an object. Returns how many.*/
+	Bool Changed[CONFIG_ATTR_MAX] = { false };
+	const struct _EnvVarList *OldEnv = Old->EnvVars, *NewEnv = New->EnvVars;
+	const struct _RLTree *OldRL = Old->ObjectRunlevels, *NewRL = New->ObjectRunlevels;
+	const struct _ObjCondition *OldCond = Old->Conditions, *NewCond = New->Conditions;
+	unsigned Inc = 0, NumChanged = 0;
+	size_t Len = 0;
+	
+	for (; Inc < sizeof ObjStringMembers / sizeof *ObjStringMembers; ++Inc)
+	{
+		const char *const OldString = ObjString(Old, Inc), *const NewString = ObjString(New, Inc);
 		
-		for (RLIWorker[0] = RunlevelInheritance; RLIWorker[0]->Next; RLIWorker[0] = RLIWorker[0]->Next)
+		if (!OldString != !NewString || (OldString && strcmp(OldString, NewString) != 0))
 		{
-			*RLIWorker[1] = *RLIWorker[0];
-			RLIWorker[1]->Prev = TempPtr;
-			TempPtr = RLIWorker[1];
-			RLIWorker[1]->Next = malloc(sizeof(struct _RunlevelInheritance));
-			memset(RLIWorker[1]->Next, 0, sizeof(struct _RunlevelInheritance));
+			Changed[ObjStringMembers[Inc].Attr] = true;
+		}
+	}
+	
+	Changed[CONFIG_ATTR_OBJECTUSER] |= Old->UserID != New->UserID;
+	Changed[CONFIG_ATTR_OBJECTGROUP] |= Old->GroupID != New->GroupID;
+	Changed[CONFIG_ATTR_OBJECTRELOADCOMMAND] |= Old->ReloadCommandSignal != New->ReloadCommandSignal;
+	Changed[CONFIG_ATTR_OBJECTSTARTPRIORITY] |= Old->State->ObjectStartPriority != New->State->ObjectStartPriority;
+	Changed[CONFIG_ATTR_OBJECTSTOPPRIORITY] |= Old->State->ObjectStopPriority != New->State->ObjectStopPriority;
+	Changed[CONFIG_ATTR_OBJECTENABLED] |= Old->State->Enabled != New->State->Enabled;
+	Changed[CONFIG_ATTR_OBJECTOPTIONS] |= Old->TermSignal != New->TermSignal || Old->State->AutoRestart != New->State->AutoRestart ||
+		memcmp(Old->ExitStatuses, New->ExitStatuses, sizeof Old->ExitStatuses) != 0 ||
+		memcmp(&Old->Opts, &New->Opts, sizeof Old->Opts) != 0; /*Both tables are zeroed before they're filled in.*/
+	
+	/*Lists end in an empty node, so walk until either runs out.*/
+	for (; OldEnv && NewEnv && OldEnv->Next && NewEnv->Next; OldEnv = OldEnv->Next, NewEnv = NewEnv->Next)
+	{
+		if (strcmp(OldEnv->EnvVar, NewEnv->EnvVar) != 0) break;
+	}
+	Changed[CONFIG_ATTR_OBJECTENVVAR] = (OldEnv && OldEnv->Next) || (NewEnv && NewEnv->Next);
+	
+	for (; OldRL && NewRL && OldRL->Next && NewRL->Next; OldRL = OldRL->Next, NewRL = NewRL->Next)
+	{
+		if (strcmp(OldRL->RL, NewRL->RL) != 0) break;
+	}
+	Changed[CONFIG_ATTR_OBJECTRUNLEVELS] = (OldRL && OldRL->Next) || (NewRL && NewRL->Next);
+	
+	/*No empty node on this one.*/
+	for (; OldCond && NewCond; OldCond = OldCond->Next, NewCond = NewCond->Next)
+	{
+		if (OldCond->Type != NewCond->Type || OldCond->Negate != NewCond->Negate ||
+			!OldCond->Arg != !NewCond->Arg || (OldCond->Arg && strcmp(OldCond->Arg, NewCond->Arg) != 0))
+		{
+			break;
+		}
+	}
+	Changed[CONFIG_ATTR_OBJECTCONDITION] = OldCond || NewCond;
+	
+	*OutList = '\0';
+	
+	for (Inc = 0; Inc < CONFIG_ATTR_MAX; ++Inc)
+	{
+		if (!Changed[Inc]) continue;
+		
+		if (Len < OutSize) Len += snprintf(OutList + Len, OutSize - Len, "%s%s", NumChanged ? ", " : "", ConfigAttrNames[Inc].Name);
+		++NumChanged;
+	}
+	
+	if (strcmp(Old->ConfigFile, New->ConfigFile) != 0)
+	{ /*Moved to another file. Not an attribute, but worth knowing.*/
+		if (Len < OutSize) Len += snprintf(OutList + Len, OutSize - Len, "%sfile %s", NumChanged ? ", " : "", New->ConfigFile);
+		++NumChanged;
+	}
+	
+	if (Len >= OutSize && OutSize > sizeof "...")
+	{ /*Say so rather than leave half a name at the end.*/
+		memcpy(OutList + OutSize - sizeof "...", "...", sizeof "...");
+	}
+	
+	return NumChanged;
+}
+
+static void ReloadConfig_Unchanged(void)
+{
+	WriteLogLine("CONFIG: No configuration files have changed since they were loaded. Nothing to reload.", true);
+	puts(CONSOLE_COLOR_GREEN "Epoch: Configuration unchanged." CONSOLE_ENDCOLOR);
+}
+
+static Bool ReloadConfig_InFiles(const ObjTable *Obj, const char *const *Files, unsigned NumFiles)
+{ /*Files are ConfigFileList entries, same as the objects point to.*/
+	unsigned Inc = 0;
+	
+	for (; Inc < NumFiles; ++Inc)
+	{
+		if (Obj->ConfigFile == Files[Inc]) return true;
+	}
+	
+	return false;
+}
+
+static void ReloadConfig_Replace(ObjTable *Live, const ObjTable *New)
+{ /*Same as a full reload, the object keeps whether it's running, and everything else comes from the file.*/
+	struct _ObjState *const State = Live->State;
+	const struct _ObjState Runtime = *State;
+	
+	*Live = *New;
+	*State = *New->State;
+	Live->State = State;
+	
+	State->Started = Runtime.Started;
+	State->ObjectPID = Runtime.ObjectPID;
+	State->StartedSince = Runtime.StartedSince;
+	
+	ExecPlan_PrepareObject(Live);
+}
+
+static ReturnCode ReloadConfig_Parse(const unsigned *Changed, unsigned NumChanged, const char *const *Files)
+{ /*Parses the changed files into whatever table is live, and gives their entries in ConfigCacheDeps the new keys.*/
+	ObjTable *Worker = NULL;
+	unsigned Inc = 0;
+	
+	for (; Inc < NumChanged; ++Inc)
+	{
+		const unsigned Before = NumConfigCacheDeps;
+		ReturnCode RetVal = FAILURE;
+		
+		ConfigStandaloneParse = true;
+		RetVal = InitConfig(Files[Inc]);
+		ConfigStandaloneParse = false;
+		
+		if (!RetVal || NumConfigCacheDeps == Before || !(ConfigCacheDeps[Before].Key.Flags & CONFIG_DEP_STANDALONE))
+		{ /*It doesn't only hold objects anymore, or it's gone.*/
+			return WARNING;
+		}
+		
+		/*It was added as a new file. Anything it pulled in after, like /etc/passwd, can stay where it is.*/
+		ConfigCacheDeps[Changed[Inc]].Key = ConfigCacheDeps[Before].Key;
+		memmove(ConfigCacheDeps + Before, ConfigCacheDeps + Before + 1, sizeof *ConfigCacheDeps * (NumConfigCacheDeps - Before - 1));
+		--NumConfigCacheDeps;
+	}
+	
+	for (Worker = ObjectTable; Worker && Worker->ObjectID; ++Worker)
+	{
+		if (Worker->ObjectDescription == NULL) Worker->ObjectDescription = Worker->ObjectID;
+		
+		/*Let the full reload report it, and hand the old configuration back.*/
+		if (!ScanConfigIntegrity_Object(Worker)) return WARNING;
+	}
+	
+	return SUCCESS;
+}
+
+static const char **ReloadConfig_Files(const unsigned *Changed, unsigned NumChanged)
+{ /*The ConfigFileList entries for the changed files, or NULL if they can't be reloaded on their own.*/
+	const char **Files = NULL;
+	unsigned Inc = 0, Inc2 = 0;
+	
+	if (!NumChanged || (ConfigCacheDeps->Key.Flags & CONFIG_DEP_PRIORITYOF)) return NULL;
+	
+	if (ConfigArena.Stats.BytesUsed + ConfigArena.CacheMapSize > ConfigArena.LoadedSize * 2)
+	{ /*Whatever we replace stays in the arena until the generation goes.*/
+		WriteLogLine("CONFIG: Objects replaced in place have doubled the configuration's size. Reloading all of it.", true);
+		return NULL;
+	}
+	
+	Files = malloc(sizeof *Files * NumChanged);
+	
+	for (Inc = 0; Files && Inc < NumChanged; ++Inc)
+	{
+		if (!(ConfigCacheDeps[Changed[Inc]].Key.Flags & CONFIG_DEP_STANDALONE)) break;
+		
+		/*Entry 0 is the primary file, which never has the flag.*/
+		for (Inc2 = 1; Inc2 < (unsigned)NumConfigFiles && strcmp(ConfigFileList[Inc2], ConfigCacheDeps[Changed[Inc]].Path) != 0; ++Inc2);
+		
+		if (Inc2 == (unsigned)NumConfigFiles) break;
+		Files[Inc] = ConfigFileList[Inc2];
+	}
+	
+	if (!Files || Inc < NumChanged)
+	{
+		free(Files);
+		return NULL;
+	}
+	
+	return Files;
+}
+
+static ReturnCode ReloadConfig_Apart(const unsigned *Changed, unsigned NumChanged, const char *const *Files,
+									const unsigned char *Image, size_t ImageSize, ObjTable **OutTable,
+									struct _ObjState **OutStates, unsigned *OutSize)
+{ /*The objects in the changed files, in a table of their own, so we can compare before we touch anything.
+	* From the files themselves, or from the Image a background reload made of them. The caller frees the table.*/
+	ObjTable *const LiveTable = ObjectTable;
+	struct _ObjState *const LiveStates = ObjectStates;
+	const unsigned LiveSize = ObjectTableSize, LiveCapacity = ObjectTableCapacity;
+	ReturnCode RetVal = WARNING;
+	
+	ObjectTable = NULL;
+	ObjectStates = NULL;
+	ObjectTableSize = ObjectTableCapacity = 0;
+	ObjectIndex.Table = NULL;
+	
+	RetVal = Image ? ConfigCache_LoadObjects(Image, ImageSize, Changed, NumChanged) : ReloadConfig_Parse(Changed, NumChanged, Files);
+	
+	if (RetVal == SUCCESS) Overlay_Apply(); /*The live objects have theirs, so the diff needs these to have them too.*/
+	
+	*OutTable = ObjectTable;
+	*OutStates = ObjectStates;
+	*OutSize = ObjectTableSize;
+	
+	ObjectTable = LiveTable;
+	ObjectStates = LiveStates;
+	ObjectTableSize = LiveSize;
+	ObjectTableCapacity = LiveCapacity;
+	ObjectIndex.Table = NULL;
+	
+	return RetVal == SUCCESS ? SUCCESS : WARNING;
+}
+
+static Bool ReloadConfig_Fits(const ObjTable *NewTable, unsigned NewSize, const char *const *Files, unsigned NumFiles)
+{ /*Whether the new objects can go in beside everything we didn't read.*/
+	const ObjTable *Worker = NULL;
+	Bool ValidRL = false;
+	unsigned Inc = 0;
+	
+	for (; Inc < NewSize; ++Inc)
+	{ /*An object that's also in a file we didn't read would be a duplicate, and which one wins depends on file order.*/
+		if ((Worker = LookupObjectInTable(NewTable[Inc].ObjectID)) && !ReloadConfig_InFiles(Worker, Files, NumFiles))
+		{
+			return false;
+		}
+		
+		if (!NewTable[Inc].Opts.HaltCmdOnly && ObjRL_CheckRunlevel(CurRunlevel, NewTable + Inc, true)) ValidRL = true;
+	}
+	
+	for (Worker = ObjectTable; !ValidRL && Worker->ObjectID; ++Worker)
+	{ /*Make sure the runlevel we're in will still have something in it, like ScanConfigIntegrity() would.*/
+		if (!ReloadConfig_InFiles(Worker, Files, NumFiles) && !Worker->Opts.HaltCmdOnly &&
+			ObjRL_CheckRunlevel(CurRunlevel, Worker, true))
+		{
+			ValidRL = true;
+		}
+	}
+	
+	return ValidRL;
+}
+
+static ReturnCode ReloadConfig_Merge(ObjTable *NewTable, const struct _ObjState *NewStates, unsigned NewSize,
+									const char *const *Files, unsigned NumChanged)
+{ /*Swaps in the objects that differ, and adds and drops the rest. WARNING if nothing could be touched.*/
+	ObjTable *Worker = NULL;
+	Bool *const Taken = calloc(NewSize + 1, sizeof(Bool));
+	unsigned Inc = 0, Inc2 = 0, Kept = 0;
+	unsigned NumAdded = 0, NumRemoved = 0, NumReplaced = 0;
+	char Report[MAX_LINE_SIZE];
+	
+	if (!Taken) return WARNING;
+	
+	for (Inc = 0; Inc < ObjectTableSize; ++Inc)
+	{ /*Replace or drop what came from those files, closing up the gaps as we go.*/
+		char Changes[MAX_LINE_SIZE], ChangeReport[MAX_LINE_SIZE + sizeof Changes];
+		
+		Worker = ObjectTable + Inc;
+		
+		if (ReloadConfig_InFiles(Worker, Files, NumChanged))
+		{
+			for (Inc2 = 0; Inc2 < NewSize && strcmp(NewTable[Inc2].ObjectID, Worker->ObjectID) != 0; ++Inc2);
 			
-			RLIWorker[1] = RLIWorker[1]->Next;
+			if (Inc2 == NewSize)
+			{
+				snprintf(Report, sizeof Report, "CONFIG: Object \"%s\" removed.%s", Worker->ObjectID,
+						Worker->State->Started ? " It was still running, and is no longer tracked." : "");
+				WriteLogLine(Report, true);
+				++NumRemoved;
+				continue;
+			}
+			
+			Taken[Inc2] = true;
+			
+			if (ConfigDiff_Object(Worker, NewTable + Inc2, Changes, sizeof Changes))
+			{
+				snprintf(ChangeReport, sizeof ChangeReport, "CONFIG: Object \"%s\" changed: %s", Worker->ObjectID, Changes);
+				WriteLogLine(ChangeReport, true);
+				++NumReplaced;
+				
+				ReloadConfig_Replace(Worker, NewTable + Inc2);
+			}
+		}
+		
+		if (Kept != Inc)
+		{
+			ObjectTable[Kept] = *Worker;
+			ObjectStates[Kept] = ObjectStates[Inc];
+			ObjectTable[Kept].State = ObjectStates + Kept;
 		}
+		++Kept;
 	}
 	
-	WriteLogLine("CONFIG: Shutting down configuration.", true);
+	ObjectTableSize = Kept;
+	memset(ObjectTable + ObjectTableSize, 0, sizeof(ObjTable));
+	
+	for (Inc = 0; Inc < NewSize; ++Inc)
+	{ /*Anything left over is new.*/
+		if (Taken[Inc]) continue;
+		
+		ObjectTable_Grow();
+		
+		Worker = ObjectTable + ObjectTableSize;
+		*Worker = NewTable[Inc];
+		ObjectStates[ObjectTableSize] = NewStates[Inc];
+		Worker->State = ObjectStates + ObjectTableSize;
+		memset(ObjectTable + ++ObjectTableSize, 0, sizeof(ObjTable));
+		
+		ExecPlan_PrepareObject(Worker);
+		
+		snprintf(Report, sizeof Report, "CONFIG: Object \"%s\" added.", Worker->ObjectID);
+		WriteLogLine(Report, true);
+		++NumAdded;
+	}
+	
+	ObjectIndex.Table = NULL; /*Things moved.*/
+	
+	/*The snapshot on disk is keyed on the old files, so the next boot parses them. We can't build a new one
+	 * from here, because the live table has the runtime overrides in it.*/
 	
-	/*Actually do the reload of the config.*/
-	ShutdownConfig();
+	snprintf(Report, sizeof Report, "CONFIG: Reparsed %u of %d files. %u objects added, %u removed, %u changed, %u untouched.",
+			NumChanged, NumConfigFiles, NumAdded, NumRemoved, NumReplaced, ObjectTableSize - NumAdded - NumReplaced);
+	WriteLogLine(Report, true);
+	
+	free(Taken);
+	
+	WriteLogLine("CONFIG: " CONSOLE_COLOR_GREEN "Configuration reload successful." CONSOLE_ENDCOLOR, true);
+	puts(CONSOLE_COLOR_GREEN "Epoch: Configuration reloaded." CONSOLE_ENDCOLOR);
+	
+	return SUCCESS;
+}
+
+static ReturnCode ReloadConfig_InPlace(const unsigned *Changed, unsigned NumChanged, const unsigned char *Image, size_t ImageSize)
+{ /*Parse only the files that changed, and swap in only the objects that differ. Everything else is left alone.
+	* With an Image, a background reload already parsed them, and we just load what it sent.
+	* WARNING means this can't be done piecemeal, and nothing was touched but the keys for those files.*/
+	const char **const Files = ReloadConfig_Files(Changed, NumChanged);
+	ObjTable *NewTable = NULL;
+	struct _ObjState *NewStates = NULL;
+	unsigned NewSize = 0;
+	char Report[MAX_LINE_SIZE];
+	ReturnCode RetVal = WARNING;
+	
+	if (!Files) return WARNING;
+	
+	snprintf(Report, sizeof Report, "CONFIG: Reloading %u changed configuration file%s in place.", NumChanged, NumChanged == 1 ? "" : "s");
+	WriteLogLine(Report, true);
+	
+	if (ReloadConfig_Apart(Changed, NumChanged, Files, Image, ImageSize, &NewTable, &NewStates, &NewSize) == SUCCESS &&
+		ReloadConfig_Fits(NewTable, NewSize, Files, NumChanged))
+	{
+		RetVal = ReloadConfig_Merge(NewTable, NewStates, NewSize, Files, NumChanged);
+	}
+	
+	if (RetVal != SUCCESS)
+	{
+		WriteLogLine("CONFIG: Changed files can't be reloaded on their own. Reloading all of them.", true);
+	}
+	
+	free(NewTable);
+	free(NewStates);
+	free(Files);
+	
+	return RetVal;
+}
+
+#ifndef NOMMU
+static unsigned char *ReloadConfig_PartialImage(const unsigned *Changed, unsigned NumChanged)
+{ /*For a background reload. Parses the changed files apart from the live table, and snapshots just their objects
+	* for ReloadConfig_InPlace() in PID 1. NULL if they can't be reloaded on their own.*/
+	const char **const Files = ReloadConfig_Files(Changed, NumChanged);
+	ObjTable *NewTable = NULL, *const LiveTable = ObjectTable;
+	struct _ObjState *NewStates = NULL, *const LiveStates = ObjectStates;
+	const unsigned LiveSize = ObjectTableSize;
+	unsigned NewSize = 0;
+	unsigned char *Image = NULL;
+	
+	if (!Files) return NULL;
+	
+	if (ReloadConfig_Apart(Changed, NumChanged, Files, NULL, 0, &NewTable, &NewStates, &NewSize) == SUCCESS &&
+		ReloadConfig_Fits(NewTable, NewSize, Files, NumChanged))
+	{ /*ConfigCache_Build() snapshots whatever table is live.*/
+		ObjectTable = NewTable;
+		ObjectStates = NewStates;
+		ObjectTableSize = NewSize;
+		
+		Image = ConfigCache_Build(-1);
+		
+		ObjectTable = LiveTable;
+		ObjectStates = LiveStates;
+		ObjectTableSize = LiveSize;
+	}
+	
+	free(NewTable);
+	free(NewStates);
+	free(Files);
+	
+	return Image;
+}
+#endif
+
+ReturnCode ReloadConfig(void)
+{
+	unsigned *const Changed = NumConfigCacheDeps ? malloc(sizeof(unsigned) * NumConfigCacheDeps) : NULL;
+	const int NumChanged = ConfigCache_Changes(Changed);
+	ReturnCode RetVal = WARNING;
+	
+	if (NumChanged == 0)
+	{ /*Every file we read last time is byte for byte the same, so a reload would give us what we have.*/
+		free(Changed);
+		ReloadConfig_Unchanged();
+		return SUCCESS;
+	}
+	
+	if (NumChanged > 0 && Changed) RetVal = ReloadConfig_InPlace(Changed, NumChanged, NULL, 0);
+	free(Changed);
+	
+	return RetVal != WARNING ? RetVal : ReloadConfig_Swap(NULL, 0);
+}
+
+static ReturnCode ReloadConfig_Swap(unsigned char *Image, size_t ImageSize)
+{ /*The live configuration is detached rather than copied, so if the new one is bad we can just hand it back.
+	* With an Image, the new configuration comes from a snapshot a background parse sent us instead of the files.*/
+	ObjTable *const OldTable = ObjectTable, *Worker = NULL, *SWorker = NULL;
+	struct _ObjState *const OldStates = ObjectStates;
+	const unsigned OldSize = ObjectTableSize, OldCapacity = ObjectTableCapacity;
+	const int OldNumConfigFiles = NumConfigFiles;
+	char **const OldConfigFileList = ConfigFileList;
+	const unsigned OldConfigFileListCapacity = ConfigFileListCapacity;
+	struct _RunlevelInheritance *const RLIRoot = RunlevelInheritance;
+	struct _EnvVarList *const GlobalEnvRoot = GlobalEnvVars;
+	struct _ConfigArena OldArena = ConfigArena;
+	char Report[MAX_LINE_SIZE];
+	Bool GlobalOpts[2], ConfigOK = true;
+	char RunlevelBackup[MAX_DESCRIPT_SIZE];
+	unsigned NumAdded = 0, NumRemoved = 0, NumChanged = 0, NumUnchanged = 0;
+	Bool ImageLogEnable = EnableLogging;
+	
+	WriteLogLine("CONFIG: Reloading configuration.\n", true);
+	WriteLogLine("CONFIG: Backing up current configuration.", true);
+	
+	/*Backup the current runlevel.*/
+	snprintf(RunlevelBackup, MAX_DESCRIPT_SIZE, "%s", CurRunlevel);
+	
+	/*Detach the object table, runlevel inheritance, global environment variables and the arena
+	 * they all live in. ShutdownConfig() and InitConfig() won't see them after this.*/
+	memset(&ConfigArena, 0, sizeof ConfigArena);
+	ConfigArena.Stats.Generation = OldArena.Stats.Generation + 1;
+	
+	ObjectTable = NULL;
+	ObjectStates = NULL;
+	ObjectTableSize = 0;
+	ObjectTableCapacity = 0;
+	RunlevelInheritance = NULL;
+	GlobalEnvVars = NULL;
+	ConfigFileList_Reset();
 	
 	/*Do this to prevent some weird options from being changeable by a config reload.*/
 	GlobalOpts[0] = EnableLogging;
@@ -3431,8 +5171,16 @@ ReturnCode ReloadConfig(void)
 
 	WriteLogLine("CONFIG: Initializing new configuration.", true);
 	
-	if (!InitConfig(ConfigFile))
+	if (Image && ConfigCache_LoadImage(Image, ImageSize, false, &ImageLogEnable))
+	{ /*InitConfig() does these itself.*/
+		Overlay_Apply();
+		ExecPlan_Prepare();
+		ConfigArena.LoadedSize = ConfigArena.Stats.BytesUsed + ConfigArena.CacheMapSize;
+	}
+	else if (Image || !InitConfig(ConfigFile))
 	{
+		if (Image && !ConfigArena.CacheMap) munmap(Image, ImageSize); /*Nobody took it.*/
+		
 		WriteLogLine("CONFIG: " CONSOLE_COLOR_RED "FAILED TO RELOAD CONFIGURATION." CONSOLE_ENDCOLOR 
 					" Restoring previous configuration from backup.", true);
 		SpitError("ReloadConfig(): Failed to reload configuration.\n"
@@ -3441,15 +5189,18 @@ ReturnCode ReloadConfig(void)
 		
 		ShutdownConfig();
 		
+		ConfigArena = OldArena;
 		GlobalEnvVars = GlobalEnvRoot;
-		ObjectTable = TRoot; /*Point ObjectTable to our new, identical copy of the old tree.*/
+		ObjectTable = OldTable; /*Point ObjectTable back at the table we detached.*/
+		ObjectStates = OldStates;
+		ObjectTableSize = OldSize;
+		ObjectTableCapacity = OldCapacity;
 		RunlevelInheritance = RLIRoot; /*Restore runlevel inheritance.*/
 		
 		/*Restore config file names.*/
-		for (Inc = 1; Inc < MAX_CONFIG_FILES; ++Inc)
-		{
-			ConfigFileList[Inc] = BackupConfigFileList[Inc];
-		}
+		ConfigFileList = OldConfigFileList;
+		ConfigFileListCapacity = OldConfigFileListCapacity;
+		NumConfigFiles = OldNumConfigFiles;
 		
 		/*Restore current runlevel*/
 		snprintf(CurRunlevel, MAX_DESCRIPT_SIZE, "%s", RunlevelBackup);
@@ -3467,52 +5218,308 @@ ReturnCode ReloadConfig(void)
 	
 	WriteLogLine("CONFIG: Restoring object statuses and deleting backup configuration.", true);
 	
-	for (SWorker = TRoot; SWorker != NULL; SWorker = Temp)
+	for (SWorker = OldTable; SWorker && SWorker->ObjectID != NULL; ++SWorker)
 	{ /*Add back the Started states, so we don't forget to stop services, etc.*/
+		char Changes[MAX_LINE_SIZE], ChangeReport[MAX_LINE_SIZE + sizeof Changes];
 		
-		if (SWorker->Next)
+		if (!(Worker = LookupObjectInTable(SWorker->ObjectID)))
 		{
-			if ((Worker = LookupObjectInTable(SWorker->ObjectID)))
+			snprintf(Report, sizeof Report, "CONFIG: Object \"%s\" removed.%s", SWorker->ObjectID,
+					SWorker->State->Started ? " It was still running, and is no longer tracked." : "");
+			WriteLogLine(Report, true);
+			++NumRemoved;
+			continue;
+		}
+		
+		Worker->State->Started = SWorker->State->Started;
+		Worker->State->ObjectPID = SWorker->State->ObjectPID;
+		Worker->State->StartedSince = SWorker->State->StartedSince;
+		
+		if (ConfigDiff_Object(SWorker, Worker, Changes, sizeof Changes))
+		{
+			snprintf(ChangeReport, sizeof ChangeReport, "CONFIG: Object \"%s\" changed: %s", Worker->ObjectID, Changes);
+			WriteLogLine(ChangeReport, true);
+			++NumChanged;
+		}
+		else ++NumUnchanged;
+	}
+	
+	for (Worker = ObjectTable; Worker && Worker->ObjectID != NULL; ++Worker)
+	{ /*Anything left over is new.*/
+		for (SWorker = OldTable; SWorker && SWorker->ObjectID != NULL && strcmp(SWorker->ObjectID, Worker->ObjectID) != 0; ++SWorker);
+		
+		if (SWorker && SWorker->ObjectID) continue;
+		
+		snprintf(Report, sizeof Report, "CONFIG: Object \"%s\" added.", Worker->ObjectID);
+		WriteLogLine(Report, true);
+		++NumAdded;
+	}
+	
+	snprintf(Report, sizeof Report, "CONFIG: %u objects added, %u removed, %u changed, %u unchanged.",
+			NumAdded, NumRemoved, NumChanged, NumUnchanged);
+	WriteLogLine(Report, true);
+	
+	/*Everything else the old configuration owned goes with its arena.*/
+	free(OldTable);
+	free(OldStates);
+	ConfigArena_Drop(&OldArena);
+	
+	snprintf(Report, sizeof Report, "CONFIG: Generation %u uses %lu bytes in %lu allocations, %u blocks, %lu bytes reserved.",
+			ConfigArena.Stats.Generation, ConfigArena.Stats.BytesUsed, ConfigArena.Stats.NumAllocs,
+			ConfigArena.Stats.NumBlocks, ConfigArena.Stats.BytesReserved);
+	WriteLogLine(Report, true);
+	
+	WriteLogLine("CONFIG: " CONSOLE_COLOR_GREEN "Configuration reload successful." CONSOLE_ENDCOLOR, true);
+	puts(CONSOLE_COLOR_GREEN "Epoch: Configuration reloaded." CONSOLE_ENDCOLOR);
+	
+	FinaliseLogStartup(false); /*Clean up logs in memory.*/
+	
+	return SUCCESS;
+}
+
+static void ReloadConfig_ChildFatal(void)
+{ /*The background child hit something that would send PID 1 to the emergency shell.
+	* We're only a copy, so we just go, without touching the membus, the socket or the disk.*/
+	const unsigned char Status = 'X';
+	
+	_exit(write(BackgroundReload.Pipe, &Status, 1) == 1 ? 1 : 2);
+}
+
+#ifndef NOMMU
+static Bool ReloadConfig_Send(int Pipe, const void *Data, size_t Size)
+{
+	size_t Sent = 0;
+	ssize_t Wrote = 0;
+	
+	for (; Sent < Size; Sent += Wrote)
+	{
+		if ((Wrote = write(Pipe, (const unsigned char*)Data + Sent, Size - Sent)) <= 0)
+		{
+			if (Wrote == -1 && errno == EINTR) { Wrote = 0; continue; }
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+static void ReloadConfig_Child(int Pipe)
+{ /*We're a throwaway copy of PID 1, so we can parse over our copy of the configuration without detaching anything.*/
+	unsigned char Status = 'F';
+	const unsigned char *Image = NULL;
+	size_t ImageSize = 0;
+	unsigned Count = 0;
+	int Null = open("/dev/null", O_WRONLY);
+	unsigned *const Changed = NumConfigCacheDeps ? malloc(sizeof(unsigned) * NumConfigCacheDeps) : NULL;
+	int NumChanged = 0;
+	
+	BackgroundReload.InChild = true;
+	BackgroundReload.Pipe = Pipe;
+	
+	/*If this parse finds problems, the foreground one reports them. Don't say it all twice.*/
+	if (Null != -1)
+	{
+		dup2(Null, STDOUT_FILENO);
+		dup2(Null, STDERR_FILENO);
+		close(Null);
+	}
+	
+	/*Same for the log and journal. PID 1 still owns those files, and InitConfig() leaves the log in memory mode
+	 * once it's done if that's how it found it, which is what keeps the writers off the disk.*/
+	LogInMemory = true;
+	EnableLogging = false;
+	*JournalPath = '\0';
+	
+	if ((NumChanged = ConfigCache_Changes(Changed)) == 0) Status = 'U';
+	else if (NumChanged > 0 && Changed && (Image = ReloadConfig_PartialImage(Changed, NumChanged)))
+	{ /*Just the objects from those files. PID 1 swaps in what differs without reading or parsing anything.*/
+		Status = 'P';
+		Count = NumChanged;
+		ImageSize = ((const struct _ConfigCacheHeader*)Image)->TotalSize;
+	}
+	else
+	{
+		ObjectTable = NULL;
+		ObjectStates = NULL;
+		ObjectTableSize = 0;
+		ObjectTableCapacity = 0;
+		RunlevelInheritance = NULL;
+		GlobalEnvVars = NULL;
+		memset(&ConfigArena, 0, sizeof ConfigArena);
+		ConfigFileList_Reset();
+		
+		ConfigCacheWriteDeferred = true;
+		
+		if (InitConfig(ConfigFile))
+		{ /*Either we built a new snapshot, or the one on disk was already good.*/
+			if (ConfigCachePending)
 			{
-				Worker->Started = SWorker->Started;
-				Worker->ObjectPID = SWorker->ObjectPID;
-				Worker->StartedSince = SWorker->StartedSince;
+				Image = ConfigCachePending;
+				ImageSize = ConfigCachePendingSize;
+			}
+			else if (ConfigArena.CacheMap)
+			{
+				Image = ConfigArena.CacheMap;
+				ImageSize = ConfigArena.CacheMapSize;
 			}
 			
-			ObjRL_ShutdownRunlevels(SWorker);
-			
-			if (SWorker->ObjectID) free(SWorker->ObjectID);
-			if (SWorker->ObjectDescription &&
-				SWorker->ObjectDescription != SWorker->ObjectID) free(SWorker->ObjectDescription);
-			if (SWorker->ObjectStartCommand) free(SWorker->ObjectStartCommand);
-			if (SWorker->ObjectStopCommand) free(SWorker->ObjectStopCommand);
-			if (SWorker->ObjectReloadCommand) free(SWorker->ObjectReloadCommand);
-			if (SWorker->ObjectPrestartCommand) free(SWorker->ObjectPrestartCommand);
-			if (SWorker->ObjectPIDFile) free(SWorker->ObjectPIDFile);
-			if (SWorker->ObjectWorkingDirectory) free(SWorker->ObjectWorkingDirectory);
-			if (SWorker->ObjectStdout) free(SWorker->ObjectStdout);
-			if (SWorker->ObjectStderr) free(SWorker->ObjectStderr);
-			EnvVarList_Shutdown(&SWorker->EnvVars);
+			if (Image) Status = 'I';
 		}
 		
-		Temp = SWorker->Next;
-		free(SWorker);
+		/*The parse put both back the way the files have them.*/
+		EnableLogging = false;
+		*JournalPath = '\0';
 	}
 	
-	/*Release the backup runlevel inheritance table.*/
-	for (; RLIRoot != NULL; RLIRoot = RLIWorker[0])
+	/*A partial snapshot goes after which files it came from.*/
+	if (ReloadConfig_Send(Pipe, &Status, 1) &&
+		(Status != 'P' || (ReloadConfig_Send(Pipe, &Count, sizeof Count) && ReloadConfig_Send(Pipe, Changed, sizeof *Changed * Count))))
 	{
-		RLIWorker[0] = RLIRoot->Next;
-		free(RLIRoot);
+		ReloadConfig_Send(Pipe, Image, ImageSize);
 	}
+	close(Pipe);
 	
-	/*Release the backup global envvars.*/
-	EnvVarList_Shutdown(&GlobalEnvRoot);
+	/*PID 1 has what it needs, so the disk write happens on our time.*/
+	ConfigCache_Flush();
+	_exit(0);
+}
+#endif
+
+ReturnCode ReloadConfig_Begin(void)
+{ /*Parse the configuration in a child, so supervision carries on while it reads the disk.
+	* ReloadConfig_Poll() swaps the result in. FAILURE means the caller should just call ReloadConfig().*/
+#ifdef NOMMU
+	return FAILURE;
+#else
+	int Pipe[2];
 	
-	WriteLogLine("CONFIG: " CONSOLE_COLOR_GREEN "Configuration reload successful." CONSOLE_ENDCOLOR, true);
-	puts(CONSOLE_COLOR_GREEN "Epoch: Configuration reloaded." CONSOLE_ENDCOLOR);
+	if (BackgroundReload.PID) return WARNING; /*Already on it.*/
 	
-	FinaliseLogStartup(false); /*Clean up logs in memory.*/
+	if (pipe(Pipe) != 0) return FAILURE;
+	
+	Log_Flush(); /*Or the child would take a copy of what's buffered.*/
+	Journal_Flush();
+	
+	switch ((BackgroundReload.PID = fork()))
+	{
+		case -1:
+			BackgroundReload.PID = 0;
+			close(Pipe[0]);
+			close(Pipe[1]);
+			return FAILURE;
+		case 0:
+			close(Pipe[0]);
+			ReloadConfig_Child(Pipe[1]);
+			break;
+		default:
+			break;
+	}
+	
+	close(Pipe[1]);
+	fcntl(Pipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl(Pipe[0], F_SETFL, O_NONBLOCK);
+	BackgroundReload.Pipe = Pipe[0];
+	BackgroundReload.Size = 0;
 	
+	WriteLogLine("CONFIG: Parsing new configuration in the background.", true);
 	return SUCCESS;
+#endif
+}
+
+ReturnCode ReloadConfig_Poll(void)
+{ /*WARNING until the background parse is done, then how the reload went.*/
+	ssize_t Got = 0;
+	ReturnCode RetVal = FAILURE;
+	
+	if (!BackgroundReload.PID) return WARNING;
+	
+	for (;;)
+	{
+		if (BackgroundReload.Size == BackgroundReload.Capacity)
+		{
+			size_t NewCapacity = BackgroundReload.Capacity ? BackgroundReload.Capacity * 2 : 65536;
+			unsigned char *NewData = realloc(BackgroundReload.Data, NewCapacity);
+			
+			if (!NewData) break; /*Drain the rest and let the foreground parse handle it.*/
+			BackgroundReload.Data = NewData;
+			BackgroundReload.Capacity = NewCapacity;
+		}
+		
+		Got = read(BackgroundReload.Pipe, BackgroundReload.Data + BackgroundReload.Size,
+					BackgroundReload.Capacity - BackgroundReload.Size);
+		
+		if (Got > 0) BackgroundReload.Size += Got;
+		else if (Got == -1 && errno == EINTR) continue;
+		else break;
+	}
+	
+	if (Got == -1 && errno == EAGAIN) return WARNING;
+	
+	/*The primary loop normally reaps it, but it may not be running.*/
+	waitpid(BackgroundReload.PID, NULL, WNOHANG);
+	close(BackgroundReload.Pipe);
+	BackgroundReload.Pipe = -1;
+	BackgroundReload.PID = 0;
+	
+	if (BackgroundReload.Size == 1 && *BackgroundReload.Data == 'U')
+	{
+		ReloadConfig_Unchanged();
+		RetVal = SUCCESS;
+	}
+	else if (BackgroundReload.Size > 1 + sizeof(unsigned) && *BackgroundReload.Data == 'P')
+	{ /*Only files with nothing but objects in them changed, and the child already parsed them.
+		* It sent which ones, then a snapshot of their objects. We only swap in what differs.*/
+		const unsigned char *const Payload = BackgroundReload.Data + 1;
+		const size_t PayloadSize = BackgroundReload.Size - 1;
+		unsigned NumChanged = 0, Inc = 0, *Changed = NULL;
+		unsigned char *Image = NULL;
+		size_t ListSize = 0;
+		
+		memcpy(&NumChanged, Payload, sizeof NumChanged);
+		ListSize = sizeof(unsigned) * (NumChanged + 1);
+		
+		if (NumChanged && NumChanged <= NumConfigCacheDeps && PayloadSize > ListSize &&
+			(Changed = malloc(ListSize)) && (Image = malloc(PayloadSize - ListSize)))
+		{ /*They're at odd offsets in there.*/
+			memcpy(Changed, Payload + sizeof NumChanged, ListSize - sizeof NumChanged);
+			memcpy(Image, Payload + ListSize, PayloadSize - ListSize);
+			for (; Inc < NumChanged && Changed[Inc] < NumConfigCacheDeps; ++Inc);
+		}
+		
+		RetVal = Image && Inc == NumChanged ? ReloadConfig_InPlace(Changed, NumChanged, Image, PayloadSize - ListSize) : WARNING;
+		if (RetVal == WARNING) RetVal = ReloadConfig_Swap(NULL, 0);
+		free(Changed);
+		free(Image);
+	}
+	else if (BackgroundReload.Size == 1 && *BackgroundReload.Data == 'X')
+	{ /*Parsing it here would take PID 1 down the same road, so keep what we have.*/
+		WriteLogLine("CONFIG: " CONSOLE_COLOR_RED "Background parse hit a fatal error." CONSOLE_ENDCOLOR
+					" Keeping the current configuration.", true);
+		SpitError("ReloadConfig_Poll(): Background parse hit a fatal error.\n"
+					"Keeping the current configuration. Check that every configuration file can be read.");
+		RetVal = FAILURE;
+	}
+	else if (BackgroundReload.Size > 1 && *BackgroundReload.Data == 'I')
+	{ /*Give it its own mapping, so it's owned and freed the same way a cache loaded from disk is.*/
+		const size_t ImageSize = BackgroundReload.Size - 1;
+		unsigned char *Image = mmap(NULL, ImageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		
+		if (Image != MAP_FAILED)
+		{
+			memcpy(Image, BackgroundReload.Data + 1, ImageSize);
+			RetVal = ReloadConfig_Swap(Image, ImageSize);
+		}
+		else RetVal = ReloadConfig();
+	}
+	else
+	{ /*The child found problems or died. Parse here so they get reported properly.*/
+		WriteLogLine("CONFIG: Background parse did not produce a configuration. Reloading in the foreground.", true);
+		RetVal = ReloadConfig();
+	}
+	
+	free(BackgroundReload.Data);
+	BackgroundReload.Data = NULL;
+	BackgroundReload.Size = BackgroundReload.Capacity = 0;
+	
+	return RetVal;
 }
@@ -29,6 +29,9 @@ struct _StatusReportFormat StatusReportFormat =
 		};
 /*Should we Disable CTRL-ALT-DEL instant reboots?*/
 Bool DisableCAD = true;
+
+/*Every warning and error we've printed. Lets InitConfig() tell a clean parse from a noisy one.*/
+unsigned long ProblemsReported;
 							
 void PrintBootBanner(void)
 { /*Real simple stuff.*/
@@ -226,6 +229,8 @@ void SpitError(const char *INErr)
 {
 	char HMS[3][16], MDY[3][16];
 	
+	++ProblemsReported;
+	
 	GetCurrentTime(HMS[0], HMS[1], HMS[2], MDY[0], MDY[1], MDY[2]);
 	
 	fprintf(stderr, "[%s:%s:%s | %s-%s-%s] " CONSOLE_COLOR_RED "Epoch: ERROR:\n" CONSOLE_ENDCOLOR "%s\n\n",
@@ -241,6 +246,8 @@ void SpitWarning(const char *INWarning)
 {
 	char HMS[3][16], MDY[3][16];
 	
+	++ProblemsReported;
+	
 	GetCurrentTime(HMS[0], HMS[1], HMS[2], MDY[0], MDY[1], MDY[2]);
 	
 	fprintf(stderr, "[%s:%s:%s | %s-%s-%s] " CONSOLE_COLOR_YELLOW "Epoch: WARNING:\n" CONSOLE_ENDCOLOR "%s\n\n",
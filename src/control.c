@@ -0,0 +1,382 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**This file handles the control socket, a SOCK_SEQPACKET Unix socket that carries
+ * the same messages as the membus. Each connection is one client, as many as we have room for,
+ * and we know who they are from SO_PEERCRED. The membus stays for early boot and reexec,
+ * when there's nowhere to put a socket yet.
+ * A connection that sends WATCH also gets sent events as objects change, which the membus can't do,
+ * since it would leave us waiting on the client.**/
+
+#define _GNU_SOURCE /*For struct ucred and accept4().*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "epoch.h"
+
+/*How often we try again to open the socket, while /run isn't ready for us.*/
+#define CONTROL_RETRY_SECS 5
+
+struct _ControlWatch
+{ /*A peer that asked for events. Only these get anything we didn't send in reply.*/
+	char *Filter; /*Object IDs, each with a space either side. Empty for all of them.*/
+	char *Events[CONTROL_WATCH_QUEUE]; /*Not sent yet, because their socket was full.*/
+	unsigned Head, Count;
+	unsigned long Dropped; /*Since the last overflow marker.*/
+};
+
+struct _ControlPeer
+{
+	int FD; /*-1 if this one's free.*/
+	Bool ReloadPending; /*Waiting on a reload that's being parsed in the background.*/
+	struct _ControlWatch *Watch;
+};
+
+static int ListenFD = -1;
+static struct _ControlPeer Peers[CONTROL_MAX_PEERS];
+static struct _ControlPeer *Serving; /*Whose message MemBus_ServeSocket() is handling.*/
+static unsigned NumPeers, NumWatchers;
+static time_t LastAttempt;
+
+static Bool Control_Allowed(const struct ucred *Cred)
+{ /*The same people the membus lets in. Root, or anyone in group 0, even as a supplementary group.*/
+	char Path[64], Line[MAX_LINE_SIZE];
+	FILE *Descriptor = NULL;
+	Bool Allowed = false;
+	
+	if (Cred->uid == 0 || Cred->gid == 0) return true;
+	
+	snprintf(Path, sizeof Path, "/proc/%ld/status", (long)Cred->pid);
+	
+	if (!(Descriptor = fopen(Path, "r"))) return false;
+	
+	while (fgets(Line, sizeof Line, Descriptor))
+	{
+		const char *Worker = Line + (sizeof "Groups:" - 1);
+		
+		if (strncmp(Line, "Groups:", sizeof "Groups:" - 1) != 0) continue;
+		
+		for (; *Worker; ++Worker)
+		{
+			if (*Worker == '0' && (Worker[-1] == ' ' || Worker[-1] == '\t') &&
+				(Worker[1] == ' ' || Worker[1] == '\t' || Worker[1] == '\n' || Worker[1] == '\0'))
+			{
+				Allowed = true;
+				break;
+			}
+		}
+		break;
+	}
+	
+	fclose(Descriptor);
+	
+	return Allowed;
+}
+
+static void Control_Close(struct _ControlPeer *Peer)
+{
+	if (Peer->FD == -1) return; /*A handler shut everything down while we were serving it.*/
+	
+	if (Peer->Watch)
+	{
+		for (; Peer->Watch->Count; --Peer->Watch->Count)
+		{
+			free(Peer->Watch->Events[Peer->Watch->Head]);
+			Peer->Watch->Head = (Peer->Watch->Head + 1) % CONTROL_WATCH_QUEUE;
+		}
+		
+		free(Peer->Watch->Filter);
+		free(Peer->Watch);
+		Peer->Watch = NULL;
+		--NumWatchers;
+	}
+	
+	close(Peer->FD);
+	Peer->FD = -1;
+	Peer->ReloadPending = false;
+	--NumPeers;
+}
+
+static Bool Control_Queue(struct _ControlWatch *Watch, const char *Event)
+{ /*Once we've had to drop something, the marker goes in ahead of whatever comes next.*/
+	char Marker[128];
+	
+	if (Watch->Dropped && Watch->Count < CONTROL_WATCH_QUEUE)
+	{
+		snprintf(Marker, sizeof Marker, "%s %lu OVERFLOW - %lu", MEMBUS_CODE_EVENT, (unsigned long)time(NULL), Watch->Dropped);
+		
+		if (!(Watch->Events[(Watch->Head + Watch->Count) % CONTROL_WATCH_QUEUE] = strdup(Marker))) return false;
+		
+		++Watch->Count;
+		Watch->Dropped = 0;
+	}
+	
+	if (!Event) return true;
+	
+	if (Watch->Count == CONTROL_WATCH_QUEUE || !(Watch->Events[(Watch->Head + Watch->Count) % CONTROL_WATCH_QUEUE] = strdup(Event)))
+	{
+		++Watch->Dropped;
+		return false;
+	}
+	
+	++Watch->Count;
+	
+	return true;
+}
+
+static void Control_Flush(struct _ControlPeer *Peer)
+{ /*Send what a watcher's socket has room for. The rest waits for POLLOUT.*/
+	struct _ControlWatch *const Watch = Peer->Watch;
+	
+	if (Watch->Count == 0 && Watch->Dropped) Control_Queue(Watch, NULL);
+	
+	while (Watch->Count)
+	{
+		const char *const Event = Watch->Events[Watch->Head];
+		
+		if (send(Peer->FD, Event, strlen(Event) + 1, MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) Control_Close(Peer);
+			return;
+		}
+		
+		free(Watch->Events[Watch->Head]);
+		Watch->Head = (Watch->Head + 1) % CONTROL_WATCH_QUEUE;
+		--Watch->Count;
+		
+		if (Watch->Count == 0 && Watch->Dropped) Control_Queue(Watch, NULL);
+	}
+}
+
+static void Control_Accept(void)
+{
+	struct ucred Cred = { 0 };
+	socklen_t CredSize = sizeof Cred;
+	unsigned Inc = 0;
+	int FD;
+	
+	while (NumPeers < CONTROL_MAX_PEERS && (FD = accept4(ListenFD, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+	{
+		if (getsockopt(FD, SOL_SOCKET, SO_PEERCRED, &Cred, &CredSize) != 0 || !Control_Allowed(&Cred))
+		{
+			char LogBuf[MAX_LINE_SIZE];
+			
+			snprintf(LogBuf, sizeof LogBuf, CONSOLE_COLOR_YELLOW "Refused a control socket connection from PID %ld, UID %lu."
+					CONSOLE_ENDCOLOR, (long)Cred.pid, (unsigned long)Cred.uid);
+			WriteLogLine(LogBuf, true);
+			close(FD);
+			continue;
+		}
+		
+		for (Inc = 0; Peers[Inc].FD != -1; ++Inc);
+		
+		Peers[Inc].FD = FD;
+		Peers[Inc].ReloadPending = false;
+		++NumPeers;
+	}
+}
+
+ReturnCode Control_Init(void)
+{ /*Open the socket. Failing is fine, clients fall back to the membus, and we try again later.*/
+	struct sockaddr_un Addr = { .sun_family = AF_UNIX };
+	
+	if (ListenFD != -1) return SUCCESS;
+	
+	LastAttempt = time(NULL);
+	
+	if (NumPeers == 0)
+	{
+		unsigned Inc = 0;
+		
+		for (; Inc < CONTROL_MAX_PEERS; ++Inc) Peers[Inc].FD = -1;
+	}
+	
+	mkdir(RUNDIR, 0755);
+	
+	if ((ListenFD = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+	{
+		return FAILURE;
+	}
+	
+	snprintf(Addr.sun_path, sizeof Addr.sun_path, "%s", CONTROLSOCKET);
+	unlink(CONTROLSOCKET); /*Left over from before a reexec, or a crash.*/
+	
+	if (bind(ListenFD, (struct sockaddr*)&Addr, sizeof Addr) != 0 || chmod(CONTROLSOCKET, 0660) != 0 ||
+		listen(ListenFD, CONTROL_MAX_PEERS) != 0)
+	{
+		close(ListenFD);
+		ListenFD = -1;
+		return FAILURE;
+	}
+	
+	return SUCCESS;
+}
+
+void Control_Shutdown(void)
+{
+	unsigned Inc = 0;
+	
+	if (ListenFD == -1) return;
+	
+	for (; Inc < CONTROL_MAX_PEERS; ++Inc)
+	{
+		if (Peers[Inc].FD != -1) Control_Close(Peers + Inc);
+	}
+	
+	close(ListenFD);
+	ListenFD = -1;
+	unlink(CONTROLSOCKET);
+}
+
+void Control_Tick(void)
+{ /*Bring the socket up once we can.*/
+	if (ListenFD == -1 && time(NULL) - LastAttempt >= CONTROL_RETRY_SECS) Control_Init();
+}
+
+Bool Control_Active(void)
+{
+	return ListenFD != -1;
+}
+
+unsigned Control_PollSet(struct pollfd *Out)
+{ /*Everything of ours that Capture_Wait() should wake up for. Room for CONTROL_MAX_PEERS + 1.*/
+	unsigned Inc = 0, NumOut = 0;
+	
+	if (ListenFD == -1) return 0;
+	
+	if (NumPeers < CONTROL_MAX_PEERS)
+	{ /*When we're full, new connections wait in the backlog until somebody leaves.*/
+		Out[NumOut].fd = ListenFD;
+		Out[NumOut++].events = POLLIN;
+	}
+	
+	for (; Inc < CONTROL_MAX_PEERS; ++Inc)
+	{
+		if (Peers[Inc].FD == -1) continue;
+		
+		Out[NumOut].fd = Peers[Inc].FD;
+		Out[NumOut++].events = Peers[Inc].Watch && Peers[Inc].Watch->Count ? POLLIN | POLLOUT : POLLIN;
+	}
+	
+	return NumOut;
+}
+
+void Control_Serve(void)
+{ /*New connections, then one message from each client that sent one. Same as the membus slots.*/
+	unsigned Inc = 0;
+	
+	if (ListenFD == -1) return;
+	
+	Control_Accept();
+	
+	for (; Inc < CONTROL_MAX_PEERS; ++Inc)
+	{
+		if (Peers[Inc].FD == -1) continue;
+		
+		Serving = Peers + Inc;
+		
+		if (!MemBus_ServeSocket(Peers[Inc].FD, &Peers[Inc].ReloadPending))
+		{
+			Control_Close(Peers + Inc);
+		}
+		else if (Peers[Inc].Watch && Peers[Inc].Watch->Count)
+		{
+			Control_Flush(Peers + Inc);
+		}
+		
+		Serving = NULL;
+	}
+}
+
+Bool Control_ReloadWaiting(void)
+{
+	unsigned Inc = 0;
+	
+	for (; Inc < CONTROL_MAX_PEERS && NumPeers; ++Inc)
+	{
+		if (Peers[Inc].FD != -1 && Peers[Inc].ReloadPending) return true;
+	}
+	
+	return false;
+}
+
+void Control_ReloadDone(const char *Reply)
+{ /*Give everyone waiting on the reload their answer.*/
+	unsigned Inc = 0;
+	
+	for (; Inc < CONTROL_MAX_PEERS; ++Inc)
+	{
+		if (Peers[Inc].FD == -1 || !Peers[Inc].ReloadPending) continue;
+		
+		Peers[Inc].ReloadPending = false;
+		
+		if (send(Peers[Inc].FD, Reply, strlen(Reply) + 1, MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
+		{
+			Control_Close(Peers + Inc);
+		}
+	}
+}
+
+Bool Control_Watch(const char *Filter)
+{ /*Called while serving a WATCH message. From then on, that connection gets events.*/
+	struct _ControlWatch *Watch = NULL;
+	const size_t Length = strlen(Filter);
+	
+	if (!Serving || Serving->Watch) return Serving != NULL;
+	
+	if (!(Watch = calloc(1, sizeof(struct _ControlWatch))) || !(Watch->Filter = malloc(Length + 3)))
+	{
+		free(Watch);
+		return false;
+	}
+	
+	if (Length) snprintf(Watch->Filter, Length + 3, " %s ", Filter);
+	else *Watch->Filter = '\0';
+	
+	Serving->Watch = Watch;
+	++NumWatchers;
+	
+	return true;
+}
+
+Bool Control_Watched(void)
+{ /*So callers can skip the work of finding out about an event nobody would hear.*/
+	return NumWatchers != 0;
+}
+
+void Control_Event(const char *Type, const char *ObjectID, const char *Detail)
+{ /*Something happened that watchers want to hear about. ObjectID is NULL for things that aren't about one object.*/
+	char Event[MAX_LINE_SIZE], Needle[MAX_DESCRIPT_SIZE + 2];
+	unsigned Inc = 0;
+	
+	if (!NumWatchers) return;
+	
+	snprintf(Event, sizeof Event, "%s %lu %s %s%s%s", MEMBUS_CODE_EVENT, (unsigned long)time(NULL), Type,
+			ObjectID ? ObjectID : "-", Detail ? " " : "", Detail ? Detail : "");
+	
+	if (ObjectID) snprintf(Needle, sizeof Needle, " %s ", ObjectID);
+	
+	for (; Inc < CONTROL_MAX_PEERS; ++Inc)
+	{
+		struct _ControlPeer *const Peer = Peers + Inc;
+		
+		if (Peer->FD == -1 || !Peer->Watch) continue;
+		
+		if (ObjectID && *Peer->Watch->Filter && !strstr(Peer->Watch->Filter, Needle)) continue;
+		
+		Control_Queue(Peer->Watch, Event);
+		
+		if (Peer != Serving) Control_Flush(Peer); /*Whoever we're serving is flushed once we're done with them.*/
+	}
+}
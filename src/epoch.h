@@ -14,7 +14,21 @@
 /*Limits and stuff.*/
 #define MAX_DESCRIPT_SIZE 384
 #define MAX_LINE_SIZE 2048
-#define MAX_CONFIG_FILES 400
+
+#ifndef LOGRING_SIZE /*How much recent log text we keep in memory. Must hold a few of the longest lines.*/
+#define LOGRING_SIZE 65536
+#endif
+
+#ifndef CAPTURE_RING_SIZE /*The same, for each object whose output we capture.*/
+#define CAPTURE_RING_SIZE 16384
+#endif
+
+#ifndef CAPTURE_FILE_MAX /*Without a LogRotate policy, a captured object's file is moved to file.1 past this size.*/
+#define CAPTURE_FILE_MAX (1024 * 1024)
+#endif
+
+#define CAPTURE_DEFAULT_RATE 100 /*Lines per second, unless LOGRATE says otherwise.*/
+#define CAPTURE_BUS_SLICE 10 /*Milliseconds. How late we can notice the membus while captured objects are running.*/
 
 /*Configuration.*/
 
@@ -37,6 +51,30 @@
 
 #define CONF_NAME "epoch.conf"
 
+#ifndef CONFIGCACHE /*The compiled configuration. Rebuilt whenever anything it came from changes.*/
+#define CONFIGCACHE CONFIGDIR CONF_NAME ".cache"
+#endif
+
+#ifndef STATEDIR /*Runtime changes to objects are kept here, so we never rewrite config files for them.*/
+#define STATEDIR "/var/lib/epoch/"
+#endif
+
+#define OVERLAYFILE STATEDIR "overlay"
+
+#ifndef RUNDIR /*Where the control socket lives. Has to be somewhere that's a tmpfs once we're booted.*/
+#define RUNDIR "/run/epoch/"
+#endif
+
+#define CONTROLSOCKET RUNDIR "control"
+
+#ifndef CONTROL_MAX_PEERS /*Control socket connections we serve at once.*/
+#define CONTROL_MAX_PEERS 32
+#endif
+
+#ifndef CONTROL_WATCH_QUEUE /*Events we hold for a watcher that isn't keeping up, before we start dropping them.*/
+#define CONTROL_WATCH_QUEUE 256
+#endif
+
 
 /*Environment variables.*/
 #ifndef ENVVAR_HOME
@@ -91,9 +129,29 @@
 /*The key for the shared memory bus and related stuff.*/
 #define MEMKEY (('E' + 'P' + 'O' + 'C' + 'H') + ('W'+'h'+'i'+'t'+'e' + 'R'+'a'+'t')) * 7 /*Cool, right?*/
 
-#define MEMBUS_SIZE 4096 + sizeof(long) * 2
+#define MEMBUS_SIZE (4096 + sizeof(long) * 2) /*Split in two halves, each a 32-bit status word followed by the message.*/
+
+#ifndef MEMBUS_SLOTS /*How many clients can be connected at once. No more than 32.*/
+#define MEMBUS_SLOTS 8
+#endif
+
+#define MEMBUS_SLOTSIZE (sizeof(long) * 2 + MEMBUS_SIZE) /*Owner PID and connect time, then the two halves.*/
+#define MEMBUS_TOTALSIZE (sizeof(long) * 2 + MEMBUS_SLOTS * MEMBUS_SLOTSIZE) /*The doorbell and slot count come first.*/
 #define MEMBUS_MSGSIZE 2047
 
+/*Anything longer than MEMBUS_MSGSIZE goes out in pieces, each starting with MEMBUS_CODE_CHUNK,
+ * its NUL and a struct _MemBusChunk. See MemBus_WriteLong().*/
+#define MEMBUS_CHUNK_MORE 1 /*Another piece follows this one.*/
+#define MEMBUS_CHUNK_PAYLOAD (MEMBUS_MSGSIZE - sizeof MEMBUS_CODE_CHUNK - sizeof(struct _MemBusChunk))
+
+#ifndef MEMBUS_LONGMSG_MAX /*The most we'll put back together, so a bad header can't eat our memory.*/
+#define MEMBUS_LONGMSG_MAX (16 * 1024 * 1024)
+#endif
+
+#ifndef MEMBUS_LONGMSG_TIMEOUT /*Seconds a long message gets to arrive in full, so a slow sender can't hold PID 1.*/
+#define MEMBUS_LONGMSG_TIMEOUT 10
+#endif
+
 /*The codes that are sent over the bus.*/
 
 /*These are what we use to set message types.*/
@@ -107,6 +165,7 @@
 #define MEMBUS_CODE_WARNING "WARN"
 #define MEMBUS_CODE_FAILURE "FAIL"
 #define MEMBUS_CODE_BADPARAM "BADPARAM"
+#define MEMBUS_CODE_CHUNK "CHUNK"
 /*These are what we actually send.*/
 #define MEMBUS_CODE_ABORTHALT "INIT_ABORTHALT"
 #define MEMBUS_CODE_HALT "INIT_HALT"
@@ -133,11 +192,19 @@
 #define MEMBUS_CODE_LSOBJS "LSOBJS"
 #define MEMBUS_CODE_CFMERGE "CFMERGE"
 #define MEMBUS_CODE_CFUMERGE "CFUMERGE"
+#define MEMBUS_CODE_CFSTATS "CFSTATS"
+#define MEMBUS_CODE_LOGTAIL "LOGTAIL"
+#define MEMBUS_CODE_OBJLOGS "OBJLOGS"
+#define MEMBUS_CODE_JOURNAL "JOURNAL"
+#define MEMBUS_CODE_WATCH "WATCH" /*Control socket only. Followed by object IDs, or nothing for all of them.*/
+#define MEMBUS_CODE_EVENT "EVENT" /*What a watcher gets: the time, the kind of event, the object ID or "-", then details.*/
+#define MEMBUS_CODE_BATCH "BATCH" /*A newline, then a script of "verb objectid..." or "verb --runlevel name" lines.*/
+#define MEMBUS_CODE_OBJRESTART "OBJRESTART" /*Only in BATCH replies, which are one "code OBJ* objectid" line per object.*/
 
 #define MEMBUS_CODE_RXD "RXD"
 #define MEMBUS_CODE_RXD_OPTS "ORXD"
 
-#define MEMBUS_LSOBJS_VERSION "V4"
+#define MEMBUS_LSOBJS_VERSION "V6"
 /**Types, enums, structs and whatnot**/
 
 #define MOUNTVIRTUAL_MKDIR 2
@@ -163,6 +230,9 @@ typedef enum { FAILURE, SUCCESS, WARNING } ReturnCode;
 /*Trinary boot/shutdown/nothing modes.*/
 typedef enum { BOOT_NEUTRAL, BOOT_BOOTUP, BOOT_SHUTDOWN } BootMode;
 
+/*How serious a journal record is. The same numbers syslog uses.*/
+enum JournalSeverity { JOURNAL_ERROR = 3, JOURNAL_WARNING = 4, JOURNAL_INFO = 6 };
+
 /**Structures go here.**/
 struct _RLTree
 { /*Runlevel linked list.*/
@@ -171,15 +241,61 @@ struct _RLTree
 	struct _RLTree *Prev;
 	struct _RLTree *Next;
 };
-	
-typedef struct _EpochObjectTable
+
+struct _MemBusChunk
 {
+	unsigned Sequence; /*Counts up from zero.*/
+	unsigned TotalLength; /*Of the whole message. The same in every piece.*/
+	unsigned Length; /*Of the payload after this header.*/
+	unsigned Flags; /*MEMBUS_CHUNK_**/
+};
+
+struct _LSObjRecord
+{ /*One object in an LSOBJS reply. The reply is MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION, its NUL,
+	* an unsigned record count, the records, then the string table their offsets point into.*/
+	unsigned IDOffset, IDLength;
+	unsigned DescriptionOffset, DescriptionLength;
+	unsigned RLOffset, RLLength; /*The runlevels, each NUL terminated, back to back.*/
+	unsigned Options; /*1 << COPT_*.*/
+	unsigned UserID, GroupID, PID, StartedSince, StopTimeout;
+	unsigned char Started, Running, Enabled, TermSignal, ReloadCommandSignal, StopMode;
+	unsigned char NumExitMaps;
+	unsigned char ExitMaps[8][2]; /*Value, then the exit status.*/
+};
+	
+struct _ObjState
+{ /*Runtime state we touch on every pass of the primary loop. These live packed together
+	* in ObjectStates[], which runs parallel to ObjectTable[], so scanning them doesn't drag
+	* the rest of the object's configuration through the cache.*/
+	unsigned ObjectPID; /*The process ID, used for shutting down.*/
+	unsigned StartedSince; /*The time in UNIX seconds since it was started.*/
 	unsigned ObjectStartPriority;
 	unsigned ObjectStopPriority;
-	unsigned ObjectPID; /*The process ID, used for shutting down.*/
+	unsigned short AutoRestart; /*Autorestarts a service whenever it terminates.*/
+	Bool Enabled;
+	Bool Started;
+};
+
+/*What an ObjectCondition line checks. The names are in config.c.*/
+enum ObjConditionType { COND_PATHEXISTS, COND_PATHISDIRECTORY, COND_FILENOTEMPTY, COND_KERNELCMDLINE,
+						COND_VIRTUALIZATION, COND_FIRSTBOOT, COND_ENVSET, COND_MAX };
+
+struct _ObjCondition
+{ /*Every one of an object's conditions has to hold, or we don't start it at all.*/
+	enum ObjConditionType Type;
+	Bool Negate; /*Written with a ! in front.*/
+	char *Arg; /*NULL for FirstBoot, which doesn't take one.*/
+	struct _ObjCondition *Next; /*NULL at the end. There's no empty node on this list.*/
+};
+
+/*Which of an object's commands each of its exec plans is for. See parse.c.*/
+enum ExecPlanCmd { EXECPLAN_START, EXECPLAN_PRESTART, EXECPLAN_STOP, EXECPLAN_RELOAD, EXECPLAN_MAX };
+
+typedef struct _EpochObjectTable
+{
+	struct _ObjState *State; /*Points to our element in ObjectStates.*/
 	unsigned UserID; /*The user ID we run this as. Zero, of course, is root and we need do nothing.*/
 	unsigned GroupID; /*Same as above, but with groups.*/
-	unsigned StartedSince; /*The time in UNIX seconds since it was started.*/
 	char *ObjectID; /*The ASCII ID given to this item by whoever configured Epoch.*/
 	char *ObjectDescription; /*The description of the object.*/
 	char *ObjectStartCommand; /*The command to be executed.*/
@@ -190,6 +306,7 @@ typedef struct _EpochObjectTable
 	char *ObjectWorkingDirectory; /*The working directory the object chdirs to before execution.*/
 	char *ObjectStderr; /*A file that stderr redirects to.*/
 	char *ObjectStdout; /*A file that stdout redirects to.*/
+	char *CaptureFile; /*Where captured output is forwarded, if anywhere. See capture.c.*/
 	
 	const char *ConfigFile; /*The config file this object was declared in.
 	* Points either to the correct element in ConfigFileList or it points to the single-file ConfigFile array.
@@ -197,8 +314,6 @@ typedef struct _EpochObjectTable
 	
 	unsigned char TermSignal; /*The signal we send to an object if it's stop mode is PID or PIDFILE.*/
 	unsigned char ReloadCommandSignal; /*If the reload command sends a signal, this works.*/
-	Bool Enabled;
-	Bool Started;
 	
 	struct
 	{ /*Maps an object's exit statuses to a special case of an ReturnCode value.*/
@@ -210,7 +325,7 @@ typedef struct _EpochObjectTable
 	{
 		enum _StopMode StopMode; /*If we use a stop command, set this to 1, otherwise, set to 0 to use PID.*/
 		unsigned StopTimeout; /*The number of seconds we wait for a task we're stopping's PID to become unavailable.*/
-		unsigned short AutoRestart; /*Autorestarts a service whenever it terminates.*/
+		unsigned LogRate; /*How many lines of captured output a second we keep. Zero for no limit.*/
 		
 		/*This saves a tiny bit of memory to use bitfields here.*/
 		unsigned Persistent : 1; /*Allowed to stop this without starting a shutdown?*/
@@ -227,6 +342,8 @@ typedef struct _EpochObjectTable
 		unsigned StopFailIsCritical : 1; /*Same but for stopping.*/
 		unsigned NoTrack : 1; /*Don't track the PID with AdvancedPIDFind().*/
 		unsigned Interactive : 1; //Says that this object is allowed to prompt for y/N to start or not on boot.
+		unsigned CaptureStdout : 1; /*Send stdout to Epoch instead of a file or the console.*/
+		unsigned CaptureStderr : 1;
 #ifndef NOMMU
 		unsigned Fork : 1; /*Essentially do the same thing (with an Epoch twist) as Command& in sh.*/
 		unsigned ForkScanOnce : 1; /*Same as Fork, but only scans through the PID once.*/
@@ -235,11 +352,28 @@ typedef struct _EpochObjectTable
 	
 	struct _EnvVarList *EnvVars; /*List of environment variables.*/
 	struct _RLTree *ObjectRunlevels; /*Dynamically allocated, needless to say.*/
-	
-	struct _EpochObjectTable *Prev;
-	struct _EpochObjectTable *Next;
+	struct _ObjCondition *Conditions; /*Checked by ProcessConfigObject() before starting.*/
+	struct _ExecPlan *ExecPlans[EXECPLAN_MAX]; /*Set up by ExecPlan_Prepare() whenever the configuration loads.*/
 } ObjTable;
 
+struct _RotatePolicy
+{ /*When a log file is moved to file.1, file.1 to file.2, and so on. Zero means no limit.*/
+	unsigned long long MaxSize; /*Bytes.*/
+	unsigned long MaxAge; /*Seconds since the file was last started over.*/
+	unsigned Keep; /*How many old files we hold on to.*/
+};
+
+struct _LogRing
+{ /*Recent lines of text. Positions count bytes since the ring was made and never wrap,
+	* so a byte lives at Data[Pos % Size].*/
+	unsigned long long Start; /*Oldest byte we still have. Always the start of a line.*/
+	unsigned long long End;
+	unsigned long long OnDisk; /*Everything before this has been written out, for rings that get written out.*/
+	unsigned long Lost; /*Lines pushed out of the ring before they reached OnDisk.*/
+	size_t Size;
+	char *Data;
+};
+
 struct _BootBanner
 {
 	Bool ShowBanner;
@@ -270,12 +404,20 @@ struct _CTask
 struct _MemBusInterface
 {
 	void *Root;
+	unsigned *Doorbell; /*Bumped by clients when they leave the server something. The server sleeps on it.*/
+	unsigned *NumSlots; /*Set by the server once the segment is ready.*/
+	unsigned Slot; /*The client slot everything below points into.*/
 	unsigned long *LockPID;
 	unsigned long *LockTime;
 	
+	/*Set while we talk over the control socket instead. The two halves below are unused then.*/
+	Bool OverSocket;
+	Bool SocketClosed;
+	int Socket;
+	
 	struct
 	{
-		unsigned char *Status;
+		unsigned *Status; /*Aligned, so both sides can futex on it.*/
 		char *Message;
 		unsigned char *BinMessage;
 	} Server, Client;
@@ -296,6 +438,15 @@ struct _StatusReportFormat
 	char StatusFormats[3][MAX_LINE_SIZE]; /*For FAILURE, Done, and WARNING, and whatnot. You specify what to show.*/
 };
 
+struct _ConfigArenaStats
+{ /*Reported by 'epoch configstats'.*/
+	unsigned Generation; /*Bumped every time a configuration is loaded from scratch.*/
+	unsigned NumBlocks;
+	unsigned long NumAllocs;
+	unsigned long BytesUsed;
+	unsigned long BytesReserved;
+};
+
 struct _StartupCustomObjCommands
 { //Used for startobj= and skipobj= on the kernel command line.
 	char Start[16][MAX_DESCRIPT_SIZE];
@@ -307,6 +458,8 @@ struct _StartupCustomObjCommands
 /**Globals go here.**/
 
 extern ObjTable *ObjectTable;
+extern struct _ObjState *ObjectStates;
+extern unsigned ObjectTableSize;
 extern struct _BootBanner BootBanner;
 extern char CurRunlevel[MAX_DESCRIPT_SIZE];
 extern struct _MemBusInterface MemBus;
@@ -317,14 +470,15 @@ extern struct _HaltParams HaltParams;
 extern unsigned char AutoMountOpts[5];
 extern Bool EnableLogging;
 extern Bool LogInMemory;
+extern struct _LogRing EpochLog;
 extern Bool BlankLogOnBoot;
-extern char *MemLogBuffer;
 extern struct _CTask CurrentTask;
 extern BootMode CurrentBootMode;
 extern int MemBusKey;
 extern Bool BusRunning;
+extern Bool UseControlSocket;
 extern char ConfigFile[MAX_LINE_SIZE];
-extern char *ConfigFileList[MAX_CONFIG_FILES];
+extern char **ConfigFileList;
 extern int NumConfigFiles;
 extern struct _EnvVarList *GlobalEnvVars;
 extern Bool AreInit;
@@ -332,6 +486,8 @@ extern struct _StatusReportFormat StatusReportFormat;
 extern struct _StartupCustomObjCommands StartupCustomObjCommands;
 extern Bool InteractiveBoot;
 extern char LogFile[MAX_LINE_SIZE];
+extern struct _RotatePolicy LogRotate;
+extern unsigned long ProblemsReported;
 //End of globals
 
 
@@ -341,6 +497,8 @@ extern char LogFile[MAX_LINE_SIZE];
 extern ReturnCode InitConfig(const char *CurConfigFile);
 extern void ShutdownConfig(void);
 extern ReturnCode ReloadConfig(void);
+extern ReturnCode ReloadConfig_Begin(void);
+extern ReturnCode ReloadConfig_Poll(void);
 extern ObjTable *LookupObjectInTable(const char *ObjectID);
 extern ObjTable *GetObjectByPriority(const char *ObjectRunlevel, ObjTable *LastNode,
 									Bool WantStartPriority, unsigned ObjectPriority);
@@ -351,6 +509,8 @@ extern Bool ObjRL_CheckRunlevel(const char *InRL, const ObjTable *InObj, Bool Co
 extern Bool ObjRL_DelRunlevel(const char *InRL, ObjTable *InObj);
 extern Bool ObjRL_ValidRunlevel(const char *InRL);
 extern void ObjRL_ShutdownRunlevels(ObjTable *InObj);
+extern Bool ObjCondition_Add(const char *InStream, ObjTable *InObj);
+extern void ObjCondition_Describe(const struct _ObjCondition *Condition, char *OutStream, size_t OutSize);
 extern char *WhitespaceArg(const char *InStream);
 extern void EnvVarList_Shutdown(struct _EnvVarList **const List);
 extern void EnvVarList_Add(const char *Var, struct _EnvVarList **const List);
@@ -358,12 +518,48 @@ extern Bool EnvVarList_Del(const char *const Check, struct _EnvVarList **const L
 extern void EnvVarList_Shutdown(struct _EnvVarList **const List);
 extern ReturnCode UnmergeImportLine(const char *Filename);
 extern ReturnCode MergeImportLine(const char *LineData);
+extern void *ConfigArena_Alloc(size_t Size);
+extern char *ConfigArena_StrDup(const char *InStream);
+extern void ConfigArena_GetStats(struct _ConfigArenaStats *OutStats);
+extern void ConfigCache_Flush(void);
+
+/*overlay.c*/
+extern void Overlay_Apply(void);
+extern ReturnCode Overlay_RecordEnabled(const ObjTable *Obj, Bool Before);
+extern ReturnCode Overlay_RecordRunlevels(const ObjTable *Obj, const char *Before);
+extern void Overlay_DescribeRunlevels(const ObjTable *Obj, char *OutStream, size_t OutSize);
+extern void Overlay_Sync(Bool Now);
+
+/*builtins.c*/
+extern Bool Builtin_Check(char **ArgV, char *OutErr, size_t OutSize);
+extern ReturnCode Builtin_Run(char **ArgV, const char *ObjectID);
+
+/*capture.c*/
+extern int Capture_Prepare(const ObjTable *InObj);
+extern Bool Capture_Active(void);
+extern const struct _LogRing *Capture_Ring(const char *ObjectID);
+extern Bool Capture_Wait(unsigned Milliseconds, Bool WatchBus);
+extern void Capture_Tick(void);
+extern void Capture_Handoff(Bool Leaving);
+extern void Capture_Adopt(void);
+
+/*journal.c*/
+extern char JournalPath[MAX_LINE_SIZE];
+extern void Journal_Write(const char *ObjectID, unsigned char Severity, const char *Text, size_t Length);
+extern void Journal_Flush(void);
+extern void Journal_Tick(void);
+extern void Journal_Close(void);
+extern Bool Journal_ParseTime(const char *InStream, long long *OutTime);
+extern ReturnCode Journal_Print(const char *Path, const char *ObjectID, long long Since, long long Until);
 
 /*parse.c*/
 extern ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool PrintStatus);
+extern void StopObjectGroup(ObjTable **Objects, unsigned NumObjects, ReturnCode *Results);
 extern ReturnCode RunAllObjects(Bool IsStartingMode);
 extern ReturnCode SwitchRunlevels(const char *Runlevel);
 extern ReturnCode ProcessReloadCommand(ObjTable *CurObj, Bool PrintStatus);
+extern void ExecPlan_Prepare(void);
+extern void ExecPlan_PrepareObject(ObjTable *InObj);
 
 /*actions.c*/
 extern void LaunchBootup(void);
@@ -380,7 +576,7 @@ extern ReturnCode SendPowerControl(const char *MembusCode);
 extern ReturnCode EmulKillall5(unsigned InSignal);
 extern void EmulWall(const char *InStream, Bool ShowUser);
 extern ReturnCode EmulShutdown(int ArgumentCount, const char **ArgStream);
-extern ReturnCode ObjControl(const char *ObjectID, const char *MemBusSignal);
+extern ReturnCode ObjControl_Batch(const char *Script);
 
 /*membus.c*/
 extern ReturnCode InitMemBus(Bool ServerSide);
@@ -392,6 +588,26 @@ extern Bool HandleMemBusPings(void);
 extern Bool CheckMemBusIntegrity(void);
 extern unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSide);
 extern unsigned MemBus_BinRead(void *OutStream_, unsigned MaxOutSize, Bool ServerSide);
+extern ReturnCode MemBus_WriteLong(const void *Data_, unsigned Size, Bool ServerSide);
+extern void *MemBus_ReadLong(unsigned *SizeOut, Bool ServerSide);
+extern void MemBus_Wait(Bool ServerSide);
+extern Bool MemBus_Pending(void);
+extern Bool MemBus_Idle(unsigned Milliseconds);
+extern Bool MemBus_ServeSocket(int Socket, Bool *ReloadPending);
+
+/*control.c*/
+struct pollfd;
+extern ReturnCode Control_Init(void);
+extern void Control_Shutdown(void);
+extern void Control_Tick(void);
+extern Bool Control_Active(void);
+extern unsigned Control_PollSet(struct pollfd *Out);
+extern void Control_Serve(void);
+extern Bool Control_ReloadWaiting(void);
+extern void Control_ReloadDone(const char *Reply);
+extern Bool Control_Watch(const char *Filter);
+extern Bool Control_Watched(void);
+extern void Control_Event(const char *Type, const char *ObjectID, const char *Detail);
 
 /*console.c*/
 extern void PrintBootBanner(void);
@@ -414,6 +630,18 @@ extern Bool AllNumeric(const char *InStream);
 extern Bool ObjectProcessRunning(const ObjTable *InObj);
 extern unsigned ReadPIDFile(const ObjTable *InObj);
 extern ReturnCode WriteLogLine(const char *InStream, Bool AddDate);
+extern const char *Log_Timestamp(void);
+extern void Log_Flush(void);
+extern void Log_Tick(void);
+extern void Log_Close(void);
+extern void Log_Reopen(void);
+extern Bool Log_Begin(Bool Truncate);
+extern time_t Rotate_Since(const char *Path, time_t Fallback);
+extern Bool Rotate_Due(const struct _RotatePolicy *Policy, unsigned long long Size, unsigned long long Adding, time_t Since);
+extern void Rotate_Shift(const char *Path, unsigned Keep);
+extern void LogRing_Append(struct _LogRing *Ring, const char *InStream, size_t Length);
+extern unsigned long long LogRing_Tail(const struct _LogRing *Ring, unsigned Lines);
+extern size_t LogRing_Read(const struct _LogRing *Ring, unsigned long long *Pos, char *OutStream, size_t OutSize);
 extern unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID);
 extern Bool ProcAvailable(void);
 extern Bool ValidIdentifierName(const char *const Identifier);
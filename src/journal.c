@@ -0,0 +1,530 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**This file is the journal, an optional binary log of everything Epoch and its captured objects say.
+ * It's append-only records with fixed headers, and every so often an index record that says
+ * which objects and what stretch of time the records before it cover. Readers mmap() the file,
+ * follow the index records back from the one the file header names, and only look at the
+ * stretches that can hold what they want.**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "epoch.h"
+
+#define JOURNAL_MAGIC "EPOCHJNL"
+#define JOURNAL_VERSION 1
+/*How many bytes of records an index record covers.*/
+#define JOURNAL_INDEX_SPAN 65536
+/*Records waiting to be written, including ones from before / was writable.*/
+#define JOURNAL_BUFFER_SIZE 65536
+#define JOURNAL_FLUSH_DELAY 1
+#define JOURNAL_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+enum JournalRecordType { JOURNAL_REC_LINE = 1, JOURNAL_REC_INDEX };
+
+struct _JournalHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t HeaderSize;
+	uint64_t LastIndex; /*Offset of the newest index record, zero if there's none yet. The only thing we ever rewrite.*/
+	uint64_t Reserved[5];
+};
+
+struct _JournalRecord
+{ /*Followed by NameLength bytes of ObjectID, then the text, then padding to eight bytes.*/
+	uint32_t Length; /*Of the name and text together.*/
+	uint16_t Type;
+	uint8_t Severity;
+	uint8_t NameLength; /*Zero for Epoch itself.*/
+	uint32_t Object; /*Journal_Hash() of the ObjectID.*/
+	uint32_t Reserved;
+	int64_t Monotonic; /*Nanoseconds. Only meaningful within a boot.*/
+	int64_t Realtime; /*Nanoseconds since the epoch.*/
+};
+
+struct _JournalIndex
+{ /*Describes the records from SpanStart up to the index record itself.*/
+	uint64_t Previous; /*The index record before this one, or zero.*/
+	uint64_t SpanStart;
+	int64_t MinTime, MaxTime; /*Realtime. The clock can go backwards, so these aren't the first and last.*/
+	uint32_t NumRecords;
+	uint32_t Reserved;
+	uint8_t Objects[32]; /*A bit for each object that appears, by hash.*/
+};
+
+char JournalPath[MAX_LINE_SIZE];
+
+static struct
+{
+	int Descriptor; /*-1 while closed.*/
+	char Path[MAX_LINE_SIZE]; /*What JournalPath was when we opened it.*/
+	uint64_t End;
+	uint64_t LastIndex;
+	struct _JournalIndex Span; /*The stretch we're in the middle of.*/
+	time_t Oldest;
+	size_t Used;
+	unsigned long Lost; /*Records we had no room for before the journal opened.*/
+	unsigned char Buffer[JOURNAL_BUFFER_SIZE];
+} JournalWriter = { -1 };
+
+static uint32_t Journal_Hash(const char *ObjectID, size_t Length)
+{ /*FNV-1a. Never zero, since that means Epoch.*/
+	uint32_t Hash = 2166136261u;
+	size_t Inc = 0;
+	
+	for (; Inc < Length; ++Inc)
+	{
+		Hash = (Hash ^ (unsigned char)ObjectID[Inc]) * 16777619u;
+	}
+	
+	return Hash ? Hash : 1;
+}
+
+static void Journal_SpanAdd(struct _JournalIndex *Span, const struct _JournalRecord *Record)
+{
+	if (!Span->NumRecords || Record->Realtime < Span->MinTime) Span->MinTime = Record->Realtime;
+	if (!Span->NumRecords || Record->Realtime > Span->MaxTime) Span->MaxTime = Record->Realtime;
+	
+	Span->Objects[(Record->Object & 255) >> 3] |= 1 << (Record->Object & 7);
+	++Span->NumRecords;
+}
+
+static const struct _JournalRecord *Journal_RecordAt(const unsigned char *Map, uint64_t MapSize, uint64_t Offset)
+{ /*NULL if there isn't a whole record there, like at the end of a journal that was cut short.*/
+	const struct _JournalRecord *Record = (const void*)(Map + Offset);
+	
+	if (Offset + sizeof(struct _JournalRecord) > MapSize) return NULL;
+	
+	if (Offset + sizeof(struct _JournalRecord) + JOURNAL_ALIGN(Record->Length) > MapSize ||
+		Record->NameLength > Record->Length || (Record->Type != JOURNAL_REC_LINE && Record->Type != JOURNAL_REC_INDEX))
+	{
+		return NULL;
+	}
+	
+	return Record;
+}
+
+#define Journal_NextOffset(Offset, Record) ((Offset) + sizeof(struct _JournalRecord) + JOURNAL_ALIGN((Record)->Length))
+
+static Bool Journal_Recover(void)
+{ /*Finds where the records really end, and rebuilds the span the last index record didn't cover.*/
+	struct stat FileStat;
+	unsigned char *Map = NULL;
+	const struct _JournalRecord *Record = NULL;
+	uint64_t Offset = sizeof(struct _JournalHeader);
+	
+	if (fstat(JournalWriter.Descriptor, &FileStat) != 0) return false;
+	
+	if ((Map = mmap(NULL, FileStat.st_size, PROT_READ, MAP_SHARED, JournalWriter.Descriptor, 0)) == MAP_FAILED) return false;
+	
+	if (JournalWriter.LastIndex && (Record = Journal_RecordAt(Map, FileStat.st_size, JournalWriter.LastIndex)) != NULL &&
+		Record->Type == JOURNAL_REC_INDEX)
+	{
+		Offset = Journal_NextOffset(JournalWriter.LastIndex, Record);
+	}
+	else JournalWriter.LastIndex = 0;
+	
+	memset(&JournalWriter.Span, 0, sizeof JournalWriter.Span);
+	JournalWriter.Span.Previous = JournalWriter.LastIndex;
+	JournalWriter.Span.SpanStart = Offset;
+	
+	for (; (Record = Journal_RecordAt(Map, FileStat.st_size, Offset)) != NULL; Offset = Journal_NextOffset(Offset, Record))
+	{
+		if (Record->Type == JOURNAL_REC_LINE) Journal_SpanAdd(&JournalWriter.Span, Record);
+	}
+	
+	munmap(Map, FileStat.st_size);
+	
+	JournalWriter.End = Offset;
+	
+	if ((uint64_t)FileStat.st_size != Offset) ftruncate(JournalWriter.Descriptor, Offset); /*A torn record from a crash.*/
+	
+	return true;
+}
+
+static Bool Journal_Open(void)
+{
+	struct _JournalHeader Header;
+	struct stat FileStat;
+	
+	if (JournalWriter.Descriptor != -1) close(JournalWriter.Descriptor);
+	
+	snprintf(JournalWriter.Path, sizeof JournalWriter.Path, "%s", JournalPath);
+	
+	/*Not O_APPEND. We rewrite the header, and Linux would send pwrite() to the end.*/
+	if ((JournalWriter.Descriptor = open(JournalPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) == -1) return false;
+	
+	fstat(JournalWriter.Descriptor, &FileStat);
+	
+	if (FileStat.st_size >= (off_t)sizeof Header && pread(JournalWriter.Descriptor, &Header, sizeof Header, 0) == sizeof Header &&
+		!memcmp(Header.Magic, JOURNAL_MAGIC, sizeof Header.Magic) && Header.Version == JOURNAL_VERSION &&
+		Header.HeaderSize == sizeof Header)
+	{
+		JournalWriter.LastIndex = Header.LastIndex;
+		
+		if (Journal_Recover()) return true;
+	}
+	else if (FileStat.st_size > 0)
+	{ /*Something else, or from a version we can't read. Keep it, but start over.*/
+		char NewPath[MAX_LINE_SIZE + 8];
+		
+		snprintf(NewPath, sizeof NewPath, "%s.old", JournalPath);
+		rename(JournalPath, NewPath);
+		close(JournalWriter.Descriptor);
+		
+		if ((JournalWriter.Descriptor = open(JournalPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1) return false;
+	}
+	
+	memset(&Header, 0, sizeof Header);
+	memcpy(Header.Magic, JOURNAL_MAGIC, sizeof Header.Magic);
+	Header.Version = JOURNAL_VERSION;
+	Header.HeaderSize = sizeof Header;
+	
+	if (pwrite(JournalWriter.Descriptor, &Header, sizeof Header, 0) != sizeof Header)
+	{
+		close(JournalWriter.Descriptor);
+		JournalWriter.Descriptor = -1;
+		return false;
+	}
+	
+	ftruncate(JournalWriter.Descriptor, sizeof Header);
+	JournalWriter.End = sizeof Header;
+	JournalWriter.LastIndex = 0;
+	memset(&JournalWriter.Span, 0, sizeof JournalWriter.Span);
+	JournalWriter.Span.SpanStart = JournalWriter.End;
+	
+	return true;
+}
+
+static void Journal_WriteIndex(void)
+{ /*Closes off the current span.*/
+	struct
+	{
+		struct _JournalRecord Record;
+		struct _JournalIndex Index;
+	} Out;
+	const uint64_t Offset = JournalWriter.End;
+	struct timespec Now;
+	
+	memset(&Out, 0, sizeof Out);
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	Out.Record.Monotonic = (int64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
+	clock_gettime(CLOCK_REALTIME, &Now);
+	Out.Record.Realtime = (int64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
+	Out.Record.Type = JOURNAL_REC_INDEX;
+	Out.Record.Length = sizeof Out.Index;
+	Out.Index = JournalWriter.Span;
+	
+	if (pwrite(JournalWriter.Descriptor, &Out, sizeof Out, Offset) != sizeof Out) return;
+	
+	/*Only once the index record is all there do we point the header at it.*/
+	pwrite(JournalWriter.Descriptor, &Offset, sizeof Offset, offsetof(struct _JournalHeader, LastIndex));
+	
+	JournalWriter.End += sizeof Out;
+	JournalWriter.LastIndex = Offset;
+	memset(&JournalWriter.Span, 0, sizeof JournalWriter.Span);
+	JournalWriter.Span.Previous = Offset;
+	JournalWriter.Span.SpanStart = JournalWriter.End;
+}
+
+void Journal_Flush(void)
+{ /*Writes the buffer out, putting in index records as the spans fill up.*/
+	size_t Pos = 0, From = 0;
+	
+	if (!JournalWriter.Used || LogInMemory) return; /*Hold on to it until / is writable.*/
+	
+	if (!*JournalPath)
+	{
+		JournalWriter.Used = 0;
+		return;
+	}
+	
+	if ((JournalWriter.Descriptor == -1 || strcmp(JournalWriter.Path, JournalPath) != 0) && !Journal_Open())
+	{
+		JournalWriter.Used = 0;
+		return;
+	}
+	
+	while (Pos < JournalWriter.Used)
+	{
+		const struct _JournalRecord *Record = (const void*)(JournalWriter.Buffer + Pos);
+		
+		Journal_SpanAdd(&JournalWriter.Span, Record);
+		Pos = Journal_NextOffset(Pos, Record);
+		
+		if (JournalWriter.End + (Pos - From) - JournalWriter.Span.SpanStart >= JOURNAL_INDEX_SPAN || Pos == JournalWriter.Used)
+		{
+			if (pwrite(JournalWriter.Descriptor, JournalWriter.Buffer + From, Pos - From, JournalWriter.End) != (ssize_t)(Pos - From))
+			{ /*Out of space, probably. Leave the journal as it was.*/
+				ftruncate(JournalWriter.Descriptor, JournalWriter.End);
+				break;
+			}
+			
+			JournalWriter.End += Pos - From;
+			From = Pos;
+			
+			if (JournalWriter.End - JournalWriter.Span.SpanStart >= JOURNAL_INDEX_SPAN) Journal_WriteIndex();
+		}
+	}
+	
+	JournalWriter.Used = 0;
+}
+
+void Journal_Write(const char *ObjectID, unsigned char Severity, const char *Text, size_t Length)
+{ /*ObjectID is NULL for Epoch's own lines.*/
+	const size_t NameLength = ObjectID ? strlen(ObjectID) : 0;
+	struct _JournalRecord Record;
+	struct timespec Now;
+	
+	if (!*JournalPath) return;
+	
+	if (NameLength > 255) return; /*Can't happen with a valid ObjectID.*/
+	
+	if (Length > MAX_LINE_SIZE) Length = MAX_LINE_SIZE;
+	
+	if (JournalWriter.Used + sizeof Record + JOURNAL_ALIGN(NameLength + Length) > sizeof JournalWriter.Buffer)
+	{
+		Journal_Flush();
+		
+		if (JournalWriter.Used)
+		{ /*Still in memory mode, and we've filled up.*/
+			++JournalWriter.Lost;
+			return;
+		}
+	}
+	
+	memset(&Record, 0, sizeof Record);
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	Record.Monotonic = (int64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
+	clock_gettime(CLOCK_REALTIME, &Now);
+	Record.Realtime = (int64_t)Now.tv_sec * 1000000000 + Now.tv_nsec;
+	Record.Type = JOURNAL_REC_LINE;
+	Record.Severity = Severity;
+	Record.NameLength = NameLength;
+	Record.Object = ObjectID ? Journal_Hash(ObjectID, NameLength) : 0;
+	Record.Length = NameLength + Length;
+	
+	if (!JournalWriter.Used) JournalWriter.Oldest = Now.tv_sec;
+	
+	memcpy(JournalWriter.Buffer + JournalWriter.Used, &Record, sizeof Record);
+	if (NameLength) memcpy(JournalWriter.Buffer + JournalWriter.Used + sizeof Record, ObjectID, NameLength);
+	memcpy(JournalWriter.Buffer + JournalWriter.Used + sizeof Record + NameLength, Text, Length);
+	memset(JournalWriter.Buffer + JournalWriter.Used + sizeof Record + Record.Length, 0,
+			JOURNAL_ALIGN(Record.Length) - Record.Length);
+	
+	JournalWriter.Used += sizeof Record + JOURNAL_ALIGN(Record.Length);
+}
+
+void Journal_Tick(void)
+{
+	if (JournalWriter.Lost && !LogInMemory)
+	{
+		char Notice[128];
+		const unsigned long Lost = JournalWriter.Lost;
+		
+		JournalWriter.Lost = 0;
+		Journal_Flush();
+		snprintf(Notice, sizeof Notice, "[Epoch: %lu journal records were dropped before the journal could be opened.]", Lost);
+		Journal_Write(NULL, JOURNAL_WARNING, Notice, strlen(Notice));
+	}
+	
+	if (JournalWriter.Used && time(NULL) - JournalWriter.Oldest >= JOURNAL_FLUSH_DELAY) Journal_Flush();
+}
+
+void Journal_Close(void)
+{
+	Journal_Flush();
+	
+	if (JournalWriter.Descriptor != -1)
+	{
+		close(JournalWriter.Descriptor);
+		JournalWriter.Descriptor = -1;
+	}
+}
+
+Bool Journal_ParseTime(const char *InStream, long long *OutTime)
+{ /*Takes "@seconds", "-30m" and the like, "YYYY-MM-DD [HH:MM[:SS]]", or "HH:MM[:SS]" for today.
+	* Gives back nanoseconds since the epoch.*/
+	const time_t Now = time(NULL);
+	struct tm TimeStruct;
+	unsigned long long Number = 0;
+	char Unit = 's', Extra;
+	int Matched, Year, Month, Day, Hour = 0, Minute = 0, Second = 0;
+	time_t Result;
+	
+	if (*InStream == '@' && AllNumeric(InStream + 1))
+	{
+		*OutTime = strtoll(InStream + 1, NULL, 10) * 1000000000LL;
+		return true;
+	}
+	
+	if (*InStream == '-')
+	{
+		Matched = sscanf(InStream + 1, "%llu%c%c", &Number, &Unit, &Extra);
+		
+		if (Matched < 1 || Matched > 2 || !isdigit((unsigned char)InStream[1])) return false;
+		
+		switch (Unit)
+		{
+			case 'd':
+				Number *= 24;
+				/*Fall through.*/
+			case 'h':
+				Number *= 60;
+				/*Fall through.*/
+			case 'm':
+				Number *= 60;
+				/*Fall through.*/
+			case 's':
+				break;
+			default:
+				return false;
+		}
+		
+		*OutTime = ((long long)Now - (long long)Number) * 1000000000LL;
+		return true;
+	}
+	
+	localtime_r(&Now, &TimeStruct);
+	
+	if (sscanf(InStream, "%d-%d-%d %d:%d:%d", &Year, &Month, &Day, &Hour, &Minute, &Second) >= 3)
+	{
+		TimeStruct.tm_year = Year - 1900;
+		TimeStruct.tm_mon = Month - 1;
+		TimeStruct.tm_mday = Day;
+	}
+	else if (sscanf(InStream, "%d:%d:%d", &Hour, &Minute, &Second) < 2) return false;
+	
+	TimeStruct.tm_hour = Hour;
+	TimeStruct.tm_min = Minute;
+	TimeStruct.tm_sec = Second;
+	TimeStruct.tm_isdst = -1;
+	
+	if ((Result = mktime(&TimeStruct)) == -1) return false;
+	
+	*OutTime = (long long)Result * 1000000000LL;
+	return true;
+}
+
+static void Journal_PrintRecord(const struct _JournalRecord *Record)
+{
+	const char *Name = (const char*)(Record + 1), *Text = Name + Record->NameLength;
+	const time_t Seconds = Record->Realtime / 1000000000;
+	struct tm TimeStruct;
+	
+	localtime_r(&Seconds, &TimeStruct);
+	
+	printf("[%02d:%02d:%02d | %02d-%02d-%02d] ", TimeStruct.tm_hour, TimeStruct.tm_min, TimeStruct.tm_sec,
+			TimeStruct.tm_year + 1900, TimeStruct.tm_mon + 1, TimeStruct.tm_mday);
+	
+	if (Record->NameLength) printf("%.*s: ", (int)Record->NameLength, Name);
+	
+	printf("%.*s\n", (int)(Record->Length - Record->NameLength), Text);
+}
+
+static unsigned long Journal_PrintSpan(const unsigned char *Map, uint64_t MapSize, uint64_t Offset, uint64_t Stop,
+										const char *ObjectID, long long Since, long long Until)
+{
+	const struct _JournalRecord *Record = NULL;
+	const size_t NameLength = ObjectID ? strlen(ObjectID) : 0;
+	const uint32_t Hash = ObjectID ? Journal_Hash(ObjectID, NameLength) : 0;
+	unsigned long Printed = 0;
+	
+	for (; Offset < Stop && (Record = Journal_RecordAt(Map, MapSize, Offset)) != NULL; Offset = Journal_NextOffset(Offset, Record))
+	{
+		if (Record->Type != JOURNAL_REC_LINE || Record->Realtime < Since || Record->Realtime > Until) continue;
+		
+		if (ObjectID && (Record->Object != Hash || Record->NameLength != NameLength ||
+			memcmp(Record + 1, ObjectID, NameLength) != 0))
+		{
+			continue;
+		}
+		
+		Journal_PrintRecord(Record);
+		++Printed;
+	}
+	
+	return Printed;
+}
+
+ReturnCode Journal_Print(const char *Path, const char *ObjectID, long long Since, long long Until)
+{ /*Prints matching records, oldest first. ObjectID may be NULL for everything.*/
+	const int Descriptor = open(Path, O_RDONLY | O_CLOEXEC);
+	const uint32_t Hash = ObjectID ? Journal_Hash(ObjectID, strlen(ObjectID)) : 0;
+	const struct _JournalHeader *Header = NULL;
+	const struct _JournalRecord *Record = NULL;
+	unsigned char *Map = NULL;
+	uint64_t *Spans = NULL, Offset, TailStart = sizeof(struct _JournalHeader);
+	unsigned NumSpans = 0, Capacity = 0;
+	struct stat FileStat;
+	
+	if (Descriptor == -1 || fstat(Descriptor, &FileStat) != 0 || FileStat.st_size < (off_t)sizeof(struct _JournalHeader) ||
+		(Map = mmap(NULL, FileStat.st_size, PROT_READ, MAP_SHARED, Descriptor, 0)) == MAP_FAILED)
+	{
+		fprintf(stderr, "Cannot read journal \"%s\".\n", Path);
+		if (Descriptor != -1) close(Descriptor);
+		return FAILURE;
+	}
+	
+	close(Descriptor);
+	Header = (const void*)Map;
+	
+	if (memcmp(Header->Magic, JOURNAL_MAGIC, sizeof Header->Magic) != 0 || Header->Version != JOURNAL_VERSION)
+	{
+		fprintf(stderr, "\"%s\" is not a journal this version of Epoch can read.\n", Path);
+		munmap(Map, FileStat.st_size);
+		return FAILURE;
+	}
+	
+	/*The index records chain backwards from the header. Collect them so we can go forwards.*/
+	for (Offset = Header->LastIndex; Offset && (Record = Journal_RecordAt(Map, FileStat.st_size, Offset)) != NULL &&
+		Record->Type == JOURNAL_REC_INDEX; Offset = ((const struct _JournalIndex*)(Record + 1))->Previous)
+	{
+		if (NumSpans == Capacity)
+		{
+			uint64_t *NewSpans = realloc(Spans, (Capacity = Capacity ? Capacity * 2 : 64) * sizeof *Spans);
+			
+			if (!NewSpans) break;
+			
+			Spans = NewSpans;
+		}
+		
+		if (!NumSpans) TailStart = Journal_NextOffset(Offset, Record);
+		
+		Spans[NumSpans++] = Offset;
+		
+		if (((const struct _JournalIndex*)(Record + 1))->Previous >= Offset) break; /*Damaged. Don't go round in circles.*/
+	}
+	
+	while (NumSpans--)
+	{
+		const struct _JournalIndex *Index = (const void*)(Map + Spans[NumSpans] + sizeof(struct _JournalRecord));
+		
+		if (Index->MaxTime < Since || Index->MinTime > Until) continue;
+		
+		if (ObjectID && !(Index->Objects[(Hash & 255) >> 3] & (1 << (Hash & 7)))) continue;
+		
+		Journal_PrintSpan(Map, FileStat.st_size, Index->SpanStart, Spans[NumSpans], ObjectID, Since, Until);
+	}
+	
+	/*Whatever came after the last index record, we have to look through.*/
+	Journal_PrintSpan(Map, FileStat.st_size, TailStart, FileStat.st_size, ObjectID, Since, Until);
+	
+	free(Spans);
+	munmap(Map, FileStat.st_size);
+	
+	return SUCCESS;
+}
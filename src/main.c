@@ -32,6 +32,7 @@ static ReturnCode ProcessGenericHalt(int argc, char **argv);
 static Bool __CmdIs(const char *CArg, const char *InCmd);
 static void PrintEpochHelp(const char *RootCommand, const char *InCmd);
 static ReturnCode HandleEpochCommand(int argc, char **argv);
+static void PrintObjectStatus(const struct _LSObjRecord *Record, const char *Strings, unsigned StringsSize, Bool UseColor);
 static void SigHandler(int Signal);
 static void SetDefaultProcessTitle(int argc, char **argv);
 static Bool KCmdLineObjCmd_Add(const char *ObjectID, Bool StartMode);
@@ -237,6 +238,11 @@ static void SigHandler(int Signal)
 			ErrorM = "Epoch has received an abort signal!";
 			break;
 		}
+		case SIGHUP: /*Someone rotated the log.*/
+		{
+			Log_Reopen();
+			return;
+		}
 		case SIGUSR2: /**We are init and being ordered to restart ourselves.**/
 		{
 			WriteLogLine(CONSOLE_COLOR_RED "Received SIGUSR2, reexecuting as requested." CONSOLE_ENDCOLOR, true);
@@ -294,12 +300,24 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		  "Wrapper for the 'shutdown' command. See 'shutdown --help' for more."
 		),
 		
-		( "[disable/enable] objectid:\n\t"
-		  "Enter disable or enable followed by an object ID to disable or enable\n\tthat object."
+		( "[disable/enable] objectid... [--runlevel runlevel]:\n\t"
+		  "Enter disable or enable followed by object IDs to disable or enable\n\tthose objects, "
+		  "or --runlevel for every object in that runlevel."
 		),
 		
-		( "[start/stop/restart] objectid:\n\t"
-		  "Enter start, stop, or restart followed by an object ID to control\n\tthat object."
+		( "[start/stop/restart] objectid... [--runlevel runlevel]:\n\t"
+		  "Enter start, stop, or restart followed by object IDs to control\n\tthose objects. "
+		  "--runlevel picks every object in a runlevel, that's enabled\n\tto start or running to stop. "
+		  "Restarting an object that isn't running starts it.\n\t"
+		  "Epoch gets them all at once, stops things that share a stop priority together,\n\t"
+		  "and starts things in start priority order."
+		),
+		
+		( "batch:\n\t"
+		
+		  "Reads lines like \"start objectid...\" or \"restart --runlevel runlevel\" from stdin,\n\t"
+		  "with start, stop, restart, enable or disable, and has Epoch do all of it as one job.\n\t"
+		  "An object named more than once is only touched once, so stopping and starting it restarts it."
 		),
 		
 		( "reload objectid:\n\t"
@@ -332,6 +350,40 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		  "to add or remove services, change runlevels, and more."
 		),
 		
+		( "configstats:\n\t"
+		
+		  "Shows how much memory the loaded configuration is using,\n\t"
+		  "and how many times it has been loaded."
+		),
+		
+		( "log [lines]:\n\t"
+		
+		  "Prints recent log lines from Epoch's memory, without reading the log file.\n\t"
+		  "Enter a number to see only that many lines."
+		),
+		
+		( "logs objectid [-f]:\n\t"
+		
+		  "Prints what an object with ObjectStdout=CAPTURE or ObjectStderr=CAPTURE\n\t"
+		  "has written recently. Add -f to keep printing new lines as they come."
+		),
+		
+		( "journal [--object objectid] [--since time] [--until time] [--file path]:\n\t"
+		
+		  "Prints records from the journal set by JournalPath, oldest first.\n\t"
+		  "Times can be \"YYYY-MM-DD [HH:MM[:SS]]\", \"HH:MM[:SS]\" for today,\n\t"
+		  "\"-30m\" and the like for a while ago, or \"@seconds\" since the epoch.\n\t"
+		  "--file reads a journal directly, without asking Epoch where it is."
+		),
+		
+		( "watch [objectid ...]:\n\t"
+		
+		  "Prints events as they happen, for the objects given or for all of them:\n\t"
+		  "STARTED, READY, FAILED, EXITED, RESTARTING and STOPPED, plus RUNLEVEL and RELOADED.\n\t"
+		  "OVERFLOW means we weren't reading fast enough and that many events were dropped.\n\t"
+		  "Needs the control socket, so it won't work during early boot."
+		),
+		
 		( "reexec:\n\t"
 		
 		  "Enter reeexec to partially restart Epoch from disk.\n\t"
@@ -371,7 +423,7 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		  "Prints the current version of the Epoch Init System."
 		)
 	};
-	enum { HCMD, SHTDN, ENDIS, STAP, REL, OBJRL, STATUS, SETCAD, CONFRL, REEXEC,
+	enum { HCMD, SHTDN, ENDIS, STAP, BATCHCMD, REL, OBJRL, STATUS, SETCAD, CONFRL, CONFSTATS, LOGCMD, LOGSCMD, JOURNALCMD, WATCHCMD, REEXEC,
 		RLCTL, GETPID, KILLOBJ, MERGECMD, VER, ENUM_MAX };
 	
 	printf("%s\nCompiled %s %s\n\n", VERSIONSTRING, __DATE__, __TIME__);
@@ -407,6 +459,11 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		printf("%s %s\n\n", RootCommand, HelpMsgs[STAP]);
 		return;
 	}
+	else if (!strcmp(InCmd, "batch"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[BATCHCMD]);
+		return;
+	}
 	else if (!strcmp(InCmd, "objrl"))
 	{
 		printf("%s %s\n\n", RootCommand, HelpMsgs[OBJRL]);
@@ -427,6 +484,31 @@ static void PrintEpochHelp(const char *RootCommand, const char *InCmd)
 		printf("%s %s\n\n", RootCommand, HelpMsgs[CONFRL]);
 		return;
 	}
+	else if (!strcmp(InCmd, "configstats"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[CONFSTATS]);
+		return;
+	}
+	else if (!strcmp(InCmd, "log"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[LOGCMD]);
+		return;
+	}
+	else if (!strcmp(InCmd, "logs"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[LOGSCMD]);
+		return;
+	}
+	else if (!strcmp(InCmd, "journal"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[JOURNALCMD]);
+		return;
+	}
+	else if (!strcmp(InCmd, "watch"))
+	{
+		printf("%s %s\n\n", RootCommand, HelpMsgs[WATCHCMD]);
+		return;
+	}
 	else if (!strcmp(InCmd, "reexec"))
 	{
 		printf("%s %s\n\n", RootCommand, HelpMsgs[REEXEC]);
@@ -545,6 +627,127 @@ static ReturnCode ProcessGenericHalt(int argc, char **argv)
 	return SUCCESS;
 }
 
+static void PrintObjectStatus(const struct _LSObjRecord *Record, const char *Strings, unsigned StringsSize, Bool UseColor)
+{ /*Prints one object from an LSOBJS reply. Strings is the reply's string table.*/
+	const char *const YN[2][3] = { { "No", "Yes", "N/A" },
+								{ CONSOLE_COLOR_RED "No" CONSOLE_ENDCOLOR,
+								CONSOLE_COLOR_GREEN "Yes" CONSOLE_ENDCOLOR,
+								CONSOLE_COLOR_YELLOW "N/A" CONSOLE_ENDCOLOR } };
+	const Bool HaltCmdOnly = (Record->Options >> COPT_HALTONLY) & 1, PivotRoot = (Record->Options >> COPT_PIVOTROOT) & 1;
+	const Bool Exec = (Record->Options >> COPT_EXEC) & 1;
+	const Bool NA = HaltCmdOnly || PivotRoot || Exec;
+	const unsigned ExtraOpts = Record->Options & ~((1u << COPT_HALTONLY) | (1u << COPT_FORKSCANONCE));
+	unsigned IDLength = Record->IDLength, DescriptionLength = Record->DescriptionLength, Inc = 0;
+	Bool OptNewline = false;
+	
+	/*Don't trust offsets that run off the end of the frame.*/
+	if (Record->IDOffset > StringsSize || IDLength > StringsSize - Record->IDOffset) IDLength = 0;
+	if (Record->DescriptionOffset > StringsSize || DescriptionLength > StringsSize - Record->DescriptionOffset) DescriptionLength = 0;
+	
+	printf("ObjectID: %.*s\nObjectDescription: %.*s\nEnabled: %s | Started: %s | Running: %s | Stop mode: ",
+			(int)IDLength, Strings + Record->IDOffset, (int)DescriptionLength, Strings + Record->DescriptionOffset,
+			YN[UseColor][Record->Enabled != 0], NA ? YN[UseColor][2] : YN[UseColor][Record->Started != 0],
+			NA ? YN[UseColor][2] : YN[UseColor][Record->Running != 0]);
+	
+	if (Record->StopMode == STOP_COMMAND) printf("Command");
+	else if (Record->StopMode == STOP_NONE) printf("None");
+	else if (Record->StopMode == STOP_PID) printf("PID");
+	else if (Record->StopMode == STOP_PIDFILE) printf("PID File");
+	
+	if (Record->Running)
+	{
+		printf(" | PID: %u\n", Record->PID);
+	}
+	else
+	{
+		putchar('\n');
+	}
+	
+	if (Record->Started)
+	{
+		time_t SS = (time_t)Record->StartedSince, CTime = time(NULL);
+		struct tm TStruct;
+		char TimeBuf[64] = { '\0' };
+		unsigned Offset = (CTime - Record->StartedSince) / 60;
+		localtime_r(&SS, &TStruct);
+		
+		asctime_r(&TStruct, TimeBuf);
+		
+		TimeBuf[strlen(TimeBuf) - 1] = '\0'; /*Nuke newline.*/
+		printf("Started since %s, for total of %u mins.\n", TimeBuf, Offset);
+	}
+	
+	if (ExtraOpts || HaltCmdOnly || Record->StopTimeout != 10 || Record->TermSignal != SIGTERM)
+	{
+		printf("Options:");
+		
+		if (ExtraOpts & (1u << COPT_SERVICE)) printf(" SERVICE");
+		if (ExtraOpts & (1u << COPT_AUTORESTART)) printf(" AUTORESTART");
+		if (HaltCmdOnly) printf(" HALTONLY");
+		if (ExtraOpts & (1u << COPT_PERSISTENT)) printf(" PERSISTENT");
+		if (ExtraOpts & (1u << COPT_FORCESHELL)) printf(" FORCESHELL");
+		if (ExtraOpts & (1u << COPT_FORK))
+		{
+			if (Record->Options & (1u << COPT_FORKSCANONCE)) printf(" FORKN");
+			else printf(" FORK");
+		}
+		if (ExtraOpts & (1u << COPT_RAWDESCRIPTION)) printf(" RAWDESCRIPTION");
+		if (Record->TermSignal != SIGTERM) printf(" TERMSIGNAL=%u", Record->TermSignal);
+		if (ExtraOpts & (1u << COPT_NOSTOPWAIT)) printf(" NOSTOPWAIT");
+		if (PivotRoot) printf(" PIVOT");
+		if (Exec) printf(" EXEC");
+		if (ExtraOpts & (1u << COPT_RUNONCE)) printf(" RUNONCE");
+		if (ExtraOpts & (1u << COPT_NOTRACK)) printf(" NOTRACK");
+		if (ExtraOpts & (1u << COPT_STARTFAILCRITICAL)) printf(" STARTFAILCRITICAL");
+		if (ExtraOpts & (1u << COPT_STOPFAILCRITICAL)) printf(" STOPFAILCRITICAL");
+		if (Record->StopTimeout != 10) printf(" STOPTIMEOUT=%u", Record->StopTimeout);
+		
+		OptNewline = true;
+	}
+	
+	/*Exit status mappings.*/
+	if (Record->NumExitMaps > 0) OptNewline = true;
+	
+	for (; Inc < Record->NumExitMaps && Inc < sizeof Record->ExitMaps / sizeof Record->ExitMaps[0]; ++Inc)
+	{
+		const char *Stringy = NULL;
+		const unsigned char Value = Record->ExitMaps[Inc][0], ExitStatus = Record->ExitMaps[Inc][1];
+		
+		if (Value == SUCCESS) Stringy = "SUCCESS";
+		else if (Value == WARNING) Stringy = "WARNING";
+		else if (Value == FAILURE) Stringy = "FAILURE";
+		else Stringy = "<BAD>";
+		
+		printf(" MAPEXITSTATUS=%d,%s", ExitStatus, Stringy);
+	}
+	
+	if (OptNewline) putchar('\n');
+	
+	if (Record->RLLength && !HaltCmdOnly && Record->RLOffset <= StringsSize &&
+		Record->RLLength <= StringsSize - Record->RLOffset)
+	{ /*Runlevels are back to back, each with its own NUL.*/
+		const char *Worker = Strings + Record->RLOffset, *const End = Worker + Record->RLLength;
+		
+		printf("Runlevels:");
+		
+		for (; Worker < End; Worker += strnlen(Worker, End - Worker) + 1)
+		{
+			printf(" %.*s", (int)strnlen(Worker, End - Worker), Worker);
+		}
+		
+		putchar('\n');
+	}
+	
+	if (Record->UserID || Record->GroupID)
+	{
+		struct passwd *UserStruct = getpwuid(Record->UserID);
+		struct group *GroupStruct = getgrgid(Record->GroupID);
+		
+		if (UserStruct) printf("User: %s\n", UserStruct->pw_name);
+		if (GroupStruct && Record->GroupID != 0) printf("Group: %s\n", GroupStruct->gr_name);
+	}
+}
+
 static ReturnCode HandleEpochCommand(int argc, char **argv)
 {
 	const char *CArg = argv[1];
@@ -635,9 +838,10 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		ShutdownMemBus(false);
 		while (shmget(MEMKEY, MEMBUS_SIZE, 0660) != -1) usleep(100); /*Wait for it to quit...*/
 		while (shmget(MEMKEY, MEMBUS_SIZE, 0660) == -1) usleep(100); /*Then wait for it to start...*/
+		UseControlSocket = false; /*It answers on the membus, before it has the socket back.*/
 		InitMemBus(false);
 
-		while (!MemBus_Read(InStream, false)) usleep(100);
+		while (!MemBus_Read(InStream, false)) MemBus_Wait(false);
 		
 		if (!strcmp(InStream, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_RXD))
 		{
@@ -677,7 +881,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 		
-		while (!MemBus_Read(TRecv, false)) usleep(1000);
+		while (!MemBus_Read(TRecv, false)) MemBus_Wait(false);
 		
 		snprintf(TBuf[0], sizeof TBuf[0], "%s %s", MEMBUS_CODE_ACKNOWLEDGED, MEMBUS_CODE_RESET);
 		snprintf(TBuf[1], sizeof TBuf[1], "%s %s", MEMBUS_CODE_FAILURE, MEMBUS_CODE_RESET);
@@ -712,290 +916,344 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 	}
-	else if (ArgIs("status") || ArgIs("statusnc"))
+	else if (ArgIs("configstats"))
+	{
+		char TRecv[MEMBUS_MSGSIZE];
+		struct _ConfigArenaStats Stats;
+		unsigned NumObjects = 0;
+		
+		if (argc > 2)
+		{
+			puts("Too many arguments.\n");
+			PrintEpochHelp(argv[0], "configstats");
+			return FAILURE;
+		}
+		
+		if (!InitMemBus(false))
+		{
+			return FAILURE;
+		}
+		
+		if (!MemBus_Write(MEMBUS_CODE_CFSTATS, false))
+		{
+			SpitError("Failed to write to membus.");
+			ShutdownMemBus(false);
+			return FAILURE;
+		}
+		
+		while (!MemBus_Read(TRecv, false)) MemBus_Wait(false);
+		
+		ShutdownMemBus(false);
+		
+		if (!strcmp(MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_CFSTATS, TRecv))
+		{
+			SpitError("We are being told that MEMBUS_CODE_CFSTATS is not a valid signal! Please report to Epoch.");
+			return FAILURE;
+		}
+		else if (sscanf(TRecv, MEMBUS_CODE_CFSTATS " %u %u %lu %lu %lu %u", &Stats.Generation, &Stats.NumBlocks,
+						&Stats.NumAllocs, &Stats.BytesUsed, &Stats.BytesReserved, &NumObjects) != 6)
+		{
+			SpitError("Unknown response received! Can't handle this! Report to Epoch please!");
+			return FAILURE;
+		}
+		
+		printf("Configuration generation: %u\n"
+				"Objects: %u\n"
+				"Allocations: %lu\n"
+				"Bytes used: %lu\n"
+				"Bytes reserved: %lu in %u blocks\n",
+				Stats.Generation, NumObjects, Stats.NumAllocs, Stats.BytesUsed, Stats.BytesReserved, Stats.NumBlocks);
+		
+		return SUCCESS;
+	}
+	else if (ArgIs("log"))
 	{
 		char OutBuf[MEMBUS_MSGSIZE], InBuf[MEMBUS_MSGSIZE];
-		char *Worker = NULL;
-		const char *const YN[2][3] = { { "No", "Yes", "N/A" },
-									{ CONSOLE_COLOR_RED "No" CONSOLE_ENDCOLOR,
-									CONSOLE_COLOR_GREEN "Yes" CONSOLE_ENDCOLOR,
-									CONSOLE_COLOR_YELLOW "N/A" CONSOLE_ENDCOLOR } };
-		unsigned Inc = 2;
-		int Stopper = argc > 2 ? argc : 3;
-		const Bool UseColor = ArgIs("status");
+		
+		if (argc > 3 || (argc == 3 && !AllNumeric(argv[2])))
+		{
+			puts("Bad arguments.\n");
+			PrintEpochHelp(argv[0], "log");
+			return FAILURE;
+		}
 		
 		if (!InitMemBus(false))
 		{
 			return FAILURE;
 		}
 		
-		for (; Inc < Stopper; ++Inc)
+		snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_LOGTAIL, argc == 3 ? argv[2] : "0");
+		
+		if (!MemBus_Write(OutBuf, false))
 		{
+			SpitError("Failed to write to membus.");
+			ShutdownMemBus(false);
+			return FAILURE;
+		}
+		
+		while (1)
+		{
+			while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 			
-			/*Send the activation code.*/
-			if (argc > 2)
+			if (!strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LOGTAIL)) break;
+			
+			if (strncmp(InBuf, MEMBUS_CODE_LOGTAIL " ", strlen(MEMBUS_CODE_LOGTAIL " ")) != 0)
 			{
-				snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_LSOBJS, argv[Inc]);
+				SpitError("We are being told that MEMBUS_CODE_LOGTAIL is not a valid signal! Please report to Epoch.");
+				ShutdownMemBus(false);
+				return FAILURE;
 			}
-			else
+			
+			fputs(InBuf + strlen(MEMBUS_CODE_LOGTAIL " "), stdout);
+		}
+		
+		ShutdownMemBus(false);
+		return SUCCESS;
+	}
+	else if (ArgIs("logs"))
+	{
+		char OutBuf[MEMBUS_MSGSIZE], InBuf[MEMBUS_MSGSIZE];
+		const Bool Follow = argc == 4 && !strcmp(argv[3], "-f");
+		unsigned long long Pos = 0;
+		
+		if (argc < 3 || (argc == 4 && !Follow) || argc > 4)
+		{
+			puts("Bad arguments.\n");
+			PrintEpochHelp(argv[0], "logs");
+			return FAILURE;
+		}
+		
+		do
+		{ /*Following means asking again every so often, from where we got to.*/
+			if (!InitMemBus(false))
 			{
-				strncpy(OutBuf, MEMBUS_CODE_LSOBJS, strlen(MEMBUS_CODE_LSOBJS) + 1);
+				return FAILURE;
 			}
 			
-			MemBus_Write(OutBuf, false);
+			snprintf(OutBuf, sizeof OutBuf, "%s %s %llu", MEMBUS_CODE_OBJLOGS, argv[2], Pos);
 			
-			while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-	
-			if (!strcmp(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS, InBuf))
+			if (!MemBus_Write(OutBuf, false))
 			{
-				puts(argc < 3 ? "No objects found!" : "Specified object not found.");
+				SpitError("Failed to write to membus.");
 				ShutdownMemBus(false);
 				return FAILURE;
 			}
 			
-			while (strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS) != 0)
+			while (1)
 			{
-				Bool FoundRL = false;
-				unsigned PID = 0;
-				Bool Started = false, Running = false, Enabled = false, PivotRoot = false, Persistent = false, Exec = false;
-				enum _StopMode StopMode;
-				unsigned char TermSignal = 0, ReloadCommandSignal = 0, *BinWorker = NULL;
-				unsigned StartedSince, UserID, GroupID, Inc = 0, StopTimeout;
-				Bool HaltCmdOnly = false, IsService = false, AutoRestart = false, NoStopWait = false, NoTrack = false;
-				Bool ForceShell = false, RawDescription = false, Fork = false, RunOnce = false, ForkScanOnce = false;
-				Bool StartFailIsCritical = false, StopFailIsCritical = false, OptNewline = false;
-				char RLExpect[MEMBUS_MSGSIZE], ObjectID[MAX_DESCRIPT_SIZE], ObjectDescription[MAX_DESCRIPT_SIZE];
-				
-				Worker = InBuf + strlen(MEMBUS_CODE_LSOBJS " ");
+				while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 				
-				/*Version matters.*/
-				if (strncmp(Worker, MEMBUS_LSOBJS_VERSION, strlen(MEMBUS_LSOBJS_VERSION)) != 0)
+				if (!strncmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_OBJLOGS " ",
+							strlen(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_OBJLOGS " ")))
 				{
-					SpitError("LSOBJS protocol version mismatch. Expected \"" MEMBUS_LSOBJS_VERSION "\".");
-					
-					while (strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS) != 0)
-					{ /*Don't mess up the membus, let it empty.*/
-						while (!MemBus_Read(InBuf, false)) usleep(10);
-					}
-					
+					Pos = strtoull(InBuf + strlen(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_OBJLOGS " "), NULL, 10);
+					break;
+				}
+				else if (!strcmp(InBuf, MEMBUS_CODE_FAILURE " " MEMBUS_CODE_OBJLOGS))
+				{
+					fprintf(stderr, "Object %s does not exist.\n", argv[2]);
 					ShutdownMemBus(false);
 					return FAILURE;
 				}
-				
-				Worker += strlen(MEMBUS_LSOBJS_VERSION) + 1;
-				
-				BinWorker = (void*)Worker;
-				
-				Started = *BinWorker++;
-				Running = *BinWorker++;
-				Enabled = *BinWorker++;
-				TermSignal = *BinWorker++;
-				ReloadCommandSignal = *BinWorker++;
-	
-				/*Remove this line when we make use of ReloadCommandSignal.*/
-				(void)ReloadCommandSignal;
-				
-				memcpy(&UserID, BinWorker, sizeof(int));
-				memcpy(&GroupID, (BinWorker += sizeof(int)), sizeof(int));
-				
-				memcpy(&StopMode, (BinWorker += sizeof(int)), sizeof(enum _StopMode));
-				memcpy(&PID, (BinWorker += sizeof(enum _StopMode)), sizeof(int));
-				
-				memcpy(&StartedSince, (BinWorker += sizeof(int)), sizeof(int));
-				memcpy(&StopTimeout, BinWorker + sizeof(int), sizeof(int));
-	
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				
-				for (Worker = InBuf, Inc = 0; Worker[Inc] != ' '; ++Inc)
-				{ /*Get ObjectID*/
-					ObjectID[Inc] = Worker[Inc];
-				}
-				ObjectID[Inc] = '\0';
-				
-				Worker += Inc + 1;
-				
-				/*Get ObjectDescription.*/
-				strncpy(ObjectDescription, Worker, strlen(Worker) + 1);
-				
-				/*Retrieve the options.*/
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				
-				for (Worker = InBuf; *Worker != 0; ++Worker)
+				else if (strncmp(InBuf, MEMBUS_CODE_OBJLOGS " ", strlen(MEMBUS_CODE_OBJLOGS " ")) != 0)
 				{
-					if (*(unsigned char*)Worker >= COPT_MAX) continue; /*If we don't understand.*/
-	
-					switch (*(unsigned char*)Worker)
-					{
-						case COPT_HALTONLY:
-							HaltCmdOnly = true;
-							break;
-						case COPT_PERSISTENT:
-							Persistent = true;
-							break;
-						case COPT_FORK:
-							Fork = true;
-							break;
-						case COPT_FORKSCANONCE:
-							ForkScanOnce = true;
-							break;
-						case COPT_SERVICE:
-							IsService = true;
-							break;
-						case COPT_RAWDESCRIPTION:
-							RawDescription = true;
-							break;
-						case COPT_AUTORESTART:
-							AutoRestart = true;
-							break;
-						case COPT_FORCESHELL:
-							ForceShell = true;
-							break;
-						case COPT_NOSTOPWAIT:
-							NoStopWait = true;
-							break;
-						case COPT_NOTRACK:
-							NoTrack = true;
-							break;
-						case COPT_STARTFAILCRITICAL:
-							StartFailIsCritical = true;
-							break;
-						case COPT_STOPFAILCRITICAL:
-							StopFailIsCritical = true;
-							break;
-						case COPT_EXEC:
-							Exec = true;
-							break;
-						case COPT_PIVOTROOT:
-							PivotRoot = true;
-							break; 
-						case COPT_RUNONCE:
-							RunOnce = true;
-							break;
-						default:
-							break;
-					}
+					SpitError("We are being told that MEMBUS_CODE_OBJLOGS is not a valid signal! Please report to Epoch.");
+					ShutdownMemBus(false);
+					return FAILURE;
 				}
+				
+				fputs(InBuf + strlen(MEMBUS_CODE_OBJLOGS " "), stdout);
+			}
 			
+			fflush(stdout);
+			ShutdownMemBus(false);
 			
-				printf("ObjectID: %s\nObjectDescription: %s\nEnabled: %s | Started: %s | Running: %s | Stop mode: ",
-						ObjectID, ObjectDescription, YN[UseColor][Enabled],
-						HaltCmdOnly || PivotRoot || Exec ? YN[UseColor][2] : YN[UseColor][Started],
-						HaltCmdOnly || PivotRoot || Exec ? YN[UseColor][2] : YN[UseColor][Running]);
-				
-				if (StopMode == STOP_COMMAND) printf("Command");
-				else if (StopMode == STOP_NONE) printf("None");
-				else if (StopMode == STOP_PID) printf("PID");
-				else if (StopMode == STOP_PIDFILE) printf("PID File");
-				
-				if (Running)
+			if (Follow) usleep(500000);
+		} while (Follow);
+		
+		return SUCCESS;
+	}
+	else if (ArgIs("watch"))
+	{
+		char OutBuf[MEMBUS_MSGSIZE], InBuf[MEMBUS_MSGSIZE];
+		size_t Length = strlen(MEMBUS_CODE_WATCH);
+		int Inc = 2;
+		
+		if (!InitMemBus(false))
+		{
+			return FAILURE;
+		}
+		
+		if (!MemBus.OverSocket)
+		{
+			SpitError("Epoch's control socket isn't up, and the membus can't carry events.");
+			ShutdownMemBus(false);
+			return FAILURE;
+		}
+		
+		memcpy(OutBuf, MEMBUS_CODE_WATCH, Length + 1);
+		
+		for (; Inc < argc && Length + strlen(argv[Inc]) + 1 < sizeof OutBuf; ++Inc)
+		{
+			Length += snprintf(OutBuf + Length, sizeof OutBuf - Length, " %s", argv[Inc]);
+		}
+		
+		MemBus_Write(OutBuf, false);
+		
+		while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
+		
+		if (strcmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_WATCH) != 0)
+		{
+			SpitError("Epoch refused to send us events.");
+			ShutdownMemBus(false);
+			return FAILURE;
+		}
+		
+		while (1)
+		{ /*Until Epoch goes away, or we're killed.*/
+			while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
+			
+			if (strncmp(InBuf, MEMBUS_CODE_EVENT " ", strlen(MEMBUS_CODE_EVENT " ")) != 0) continue;
+			
+			puts(InBuf + strlen(MEMBUS_CODE_EVENT " "));
+			fflush(stdout);
+		}
+	}
+	else if (ArgIs("journal"))
+	{
+		char OutBuf[MEMBUS_MSGSIZE], InBuf[MEMBUS_MSGSIZE];
+		const char *ObjectID = NULL, *Path = NULL;
+		long long Since = 0, Until = 0x7fffffffffffffffLL;
+		int Inc = 2;
+		
+		for (; Inc < argc; Inc += 2)
+		{
+			Bool Good = Inc + 1 < argc;
+			
+			if (Good && !strcmp(argv[Inc], "--object")) ObjectID = argv[Inc + 1];
+			else if (Good && !strcmp(argv[Inc], "--file")) Path = argv[Inc + 1];
+			else if (Good && !strcmp(argv[Inc], "--since")) Good = Journal_ParseTime(argv[Inc + 1], &Since);
+			else if (Good && !strcmp(argv[Inc], "--until")) Good = Journal_ParseTime(argv[Inc + 1], &Until);
+			else Good = false;
+			
+			if (!Good)
+			{
+				puts("Bad arguments.\n");
+				PrintEpochHelp(argv[0], "journal");
+				return FAILURE;
+			}
+		}
+		
+		if (!Path)
+		{
+			if (!InitMemBus(false))
+			{
+				return FAILURE;
+			}
+			
+			snprintf(OutBuf, sizeof OutBuf, "%s", MEMBUS_CODE_JOURNAL);
+			
+			if (!MemBus_Write(OutBuf, false))
+			{
+				SpitError("Failed to write to membus.");
+				ShutdownMemBus(false);
+				return FAILURE;
+			}
+			
+			while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
+			
+			ShutdownMemBus(false);
+			
+			if (!strcmp(InBuf, MEMBUS_CODE_FAILURE " " MEMBUS_CODE_JOURNAL))
+			{
+				fputs("The journal is not enabled. Set JournalPath in the configuration.\n", stderr);
+				return FAILURE;
+			}
+			else if (strncmp(InBuf, MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_JOURNAL " ",
+							strlen(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_JOURNAL " ")) != 0)
+			{
+				SpitError("We are being told that MEMBUS_CODE_JOURNAL is not a valid signal! Please report to Epoch.");
+				return FAILURE;
+			}
+			
+			Path = InBuf + strlen(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_JOURNAL " ");
+		}
+		
+		return Journal_Print(Path, ObjectID, Since, Until);
+	}
+	else if (ArgIs("status") || ArgIs("statusnc"))
+	{
+		const unsigned HeaderSize = sizeof MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION + sizeof(unsigned);
+		char OutBuf[MEMBUS_MSGSIZE], *Reply = NULL;
+		struct _LSObjRecord Record;
+		unsigned Inc = 2, ReplySize = 0, NumRecords = 0, RecInc = 0;
+		int Stopper = argc > 2 ? argc : 3;
+		const Bool UseColor = ArgIs("status");
+		
+		if (!InitMemBus(false))
+		{
+			return FAILURE;
+		}
+		
+		for (; Inc < Stopper; ++Inc)
+		{
+			
+			/*Send the activation code.*/
+			if (argc > 2)
+			{
+				snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_LSOBJS, argv[Inc]);
+			}
+			else
+			{
+				strncpy(OutBuf, MEMBUS_CODE_LSOBJS, strlen(MEMBUS_CODE_LSOBJS) + 1);
+			}
+			
+			MemBus_Write(OutBuf, false);
+			
+			if (!(Reply = MemBus_ReadLong(&ReplySize, false)))
+			{
+				SpitError("Failed to read the object list from Epoch.");
+				ShutdownMemBus(false);
+				return FAILURE;
+			}
+			
+			/*Version matters.*/
+			if (ReplySize < HeaderSize ||
+				memcmp(Reply, MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION, sizeof MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION) != 0)
+			{
+				if (!strcmp(Reply, MEMBUS_CODE_FAILURE " " MEMBUS_CODE_LSOBJS))
 				{
-					printf(" | PID: %u\n", PID);
+					SpitError("Epoch failed to list the objects.");
 				}
 				else
 				{
-					putchar('\n');
-				}
-				
-				if (Started)
-				{
-					time_t SS = (time_t)StartedSince, CTime = time(NULL);
-					struct tm TStruct;
-					char TimeBuf[64] = { '\0' };
-					unsigned Offset = (CTime - StartedSince) / 60;
-					localtime_r(&SS, &TStruct);
-					
-					asctime_r(&TStruct, TimeBuf);
-					
-					TimeBuf[strlen(TimeBuf) - 1] = '\0'; /*Nuke newline.*/
-					printf("Started since %s, for total of %u mins.\n", TimeBuf, Offset);
-				}
-				
-				if (IsService || AutoRestart || HaltCmdOnly || Persistent || Fork || StopTimeout != 10 || NoTrack ||
-					ForceShell || RawDescription || NoStopWait || PivotRoot || RunOnce || TermSignal != SIGTERM || Exec ||
-					StartFailIsCritical || StopFailIsCritical)
-				{
-					printf("Options:");
-					
-					if (IsService) printf(" SERVICE");
-					if (AutoRestart) printf(" AUTORESTART");
-					if (HaltCmdOnly) printf(" HALTONLY");
-					if (Persistent) printf(" PERSISTENT");
-					if (ForceShell) printf(" FORCESHELL");
-					if (Fork)
-					{
-						if (ForkScanOnce) printf(" FORKN");
-						else printf(" FORK");
-					}
-					if (RawDescription) printf(" RAWDESCRIPTION");
-					if (TermSignal != SIGTERM) printf(" TERMSIGNAL=%u", TermSignal);
-					if (NoStopWait) printf(" NOSTOPWAIT");
-					if (PivotRoot) printf(" PIVOT");
-					if (Exec) printf(" EXEC");
-					if (RunOnce) printf(" RUNONCE");
-					if (NoTrack) printf(" NOTRACK");
-					if (StartFailIsCritical) printf( "STARTFAILCRITICAL");
-					if (StopFailIsCritical) printf( "STOPFAILCRITICAL");
-					if (StopTimeout != 10) printf(" STOPTIMEOUT=%u", StopTimeout);
-					
-					OptNewline = true;
-				}
-	
-				/*Get exit status mappings.*/
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-	
-				BinWorker = (void*)(InBuf + sizeof MEMBUS_CODE_LSOBJS " MXS");
-				Inc = *BinWorker++; /*Get the count.*/
-				
-				if (Inc > 0) OptNewline = true;
-				
-				for (; Inc; --Inc)
-				{
-					const char *Stringy = NULL;
-					unsigned char Value = *BinWorker++, ExitStatus = *BinWorker++;
-					
-					if (Value == SUCCESS) Stringy = "SUCCESS";
-					else if (Value == WARNING) Stringy = "WARNING";
-					else if (Value == FAILURE) Stringy = "FAILURE";
-					else Stringy = "<BAD>";
-					
-					printf(" MAPEXITSTATUS=%d,%s", ExitStatus, Stringy);
+					SpitError("LSOBJS protocol version mismatch. Expected \"" MEMBUS_LSOBJS_VERSION "\".");
 				}
 				
-				if (OptNewline) putchar('\n');
-				
-				snprintf(RLExpect, sizeof RLExpect, "%s %s %s", MEMBUS_CODE_LSOBJS, MEMBUS_LSOBJS_VERSION, ObjectID);
-				
-				/*Done with this, now read runlevels.*/
-				while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				
-				while (!strncmp(InBuf, RLExpect, strlen(RLExpect)))
-				{ /*Also causes the next object to be read.*/
-					if (!FoundRL && !HaltCmdOnly)
-					{
-						printf("Runlevels:");
-						FoundRL = true;
-					}
-					
-					Worker = InBuf + strlen(MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION " ") + strlen(ObjectID) + 1;
-					
-					if (!HaltCmdOnly)
-					{
-						printf(" %s", Worker);
-					}
-					
-					while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, false)) usleep(100);
-				}
+				free(Reply);
+				ShutdownMemBus(false);
+				return FAILURE;
+			}
+			
+			memcpy(&NumRecords, Reply + sizeof MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION, sizeof(unsigned));
+			
+			if (NumRecords > (ReplySize - HeaderSize) / sizeof Record) NumRecords = 0; /*Garbage.*/
+			
+			if (NumRecords == 0)
+			{
+				puts(argc < 3 ? "No objects found!" : "Specified object not found.");
+				free(Reply);
+				ShutdownMemBus(false);
+				return FAILURE;
+			}
+			
+			for (RecInc = 0; RecInc < NumRecords; ++RecInc)
+			{
+				const unsigned StringsStart = HeaderSize + NumRecords * sizeof Record;
 				
-				if (FoundRL) putchar('\n');
+				memcpy(&Record, Reply + HeaderSize + RecInc * sizeof Record, sizeof Record);
 				
-				if (UserID || GroupID)
-				{
-					struct passwd *UserStruct = getpwuid(UserID);
-					struct group *GroupStruct = getgrgid(GroupID);
-					
-					if (UserStruct) printf("User: %s\n", UserStruct->pw_name);
-					if (GroupStruct && GroupID != 0) printf("Group: %s\n", GroupStruct->gr_name);
-				}
+				PrintObjectStatus(&Record, Reply + StringsStart, ReplySize - StringsStart, UseColor);
 				
 				if (argc == 2)
 				{
@@ -1003,6 +1261,8 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 				}
 			}
 			
+			free(Reply);
+			
 			if (argc > 3)
 			{
 				puts("-------");
@@ -1032,7 +1292,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		{
 			MemBus_Write(MEMBUS_CODE_GETRL, false);
 			
-			while (!MemBus_Read(InBuf, false)) usleep(1000);
+			while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 			
 			if (!strcmp(MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_GETRL, InBuf))
 			{
@@ -1062,7 +1322,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			
 			MemBus_Write(OutBuf, false);
 			
-			while (!MemBus_Read(InBuf, false)) usleep(1000);
+			while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 			
 			if (!strcmp(PossibleResponses[0], InBuf))
 			{
@@ -1137,7 +1397,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 		
-		while (!MemBus_Read(Msg, false)) usleep(1000);
+		while (!MemBus_Read(Msg, false)) MemBus_Wait(false);
 		
 		ShutdownMemBus(false); //We're done with membus now.
 		
@@ -1228,114 +1488,100 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		ShutdownMemBus(false);
 		return RetVal;
 	}
-	else if (ArgIs("enable") || ArgIs("disable"))
-	{
-		ReturnCode RV = SUCCESS;
-		Bool Enabling = ArgIs("enable");
-		char TOut[MAX_LINE_SIZE];
-		unsigned Inc = 2;
+	else if (ArgIs("start") || ArgIs("stop") || ArgIs("restart") || ArgIs("enable") || ArgIs("disable"))
+	{ /*However many objects there are, it's one BATCH, so one trip to Epoch.*/
+		const char *const Verb = CArg;
+		size_t Size = sizeof MEMBUS_CODE_BATCH;
+		char *Script = NULL, *Worker = NULL;
+		ReturnCode RV = FAILURE;
+		int Inc = 2;
 		
 		if (argc < 3)
 		{
-
 			puts("Too few arguments.\n");
 			
-			PrintEpochHelp(argv[0], "enable");
+			PrintEpochHelp(argv[0], Verb);
 			return FAILURE;
 		}
 		
-		if (!InitMemBus(false))
+		for (; Inc < argc; ++Inc) Size += strlen(Verb) + strlen(argv[Inc]) + 2;
+		
+		if (!(Script = Worker = malloc(Size)))
 		{
-			
+			SpitError("Out of memory.");
 			return FAILURE;
 		}
 		
-		/*Iterate through all specified objects.*/
+		Worker += sprintf(Worker, "%s", MEMBUS_CODE_BATCH);
+		
 		for (Inc = 2; Inc < argc; ++Inc)
 		{
-			snprintf(TOut, sizeof TOut, (Enabling ? "Enabling %s" : "Disabling %s"), argv[Inc]);
-			BeginStatusReport(TOut);
+			if (strcmp(argv[Inc], "--runlevel") != 0)
+			{
+				Worker += sprintf(Worker, "\n%s %s", Verb, argv[Inc]);
+				continue;
+			}
+			
+			if (++Inc == argc)
+			{
+				puts("--runlevel needs a runlevel after it.\n");
+				
+				PrintEpochHelp(argv[0], Verb);
+				free(Script);
+				return FAILURE;
+			}
 			
-			RV = ObjControl(argv[Inc], (Enabling ? MEMBUS_CODE_OBJENABLE : MEMBUS_CODE_OBJDISABLE));
-			CompleteStatusReport(TOut, RV, false);
+			Worker += sprintf(Worker, "\n%s --runlevel %s", Verb, argv[Inc]);
 		}
 		
-		ShutdownMemBus(false);
+		if (InitMemBus(false))
+		{
+			RV = ObjControl_Batch(Script);
+			ShutdownMemBus(false);
+		}
+		
+		free(Script);
 		return RV;
 	}
-	else if (ArgIs("start") || ArgIs("stop") || ArgIs("restart"))
-	{
-		ReturnCode RV = SUCCESS;
-		short StartMode = 0;
-		enum { START = 1, STOP, RESTART };
-		char TOut[MAX_LINE_SIZE];
-		unsigned Inc = 2;
-
-		if (argc < 3)
+	else if (ArgIs("batch"))
+	{ /*The same thing, from a script on stdin.*/
+		size_t Size = strlen(MEMBUS_CODE_BATCH "\n"), Capacity = 4096, Got;
+		char *Script = malloc(Capacity), *NewScript = NULL;
+		ReturnCode RV = FAILURE;
+		
+		if (!Script)
 		{
-			puts("Too few arguments.\n");
-			
-			PrintEpochHelp(argv[0], "start");
+			SpitError("Out of memory.");
 			return FAILURE;
 		}
-
-		if (!InitMemBus(false))
+		
+		memcpy(Script, MEMBUS_CODE_BATCH "\n", Size);
+		
+		while ((Got = fread(Script + Size, 1, Capacity - Size - 1, stdin)) > 0)
 		{
+			if ((Size += Got) < Capacity - 1) continue;
 			
-			return FAILURE;
+			if (Capacity >= MEMBUS_LONGMSG_MAX || !(NewScript = realloc(Script, Capacity * 2)))
+			{
+				SpitError("That script is too big.");
+				free(Script);
+				return FAILURE;
+			}
+			
+			Script = NewScript;
+			Capacity *= 2;
 		}
 		
-		if (ArgIs("start"))
-		{
-			StartMode = START;
-		}
-		else if (ArgIs("stop"))
-		{
-			StartMode = STOP;
-		}
-		else
-		{
-			StartMode = RESTART;
-		}
+		Script[Size] = '\0';
 		
-		/*Iterate through all provided arguments.*/
-		for (Inc = 2; Inc < argc; ++Inc)
+		if (InitMemBus(false))
 		{
-			if (StartMode < RESTART)
-			{
-				const char *ActionString = StartMode == START ? "Starting" : "Stopping";
-				
-				snprintf(TOut, sizeof TOut, "%s %s", ActionString, argv[Inc]);
-				BeginStatusReport(TOut);
-				
-				RV = ObjControl(argv[Inc], (StartMode == START ? MEMBUS_CODE_OBJSTART : MEMBUS_CODE_OBJSTOP));
-				
-				CompleteStatusReport(TOut, RV, false);
-			}
-			else
-			{
-				snprintf(TOut, sizeof TOut, "Stopping %s", argv[Inc]);
-				
-				BeginStatusReport(TOut);
-				RV = ObjControl(argv[Inc], MEMBUS_CODE_OBJSTOP);
-				CompleteStatusReport(TOut, RV, false);
-				
-				if (!RV)
-				{ /*Stop failed so...*/
-					continue;
-				}
-				
-				snprintf(TOut, sizeof TOut, "Starting %s", argv[Inc]);
-				
-				BeginStatusReport(TOut);
-				RV = ObjControl(argv[Inc], MEMBUS_CODE_OBJSTART);
-				CompleteStatusReport(TOut, RV, false);
-			}	
+			RV = ObjControl_Batch(Script);
+			ShutdownMemBus(false);
 		}
 		
-		/*Now that we're done, shut down the membus.*/
-		ShutdownMemBus(false);
-		return SUCCESS;
+		free(Script);
+		return RV;
 	}
 	else if (ArgIs("reload"))
 	{
@@ -1373,7 +1619,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			
 			MemBus_Write(OutBuf, false);
 			
-			while (!MemBus_Read(InBuf, false)) usleep(1000);
+			while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 			
 			if (!strcmp(InBuf, PossibleResponses[0]))
 			{
@@ -1443,7 +1689,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		
 		MemBus_Write(OutBuf, false);
 		
-		while (!MemBus_Read(InBuf, false)) usleep(1000);
+		while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 		
 		if (!strncmp(InBuf, PossibleResponses[0], strlen(PossibleResponses[0])))
 		{
@@ -1501,7 +1747,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 		
 		MemBus_Write(OutBuf, false);
 		
-		while (!MemBus_Read(InBuf, false)) usleep(1000);
+		while (!MemBus_Read(InBuf, false)) MemBus_Wait(false);
 		
 		if (!strcmp(InBuf, PossibleResponses[0]))
 		{
@@ -1584,7 +1830,7 @@ static ReturnCode HandleEpochCommand(int argc, char **argv)
 			return FAILURE;
 		}
 		
-		while (!MemBus_Read(IBuf, false)) usleep(1000);
+		while (!MemBus_Read(IBuf, false)) MemBus_Wait(false);
 		
 		if (ArgIs("add") || ArgIs("del"))
 		{	
@@ -1784,6 +2030,7 @@ int main(int argc, char **argv)
 		}
 		
 		signal(SIGUSR2, SigHandler); /**If we receive this, we reexecute. Mostly in case something is wrong.**/
+		signal(SIGHUP, SigHandler); /*Reopens the log file.*/
 		
 		const char *TRunlevel = NoKArgs ? NULL : getenv("runlevel");
 		
@@ -1908,7 +2155,7 @@ int main(int argc, char **argv)
 				return 1;
 			}
 			
-			while (!MemBus_Read(MembusResponse, false)) usleep(1000);
+			while (!MemBus_Read(MembusResponse, false)) MemBus_Wait(false);
 			
 			if (!strcmp(MembusResponse, PossibleResponses[0]))
 			{
@@ -14,11 +14,18 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/reboot.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
 #include <time.h>
+#include <poll.h>
 #include "epoch.h"
 
 /*Memory bus globals.*/
@@ -26,19 +33,203 @@
 struct _MemBusInterface MemBus;
 
 Bool BusRunning;
+Bool UseControlSocket = true; /*Clients try the control socket before the membus.*/
 int MemBusKey = MEMKEY;
 int MemDescriptor;
 
+/*Slots whose clients asked for a reload that's still being parsed in the background. One bit each.*/
+static unsigned ReloadReplySlots;
+static Bool *SocketReloadPending; /*The same, for the control socket connection being served. See Control_ReloadDone().*/
+
+/*The status words are shared with another process, so no FUTEX_PRIVATE_FLAG.*/
+static unsigned MemBus_GetStatus(unsigned *Status)
+{
+	return __atomic_load_n(Status, __ATOMIC_SEQ_CST);
+}
+
+static void MemBus_SetStatus(unsigned *Status, unsigned Value)
+{ /*Every change of state wakes whoever is sleeping on the word.*/
+	__atomic_store_n(Status, Value, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, Status, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void MemBus_Sleep(unsigned *Status, unsigned Value, unsigned Milliseconds)
+{ /*Sleep while the word still reads Value. Returns early on a wake, a change, or a signal.*/
+	struct timespec Timeout = { Milliseconds / 1000, (Milliseconds % 1000) * 1000000L };
+	
+	syscall(SYS_futex, Status, FUTEX_WAIT, Value, &Timeout, NULL, 0);
+}
+
+static Bool MemBus_SleepUntil(unsigned *Status, unsigned Value, unsigned Milliseconds)
+{ /*Returns false if the word still doesn't read Value after Milliseconds.*/
+	struct timespec Now, Deadline;
+	unsigned Current;
+	long Remaining;
+	
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+	Deadline.tv_sec += Milliseconds / 1000;
+	Deadline.tv_nsec += (Milliseconds % 1000) * 1000000L;
+	
+	if (Deadline.tv_nsec >= 1000000000L)
+	{
+		++Deadline.tv_sec;
+		Deadline.tv_nsec -= 1000000000L;
+	}
+	
+	while ((Current = MemBus_GetStatus(Status)) != Value)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &Now);
+		Remaining = (Deadline.tv_sec - Now.tv_sec) * 1000 + (Deadline.tv_nsec - Now.tv_nsec) / 1000000;
+		
+		if (Remaining <= 0) return false;
+		
+		MemBus_Sleep(Status, Current, Remaining);
+	}
+	
+	return true;
+}
+
+static void MemBus_Select(unsigned Slot)
+{ /*Aim MemBus.Server and MemBus.Client at one client's slot. Everything else works on whichever is selected.*/
+	char *const Base = (char*)MemBus.Root + sizeof(long) * 2 + Slot * MEMBUS_SLOTSIZE;
+	
+	MemBus.Slot = Slot;
+	
+	/*Status.*/
+	MemBus.LockPID = (unsigned long*)Base;
+	MemBus.LockTime = (unsigned long*)(Base + sizeof(long));
+	
+	/*Server side. Both halves start on a long boundary, so the status words are aligned.*/
+	MemBus.Server.Status = (unsigned*)(Base + sizeof(long) * 2);
+	MemBus.Server.BinMessage = (unsigned char*)(MemBus.Server.Status + 1);
+	MemBus.Server.Message = (char*)MemBus.Server.BinMessage;
+	
+	/*Client side.*/
+	MemBus.Client.Status = (unsigned*)(Base + sizeof(long) * 2 + MEMBUS_SIZE/2);
+	MemBus.Client.BinMessage = (unsigned char*)(MemBus.Client.Status + 1);
+	MemBus.Client.Message = (char*)MemBus.Client.BinMessage;
+}
+
+static void MemBus_Ring(void)
+{ /*Client side. Wake the server, which sleeps on the doorbell rather than on any one slot.*/
+	__atomic_add_fetch(MemBus.Doorbell, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, MemBus.Doorbell, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static Bool MemBus_OwnerGone(unsigned long PID)
+{ /*EPERM means it's alive, just not ours to signal.*/
+	return PID != 0 && kill((pid_t)PID, 0) == -1 && errno == ESRCH;
+}
+
+static void MemBus_Release(void)
+{ /*Empty the selected slot and hand it back. Clients just let go, see ShutdownMemBus().*/
+	*MemBus.Server.Message = '\0';
+	*MemBus.Client.Message = '\0';
+	MemBus_SetStatus(MemBus.Server.Status, MEMBUS_NOMSG);
+	MemBus_SetStatus(MemBus.Client.Status, MEMBUS_NOMSG);
+	ReloadReplySlots &= ~(1u << MemBus.Slot);
+	*MemBus.LockTime = 0;
+	__atomic_store_n(MemBus.LockPID, 0, __ATOMIC_SEQ_CST);
+}
+
+static ReturnCode MemBus_Claim(void)
+{ /*Client side. Take the first free slot. Only the server frees a dead client's slot,
+	* since it might be halfway through answering it.*/
+	const unsigned long OurPID = getpid();
+	unsigned long Owner;
+	unsigned Inc = 0;
+	Bool Stale = false;
+	
+	for (; Inc < MEMBUS_SLOTS; ++Inc)
+	{
+		MemBus_Select(Inc);
+		Owner = 0;
+		
+		if (__atomic_compare_exchange_n(MemBus.LockPID, &Owner, OurPID, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+			*MemBus.LockTime = time(NULL);
+			return SUCCESS;
+		}
+		
+		if (MemBus_OwnerGone(Owner)) Stale = true;
+	}
+	
+	return Stale ? WARNING : FAILURE; /*WARNING: try again once the server has swept.*/
+}
+
+static Bool MemBus_Connect(void)
+{ /*Client side. Connect to the control socket, if Epoch has one up.*/
+	struct sockaddr_un Addr = { .sun_family = AF_UNIX };
+	int Socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	
+	if (Socket == -1) return false;
+	
+	snprintf(Addr.sun_path, sizeof Addr.sun_path, "%s", CONTROLSOCKET);
+	
+	if (connect(Socket, (struct sockaddr*)&Addr, sizeof Addr) != 0)
+	{
+		close(Socket);
+		return false;
+	}
+	
+	MemBus.Socket = Socket;
+	MemBus.OverSocket = true;
+	
+	return true;
+}
+
+static unsigned MemBus_SocketSend(const void *Data, unsigned Length)
+{ /*Both sides. Same ten seconds as the membus, if they aren't reading.*/
+	struct pollfd Poll = { .fd = MemBus.Socket, .events = POLLOUT };
+	
+	if (MemBus.SocketClosed) return 0;
+	
+	while (send(MemBus.Socket, Data, Length, MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
+	{
+		if (errno == EINTR) continue;
+		
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || poll(&Poll, 1, 10000) <= 0)
+		{
+			MemBus.SocketClosed = true;
+			return 0;
+		}
+	}
+	
+	return Length;
+}
+
+static unsigned MemBus_SocketRecv(void *Out, unsigned MaxOutSize)
+{ /*Both sides. Zero if there's nothing yet. We never send empty messages, so zero bytes read means they're gone.*/
+	ssize_t Got;
+	
+	if (MemBus.SocketClosed) return 0;
+	
+	if ((Got = recv(MemBus.Socket, Out, MaxOutSize, MSG_DONTWAIT)) > 0) return Got;
+	
+	if (Got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+	{
+		MemBus.SocketClosed = true;
+	}
+	
+	return 0;
+}
+
 ReturnCode InitMemBus(Bool ServerSide)
 { /*Fire up the memory bus.*/
-	char CheckCode = 0;
-	unsigned Inc = 0;
+	unsigned CheckCode = 0, Status = 0, Inc = 0;
+	ReturnCode Claimed = FAILURE;
 
 	if (BusRunning) return SUCCESS;
 	
 	memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 	
-	if ((MemDescriptor = shmget((key_t)MemBusKey, MEMBUS_SIZE + sizeof(long) * 2, (ServerSide ? (IPC_CREAT | 0660) : 0660))) < 0)
+	if (!ServerSide && UseControlSocket && MemBus_Connect())
+	{ /*Everything after this is the membus, which is there for early boot and reexec.*/
+		BusRunning = true;
+		return SUCCESS;
+	}
+	
+	if ((MemDescriptor = shmget((key_t)MemBusKey, MEMBUS_TOTALSIZE, (ServerSide ? (IPC_CREAT | 0660) : 0660))) < 0)
 	{
 		if (ServerSide) SpitError("InitMemBus(): Failed to allocate memory bus."); /*should probably use perror*/
 		else SpitError("InitMemBus(): Failed to connect to memory bus.\n\n"
@@ -61,74 +252,72 @@ ReturnCode InitMemBus(Bool ServerSide)
 		return FAILURE;
 	}
 	
-	/*Status.*/
-	MemBus.LockPID = MemBus.Root;
-	MemBus.LockTime = (unsigned long*) ((char*)MemBus.Root + sizeof(long));
-	
-	/*Server side.*/
-	MemBus.Server.Status = (unsigned char*)MemBus.Root + sizeof(long) * 2;
-	MemBus.Server.BinMessage = MemBus.Server.Status + 1;
-	MemBus.Server.Message = (char*)MemBus.Server.BinMessage;
-	
-	/*Client side.*/
-	MemBus.Client.Status = (unsigned char*)MemBus.Root + sizeof(long) * 2 + MEMBUS_SIZE/2;
-	MemBus.Client.BinMessage = MemBus.Client.Status + 1;
-	MemBus.Client.Message = (char*)MemBus.Client.BinMessage;
+	MemBus.Doorbell = (unsigned*)MemBus.Root;
+	MemBus.NumSlots = MemBus.Doorbell + 1;
 	
 	if (ServerSide) /*Don't nuke messages on startup if we aren't init.*/
 	{
-		memset((void*)MemBus.Root, 0, MEMBUS_SIZE); /*Zero it out just to be neat. Probably don't really need this.*/
+		memset((void*)MemBus.Root, 0, MEMBUS_TOTALSIZE); /*Zero it out just to be neat. Probably don't really need this.*/
+		
+		for (Inc = MEMBUS_SLOTS; Inc-- > 0;)
+		{ /*Set to no message by default. Ends up with slot 0 selected.*/
+			MemBus_Select(Inc);
+			MemBus_SetStatus(MemBus.Server.Status, MEMBUS_NOMSG);
+			MemBus_SetStatus(MemBus.Client.Status, MEMBUS_NOMSG);
+		}
 		
-		*MemBus.Server.Status = MEMBUS_NOMSG; /*Set to no message by default.*/
+		MemBus_SetStatus(MemBus.NumSlots, MEMBUS_SLOTS); /*Open for business.*/
 	}
 	else
 	{ /*Client side stuff.*/
-		for (; *MemBus.Server.Status != MEMBUS_NOMSG && *MemBus.Server.Status != MEMBUS_MSG; ++Inc)
-		{ /*Wait for server-side to finish setting up its half, if it was just starting up itself.*/
-			if (Inc == 100000) /*Ten secs.*/
-			{
-				SmallError("Cannot connect to Epoch over MemBus, stream corrupted. Aborting MemBus initialization.");
-				BusRunning = false;
-				memset(&MemBus, 0, sizeof(struct _MemBusInterface));
-				
-				return FAILURE;
-			}
+		/*Wait for server-side to finish setting up, if it was just starting up itself.*/
+		if (!MemBus_SleepUntil(MemBus.NumSlots, MEMBUS_SLOTS, 10000))
+		{
+			SmallError("Cannot connect to Epoch over MemBus, stream corrupted. Aborting MemBus initialization.");
+			BusRunning = false;
+			shmdt(MemBus.Root);
+			memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 			
-			usleep(100);
+			return FAILURE;
+		}
+		
+		/*Get a slot of our own. If they're all taken but somebody died holding one, the server frees it shortly.*/
+		for (Inc = 0; (Claimed = MemBus_Claim()) == WARNING && Inc < 20; ++Inc)
+		{
+			usleep(50000); /*0.05 secs, so a second at most.*/
 		}
 		
-		/*Check the lock.*/
-		if (*MemBus.LockPID != 0 && *MemBus.LockPID != getpid())
+		if (Claimed != SUCCESS)
 		{
-			SmallError("Another client is currently connected to the membus. Cannot continue!");
+			char ErrBuf[MAX_LINE_SIZE];
+			
+			snprintf(ErrBuf, sizeof ErrBuf, "All %u membus client slots are in use. Cannot continue!", MEMBUS_SLOTS);
+			SmallError(ErrBuf);
 			BusRunning = false;
+			shmdt(MemBus.Root);
 			memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 
 			return FAILURE;
 		}
 		
-		CheckCode = *MemBus.Server.Status = (*MemBus.Server.Status == MEMBUS_MSG ? MEMBUS_CHECKALIVE_MSG : MEMBUS_CHECKALIVE_NOMSG); /*Ask server-side if they're alive.*/
+		Status = MemBus_GetStatus(MemBus.Server.Status);
+		CheckCode = (Status == MEMBUS_MSG ? MEMBUS_CHECKALIVE_MSG : MEMBUS_CHECKALIVE_NOMSG);
+		MemBus_SetStatus(MemBus.Server.Status, CheckCode); /*Ask server-side if they're alive.*/
+		MemBus_Ring();
 		
-		for (Inc = 0; *MemBus.Server.Status == CheckCode; ++Inc)
-		{ /*Wait ten seconds for server-side to respond.*/
-			if (Inc == 100000)
-			{ /*Ten seconds.*/
-				SmallError("Cannot connect to Epoch over MemBus, timeout expired. Aborting MemBus initialization.");
-				
-				BusRunning = false;
-				memset(&MemBus, 0, sizeof(struct _MemBusInterface));
-
-				return FAILURE;
-			}
+		if (!MemBus_SleepUntil(MemBus.Server.Status, Status, 10000)) /*Back to what it was, once they answer.*/
+		{ /*Ten seconds.*/
+			SmallError("Cannot connect to Epoch over MemBus, timeout expired. Aborting MemBus initialization.");
+			
+			MemBus_Release();
+			BusRunning = false;
+			shmdt(MemBus.Root);
+			memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 			
-			usleep(100);
+			return FAILURE;
 		}
-		
-		/*Acquire the lock.*/
-		*MemBus.LockPID = getpid();
-		*MemBus.LockTime = time(NULL);
 
-		*MemBus.Client.Status = MEMBUS_NOMSG;
+		MemBus_SetStatus(MemBus.Client.Status, MEMBUS_NOMSG);
 	}
 	/*Either the server side is alive, or we ARE the server side.*/
 	BusRunning = true;
@@ -139,9 +328,14 @@ ReturnCode InitMemBus(Bool ServerSide)
 unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSide)
 { /*Copies binary data of length DataSize to the membus.*/
 	const char *InStream = InStream_;
-	unsigned char *BusData = NULL, *BusStatus = NULL;
+	unsigned char *BusData = NULL;
+	unsigned *BusStatus = NULL;
 	unsigned Inc = 0;
-	unsigned short WaitCount = 0;
+	
+	if (MemBus.OverSocket)
+	{
+		return MemBus_SocketSend(InStream, DataSize < MEMBUS_MSGSIZE ? DataSize : MEMBUS_MSGSIZE);
+	}
 	
 	if (ServerSide)
 	{
@@ -152,17 +346,11 @@ unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSi
 		BusStatus = MemBus.Server.Status;
 	}
 	
-	BusData = BusStatus + 1;
+	BusData = (unsigned char*)(BusStatus + 1);
 	
-	while (*BusStatus != MEMBUS_NOMSG) /*Wait ten secs for their last message to process.*/
+	if (!MemBus_SleepUntil(BusStatus, MEMBUS_NOMSG, 10000)) /*Wait ten secs for their last message to process.*/
 	{
-		usleep(1000); /*0.001 seconds.*/
-		++WaitCount;
-		
-		if (WaitCount == 10000)
-		{
-			return 0;
-		}
+		return 0;
 	}
 	
 	for (; Inc < DataSize && Inc < MEMBUS_MSGSIZE; ++Inc)
@@ -170,17 +358,25 @@ unsigned MemBus_BinWrite(const void *InStream_, unsigned DataSize, Bool ServerSi
 		BusData[Inc] = InStream[Inc];
 	}
 	
-	*BusStatus = MEMBUS_MSG;
+	MemBus_SetStatus(BusStatus, MEMBUS_MSG);
+	
+	if (!ServerSide) MemBus_Ring();
 	
 	return Inc; /*Return number of bytes written.*/
 }
 
 unsigned MemBus_BinRead(void *OutStream_, unsigned MaxOutSize, Bool ServerSide)
 {
-	unsigned char *BusStatus = NULL, *BusData = NULL;
+	unsigned *BusStatus = NULL;
+	unsigned char *BusData = NULL;
 	unsigned char *OutStream = OutStream_;
 	unsigned Inc = 0;
 	
+	if (MemBus.OverSocket)
+	{
+		return MemBus_SocketRecv(OutStream, MaxOutSize < MEMBUS_MSGSIZE ? MaxOutSize : MEMBUS_MSGSIZE);
+	}
+	
 	if (ServerSide)
 	{
 		BusStatus = MemBus.Server.Status;
@@ -190,145 +386,863 @@ unsigned MemBus_BinRead(void *OutStream_, unsigned MaxOutSize, Bool ServerSide)
 		BusStatus = MemBus.Client.Status;
 	}
 	
-	BusData = BusStatus + 1;
+	BusData = (unsigned char*)(BusStatus + 1);
+	
+	if (MemBus_GetStatus(BusStatus) != MEMBUS_MSG)
+	{
+		return 0;
+	}
+	
+	for (; Inc < MaxOutSize && Inc < MEMBUS_MSGSIZE; ++Inc)
+	{
+		OutStream[Inc] = BusData[Inc];
+	}
+	
+	MemBus_SetStatus(BusStatus, MEMBUS_NOMSG);
+	
+	return Inc;
+}
+
+static Bool MemBus_WaitRead(char *OutBuf, Bool ServerSide, time_t Deadline)
+{ /*The next piece of a long message. Deadline is for the whole message, not each piece.*/
+	while (!MemBus_BinRead(OutBuf, MEMBUS_MSGSIZE, ServerSide))
+	{
+		if (MemBus.SocketClosed || time(NULL) > Deadline) return false;
+		
+		MemBus_Wait(ServerSide);
+	}
+	
+	return true;
+}
+
+static void *MemBus_Reassemble(const char *First, Bool ServerSide, unsigned *SizeOut)
+{ /*First is the first piece, already read. Returns the whole thing with a NUL on the end, or NULL.*/
+	char InBuf[MEMBUS_MSGSIZE];
+	const char *Frame = First;
+	struct _MemBusChunk Chunk;
+	char *Out = NULL;
+	unsigned Received = 0, Sequence = 0, TotalLength = 0;
+	const time_t Deadline = time(NULL) + MEMBUS_LONGMSG_TIMEOUT; /*They come right after each other.*/
+	
+	for (;; ++Sequence)
+	{
+		memcpy(&Chunk, Frame + sizeof MEMBUS_CODE_CHUNK, sizeof Chunk);
+		
+		if (!Out)
+		{
+			if (Chunk.TotalLength > MEMBUS_LONGMSG_MAX || !(Out = malloc(Chunk.TotalLength + 1))) return NULL;
+			TotalLength = Chunk.TotalLength;
+		}
+		
+		if (Chunk.Sequence != Sequence || Chunk.TotalLength != TotalLength ||
+			Chunk.Length > MEMBUS_CHUNK_PAYLOAD || Chunk.Length > TotalLength - Received)
+		{ /*Lost one, or garbage.*/
+			free(Out);
+			return NULL;
+		}
+		
+		memcpy(Out + Received, Frame + sizeof MEMBUS_CODE_CHUNK + sizeof Chunk, Chunk.Length);
+		Received += Chunk.Length;
+		
+		if (!(Chunk.Flags & MEMBUS_CHUNK_MORE)) break;
+		
+		if (!MemBus_WaitRead(InBuf, ServerSide, Deadline) || memcmp(InBuf, MEMBUS_CODE_CHUNK, sizeof MEMBUS_CODE_CHUNK) != 0)
+		{
+			free(Out);
+			return NULL;
+		}
+		
+		Frame = InBuf;
+	}
+	
+	if (Received != TotalLength)
+	{
+		free(Out);
+		return NULL;
+	}
+	
+	Out[Received] = '\0';
+	if (SizeOut) *SizeOut = Received;
+	
+	return Out;
+}
+
+static Bool MemBus_ReadChunked(char *OutStream, char **WholeOut, const char *First, Bool ServerSide)
+{ /*MemBus_Read() got the start of a long message. Callers with a fixed buffer get what fits, like they always did.
+	* If WholeOut isn't NULL, it gets all of it too, to be freed after.*/
+	char *Whole = MemBus_Reassemble(First, ServerSide, NULL);
+	
+	if (!Whole) return false;
+	
+	snprintf(OutStream, MEMBUS_MSGSIZE, "%s", Whole);
+	
+	if (WholeOut) *WholeOut = Whole;
+	else free(Whole);
+	
+	return true;
+}
+
+ReturnCode MemBus_WriteLong(const void *Data_, unsigned Size, Bool ServerSide)
+{ /*Sends Size bytes of anything, however many pieces it takes. The other side reads it with MemBus_ReadLong().*/
+	const char *Data = Data_;
+	char OutBuf[MEMBUS_MSGSIZE];
+	struct _MemBusChunk Chunk = { 0, Size, 0, 0 };
+	unsigned Offset = 0;
+	
+	memcpy(OutBuf, MEMBUS_CODE_CHUNK, sizeof MEMBUS_CODE_CHUNK);
+	
+	do
+	{
+		Chunk.Length = Size - Offset > MEMBUS_CHUNK_PAYLOAD ? MEMBUS_CHUNK_PAYLOAD : Size - Offset;
+		Chunk.Flags = Offset + Chunk.Length < Size ? MEMBUS_CHUNK_MORE : 0;
+		
+		memcpy(OutBuf + sizeof MEMBUS_CODE_CHUNK, &Chunk, sizeof Chunk);
+		memcpy(OutBuf + sizeof MEMBUS_CODE_CHUNK + sizeof Chunk, Data + Offset, Chunk.Length);
+		
+		if (!MemBus_BinWrite(OutBuf, sizeof MEMBUS_CODE_CHUNK + sizeof Chunk + Chunk.Length, ServerSide))
+		{
+			return FAILURE;
+		}
+		
+		Offset += Chunk.Length;
+		++Chunk.Sequence;
+	} while (Offset < Size);
+	
+	return SUCCESS;
+}
+
+void *MemBus_ReadLong(unsigned *SizeOut, Bool ServerSide)
+{ /*Waits for a whole message, in pieces or not, and returns it with a NUL on the end. Free it after.*/
+	char InBuf[MEMBUS_MSGSIZE];
+	char *Out = NULL;
+	unsigned Length = 0;
+	
+	while (!MemBus_BinRead(InBuf, MEMBUS_MSGSIZE, ServerSide))
+	{
+		if (MemBus.SocketClosed) return NULL;
+		
+		MemBus_Wait(ServerSide);
+	}
+	
+	if (!memcmp(InBuf, MEMBUS_CODE_CHUNK, sizeof MEMBUS_CODE_CHUNK))
+	{
+		return MemBus_Reassemble(InBuf, ServerSide, SizeOut);
+	}
+	
+	/*An ordinary message, which is always text.*/
+	Length = strnlen(InBuf, MEMBUS_MSGSIZE);
+	
+	if (!(Out = malloc(Length + 1))) return NULL;
+	
+	memcpy(Out, InBuf, Length);
+	Out[Length] = '\0';
+	if (SizeOut) *SizeOut = Length;
+	
+	return Out;
+}
+	
+ReturnCode MemBus_Write(const char *InStream, Bool ServerSide)
+{
+	unsigned *BusStatus = NULL;
+	char *BusData = NULL;
+	const size_t Length = strlen(InStream);
+	
+	if (Length >= MEMBUS_MSGSIZE)
+	{ /*Doesn't fit in one. MemBus_Read() still hands back what it used to, MemBus_ReadLong() gets all of it.*/
+		return MemBus_WriteLong(InStream, Length, ServerSide);
+	}
+	
+	if (MemBus.OverSocket)
+	{ /*No status word, a message is just a datagram.*/
+		return MemBus_SocketSend(InStream, Length + 1) ? SUCCESS : FAILURE;
+	}
+	
+	if (ServerSide)
+	{
+		BusStatus = MemBus.Client.Status; /*This isn't a typo, we write to the opposite side.*/
+	}
+	else
+	{
+		BusStatus = MemBus.Server.Status;
+	}
+	
+	BusData = (char*)(BusStatus + 1); /*Our actual data goes right after the status word.*/
+	
+	if (!MemBus_SleepUntil(BusStatus, MEMBUS_NOMSG, 10000)) /*Wait for them to finish eating their last message.*/
+	{ /*Been 10 seconds! Does it take that long to copy a string?*/
+		return FAILURE;
+	}
+	
+	memcpy(BusData, InStream, Length + 1);
+	
+	MemBus_SetStatus(BusStatus, MEMBUS_MSG); /*Now we sent it.*/
+	
+	if (!ServerSide) MemBus_Ring();
+	
+	return SUCCESS;
+}
+
+static Bool MemBus_ReadWhole(char *OutStream, char **WholeOut, Bool ServerSide)
+{ /*MemBus_Read(), but a message that came in pieces also comes back whole in *WholeOut. It's NULL otherwise.*/
+	unsigned *BusStatus = NULL;
+	char *BusData = NULL;
+	
+	if (WholeOut) *WholeOut = NULL;
+	
+	if (MemBus.OverSocket)
+	{
+		const unsigned Got = MemBus_SocketRecv(OutStream, MEMBUS_MSGSIZE);
+		
+		if (!Got) return false;
+		
+		if (Got > sizeof MEMBUS_CODE_CHUNK && !memcmp(OutStream, MEMBUS_CODE_CHUNK, sizeof MEMBUS_CODE_CHUNK))
+		{
+			char First[MEMBUS_MSGSIZE];
+			
+			memcpy(First, OutStream, Got);
+			return MemBus_ReadChunked(OutStream, WholeOut, First, ServerSide);
+		}
+		
+		OutStream[Got < MEMBUS_MSGSIZE ? Got : MEMBUS_MSGSIZE - 1] = '\0'; /*Usually already there.*/
+		return true;
+	}
+	
+	if (ServerSide)
+	{
+		BusStatus = MemBus.Server.Status;
+	}
+	else
+	{
+		BusStatus = MemBus.Client.Status;
+	}
+	
+	BusData = (char*)(BusStatus + 1);
+		
+	if (MemBus_GetStatus(BusStatus) != MEMBUS_MSG)
+	{ /*No data? Quit.*/
+		return false;
+	}
+	
+	if (!memcmp(BusData, MEMBUS_CODE_CHUNK, sizeof MEMBUS_CODE_CHUNK))
+	{ /*The rest can't come until we let go of this piece.*/
+		char First[MEMBUS_MSGSIZE];
+		
+		memcpy(First, BusData, MEMBUS_MSGSIZE);
+		MemBus_SetStatus(BusStatus, MEMBUS_NOMSG);
+		
+		return MemBus_ReadChunked(OutStream, WholeOut, First, ServerSide);
+	}
+	
+	snprintf(OutStream, MEMBUS_MSGSIZE, "%s", BusData);
+	
+	MemBus_SetStatus(BusStatus, MEMBUS_NOMSG); /*Set back to NOMSG once we got the message.*/
+
+	return true;
+}
+
+Bool MemBus_Read(char *OutStream, Bool ServerSide)
+{
+	return MemBus_ReadWhole(OutStream, NULL, ServerSide);
+}
+
+void MemBus_Wait(Bool ServerSide)
+{ /*Sleep until a message shows up on our side. Use between MemBus_Read() attempts.*/
+	unsigned *BusStatus = ServerSide ? MemBus.Server.Status : MemBus.Client.Status;
+	
+	if (MemBus.OverSocket)
+	{
+		struct pollfd Poll = { .fd = MemBus.Socket, .events = POLLIN };
+		
+		if (MemBus.SocketClosed && !ServerSide)
+		{ /*Nothing more is coming, and every caller would loop forever.*/
+			SpitError("Lost the connection to Epoch.");
+			exit(1);
+		}
+		
+		if (!MemBus.SocketClosed) poll(&Poll, 1, 1000);
+		return; /*The server checks SocketClosed itself, where it waits.*/
+	}
+	
+	/*Capped, so a side that vanished without a word doesn't hang us in here forever.*/
+	MemBus_Sleep(BusStatus, MEMBUS_NOMSG, 1000);
+}
+
+Bool MemBus_Pending(void)
+{ /*Server side. Is there a message or a ping waiting for us in any slot?*/
+	const char *Base = (const char*)MemBus.Root + sizeof(long) * 2;
+	unsigned Inc = 0, Status;
+	
+	if (!BusRunning) return false;
+	
+	for (; Inc < MEMBUS_SLOTS; ++Inc, Base += MEMBUS_SLOTSIZE)
+	{ /*Peek without selecting, we might be in the middle of talking to someone.*/
+		Status = MemBus_GetStatus((unsigned*)(Base + sizeof(long) * 2));
+		
+		if (Status == MEMBUS_MSG || Status == MEMBUS_CHECKALIVE_MSG || Status == MEMBUS_CHECKALIVE_NOMSG)
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+Bool MemBus_Idle(unsigned Milliseconds)
+{ /*Server side. Sleep for Milliseconds, unless a client shows up first. Returns true if one did.*/
+	unsigned Bell;
+	
+	if (!BusRunning)
+	{
+		usleep(Milliseconds * 1000);
+		return false;
+	}
+	
+	Bell = MemBus_GetStatus(MemBus.Doorbell); /*Before looking, so a ring in between isn't missed.*/
+	
+	if (!MemBus_Pending()) MemBus_Sleep(MemBus.Doorbell, Bell, Milliseconds);
+	
+	return MemBus_Pending(); /*Can also come back early and false, on a signal.*/
+}
+
+Bool HandleMemBusPings(void)
+{ /*If we are pinged, we must initialize the client side immediately.
+	* Leaves the last slot that pinged us selected, so the caller can talk to it.*/
+	const unsigned Current = MemBus.Slot;
+	unsigned Inc = 0, Pinged = MEMBUS_SLOTS;
+	
+	if (!BusRunning) return false;
+	
+	for (; Inc < MEMBUS_SLOTS; ++Inc)
+	{
+		MemBus_Select(Inc);
+		
+		switch (MemBus_GetStatus(MemBus.Server.Status))
+		{
+			case MEMBUS_CHECKALIVE_MSG:
+				MemBus_SetStatus(MemBus.Server.Status, MEMBUS_MSG);
+				Pinged = Inc;
+				break;
+			case MEMBUS_CHECKALIVE_NOMSG:
+				MemBus_SetStatus(MemBus.Server.Status, MEMBUS_NOMSG);
+				Pinged = Inc;
+				break;
+			default:
+				break;
+		}
+	}
+	
+	MemBus_Select(Pinged < MEMBUS_SLOTS ? Pinged : Current);
+	
+	return Pinged < MEMBUS_SLOTS;
+}
+
+Bool CheckMemBusIntegrity(void)
+{ /*Free the slots of clients that died without disconnecting, so nobody has to wait on them.*/
+	const unsigned Current = MemBus.Slot;
+	unsigned Inc = 0;
+	Bool AllAlive = true;
+	
+	if (!BusRunning) return true;
+	
+	for (; Inc < MEMBUS_SLOTS; ++Inc)
+	{
+		MemBus_Select(Inc);
+		
+		if (MemBus_OwnerGone(__atomic_load_n(MemBus.LockPID, __ATOMIC_SEQ_CST)))
+		{
+			MemBus_Release();
+			AllAlive = false;
+		}
+	}
+	
+	MemBus_Select(Current);
+	
+	return AllAlive;
+}
+	
+/*LSOBJS replies.*/
+#define LSOBJS_HEADERSIZE (sizeof MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION + sizeof(unsigned))
+
+struct _LSObjReply
+{ /*Records and strings are kept apart until we send, since we don't know how many records there'll be.*/
+	struct _LSObjRecord *Records;
+	char *Strings;
+	unsigned NumRecords, RecordsCapacity;
+	unsigned StringsSize, StringsCapacity;
+};
+
+static unsigned LSObjs_AddString(struct _LSObjReply *Reply, const char *String)
+{ /*Returns the offset. Space was already made by LSObjs_Add().*/
+	const unsigned Offset = Reply->StringsSize;
+	const unsigned Length = strlen(String) + 1;
+	
+	memcpy(Reply->Strings + Offset, String, Length);
+	Reply->StringsSize += Length;
+	
+	return Offset;
+}
+
+static Bool LSObjs_Add(struct _LSObjReply *Reply, ObjTable *Obj)
+{
+	struct _LSObjRecord *Record = NULL;
+	const struct _RLTree *RLWorker = Obj->ObjectRunlevels;
+	unsigned Needed = strlen(Obj->ObjectID) + strlen(Obj->ObjectDescription) + 2;
+	unsigned TPID = 0, Inc = 0;
+	
+	for (; RLWorker && RLWorker->Next; RLWorker = RLWorker->Next)
+	{
+		Needed += strlen(RLWorker->RL) + 1;
+	}
+	
+	if (Reply->NumRecords == Reply->RecordsCapacity)
+	{
+		const unsigned NewCapacity = Reply->RecordsCapacity ? Reply->RecordsCapacity * 2 : 64;
+		struct _LSObjRecord *NewRecords = realloc(Reply->Records, NewCapacity * sizeof(struct _LSObjRecord));
+		
+		if (!NewRecords) return false;
+		
+		Reply->Records = NewRecords;
+		Reply->RecordsCapacity = NewCapacity;
+	}
+	
+	if (Reply->StringsSize + Needed > Reply->StringsCapacity)
+	{
+		unsigned NewCapacity = Reply->StringsCapacity ? Reply->StringsCapacity : 4096;
+		char *NewStrings = NULL;
+		
+		while (Reply->StringsSize + Needed > NewCapacity) NewCapacity *= 2;
+		
+		if (!(NewStrings = realloc(Reply->Strings, NewCapacity))) return false;
+		
+		Reply->Strings = NewStrings;
+		Reply->StringsCapacity = NewCapacity;
+	}
+	
+	Record = Reply->Records + Reply->NumRecords++;
+	memset(Record, 0, sizeof *Record);
+	
+	if (!Obj->Opts.HasPIDFile || !(TPID = ReadPIDFile(Obj)))
+	{
+		TPID = Obj->State->ObjectPID;
+	}
+	
+	/*We need a version for this protocol, because relevant options can change with updates.
+	 * Not all options are here, because some are not really useful.*/
+	Record->Started = (Obj->State->Started && !Obj->Opts.HaltCmdOnly);
+	Record->Running = ObjectProcessRunning(Obj);
+	Record->Enabled = Obj->State->Enabled;
+	Record->TermSignal = Obj->TermSignal;
+	Record->ReloadCommandSignal = Obj->ReloadCommandSignal;
+	Record->StopMode = Obj->Opts.StopMode;
+	Record->UserID = Obj->UserID;
+	Record->GroupID = Obj->GroupID;
+	Record->PID = TPID;
+	Record->StartedSince = Obj->State->StartedSince;
+	Record->StopTimeout = Obj->Opts.StopTimeout;
+	
+	if (Obj->Opts.RawDescription) Record->Options |= 1 << COPT_RAWDESCRIPTION;
+	if (Obj->Opts.HaltCmdOnly) Record->Options |= 1 << COPT_HALTONLY;
+	if (Obj->Opts.Persistent) Record->Options |= 1 << COPT_PERSISTENT;
+#ifndef NOMMU
+	if (Obj->Opts.Fork) Record->Options |= 1 << COPT_FORK;
+	if (Obj->Opts.ForkScanOnce) Record->Options |= 1 << COPT_FORKSCANONCE;
+#endif /*NOMMU*/
+	if (Obj->Opts.IsService) Record->Options |= 1 << COPT_SERVICE;
+	if (Obj->State->AutoRestart) Record->Options |= 1 << COPT_AUTORESTART;
+	if (Obj->Opts.ForceShell) Record->Options |= 1 << COPT_FORCESHELL;
+	if (Obj->Opts.NoStopWait) Record->Options |= 1 << COPT_NOSTOPWAIT;
+	if (Obj->Opts.Exec) Record->Options |= 1 << COPT_EXEC;
+	if (Obj->Opts.PivotRoot) Record->Options |= 1 << COPT_PIVOTROOT;
+	if (Obj->Opts.RunOnce) Record->Options |= 1 << COPT_RUNONCE;
+	if (Obj->Opts.NoTrack) Record->Options |= 1 << COPT_NOTRACK;
+	if (Obj->Opts.StartFailIsCritical) Record->Options |= 1 << COPT_STARTFAILCRITICAL;
+	if (Obj->Opts.StopFailIsCritical) Record->Options |= 1 << COPT_STOPFAILCRITICAL;
+	
+	for (; Inc < sizeof Obj->ExitStatuses / sizeof Obj->ExitStatuses[0] && Obj->ExitStatuses[Inc].Value != 3; ++Inc)
+	{
+		Record->ExitMaps[Inc][0] = Obj->ExitStatuses[Inc].Value;
+		Record->ExitMaps[Inc][1] = Obj->ExitStatuses[Inc].ExitStatus;
+	}
+	Record->NumExitMaps = Inc;
+	
+	Record->IDOffset = LSObjs_AddString(Reply, Obj->ObjectID);
+	Record->IDLength = Reply->StringsSize - Record->IDOffset - 1;
+	Record->DescriptionOffset = LSObjs_AddString(Reply, Obj->ObjectDescription);
+	Record->DescriptionLength = Reply->StringsSize - Record->DescriptionOffset - 1;
+	
+	Record->RLOffset = Reply->StringsSize;
+	
+	for (RLWorker = Obj->ObjectRunlevels; RLWorker && RLWorker->Next; RLWorker = RLWorker->Next)
+	{
+		LSObjs_AddString(Reply, RLWorker->RL);
+	}
+	
+	Record->RLLength = Reply->StringsSize - Record->RLOffset;
+	
+	return true;
+}
+
+static void LSObjs_Send(struct _LSObjReply *Reply)
+{ /*One message, however long it gets. MemBus_WriteLong() worries about the pieces.*/
+	const unsigned RecordsSize = Reply->NumRecords * sizeof(struct _LSObjRecord);
+	const unsigned Size = LSOBJS_HEADERSIZE + RecordsSize + Reply->StringsSize;
+	char *OutBuf = malloc(Size), *Worker = OutBuf;
+	
+	if (!OutBuf)
+	{
+		MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_LSOBJS, true);
+		return;
+	}
+	
+	memcpy(Worker, MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION, sizeof MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION);
+	memcpy((Worker += sizeof MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION), &Reply->NumRecords, sizeof(unsigned));
+	if (RecordsSize) memcpy((Worker += sizeof(unsigned)), Reply->Records, RecordsSize);
+	if (Reply->StringsSize) memcpy(Worker + RecordsSize, Reply->Strings, Reply->StringsSize);
+	
+	MemBus_WriteLong(OutBuf, Size, true);
+	
+	free(OutBuf);
+}
+
+/*BATCH. A whole script of object commands, parsed before any of it runs, then done as one job.*/
+struct _BatchItem
+{ /*Everything asked of one object, however many lines asked it.*/
+	ObjTable *Obj; /*NULL if there's no such object.*/
+	const char *ObjectID;
+	signed char Enable; /*1 to enable, -1 to disable, 0 to leave it be.*/
+	Bool Stop, Start, StopOnlyIfRunning;
+	ReturnCode EnableResult, StopResult, StartResult;
+};
+
+struct _BatchJob
+{
+	struct _BatchItem *Items;
+	unsigned NumItems, Capacity;
+};
+
+static const struct _BatchVerb
+{
+	const char *Verb;
+	signed char Enable;
+	Bool Stop, Start;
+} BatchVerbs[] = { { "start", 0, false, true }, { "stop", 0, true, false }, { "restart", 0, true, true },
+					{ "enable", 1, false, false }, { "disable", -1, false, false } };
+
+static Bool Batch_Add(struct _BatchJob *Job, ObjTable *Obj, const char *ObjectID, const struct _BatchVerb *Verb)
+{ /*An object named twice gets one item, so "stop a" and "start a" is a restart.*/
+	struct _BatchItem *Item = NULL;
+	unsigned Inc = 0;
+	
+	for (; Obj && Inc < Job->NumItems && Job->Items[Inc].Obj != Obj; ++Inc);
+	
+	if (Obj && Inc < Job->NumItems) Item = Job->Items + Inc;
+	else
+	{
+		if (Job->NumItems == Job->Capacity)
+		{
+			struct _BatchItem *NewItems = realloc(Job->Items, (Job->Capacity * 2 + 16) * sizeof(struct _BatchItem));
+			
+			if (!NewItems) return false;
+			
+			Job->Items = NewItems;
+			Job->Capacity = Job->Capacity * 2 + 16;
+		}
+		
+		Item = Job->Items + Job->NumItems++;
+		memset(Item, 0, sizeof(struct _BatchItem));
+		Item->Obj = Obj;
+		Item->ObjectID = ObjectID;
+		Item->StopOnlyIfRunning = true;
+		Item->EnableResult = Item->StopResult = Item->StartResult = SUCCESS;
+	}
+	
+	if (Verb->Enable) Item->Enable = Verb->Enable;
+	
+	if (Verb->Stop)
+	{ /*A restart of something that isn't running just starts it. A plain stop of it fails, like it always did.*/
+		Item->StopOnlyIfRunning = Item->StopOnlyIfRunning && Verb->Start;
+		Item->Stop = true;
+	}
+	
+	if (Verb->Start) Item->Start = true;
+	
+	return true;
+}
+
+static Bool Batch_AddRunlevel(struct _BatchJob *Job, const char *Runlevel, const struct _BatchVerb *Verb)
+{ /*Every object in the runlevel that the verb makes sense for.*/
+	ObjTable *Worker = ObjectTable;
+	
+	for (; Worker->ObjectID != NULL; ++Worker)
+	{
+		if (Worker->Opts.HaltCmdOnly || !ObjRL_CheckRunlevel(Runlevel, Worker, true)) continue;
+		
+		if (Verb->Start && !Verb->Stop && !Worker->State->Enabled) continue;
+		
+		if (Verb->Stop && !Verb->Start && !Worker->State->Started) continue;
+		
+		if (Verb->Stop && Verb->Start && !Worker->State->Enabled && !Worker->State->Started) continue;
+		
+		if (!Batch_Add(Job, Worker, Worker->ObjectID, Verb)) return false;
+	}
+	
+	return true;
+}
+
+static const char *Batch_Parse(struct _BatchJob *Job, char *Script)
+{ /*Returns NULL if it's all good, or the line we didn't like. Script gets chopped up and the items point into it.*/
+	char *Line = Script, *Next = NULL;
+	
+	for (; Line; Line = Next)
+	{
+		const struct _BatchVerb *Verb = NULL;
+		char *Words[2], *Worker = NULL;
+		unsigned Inc = 0;
+		
+		if ((Next = strchr(Line, '\n'))) *Next++ = '\0';
+		
+		if ((Worker = strchr(Line, '#'))) *Worker = '\0'; /*Comments.*/
+		
+		for (Worker = Line; *Worker == ' ' || *Worker == '\t'; ++Worker);
+		
+		if (*Worker == '\0') continue;
+		
+		for (Inc = 0; Inc < sizeof BatchVerbs / sizeof *BatchVerbs; ++Inc)
+		{
+			const size_t VerbLength = strlen(BatchVerbs[Inc].Verb);
+			
+			if (!strncmp(Worker, BatchVerbs[Inc].Verb, VerbLength) &&
+				(Worker[VerbLength] == ' ' || Worker[VerbLength] == '\t'))
+			{
+				Verb = BatchVerbs + Inc;
+				Worker += VerbLength;
+				break;
+			}
+		}
+		
+		if (!Verb) return Line;
+		
+		/*The rest of the line is object IDs, or --runlevel and a runlevel.*/
+		for (Inc = 0; *Worker != '\0';)
+		{
+			for (; *Worker == ' ' || *Worker == '\t'; ++Worker) *Worker = '\0';
+			
+			if (*Worker == '\0') break;
+			
+			Words[Inc] = Worker;
+			
+			for (; *Worker != '\0' && *Worker != ' ' && *Worker != '\t'; ++Worker);
+			
+			if (Inc == 1)
+			{
+				if (*Worker != '\0') *Worker++ = '\0';
+				
+				if (!Batch_AddRunlevel(Job, Words[1], Verb)) return Line;
+				
+				Inc = 0;
+			}
+			else if (!strncmp(Words[0], "--runlevel", Worker - Words[0]) && Worker - Words[0] == sizeof "--runlevel" - 1)
+			{
+				Inc = 1;
+			}
+			else
+			{
+				if (*Worker != '\0') *Worker++ = '\0';
+				
+				if (!Batch_Add(Job, LookupObjectInTable(Words[0]), Words[0], Verb)) return Line;
+			}
+		}
+		
+		if (Inc == 1) return Line; /*--runlevel with nothing after it.*/
+	}
+	
+	return NULL;
+}
+
+static void Batch_Sort(struct _BatchItem **List, unsigned NumItems, Bool ByStartPriority)
+{ /*Insertion sort, since it keeps the script's order for objects of the same priority.
+	* Priority zero goes last. Those never run at boot, so they have nothing to be ordered with.*/
+	unsigned Inc = 1;
+	
+	for (; Inc < NumItems; ++Inc)
+	{
+		struct _BatchItem *const Item = List[Inc];
+		const unsigned Key = ByStartPriority ? Item->Obj->State->ObjectStartPriority : Item->Obj->State->ObjectStopPriority;
+		unsigned Slot = Inc;
+		
+		for (; Slot > 0; --Slot)
+		{
+			const unsigned Before = ByStartPriority ? List[Slot - 1]->Obj->State->ObjectStartPriority
+										: List[Slot - 1]->Obj->State->ObjectStopPriority;
+			
+			if ((Before ? Before : UINT_MAX) <= (Key ? Key : UINT_MAX)) break;
+			
+			List[Slot] = List[Slot - 1];
+		}
+		
+		List[Slot] = Item;
+	}
+}
+
+static void Batch_Log(const ObjTable *Obj, const char *Action, ReturnCode Result)
+{
+	char TmpBuf[MAX_LINE_SIZE];
+	
+	snprintf(TmpBuf, sizeof TmpBuf, "Manual %s of object %s %s%s", Action, Obj->ObjectID,
+			(Result ? "succeeded" : "failed"), ((Result == WARNING) ? " with a warning" : ""));
+	WriteLogLine(TmpBuf, true);
+}
+
+static void Batch_Run(struct _BatchJob *Job)
+{ /*Enables and disables first, since they're free. Then the stops, a stop priority at a time, all of a priority together.
+	* Then the starts, in start priority order. Starting one has to wait for its command, so they go one after another.*/
+	struct _BatchItem **List = malloc(Job->NumItems * sizeof(struct _BatchItem*) + 1);
+	ObjTable **Group = malloc(Job->NumItems * sizeof(ObjTable*) + 1);
+	ReturnCode *Results = malloc(Job->NumItems * sizeof(ReturnCode) + 1);
+	unsigned Inc = 0, NumListed = 0;
 	
-	if (*BusStatus != MEMBUS_MSG)
+	if (!List || !Group || !Results)
 	{
-		return 0;
+		for (; Inc < Job->NumItems; ++Inc) Job->Items[Inc].EnableResult = Job->Items[Inc].StopResult = Job->Items[Inc].StartResult = FAILURE;
+		
+		goto End;
 	}
 	
-	for (; Inc < MaxOutSize && Inc < MEMBUS_MSGSIZE; ++Inc)
+	for (; Inc < Job->NumItems; ++Inc)
 	{
-		OutStream[Inc] = BusData[Inc];
+		struct _BatchItem *const Item = Job->Items + Inc;
+		Bool WasEnabled;
+		
+		if (!Item->Obj)
+		{
+			Item->EnableResult = Item->StopResult = Item->StartResult = FAILURE;
+			continue;
+		}
+		
+		if (!Item->Enable) continue;
+		
+		WasEnabled = Item->Obj->State->Enabled;
+		Item->Obj->State->Enabled = Item->Enable > 0;
+		Item->EnableResult = Overlay_RecordEnabled(Item->Obj, WasEnabled);
 	}
 	
-	*BusStatus = MEMBUS_NOMSG;
-	
-	return Inc;
-}
-	
-ReturnCode MemBus_Write(const char *InStream, Bool ServerSide)
-{
-	unsigned char *BusStatus = NULL;
-	char *BusData = NULL;
-	unsigned short WaitCount = 0;
-	
-	if (ServerSide)
-	{
-		BusStatus = MemBus.Client.Status; /*This isn't a typo, we write to the opposite side.*/
-	}
-	else
+	for (NumListed = 0, Inc = 0; Inc < Job->NumItems; ++Inc)
 	{
-		BusStatus = MemBus.Server.Status;
+		struct _BatchItem *const Item = Job->Items + Inc;
+		
+		if (!Item->Obj || !Item->Stop || (Item->StopOnlyIfRunning && !Item->Obj->State->Started)) continue;
+		
+		List[NumListed++] = Item;
 	}
 	
-	BusData = (char*)BusStatus + 1; /*Our actual data goes one byte after the status byte.*/
+	Batch_Sort(List, NumListed, false);
 	
-	while (*BusStatus != MEMBUS_NOMSG) /*Wait for them to finish eating their last message.*/
+	for (Inc = 0; Inc < NumListed;)
 	{
-		usleep(1000); /*0.001 seconds.*/
-		++WaitCount;
+		const unsigned Priority = List[Inc]->Obj->State->ObjectStopPriority;
+		unsigned NumGroup = 0, GroupInc = 0;
 		
-		if (WaitCount == 10000)
-		{ /*Been 10 seconds! Does it take that long to copy a string?*/
-			return FAILURE;
+		for (; Inc + NumGroup < NumListed && List[Inc + NumGroup]->Obj->State->ObjectStopPriority == Priority; ++NumGroup)
+		{
+			Group[NumGroup] = List[Inc + NumGroup]->Obj;
+		}
+		
+		StopObjectGroup(Group, NumGroup, Results);
+		
+		for (; GroupInc < NumGroup; ++GroupInc)
+		{
+			List[Inc + GroupInc]->StopResult = Results[GroupInc];
+			Batch_Log(Group[GroupInc], "stop", Results[GroupInc]);
 		}
+		
+		Inc += NumGroup;
 	}
 	
-	snprintf((char*)BusData, MEMBUS_MSGSIZE, "%s", InStream);
-	
-	*BusStatus = MEMBUS_MSG; /*Now we sent it.*/
-	
-	return SUCCESS;
-}
-
-Bool MemBus_Read(char *OutStream, Bool ServerSide)
-{
-	unsigned char *BusStatus = NULL;
-	char *BusData = NULL;
-	
-	if (ServerSide)
-	{
-		BusStatus = MemBus.Server.Status;
-	}
-	else
+	for (NumListed = 0, Inc = 0; Inc < Job->NumItems; ++Inc)
 	{
-		BusStatus = MemBus.Client.Status;
-	}
-	
-	BusData = (char*)BusStatus + 1;
+		struct _BatchItem *const Item = Job->Items + Inc;
 		
-	if (*BusStatus != MEMBUS_MSG)
-	{ /*No data? Quit.*/
-		return false;
+		if (!Item->Obj || !Item->Start || !Item->StopResult) continue;
+		
+		List[NumListed++] = Item;
 	}
 	
-	snprintf(OutStream, MEMBUS_MSGSIZE, "%s", BusData);
+	Batch_Sort(List, NumListed, true);
 	
-	*BusStatus = MEMBUS_NOMSG; /*Set back to NOMSG once we got the message.*/
+	for (Inc = 0; Inc < NumListed; ++Inc)
+	{ /*If we ask to start a HaltCmdOnly command, run the stop command instead, because that's all that we use.*/
+		List[Inc]->StartResult = ProcessConfigObject(List[Inc]->Obj, !List[Inc]->Obj->Opts.HaltCmdOnly, false);
+		Batch_Log(List[Inc]->Obj, "start", List[Inc]->StartResult);
+	}
 
-	return true;
+End:
+	free(List);
+	free(Group);
+	free(Results);
 }
 
-Bool HandleMemBusPings(void)
-{ /*If we are pinged, we must initialize the client side immediately.*/
-	if (!BusRunning) return false;
-
-	switch (*MemBus.Server.Status)
+static void Batch_Reply(const struct _BatchJob *Job)
+{ /*"OK BATCH", then a line per object per thing done to it.*/
+	static const char *const Codes[] = { MEMBUS_CODE_FAILURE, MEMBUS_CODE_ACKNOWLEDGED, MEMBUS_CODE_WARNING };
+	const size_t LineMax = sizeof MEMBUS_CODE_WARNING + sizeof MEMBUS_CODE_OBJRESTART + 1;
+	size_t Capacity = sizeof MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_BATCH "\n", Size = 0;
+	char *Reply = NULL;
+	unsigned Inc = 0;
+	
+	for (; Inc < Job->NumItems; ++Inc) Capacity += (LineMax + strlen(Job->Items[Inc].ObjectID)) * 2;
+	
+	if (!(Reply = malloc(Capacity)))
 	{
-		case MEMBUS_CHECKALIVE_MSG:
-			*MemBus.Server.Status = MEMBUS_MSG;
-			return true;
-			break;
-		case MEMBUS_CHECKALIVE_NOMSG:
-			*MemBus.Server.Status = MEMBUS_NOMSG;
-			return true;
-			break;
-		default:
-			break;
+		MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_BATCH, true);
+		return;
 	}
 	
-	return false;
-}
-
-Bool CheckMemBusIntegrity(void)
-{
-	if (!BusRunning) return true;
-	
-	if (*MemBus.LockPID == 0) return true;
+	Size = snprintf(Reply, Capacity, "%s %s\n", MEMBUS_CODE_ACKNOWLEDGED, MEMBUS_CODE_BATCH);
 	
-	if (*MemBus.LockTime + 60 < time(NULL))
-	{ /*Anything after a minute needs to be disconnected.*/
-		*MemBus.Server.Status = MEMBUS_NOMSG;
-		*MemBus.Server.Message = '\0';
-		*MemBus.Client.Status = MEMBUS_NOMSG;
-		*MemBus.Client.Message = '\0';
-		*MemBus.LockTime = 0;
-		*MemBus.LockPID = 0;
-		return false;
+	for (Inc = 0; Inc < Job->NumItems; ++Inc)
+	{
+		const struct _BatchItem *const Item = Job->Items + Inc;
+		
+		if (Item->Enable)
+		{
+			Size += snprintf(Reply + Size, Capacity - Size, "%s %s %s\n", Codes[Item->EnableResult],
+							Item->Enable > 0 ? MEMBUS_CODE_OBJENABLE : MEMBUS_CODE_OBJDISABLE, Item->ObjectID);
+		}
+		
+		if (Item->Stop || Item->Start)
+		{ /*A restart whose stop failed never got started, so the stop is what we report.*/
+			const ReturnCode Result = !Item->StopResult || !Item->Start ? Item->StopResult
+									: (Item->StopResult == WARNING && Item->StartResult ? WARNING : Item->StartResult);
+			const char *const Code = Item->Stop && Item->Start ? MEMBUS_CODE_OBJRESTART
+									: Item->Stop ? MEMBUS_CODE_OBJSTOP : MEMBUS_CODE_OBJSTART;
+			
+			Size += snprintf(Reply + Size, Capacity - Size, "%s %s %s\n", Codes[Result], Code, Item->ObjectID);
+		}
 	}
 	
-	return true;	
+	MemBus_WriteLong(Reply, Size, true);
+	free(Reply);
 }
-	
-void ParseMemBus(void)
-{ /*This function handles EVERYTHING passed to us via membus. It's truly vast.*/
-#define BusDataIs(x) !strncmp(x, BusData, strlen(x))
-	char BusData[MEMBUS_MSGSIZE];
 
-	if (!BusRunning) return;
-	
-	if (!MemBus_Read(BusData, true))
-	{
-		return;
-	}
+static void HandleMemBusMessage(char *BusData, const char *Whole)
+{ /*This function handles EVERYTHING passed to us via membus. It's truly vast.
+	* Whole is the entire message when it came in pieces, and BusData just what fits in one.*/
+#define BusDataIs(x) !strncmp(x, BusData, strlen(x))
+	ReturnCode ReloadStatus;
 	
 	/*If we got a signal over the membus.*/
 	if (BusDataIs(MEMBUS_CODE_RESET))
 	{
-		if (ReloadConfig())
-		{
+		if ((ReloadStatus = ReloadConfig_Begin()) != FAILURE)
+		{ /*We'll reply once it's swapped in. The client just waits.
+			* WARNING is another client's reload already underway, which does for this one too.*/
+			if (MemBus.OverSocket) *SocketReloadPending = true;
+			else ReloadReplySlots |= 1u << MemBus.Slot;
+		}
+		else if (ReloadStatus == FAILURE && ReloadConfig())
+		{ /*Couldn't fork, so do it the slow way.*/
 			MemBus_Write(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_RESET, true);
+			Control_Event("RELOADED", NULL, NULL);
 		}
 		else
 		{
@@ -410,126 +1324,152 @@ void ParseMemBus(void)
 		
 	}
 	else if (BusDataIs(MEMBUS_CODE_LSOBJS))
-	{ /*Done for mostly third party stuff.*/
-		int Inc = 0;
-		char OutBuf[MEMBUS_MSGSIZE];
-		unsigned char *BinWorker = (void*)OutBuf;
+	{ /*Done for mostly third party stuff. Every object goes out in one reply.*/
+		struct _LSObjReply Reply = { 0 };
+		const char *Filter = strlen(BusData) > strlen(MEMBUS_CODE_LSOBJS) ? BusData + strlen(MEMBUS_CODE_LSOBJS " ") : NULL;
 		ObjTable *Worker = ObjectTable;
-		unsigned TPID = 0;
-		const unsigned Length = strlen(MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION) + 1;
+		Bool OK = true;
 		
-		for (; Worker->Next; Worker = Worker->Next)
+		for (; Worker->ObjectID && OK; ++Worker)
 		{
-			const struct _RLTree *RLWorker = Worker->ObjectRunlevels;
-			
+			if (Filter && strcmp(Filter, Worker->ObjectID) != 0) continue; /*Allow for getting status of just one object.*/
 			
-			if (strlen(BusData) > strlen(MEMBUS_CODE_LSOBJS) &&
-				strcmp(BusData + strlen(MEMBUS_CODE_LSOBJS " "), Worker->ObjectID) != 0)
-			{ /*Allow for getting status of just one object.*/
-					continue;
-			}
-			
-			if (!Worker->Opts.HasPIDFile || !(TPID = ReadPIDFile(Worker)))
-			{
-				TPID = Worker->ObjectPID;
-			}
-			
-			/*We need a version for this protocol, because relevant options can change with updates.
-			 * Not all options are here, because some are not really useful.*/
-						
-			strncpy(OutBuf, MEMBUS_CODE_LSOBJS " " MEMBUS_LSOBJS_VERSION, Length);
-			
-			BinWorker = (unsigned char*)OutBuf + Length;
-			
-			*BinWorker++ = (Worker->Started && !Worker->Opts.HaltCmdOnly);
-			*BinWorker++ = ObjectProcessRunning(Worker);
-			*BinWorker++ = Worker->Enabled;
-			*BinWorker++ = Worker->TermSignal;
-			*BinWorker++ = Worker->ReloadCommandSignal;
-			
-			memcpy(BinWorker, &Worker->UserID, sizeof(int));
-			memcpy((BinWorker += sizeof(int)), &Worker->GroupID, sizeof(int));
-			
-			memcpy((BinWorker += sizeof(int)), &Worker->Opts.StopMode, sizeof(enum _StopMode));
-			memcpy((BinWorker += sizeof(enum _StopMode)), &TPID, sizeof(int));
-			
-			memcpy((BinWorker += sizeof(int)), &Worker->StartedSince, sizeof(int));
-			memcpy(BinWorker + sizeof(int), &Worker->Opts.StopTimeout, sizeof(int));
-			
-			
-			MemBus_BinWrite(OutBuf, MEMBUS_MSGSIZE, true);
-			
-			snprintf(OutBuf, sizeof OutBuf, "%s %s", Worker->ObjectID, Worker->ObjectDescription);
-			
-			MemBus_Write(OutBuf, true);
-			
-			*OutBuf = '\0';
-			
-			BinWorker = (void*)OutBuf;
-			/*Write it over binary now.*/
-			if (Worker->Opts.RawDescription) *BinWorker++ = COPT_RAWDESCRIPTION;
-			if (Worker->Opts.HaltCmdOnly) *BinWorker++ = COPT_HALTONLY;
-			if (Worker->Opts.Persistent) *BinWorker++ = COPT_PERSISTENT;
-#ifndef NOMMU
-			if (Worker->Opts.Fork) *BinWorker++ = COPT_FORK;
-			if (Worker->Opts.ForkScanOnce) *BinWorker++ = COPT_FORKSCANONCE;
-#endif /*NOMMU*/
-			if (Worker->Opts.IsService) *BinWorker++ = COPT_SERVICE;
-			if (Worker->Opts.AutoRestart) *BinWorker++ = COPT_AUTORESTART;
-			if (Worker->Opts.ForceShell) *BinWorker++ = COPT_FORCESHELL;
-			if (Worker->Opts.NoStopWait) *BinWorker++ = COPT_NOSTOPWAIT;
-			if (Worker->Opts.Exec) *BinWorker++ = COPT_EXEC;
-			if (Worker->Opts.PivotRoot) *BinWorker++ = COPT_PIVOTROOT;
-			if (Worker->Opts.RunOnce) *BinWorker++ = COPT_RUNONCE;
-			if (Worker->Opts.NoTrack) *BinWorker++ = COPT_NOTRACK;
-			if (Worker->Opts.StartFailIsCritical) *BinWorker++ = COPT_STARTFAILCRITICAL;
-			if (Worker->Opts.StopFailIsCritical) *BinWorker++ = COPT_STOPFAILCRITICAL;
-			
-			*BinWorker = 0;
-			
-			MemBus_BinWrite(OutBuf, MEMBUS_MSGSIZE, true);
-			
-			/*Now onto exit status mapping.*/
-			snprintf(OutBuf, sizeof OutBuf, MEMBUS_CODE_LSOBJS " MXS");
-			
-			BinWorker = (void*)(OutBuf + sizeof MEMBUS_CODE_LSOBJS " MXS" + 1);
-
-			
-			for (Inc = 0; Worker->ExitStatuses[Inc].Value != 3 && Inc < sizeof Worker->ExitStatuses / sizeof Worker->ExitStatuses[0]; ++Inc)		
-			{ /*Found one.*/
-				*BinWorker++ = Worker->ExitStatuses[Inc].Value;
-				*BinWorker++ = Worker->ExitStatuses[Inc].ExitStatus;
-			}
-			BinWorker = (void*)(OutBuf + sizeof MEMBUS_CODE_LSOBJS " MXS");
-			*BinWorker = Inc;
-
-			MemBus_BinWrite(OutBuf, MEMBUS_MSGSIZE, true);
-			/**We know we're going to the runlevels now because we only send this one chunk before we ever do.**/
-			
-			if (RLWorker)
-			{
-				for (; RLWorker->Next; RLWorker = RLWorker->Next)
-				{ /*Send all runlevels.*/
-					snprintf(OutBuf, sizeof OutBuf, "%s %s %s %s", MEMBUS_CODE_LSOBJS,
-							MEMBUS_LSOBJS_VERSION, Worker->ObjectID, RLWorker->RL);
-
-					MemBus_Write(OutBuf, true);
-				}
-			}
+			OK = LSObjs_Add(&Reply, Worker);
 		}
 		
-		/*This says we are done.*/
-		MemBus_Write(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LSOBJS, true);
-
+		if (OK) LSObjs_Send(&Reply);
+		else MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_LSOBJS, true);
+		
+		free(Reply.Records);
+		free(Reply.Strings);
+		
 		return;
 	}					
+	else if (BusDataIs(MEMBUS_CODE_BATCH))
+	{ /*Nothing runs until we've understood all of it.*/
+		struct _BatchJob Job = { NULL, 0, 0 };
+		char *Script = strdup(Whole ? Whole : BusData);
+		const char *BadLine = NULL;
+		
+		if (!Script)
+		{
+			MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_BATCH, true);
+			return;
+		}
+		
+		if ((BadLine = Batch_Parse(&Job, Script + strlen(MEMBUS_CODE_BATCH))))
+		{
+			char TmpBuf[MEMBUS_MSGSIZE];
+			
+			snprintf(TmpBuf, sizeof TmpBuf, "%s %s %s", MEMBUS_CODE_BADPARAM, MEMBUS_CODE_BATCH, BadLine);
+			MemBus_Write(TmpBuf, true);
+		}
+		else
+		{
+			Batch_Run(&Job);
+			Batch_Reply(&Job);
+		}
+		
+		free(Job.Items);
+		free(Script);
+	}
+	else if (BusDataIs(MEMBUS_CODE_WATCH))
+	{ /*Only over the control socket. A stream of events on the membus would have us waiting on the client to read them.*/
+		const char *Filter = BusData + strlen(MEMBUS_CODE_WATCH);
+		
+		if (*Filter == ' ') ++Filter;
+		
+		if (MemBus.OverSocket && Control_Watch(Filter))
+		{
+			MemBus_Write(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_WATCH, true);
+		}
+		else
+		{
+			MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_WATCH, true);
+		}
+	}
 	else if (BusDataIs(MEMBUS_CODE_GETRL))
 	{
 		char TmpBuf[MEMBUS_MSGSIZE];
 		
 		snprintf(TmpBuf, sizeof TmpBuf, MEMBUS_CODE_GETRL " %s", CurRunlevel);
 		MemBus_Write(TmpBuf, true);
-	}		
+	}
+	else if (BusDataIs(MEMBUS_CODE_CFSTATS))
+	{ /*Report how much memory the loaded configuration is using.*/
+		char TmpBuf[MEMBUS_MSGSIZE];
+		struct _ConfigArenaStats Stats;
+		
+		ConfigArena_GetStats(&Stats);
+		
+		snprintf(TmpBuf, sizeof TmpBuf, MEMBUS_CODE_CFSTATS " %u %u %lu %lu %lu %u", Stats.Generation,
+				Stats.NumBlocks, Stats.NumAllocs, Stats.BytesUsed, Stats.BytesReserved, ObjectTableSize);
+		MemBus_Write(TmpBuf, true);
+	}
+	else if (BusDataIs(MEMBUS_CODE_LOGTAIL))
+	{ /*Recent log lines, straight out of the log ring. Sent in pieces, then an acknowledgement.*/
+		char TmpBuf[MEMBUS_MSGSIZE];
+		const unsigned HeaderLength = strlen(MEMBUS_CODE_LOGTAIL " ");
+		unsigned long long Pos = LogRing_Tail(&EpochLog, strtoul(BusData + strlen(MEMBUS_CODE_LOGTAIL), NULL, 10));
+		
+		memcpy(TmpBuf, MEMBUS_CODE_LOGTAIL " ", HeaderLength);
+		
+		while (LogRing_Read(&EpochLog, &Pos, TmpBuf + HeaderLength, sizeof TmpBuf - HeaderLength))
+		{
+			if (!MemBus_Write(TmpBuf, true)) return; /*Client went away.*/
+		}
+		
+		MemBus_Write(MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_LOGTAIL, true);
+	}
+	else if (BusDataIs(MEMBUS_CODE_JOURNAL))
+	{ /*The client reads the journal itself. We just make sure it's current and say where it is.*/
+		char TmpBuf[MEMBUS_MSGSIZE];
+		
+		if (!*JournalPath)
+		{
+			MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_JOURNAL, true);
+			return;
+		}
+		
+		Journal_Flush();
+		snprintf(TmpBuf, sizeof TmpBuf, "%s %s %.1024s", MEMBUS_CODE_ACKNOWLEDGED, MEMBUS_CODE_JOURNAL, JournalPath);
+		MemBus_Write(TmpBuf, true);
+	}
+	else if (BusDataIs(MEMBUS_CODE_OBJLOGS))
+	{ /*A captured object's output, from where the client left off. The acknowledgement says where to ask from next.*/
+		char TmpBuf[MEMBUS_MSGSIZE], ObjectID[MAX_LINE_SIZE];
+		const unsigned HeaderLength = strlen(MEMBUS_CODE_OBJLOGS " ");
+		const struct _LogRing *Ring = NULL;
+		unsigned long long Pos = 0;
+		
+		if (sscanf(BusData + HeaderLength, "%2047s %llu", ObjectID, &Pos) < 1)
+		{
+			snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_BADPARAM, MEMBUS_CODE_OBJLOGS);
+			MemBus_Write(TmpBuf, true);
+			return;
+		}
+		
+		if (!(Ring = Capture_Ring(ObjectID)) && !LookupObjectInTable(ObjectID))
+		{
+			MemBus_Write(MEMBUS_CODE_FAILURE " " MEMBUS_CODE_OBJLOGS, true);
+			return;
+		}
+		
+		if (Ring)
+		{
+			if (Pos > Ring->End) Pos = Ring->Start; /*From before a reexec.*/
+			
+			memcpy(TmpBuf, MEMBUS_CODE_OBJLOGS " ", HeaderLength);
+			
+			while (LogRing_Read(Ring, &Pos, TmpBuf + HeaderLength, sizeof TmpBuf - HeaderLength))
+			{
+				if (!MemBus_Write(TmpBuf, true)) return;
+			}
+		}
+		
+		snprintf(TmpBuf, sizeof TmpBuf, "%s %s %llu", MEMBUS_CODE_ACKNOWLEDGED, MEMBUS_CODE_OBJLOGS, Pos);
+		MemBus_Write(TmpBuf, true);
+	}
 	else if (BusDataIs(MEMBUS_CODE_OBJENABLE) || BusDataIs(MEMBUS_CODE_OBJDISABLE))
 	{
 		Bool EnablingThis = (BusDataIs(MEMBUS_CODE_OBJENABLE) ? true : false);
@@ -539,6 +1479,7 @@ void ParseMemBus(void)
 		ObjTable *CurObj = LookupObjectInTable(TWorker);
 		char TmpBuf[MEMBUS_MSGSIZE];
 		ReturnCode DidWork = FAILURE;
+		Bool WasEnabled;
 		
 		if (LOffset >= strlen(BusData) || BusData[LOffset] == ' ')
 		{ /*No argument?*/
@@ -556,8 +1497,9 @@ void ParseMemBus(void)
 			return;
 		}
 		
-		CurObj->Enabled = (EnablingThis ? true : false);
-		DidWork = EditConfigValue(CurObj->ConfigFile, TWorker, "ObjectEnabled", EnablingThis ? "true" : "false");
+		WasEnabled = CurObj->State->Enabled;
+		CurObj->State->Enabled = (EnablingThis ? true : false);
+		DidWork = Overlay_RecordEnabled(CurObj, WasEnabled);
 		
 		switch (DidWork)
 		{
@@ -633,9 +1575,7 @@ void ParseMemBus(void)
 		int LOffset = 0, Inc = 0;
 		char OutBuf[MEMBUS_MSGSIZE] = { '\0' };
 		ObjTable *CurObj = NULL;
-		char *RunlevelText = NULL;
-		unsigned RequiredRLTLength = 0;
-		struct _RLTree *RLWorker = NULL;
+		char Before[MAX_LINE_SIZE];
 		
 		if (BusDataIs(MEMBUS_CODE_OBJRLS_CHECK)) LOffset = sizeof MEMBUS_CODE_OBJRLS_CHECK " " - 1, Mode = OBJRLS_CHECK;
 		else if (BusDataIs(MEMBUS_CODE_OBJRLS_ADD)) LOffset = sizeof MEMBUS_CODE_OBJRLS_ADD " " - 1, Mode = OBJRLS_ADD;
@@ -683,15 +1623,19 @@ void ParseMemBus(void)
 				/*Add the runlevel in memory.*/
 				if (!ObjRL_CheckRunlevel(SpecRunlevel, CurObj, false))
 				{
+					Overlay_DescribeRunlevels(CurObj, Before, sizeof Before);
 					ObjRL_AddRunlevel(SpecRunlevel, CurObj);
 				}
 				else
 				{
 					snprintf(OutBuf, sizeof OutBuf, MEMBUS_CODE_FAILURE " %s", BusData);
 					MemBus_Write(OutBuf, true);
+					return;
 				}
 				break;
 			case OBJRLS_DEL:
+				Overlay_DescribeRunlevels(CurObj, Before, sizeof Before);
+				
 				if (!ObjRL_DelRunlevel(SpecRunlevel, CurObj))
 				{
 					snprintf(OutBuf, sizeof OutBuf, "%s %s", MEMBUS_CODE_FAILURE, BusData);
@@ -703,68 +1647,14 @@ void ParseMemBus(void)
 				break;
 		}
 		
-		/*File editing. We already returned if we were just checking, so I won't handle that here.*/
-		if (CurObj->ObjectRunlevels)
-		{
-			for (RLWorker = CurObj->ObjectRunlevels; RLWorker->Next; RLWorker = RLWorker->Next)
-			{
-				RequiredRLTLength += strlen(RLWorker->RL) + 2;
-			}
-			++RequiredRLTLength; /*For the null terminator.*/
-			
-			*(RunlevelText = malloc(RequiredRLTLength)) = '\0'; /*I'm only going to say this once.
-			* This is a Linux program. In Linux programs, most of the time, even if something is wrong,
-			* malloc will NEVER return NULL. I will not dirty up my code with a hundred thousand
-			* checks for a value that will never come to pass.*/
-			
-			for (RLWorker = CurObj->ObjectRunlevels; RLWorker->Next; RLWorker = RLWorker->Next)
-			{
-				strncat(RunlevelText, RLWorker->RL, RequiredRLTLength - 1);
-				strncat(RunlevelText, " ", 1);
-			}
-			
-			/*Get rid of the space at the end.*/
-			RunlevelText[strlen(RunlevelText) - 1] = '\0';
-		}
-		
-		if (Mode == OBJRLS_ADD)
+		/*Keep it across reboots. We already returned if we were just checking.*/
+		if (!Overlay_RecordRunlevels(CurObj, Before))
 		{
-			if (!EditConfigValue(CurObj->ConfigFile, CurObj->ObjectID, "ObjectRunlevels", RunlevelText))
-			{
-				const int Length = MAX_LINE_SIZE + strlen(RunlevelText);
-				char *TrickyBuf = malloc(Length);
-				/*Special trick to attempt to add the ObjectRunlevels attribute.*/
-				snprintf(TrickyBuf, Length, "%s\n\tObjectRunlevels=%s",
-						CurObj->Enabled ? "true" : "false", RunlevelText);
-						
-				if (!EditConfigValue(CurObj->ConfigFile, CurObj->ObjectID, "ObjectEnabled", TrickyBuf))
-				{ /*Darn, we can't even do it the sneaky way!*/
-					free(TrickyBuf);
-					free(RunlevelText);
-					snprintf(OutBuf, sizeof OutBuf, MEMBUS_CODE_FAILURE " %s", BusData);
-					MemBus_Write(OutBuf, true);
-					return;
-				}
-				free(TrickyBuf);
-			}
-			
-		}
-		else
-		{ /*OBJRLS_DEL*/
-			/*Delete the line.*/
-			if (!EditConfigValue(CurObj->ConfigFile, CurObj->ObjectID, "ObjectRunlevels",
-								CurObj->ObjectRunlevels ? RunlevelText : NULL))
-			{ /*If we pass NULL to EditConfigValue(), it means we want to DELETE that line.*/
-				if (RunlevelText) free(RunlevelText);
-				snprintf(OutBuf, sizeof OutBuf, MEMBUS_CODE_FAILURE " %s", BusData);
-				MemBus_Write(OutBuf, true);
-				return;
-			}
-		
+			snprintf(OutBuf, sizeof OutBuf, MEMBUS_CODE_FAILURE " %s", BusData);
+			MemBus_Write(OutBuf, true);
+			return;
 		}
 		
-		if (RunlevelText) free(RunlevelText), RunlevelText = NULL;
-		
 		snprintf(OutBuf, sizeof OutBuf, MEMBUS_CODE_ACKNOWLEDGED " %s", BusData);
 		MemBus_Write(OutBuf, true);
 		return;
@@ -805,7 +1695,7 @@ void ParseMemBus(void)
 			snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_ACKNOWLEDGED, MSig);
 			MemBus_Write(TmpBuf, true);
 			
-			while (!MemBus_Read(TmpBuf, true)) usleep(100); /*Wait to be told they received it.*/
+			while (!MemBus_Read(TmpBuf, true) && !MemBus.SocketClosed) MemBus_Wait(true); /*Wait to be told they received it.*/
 			
 			LaunchShutdown(Signal);
 
@@ -936,7 +1826,7 @@ void ParseMemBus(void)
 			return;
 		}
 		
-		if (!(TmpObj = LookupObjectInTable(TWorker)) || !TmpObj->Started)
+		if (!(TmpObj = LookupObjectInTable(TWorker)) || !TmpObj->State->Started)
 		{ /*Bad argument?*/
 			snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_FAILURE, BusData);
 			MemBus_Write(TmpBuf, true);
@@ -945,7 +1835,7 @@ void ParseMemBus(void)
 		}
 		
 		snprintf(TmpBuf, sizeof TmpBuf, "%s %s %u", MEMBUS_CODE_SENDPID, TWorker,
-				(TmpObj->Opts.HasPIDFile ? ReadPIDFile(TmpObj) : TmpObj->ObjectPID));
+				(TmpObj->Opts.HasPIDFile ? ReadPIDFile(TmpObj) : TmpObj->State->ObjectPID));
 		MemBus_Write(TmpBuf, true);
 	}
 	else if (BusDataIs(MEMBUS_CODE_KILLOBJ) || BusDataIs(MEMBUS_CODE_OBJRELOAD))
@@ -964,7 +1854,7 @@ void ParseMemBus(void)
 			return;
 		}
 		
-		if (!(TmpObj = LookupObjectInTable(TWorker)) || !TmpObj->Started)
+		if (!(TmpObj = LookupObjectInTable(TWorker)) || !TmpObj->State->Started)
 		{ /*Bad argument?*/
 			snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_FAILURE, BusData);
 			MemBus_Write(TmpBuf, true);
@@ -975,17 +1865,17 @@ void ParseMemBus(void)
 		if (BusDataIs(MEMBUS_CODE_KILLOBJ))
 		{
 			/*Attempt to send SIGKILL to the PID.*/
-			if (!TmpObj->ObjectPID || 
-				kill((TmpObj->Opts.HasPIDFile ? ReadPIDFile(TmpObj) : TmpObj->ObjectPID), SIGKILL) != 0)
+			if (!TmpObj->State->ObjectPID || 
+				kill((TmpObj->Opts.HasPIDFile ? ReadPIDFile(TmpObj) : TmpObj->State->ObjectPID), SIGKILL) != 0)
 			{
 				snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_FAILURE, BusData);
 			}
 			else
 			{
 				snprintf(TmpBuf, sizeof TmpBuf, "%s %s", MEMBUS_CODE_ACKNOWLEDGED, BusData);
-				TmpObj->Started = false; /*Mark it as stopped now that it's dead.*/
-				TmpObj->ObjectPID = 0; /*Erase the PID.*/
-				TmpObj->StartedSince = 0;
+				TmpObj->State->Started = false; /*Mark it as stopped now that it's dead.*/
+				TmpObj->State->ObjectPID = 0; /*Erase the PID.*/
+				TmpObj->State->StartedSince = 0;
 			}
 			MemBus_Write(TmpBuf, true);
 		}
@@ -1050,18 +1940,90 @@ void ParseMemBus(void)
 	}
 }
 
+static void ParseMemBusMessage(void)
+{ /*One message from the selected slot, or the socket being served.*/
+	char BusData[MEMBUS_MSGSIZE], *Whole = NULL;
+	
+	if (!MemBus_ReadWhole(BusData, &Whole, true)) return;
+	
+	HandleMemBusMessage(BusData, Whole);
+	free(Whole);
+}
+
+void ParseMemBus(void)
+{ /*One message from each slot that has one, starting a slot further along each time, so nobody hogs us.*/
+	static unsigned NextSlot;
+	ReturnCode ReloadStatus;
+	unsigned Inc = 0;
+	
+	if (!BusRunning) return;
+	
+	if ((ReloadReplySlots || Control_ReloadWaiting()) && (ReloadStatus = ReloadConfig_Poll()) != WARNING)
+	{ /*The new configuration is in, so answer whoever asked for it.*/
+		const char *const Reply = ReloadStatus ? MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_RESET
+								: MEMBUS_CODE_FAILURE " " MEMBUS_CODE_RESET;
+		
+		for (; Inc < MEMBUS_SLOTS; ++Inc)
+		{
+			if (!(ReloadReplySlots & (1u << Inc))) continue;
+			
+			MemBus_Select(Inc);
+			MemBus_Write(Reply, true);
+		}
+		
+		ReloadReplySlots = 0;
+		Control_ReloadDone(Reply);
+		
+		if (ReloadStatus) Control_Event("RELOADED", NULL, NULL);
+	}
+	
+	for (Inc = 0; Inc < MEMBUS_SLOTS; ++Inc)
+	{
+		MemBus_Select((NextSlot + Inc) % MEMBUS_SLOTS);
+		ParseMemBusMessage();
+	}
+	
+	NextSlot = (NextSlot + 1) % MEMBUS_SLOTS;
+}
+
+Bool MemBus_ServeSocket(int Socket, Bool *ReloadPending)
+{ /*Server side. One message from a control socket connection, through the same handlers as the slots.
+	* Returns false once they've hung up.*/
+	Bool Closed;
+	
+	MemBus.Socket = Socket;
+	MemBus.SocketClosed = false;
+	MemBus.OverSocket = true;
+	SocketReloadPending = ReloadPending;
+	
+	ParseMemBusMessage();
+	
+	Closed = MemBus.SocketClosed;
+	MemBus.OverSocket = false;
+	SocketReloadPending = NULL;
+	
+	return !Closed;
+}
+
 ReturnCode ShutdownMemBus(Bool ServerSide)
 {	
-	if (!BusRunning || !MemBus.Root)
+	if (BusRunning && MemBus.OverSocket && !ServerSide)
 	{
+		close(MemBus.Socket);
+		BusRunning = false;
+		memset(&MemBus, 0, sizeof(struct _MemBusInterface));
 		return SUCCESS;
 	}
 	
-	*MemBus.Client.Status = MEMBUS_NOMSG;
+	if (!BusRunning || !MemBus.Root)
+	{
+		return SUCCESS;
+	}
 	
 	if (ServerSide)
 	{
-		*MemBus.Server.Status = MEMBUS_NOMSG;
+		MemBus_SetStatus(MemBus.Client.Status, MEMBUS_NOMSG);
+		MemBus_SetStatus(MemBus.Server.Status, MEMBUS_NOMSG);
 	
 		if (shmctl(MemDescriptor, IPC_RMID, NULL) == -1)
 		{
@@ -1070,9 +2032,10 @@ ReturnCode ShutdownMemBus(Bool ServerSide)
 		}
 	}
 	else
-	{ /*Release the client lock.*/
-		*MemBus.LockPID = 0;
+	{ /*Release our slot. Anything we just sent stays put for the server to pick up.*/
+		MemBus_SetStatus(MemBus.Client.Status, MEMBUS_NOMSG);
 		*MemBus.LockTime = 0;
+		__atomic_store_n(MemBus.LockPID, 0, __ATOMIC_SEQ_CST);
 	}
 	
 	if (shmdt(MemBus.Root) != 0)
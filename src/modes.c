@@ -66,7 +66,7 @@ ReturnCode SendPowerControl(const char *MembusCode)
 		return FAILURE;
 	}
 	
-	while (!MemBus_Read(InitsResponse, false)) usleep(1000); /*0.001 secs.*/
+	while (!MemBus_Read(InitsResponse, false)) MemBus_Wait(false);
 	
 	MemBus_Write(MembusCode, false); /*Tells init it can shut down the membus.*/
 	
@@ -86,55 +86,72 @@ ReturnCode SendPowerControl(const char *MembusCode)
 	return SUCCESS;
 }
 
-ReturnCode ObjControl(const char *ObjectID, const char *MemBusSignal)
-{ /*Start and stop or disable services.*/
-	char RemoteResponse[MEMBUS_MSGSIZE];
-	char OutMsg[MEMBUS_MSGSIZE];
-	char PossibleResponses[4][MEMBUS_MSGSIZE];
-	
-	snprintf(OutMsg, sizeof OutMsg, "%s %s", MemBusSignal, ObjectID);
+ReturnCode ObjControl_Batch(const char *Script)
+{ /*Sends a whole BATCH script, then reports on each object once Epoch has done the lot. Returns the worst of them.*/
+	static const struct { const char *Code, *Action; } Actions[] =
+	{
+		{ MEMBUS_CODE_OBJSTART, "Starting" }, { MEMBUS_CODE_OBJSTOP, "Stopping" }, { MEMBUS_CODE_OBJRESTART, "Restarting" },
+		{ MEMBUS_CODE_OBJENABLE, "Enabling" }, { MEMBUS_CODE_OBJDISABLE, "Disabling" }
+	};
+	const char *const Header = MEMBUS_CODE_ACKNOWLEDGED " " MEMBUS_CODE_BATCH "\n";
+	ReturnCode RetVal = SUCCESS;
+	char *Reply = NULL, *Line = NULL, *Next = NULL;
+	unsigned NumReported = 0;
 	
-	if (!MemBus_Write(OutMsg, false))
+	if (!MemBus_Write(Script, false) || !(Reply = MemBus_ReadLong(NULL, false)))
 	{
 		return FAILURE;
 	}
 	
-	while (!MemBus_Read(RemoteResponse, false)) usleep(1000); /*0.001 secs*/
+	if (strncmp(Reply, Header, strlen(Header)) != 0)
+	{
+		if (!strncmp(Reply, MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_BATCH " ", sizeof MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_BATCH " " - 1))
+		{
+			fprintf(stderr, "Epoch didn't understand \"%s\".\n", Reply + sizeof MEMBUS_CODE_BADPARAM " " MEMBUS_CODE_BATCH " " - 1);
+		}
+		else SpitError("\nReceived invalid reply from membus.");
+		
+		free(Reply);
+		return FAILURE;
+	}
 	
-	snprintf(PossibleResponses[0], sizeof PossibleResponses[0], "%s %s %s",
-		MEMBUS_CODE_ACKNOWLEDGED, MemBusSignal, ObjectID);
+	for (Line = Reply + strlen(Header); *Line != '\0'; Line = Next)
+	{ /*Each line is the result, what was done, and to which object.*/
+		char *ObjCode = NULL, *ObjectID = NULL, TOut[MAX_LINE_SIZE];
+		const char *Action = "Controlling";
+		ReturnCode Result = FAILURE;
+		unsigned Inc = 0;
 		
-	snprintf(PossibleResponses[1], sizeof PossibleResponses[1], "%s %s %s",
-		MEMBUS_CODE_FAILURE, MemBusSignal, ObjectID);
+		if ((Next = strchr(Line, '\n'))) *Next++ = '\0';
+		else Next = Line + strlen(Line);
 		
-	snprintf(PossibleResponses[2], sizeof PossibleResponses[2], "%s %s",
-		MEMBUS_CODE_BADPARAM, OutMsg);
-
-	snprintf(PossibleResponses[3], sizeof PossibleResponses[3], "%s %s %s",
-		MEMBUS_CODE_WARNING, MemBusSignal, ObjectID);
+		if (!(ObjCode = strchr(Line, ' ')) || !(ObjectID = strchr(ObjCode + 1, ' '))) continue;
 		
-	if (!strcmp(RemoteResponse, PossibleResponses[0]))
-	{
-		return SUCCESS;
-	}
-	else if (!strcmp(RemoteResponse, PossibleResponses[1]))
-	{
-		return FAILURE;
-	}
-	else if (!strcmp(RemoteResponse, PossibleResponses[3]))
-	{
-		return WARNING;
-	}
-	else if (!strcmp(RemoteResponse, PossibleResponses[2]))
-	{
-		SpitError("\nWe are being told that we sent a bad parameter.");
-		return FAILURE;
-	}
-	else
-	{
-		SpitError("\nReceived invalid reply from membus.");
-		return FAILURE;
+		*ObjCode++ = '\0';
+		*ObjectID++ = '\0';
+		
+		if (!strcmp(Line, MEMBUS_CODE_ACKNOWLEDGED)) Result = SUCCESS;
+		else if (!strcmp(Line, MEMBUS_CODE_WARNING)) Result = WARNING;
+		
+		for (; Inc < sizeof Actions / sizeof *Actions; ++Inc)
+		{
+			if (!strcmp(ObjCode, Actions[Inc].Code)) Action = Actions[Inc].Action;
+		}
+		
+		snprintf(TOut, sizeof TOut, "%s %s", Action, ObjectID);
+		BeginStatusReport(TOut);
+		CompleteStatusReport(TOut, Result, false);
+		
+		if (!Result) RetVal = FAILURE;
+		else if (Result == WARNING && RetVal == SUCCESS) RetVal = WARNING;
+		
+		++NumReported;
 	}
+	
+	if (!NumReported) puts("Nothing to do.");
+	
+	free(Reply);
+	return RetVal;
 }
 
 ReturnCode EmulKillall5(unsigned InSignal)
@@ -437,7 +454,7 @@ ReturnCode EmulShutdown(int ArgumentCount, const char **ArgStream)
 		return FAILURE;
 	}
 	
-	while (!MemBus_Read(InRecv, false)) usleep(1000); /*Wait for a response.*/
+	while (!MemBus_Read(InRecv, false)) MemBus_Wait(false); /*Wait for a response.*/
 	
 	if (ImmediateHalt) MemBus_Write(" ", false); /*Tells init it can shut down the membus.*/
 	
@@ -0,0 +1,389 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**This file keeps changes made at runtime, like "epoch disable"
+ * and "epoch objrl add", in an append-only state overlay under
+ * STATEDIR instead of rewriting configuration files. The overlay
+ * is replayed over the object table whenever the configuration
+ * is loaded, and rewritten compactly once it's mostly dead records.**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "epoch.h"
+
+#define OVERLAY_SYNC_INTERVAL 1 /*Seconds. Changes reach the disk at most this often, with one fsync for the lot.*/
+#define OVERLAY_COMPACT_MIN 64 /*Never bother compacting a file with fewer records than this.*/
+
+enum OverlayField { OVERLAY_ENABLED, OVERLAY_RUNLEVELS, OVERLAY_NUMFIELDS };
+
+static const char *const OverlayFieldNames[OVERLAY_NUMFIELDS] = { "enabled", "runlevels" };
+static const char *const OverlayAttrNames[OVERLAY_NUMFIELDS] = { "ObjectEnabled", "ObjectRunlevels" };
+
+struct _OverlayEntry
+{ /*Base is what the configuration said when we first overrode it, so we can tell
+	* when someone has edited the file by hand since. Value is NULL if not overridden.*/
+	char *ObjectID;
+	char *Value[OVERLAY_NUMFIELDS];
+	char *Base[OVERLAY_NUMFIELDS];
+	unsigned char Local; /*Bit per field, set if it changed here before we could read the file.*/
+};
+
+static struct
+{
+	struct _OverlayEntry *Entries;
+	unsigned NumEntries, Capacity;
+	unsigned FileRecords; /*Lines in the file, live or not.*/
+	char *Pending; /*Records that aren't on disk yet.*/
+	size_t PendingSize;
+	time_t LastSync, LastLoad;
+	Bool Loaded, NeedCompact;
+} Overlay;
+
+static struct _OverlayEntry *Overlay_Find(const char *ObjectID, Bool Create)
+{
+	unsigned Inc = 0;
+	
+	for (; Inc < Overlay.NumEntries; ++Inc)
+	{
+		if (!strcmp(Overlay.Entries[Inc].ObjectID, ObjectID)) return Overlay.Entries + Inc;
+	}
+	
+	if (!Create) return NULL;
+	
+	if (Overlay.NumEntries == Overlay.Capacity)
+	{
+		const unsigned NewCapacity = Overlay.Capacity ? Overlay.Capacity * 2 : 32;
+		struct _OverlayEntry *const NewEntries = realloc(Overlay.Entries, sizeof(struct _OverlayEntry) * NewCapacity);
+		
+		if (!NewEntries) return NULL;
+		
+		Overlay.Entries = NewEntries;
+		Overlay.Capacity = NewCapacity;
+	}
+	
+	memset(Overlay.Entries + Overlay.NumEntries, 0, sizeof(struct _OverlayEntry));
+	
+	if (!(Overlay.Entries[Overlay.NumEntries].ObjectID = strdup(ObjectID))) return NULL;
+	
+	return Overlay.Entries + Overlay.NumEntries++;
+}
+
+static void Overlay_Set(struct _OverlayEntry *Entry, enum OverlayField Field, const char *Value, const char *Base)
+{ /*NULL Value clears the override.*/
+	free(Entry->Value[Field]);
+	free(Entry->Base[Field]);
+	
+	Entry->Value[Field] = Value ? strdup(Value) : NULL;
+	Entry->Base[Field] = Value ? strdup(Base) : NULL;
+}
+
+static void Overlay_Describe(const ObjTable *Obj, enum OverlayField Field, char *OutStream, size_t OutSize)
+{ /*What the object has right now, in the same form the config file uses.*/
+	const struct _RLTree *Worker = Obj->ObjectRunlevels;
+	size_t Length = 0;
+	
+	if (Field == OVERLAY_ENABLED)
+	{
+		snprintf(OutStream, OutSize, "%s", Obj->State->Enabled ? "true" : "false");
+		return;
+	}
+	
+	*OutStream = '\0';
+	
+	for (; Worker && Worker->Next && Length < OutSize; Worker = Worker->Next)
+	{
+		Length += snprintf(OutStream + Length, OutSize - Length, Length ? " %s" : "%s", Worker->RL);
+	}
+}
+
+static void Overlay_Queue(const char *ObjectID, enum OverlayField Field, const char *Value, const char *Base)
+{ /*Tab separated, since none of these can contain a tab.*/
+	const size_t Length = strlen(OverlayFieldNames[Field]) + strlen(ObjectID) + strlen(Value) + strlen(Base) + 4;
+	char *const NewPending = realloc(Overlay.Pending, Overlay.PendingSize + Length + 1);
+	
+	if (!NewPending)
+	{ /*The entry still gets the change, and compacting writes out every entry.*/
+		Overlay.NeedCompact = true;
+		return;
+	}
+	
+	Overlay.Pending = NewPending;
+	snprintf(Overlay.Pending + Overlay.PendingSize, Length + 1, "%s\t%s\t%s\t%s\n",
+			OverlayFieldNames[Field], ObjectID, Value, Base);
+	Overlay.PendingSize += Length;
+	++Overlay.FileRecords;
+}
+
+static void Overlay_Load(void)
+{ /*Read what's on disk. Anything changed here before we could read it wins over the file.*/
+	struct stat FileStat;
+	char *Buffer = NULL, *Worker = NULL, *LineEnd = NULL;
+	int Descriptor = open(OVERLAYFILE, O_RDONLY | O_CLOEXEC);
+	ssize_t Got = 0;
+	
+	if (Descriptor == -1)
+	{ /*No file is fine, as long as it could be there. A missing STATEDIR might just not be mounted yet.*/
+		Overlay.Loaded = errno == ENOENT && stat(STATEDIR, &FileStat) == 0;
+		return;
+	}
+	
+	if (fstat(Descriptor, &FileStat) != 0 || !(Buffer = malloc(FileStat.st_size + 1)) ||
+		(Got = read(Descriptor, Buffer, FileStat.st_size)) < 0)
+	{
+		free(Buffer);
+		close(Descriptor);
+		return;
+	}
+	close(Descriptor);
+	Buffer[Got] = '\0';
+	
+	/*A line without a newline is one a crash cut short, so it never counts.*/
+	for (Worker = Buffer; (LineEnd = strchr(Worker, '\n')); Worker = LineEnd + 1)
+	{
+		char *Fields[4] = { Worker };
+		unsigned Inc = 1, Field = 0;
+		struct _OverlayEntry *Entry = NULL;
+		
+		*LineEnd = '\0';
+		++Overlay.FileRecords;
+		
+		for (; Inc < 4 && (Fields[Inc] = strchr(Fields[Inc - 1], '\t')); ++Inc)
+		{
+			*Fields[Inc]++ = '\0';
+		}
+		
+		if (Inc != 4 || !*Fields[1] || strchr(Fields[3], '\t')) continue;
+		
+		for (; Field < OVERLAY_NUMFIELDS && strcmp(Fields[0], OverlayFieldNames[Field]) != 0; ++Field);
+		
+		if (Field == OVERLAY_NUMFIELDS) continue;
+		
+		Entry = Overlay_Find(Fields[1], true);
+		
+		if (!Entry || (Entry->Local & (1 << Field))) continue;
+		
+		/*Setting something back to what the config says is how an override ends.*/
+		Overlay_Set(Entry, Field, strcmp(Fields[2], Fields[3]) ? Fields[2] : NULL, Fields[3]);
+	}
+	
+	free(Buffer);
+	Overlay.Loaded = true;
+}
+
+void Overlay_Apply(void)
+{ /*Replay the overrides over the object table. Safe to repeat on a table that already has them.*/
+	char Current[MAX_LINE_SIZE], ErrBuf[MAX_LINE_SIZE];
+	unsigned Inc = 0, Field = 0;
+	
+	if (!Overlay.Loaded) Overlay_Load();
+	
+	for (; Inc < Overlay.NumEntries; ++Inc)
+	{
+		struct _OverlayEntry *const Entry = Overlay.Entries + Inc;
+		ObjTable *const Obj = LookupObjectInTable(Entry->ObjectID);
+		
+		if (!Obj) continue; /*Keep it. The object may only be gone until the next reload.*/
+		
+		for (Field = 0; Field < OVERLAY_NUMFIELDS; ++Field)
+		{
+			if (!Entry->Value[Field]) continue;
+			
+			Overlay_Describe(Obj, Field, Current, sizeof Current);
+			
+			if (!strcmp(Current, Entry->Value[Field])) continue;
+			
+			if (strcmp(Current, Entry->Base[Field]) != 0)
+			{ /*The file says something new, so whoever edited it gets the last word.*/
+				snprintf(ErrBuf, sizeof ErrBuf, "CONFIG: %s for object \"%s\" was changed in its config file. "
+						"Dropping the saved runtime setting.", OverlayAttrNames[Field], Entry->ObjectID);
+				WriteLogLine(ErrBuf, true);
+				
+				Overlay_Set(Entry, Field, NULL, NULL);
+				Overlay.NeedCompact = true;
+				continue;
+			}
+			
+			if (Field == OVERLAY_ENABLED)
+			{
+				Obj->State->Enabled = !strcmp(Entry->Value[Field], "true");
+			}
+			else
+			{
+				const char *Worker = Entry->Value[Field];
+				char RL[MAX_DESCRIPT_SIZE];
+				size_t Length = 0;
+				
+				ObjRL_ShutdownRunlevels(Obj);
+				
+				for (; *Worker; Worker += Length + (Worker[Length] == ' '))
+				{
+					Length = strcspn(Worker, " ");
+					snprintf(RL, sizeof RL, "%.*s", (int)Length, Worker);
+					if (*RL) ObjRL_AddRunlevel(RL, Obj);
+				}
+			}
+		}
+	}
+}
+
+static ReturnCode Overlay_Record(const ObjTable *Obj, enum OverlayField Field, const char *Before)
+{
+	struct _OverlayEntry *const Entry = Overlay_Find(Obj->ObjectID, true);
+	char Now[MAX_LINE_SIZE];
+	char *SavedBase = NULL;
+	
+	if (!Entry || !(SavedBase = strdup(Entry->Value[Field] ? Entry->Base[Field] : Before))) return FAILURE;
+	
+	Overlay_Describe(Obj, Field, Now, sizeof Now);
+	
+	Overlay_Queue(Obj->ObjectID, Field, Now, SavedBase);
+	Overlay_Set(Entry, Field, strcmp(Now, SavedBase) ? Now : NULL, SavedBase);
+	Entry->Local |= 1 << Field;
+	
+	free(SavedBase);
+	return SUCCESS;
+}
+
+ReturnCode Overlay_RecordEnabled(const ObjTable *Obj, Bool Before)
+{ /*Call after changing the object, with what it was before.*/
+	return Overlay_Record(Obj, OVERLAY_ENABLED, Before ? "true" : "false");
+}
+
+ReturnCode Overlay_RecordRunlevels(const ObjTable *Obj, const char *Before)
+{ /*Before comes from Overlay_DescribeRunlevels().*/
+	return Overlay_Record(Obj, OVERLAY_RUNLEVELS, Before);
+}
+
+void Overlay_DescribeRunlevels(const ObjTable *Obj, char *OutStream, size_t OutSize)
+{
+	Overlay_Describe(Obj, OVERLAY_RUNLEVELS, OutStream, OutSize);
+}
+
+static Bool Overlay_SyncDir(void)
+{ /*So a rename survives a crash too.*/
+	const int Descriptor = open(STATEDIR, O_RDONLY | O_CLOEXEC);
+	Bool RetVal = false;
+	
+	if (Descriptor == -1) return false;
+	
+	RetVal = fsync(Descriptor) == 0;
+	close(Descriptor);
+	
+	return RetVal;
+}
+
+static ReturnCode Overlay_Compact(void)
+{ /*Write only what's live, beside the old file, then swap it in.*/
+	const char *const TempPath = OVERLAYFILE ".new";
+	FILE *Descriptor = NULL;
+	unsigned Inc = 0, Field = 0, NumRecords = 0;
+	Bool Written = false;
+	int FD = open(TempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	
+	if (FD == -1 || !(Descriptor = fdopen(FD, "w")))
+	{
+		if (FD != -1) close(FD);
+		return FAILURE;
+	}
+	
+	for (; Inc < Overlay.NumEntries; ++Inc)
+	{
+		for (Field = 0; Field < OVERLAY_NUMFIELDS; ++Field)
+		{
+			if (!Overlay.Entries[Inc].Value[Field]) continue;
+			
+			fprintf(Descriptor, "%s\t%s\t%s\t%s\n", OverlayFieldNames[Field], Overlay.Entries[Inc].ObjectID,
+					Overlay.Entries[Inc].Value[Field], Overlay.Entries[Inc].Base[Field]);
+			++NumRecords;
+		}
+	}
+	
+	Written = fflush(Descriptor) == 0 && fsync(FD) == 0;
+	Written = fclose(Descriptor) == 0 && Written;
+	
+	if (!Written || rename(TempPath, OVERLAYFILE) != 0)
+	{
+		unlink(TempPath);
+		return FAILURE;
+	}
+	
+	Overlay_SyncDir();
+	
+	Overlay.FileRecords = NumRecords;
+	return SUCCESS;
+}
+
+void Overlay_Sync(Bool Now)
+{ /*Called from the primary loop. Now is for shutdown and reexec, when there's no later.*/
+	unsigned Inc = 0, Field = 0, NumLive = 0;
+	int Descriptor = 0;
+	Bool Written = false;
+	
+	if (!Overlay.Loaded && (Now || time(NULL) - Overlay.LastLoad >= OVERLAY_SYNC_INTERVAL))
+	{ /*We couldn't read it at boot. Once STATEDIR is mounted we can, even if nothing changed here since.*/
+		Overlay.LastLoad = time(NULL);
+		
+		Overlay_Load();
+		
+		/*Whatever the file had that we didn't goes onto the table now.*/
+		if (Overlay.Loaded) Overlay_Apply();
+	}
+	
+	if (!Overlay.PendingSize && !Overlay.NeedCompact) return;
+	
+	if (!Now && time(NULL) - Overlay.LastSync < OVERLAY_SYNC_INTERVAL) return;
+	
+	Overlay.LastSync = time(NULL);
+	
+	if (!Overlay.Loaded)
+	{ /*Still nothing to read, but we have something to write. Make STATEDIR if it isn't there.*/
+		if (mkdir(STATEDIR, 0755) != 0 && errno != EEXIST) return;
+		
+		Overlay_Load();
+		if (!Overlay.Loaded) return;
+		
+		Overlay_Apply();
+	}
+	
+	for (; Inc < Overlay.NumEntries; ++Inc)
+	{
+		for (Field = 0; Field < OVERLAY_NUMFIELDS; ++Field)
+		{
+			if (Overlay.Entries[Inc].Value[Field]) ++NumLive;
+		}
+	}
+	
+	if (Overlay.NeedCompact || (Overlay.FileRecords >= OVERLAY_COMPACT_MIN && Overlay.FileRecords > NumLive * 4))
+	{ /*The compacted file already has everything pending in it.*/
+		if (!Overlay_Compact()) return;
+		
+		Overlay.NeedCompact = false;
+	}
+	else
+	{
+		if ((Descriptor = open(OVERLAYFILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600)) == -1) return;
+		
+		Written = write(Descriptor, Overlay.Pending, Overlay.PendingSize) == (ssize_t)Overlay.PendingSize &&
+				fsync(Descriptor) == 0;
+		close(Descriptor);
+		
+		if (!Written)
+		{ /*A torn line is ignored when read, but anything appended after it would be lost with it.*/
+			Overlay.NeedCompact = true;
+			return;
+		}
+	}
+	
+	free(Overlay.Pending);
+	Overlay.Pending = NULL;
+	Overlay.PendingSize = 0;
+}
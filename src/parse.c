@@ -14,6 +14,9 @@
 #include <grp.h>
 #include <ctype.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "epoch.h"
 
 /**Globals**/
@@ -44,26 +47,1000 @@ static Bool FileUsable(const char *FileName)
 	}
 }	
 
+enum ExecLink { EXECLINK_END, EXECLINK_SEQ, EXECLINK_AND, EXECLINK_OR, EXECLINK_PIPE };
+
+struct _ExecRedirect
+{
+	const char *Path; /*NULL to duplicate DupFD instead.*/
+	int Flags;
+	int FD, DupFD;
+};
+
+struct _ExecStep
+{ /*One simple command.*/
+	const char *Path; /*NULL if PATH didn't have it at load time. The child searches again then.*/
+	char **ArgV;
+	struct _ExecRedirect *Redirects;
+	unsigned NumRedirects;
+	enum ExecLink Link; /*How it joins the step after it.*/
+};
+
+struct _ExecPlan
+{ /*Everything a command needs at exec time, worked out once when the configuration loads,
+	* so the child only has to set credentials and call execve(). Lives in the config arena,
+	* unless ExecPlan_Rebuild() made it.*/
+	struct _ExecStep *Steps; /*Just one, unless our own interpreter is running a command line.*/
+	unsigned NumSteps;
+	char **EnvP;
+	const char *HomeDir; /*Where a start command goes if it has no working directory.*/
+	gid_t *Groups;
+	int NumGroups;
+	unsigned GroupID;
+	Bool SetUser; /*Only start commands run as ObjectUser.*/
+	Bool NoUser; /*ObjectUser isn't in the passwd database anymore, so we can't run.*/
+	Bool UsesShell; /*Only then do we have to guess at the PID with ShellDissolves.*/
+	Bool IsBuiltin; /*A BUILTIN action. Steps->ArgV starts with its name, and we never fork.*/
+	const char *BuiltinError; /*Set if it's a BUILTIN we can't run. Reported again each time it's tried.*/
+};
+
+static struct
+{ /*Chosen once per configuration, not on every exec.*/
+	const char *Path;
+	Bool Enabled;
+	Bool Dissolves;
+} ExecShell;
+
+static struct
+{ /*So we notice when a user's credentials change under us.*/
+	time_t Passwd, Group;
+} ExecPlanStamp;
+
+static struct
+{ /*Plans rebuilt because the user databases changed. The arena can't give memory back
+	* until the next load, so these come from the heap, and go when they're replaced.*/
+	void **Blocks;
+	unsigned NumBlocks, Capacity;
+	Bool Active; /*ExecPlan_Alloc() takes from here instead of the arena.*/
+} ExecPlanHeap;
+
+static void ExecPlan_PickShell(void)
+{ /*Check how we should handle PIDs for each shell. In order to get the PID, exit status,
+	* and support shell commands, we need to jump through a bunch of hoops.*/
+	static Bool DidWarn = false;
+	
+	ExecShell.Path = "/bin/sh";
+	ExecShell.Dissolves = SHELLDISSOLVES;
+	ExecShell.Enabled = false;
+
+#ifndef NOSHELL
+	ExecShell.Enabled = true;
+	
+	if (FileUsable(SHELLPATH))
+	{ /*Try our specified shell first.*/
+		ExecShell.Path = SHELLPATH;
+	}
+	else if (FileUsable("/bin/bash"))
+	{
+		ExecShell.Dissolves = true;
+		ExecShell.Path = "/bin/bash";
+	}
+	else if (FileUsable("/bin/dash"))
+	{
+		ExecShell.Path = "/bin/dash";
+		ExecShell.Dissolves = true;
+	}
+	else if (FileUsable("/bin/zsh"))
+	{
+		ExecShell.Path = "/bin/zsh";
+		ExecShell.Dissolves = true;
+	}
+	else if (FileUsable("/bin/csh"))
+	{
+		ExecShell.Path = "/bin/csh";
+		ExecShell.Dissolves = true;
+	}
+	else if (FileUsable("/bin/tcsh"))
+	{
+		ExecShell.Path = "/bin/tcsh";
+		ExecShell.Dissolves = true;
+	}
+	else if (FileUsable("/bin/ksh"))
+	{
+		ExecShell.Path = "/bin/ksh";
+		ExecShell.Dissolves = true;
+	}
+	else if (FileUsable("/bin/busybox"))
+	{ /*This is one of those weird shells that still does the old practice of creating a child for -c.
+		* We can deal with the likes of them. Small chance that for shells like this, another PID could jump in front
+		* and we could end up storing the wrong one. Very small, but possible.*/
+		ExecShell.Path = "/bin/busybox";
+		ExecShell.Dissolves = false;
+	}
+	else /*Found no other shells. Assume fossil, spit warning.*/
+	{
+		const char *Errs[2] = { ("Cannot find any functioning shell. /bin/sh is not available.\n"
+								 CONSOLE_COLOR_YELLOW "** Disabling shell support! **" CONSOLE_ENDCOLOR),
+								("No known shell found. Using \"/bin/sh\".\n"
+								"Best if you install one of these: bash, dash, csh, zsh, or busybox.\n") };
+		
+		if (!FileUsable("/bin/sh"))
+		{
+			ExecShell.Enabled = false; /*Disable shell support.*/
+			
+			if (!DidWarn)
+			{
+				SpitWarning(Errs[0]);
+				WriteLogLine(Errs[0], true);
+			}
+		}
+		else
+		{
+			ExecShell.Dissolves = true; /*Most do.*/
+			
+			if (!DidWarn)
+			{
+				SpitWarning(Errs[1]);
+				WriteLogLine(Errs[1], true);
+			}
+		}
+		
+		DidWarn = true;
+	}
+	
+	if (!DidWarn && strcmp(ExecShell.Path, ENVVAR_SHELL) != 0)
+	{ /*Only happens if we are using a known shell, even if it's not ours.*/
+		char ErrBuf[MAX_LINE_SIZE];
+		
+		snprintf(ErrBuf, sizeof ErrBuf, "\"" ENVVAR_SHELL "\" cannot be read. Using \"%s\" instead.", ExecShell.Path);
+		
+		/*Just write to log, because this happens.*/
+		WriteLogLine(ErrBuf, true);
+		SpitWarning(ErrBuf);
+		DidWarn = true;
+	}
+#endif /*NOSHELL*/
+}
+
+static void *ExecPlan_Alloc(size_t Size)
+{ /*Zeroed, like the arena.*/
+	void *RetVal = NULL;
+	
+	if (!ExecPlanHeap.Active) return ConfigArena_Alloc(Size);
+	
+	if (ExecPlanHeap.NumBlocks == ExecPlanHeap.Capacity)
+	{
+		void **const NewBlocks = realloc(ExecPlanHeap.Blocks, sizeof(void*) * (ExecPlanHeap.Capacity * 2 + 16));
+		
+		if (!NewBlocks) return ConfigArena_Alloc(Size); /*Better to keep it around for good than not have it.*/
+		
+		ExecPlanHeap.Blocks = NewBlocks;
+		ExecPlanHeap.Capacity = ExecPlanHeap.Capacity * 2 + 16;
+	}
+	
+	if (!(RetVal = calloc(1, Size))) return ConfigArena_Alloc(Size);
+	
+	return ExecPlanHeap.Blocks[ExecPlanHeap.NumBlocks++] = RetVal;
+}
+
+static char *ExecPlan_StrDup(const char *InStream)
+{
+	const size_t Length = strlen(InStream) + 1;
+	
+	return memcpy(ExecPlan_Alloc(Length), InStream, Length);
+}
+
+static void ExecPlan_FreeHeap(void **Blocks, unsigned NumBlocks)
+{
+	unsigned Inc = 0;
+	
+	for (; Inc < NumBlocks; ++Inc) free(Blocks[Inc]);
+	
+	free(Blocks);
+}
+
+static void ExecPlan_SetEnv(char **EnvP, unsigned *NumVars, char *Var)
+{ /*Later ones replace earlier ones of the same name, like putenv() did.*/
+	const size_t NameLength = strcspn(Var, "=");
+	unsigned Inc = 0;
+	
+	if (Var[NameLength] != '=') return;
+	
+	for (; Inc < *NumVars; ++Inc)
+	{
+		if (!strncmp(EnvP[Inc], Var, NameLength + 1))
+		{
+			EnvP[Inc] = Var;
+			return;
+		}
+	}
+	
+	EnvP[(*NumVars)++] = Var;
+}
+
+static char *ExecPlan_EnvString(const char *Name, const char *Value)
+{
+	const size_t Length = strlen(Name) + strlen(Value) + 2;
+	char *const RetVal = ExecPlan_Alloc(Length);
+	
+	snprintf(RetVal, Length, "%s=%s", Name, Value);
+	return RetVal;
+}
+
+static const char *ExecPlan_SearchPath(char *const *EnvP)
+{
+	for (; *EnvP; ++EnvP)
+	{
+		if (!strncmp(*EnvP, "PATH=", sizeof "PATH=" - 1)) return *EnvP + sizeof "PATH=" - 1;
+	}
+	
+	return ENVVAR_PATH;
+}
+
+static const char *ExecPlan_ResolvePath(const char *Binary, char *const *EnvP)
+{ /*The same search execvp() does, but now instead of in every child.*/
+	const char *Worker = NULL;
+	char Candidate[MAX_LINE_SIZE];
+	size_t Length = 0;
+	
+	if (strchr(Binary, '/')) return Binary;
+	
+	for (Worker = ExecPlan_SearchPath(EnvP); *Worker; Worker += Length + (Worker[Length] == ':'))
+	{
+		Length = strcspn(Worker, ":");
+		
+		/*An empty element means the current directory. Only the child knows what that is.*/
+		if (!Length) return NULL;
+		
+		snprintf(Candidate, sizeof Candidate, "%.*s/%s", (int)Length, Worker, Binary);
+		
+		if (access(Candidate, X_OK) == 0) return ExecPlan_StrDup(Candidate);
+	}
+	
+	return NULL;
+}
+
+/**A small command line interpreter, for what most objects only use a shell for: sequences,
+ * && and ||, pipes, redirection, quoting, and $VAR. It runs at load time against the plan's
+ * environment, so the child just forks and execs. Anything else, and we use the real shell.**/
+
+struct _CmdLineState
+{ /*Scratch space while compiling. Only what we keep goes in the arena.*/
+	const char *Cmd;
+	size_t Pos;
+	char *const *EnvP;
+	char *Word; /*The word being read.*/
+	size_t WordSize, WordCapacity;
+	Bool Quoted; /*Quoted words count even if they're empty.*/
+	Bool PendingRedirect; /*The next word is where the last redirect goes.*/
+	char **Words;
+	unsigned NumWords;
+	struct _ExecRedirect *Redirects;
+	unsigned NumRedirects;
+	struct _ExecStep *Steps;
+	unsigned NumSteps;
+};
+
+/*Keywords and builtins. These mean nothing without a shell, so we leave them to one.*/
+static const char *const CmdLineShellWords[] = { "if", "then", "else", "elif", "fi", "case", "esac", "for", "select",
+												"while", "until", "do", "done", "function", "time", "{", "}", "!", "[[",
+												":", ".", "cd", "exec", "exit", "export", "set", "unset", "source", "eval",
+												"read", "ulimit", "umask", "trap", "shift", "alias", "unalias", "wait",
+												"return", "local", "readonly", "declare", "typeset", "let", "command",
+												"builtin", "hash", "type", "getopts", "jobs", "fg", "bg", "times", NULL };
+
+static Bool CmdLine_IsNameChar(char Char, Bool First)
+{
+	return Char == '_' || isalpha((unsigned char)Char) || (!First && isdigit((unsigned char)Char));
+}
+
+static void CmdLine_Append(struct _CmdLineState *State, const char *Data, size_t Length)
+{
+	if (State->WordSize + Length + 1 > State->WordCapacity)
+	{
+		State->WordCapacity = (State->WordSize + Length + 1) * 2;
+		State->Word = realloc(State->Word, State->WordCapacity);
+	}
+	
+	memcpy(State->Word + State->WordSize, Data, Length);
+	State->WordSize += Length;
+	State->Word[State->WordSize] = '\0';
+}
+
+static Bool CmdLine_Expand(struct _CmdLineState *State, Bool InQuotes)
+{ /*Pos is just past the $. Only $NAME and ${NAME}, nothing fancier.*/
+	const char *Name = State->Cmd + State->Pos, *Value = "";
+	const Bool Braced = *Name == '{';
+	char *const *Env = State->EnvP;
+	size_t Length = 0;
+	
+	Name += Braced;
+	
+	for (; CmdLine_IsNameChar(Name[Length], !Length); ++Length);
+	
+	if (!Length || (Braced && Name[Length] != '}')) return false;
+	
+	State->Pos = Name + Length + Braced - State->Cmd;
+	
+	for (; *Env; ++Env)
+	{
+		if (!strncmp(*Env, Name, Length) && (*Env)[Length] == '=')
+		{
+			Value = *Env + Length + 1;
+			break;
+		}
+	}
+	
+	/*Unquoted, a shell would split this into words and glob them.*/
+	if (!InQuotes && strpbrk(Value, " \t\n*?[")) return false;
+	
+	CmdLine_Append(State, Value, strlen(Value));
+	return true;
+}
+
+static Bool CmdLine_Word(struct _CmdLineState *State)
+{ /*Reads one word into State->Word.*/
+	const char *const Cmd = State->Cmd;
+	
+	State->WordSize = 0;
+	State->Quoted = false;
+	CmdLine_Append(State, "", 0);
+	
+	/*Comments and home directories.*/
+	if (Cmd[State->Pos] == '#' || Cmd[State->Pos] == '~') return false;
+	
+	while (Cmd[State->Pos] && !strchr(" \t;&|<>", Cmd[State->Pos]))
+	{
+		const char Char = Cmd[State->Pos++];
+		
+		switch (Char)
+		{
+			case '\'':
+			{
+				const char *const End = strchr(Cmd + State->Pos, '\'');
+				
+				if (!End) return false;
+				
+				CmdLine_Append(State, Cmd + State->Pos, End - (Cmd + State->Pos));
+				State->Pos = End - Cmd + 1;
+				State->Quoted = true;
+				break;
+			}
+			case '"':
+				for (State->Quoted = true; Cmd[State->Pos] != '"'; )
+				{
+					const char Inner = Cmd[State->Pos++];
+					
+					if (!Inner || Inner == '`') return false;
+					
+					if (Inner == '$')
+					{
+						if (!CmdLine_Expand(State, true)) return false;
+					}
+					else if (Inner == '\\' && Cmd[State->Pos] && strchr("$`\"\\", Cmd[State->Pos]))
+					{
+						CmdLine_Append(State, Cmd + State->Pos++, 1);
+					}
+					else CmdLine_Append(State, &Inner, 1);
+				}
+				++State->Pos;
+				break;
+			case '\\':
+				if (!Cmd[State->Pos]) return false;
+				
+				CmdLine_Append(State, Cmd + State->Pos++, 1);
+				break;
+			case '$':
+				if (!CmdLine_Expand(State, false)) return false;
+				break;
+			case '[': /*On its own, that's just test.*/
+				if (State->WordSize || (Cmd[State->Pos] && !strchr(" \t", Cmd[State->Pos]))) return false;
+				
+				CmdLine_Append(State, &Char, 1);
+				break;
+			case '`': case '(': case ')': case '*': case '?': case '{': case '}':
+				return false; /*Command substitution, subshells, globs and brace expansion.*/
+			default:
+				CmdLine_Append(State, &Char, 1);
+				break;
+		}
+	}
+	
+	return true;
+}
+
+static Bool CmdLine_Redirect(struct _CmdLineState *State)
+{ /*[n]<, [n]>, [n]>>, and [n]>&m. Pos is at the start of it.*/
+	const char *Here = State->Cmd + State->Pos;
+	struct _ExecRedirect *const Redirect = State->Redirects + State->NumRedirects;
+	
+	if (State->PendingRedirect) return false;
+	
+	Redirect->FD = isdigit((unsigned char)*Here) ? *Here++ - '0' : -1;
+	Redirect->Path = NULL;
+	Redirect->DupFD = -1;
+	
+	if (*Here == '<')
+	{
+		if (Here[1] == '<' || Here[1] == '&' || Here[1] == '>') return false; /*Here documents and friends.*/
+		
+		if (Redirect->FD == -1) Redirect->FD = STDIN_FILENO;
+		Redirect->Flags = O_RDONLY;
+	}
+	else
+	{
+		if (Redirect->FD == -1) Redirect->FD = STDOUT_FILENO;
+		Redirect->Flags = O_WRONLY | O_CREAT | O_TRUNC;
+		
+		if (Here[1] == '|') return false;
+		
+		if (Here[1] == '>')
+		{
+			Redirect->Flags = O_WRONLY | O_CREAT | O_APPEND;
+			++Here;
+		}
+		else if (Here[1] == '&')
+		{ /*Only a single digit and nothing after it. No closing, no moving.*/
+			if (!isdigit((unsigned char)Here[2]) || (Here[3] && !strchr(" \t;&|<>", Here[3]))) return false;
+			
+			Redirect->DupFD = Here[2] - '0';
+			Here += 2;
+		}
+	}
+	
+	State->Pos = Here + 1 - State->Cmd;
+	State->PendingRedirect = Redirect->DupFD == -1;
+	++State->NumRedirects;
+	
+	return true;
+}
+
+static Bool CmdLine_EndStep(struct _CmdLineState *State, enum ExecLink Link)
+{
+	struct _ExecStep *Step = NULL;
+	unsigned Inc = 0;
+	
+	/*A redirect to nowhere.*/
+	if (State->PendingRedirect) return false;
+	
+	if (!State->NumWords)
+	{ /*Fine after a trailing ;, and nowhere else.*/
+		if (Link != EXECLINK_END || State->NumRedirects || !State->NumSteps ||
+			State->Steps[State->NumSteps - 1].Link != EXECLINK_SEQ)
+		{
+			return false;
+		}
+		
+		State->Steps[State->NumSteps - 1].Link = EXECLINK_END;
+		return true;
+	}
+	
+	for (; CmdLineShellWords[Inc]; ++Inc)
+	{
+		if (!strcmp(*State->Words, CmdLineShellWords[Inc])) return false;
+	}
+	
+	Step = State->Steps + State->NumSteps++;
+	memset(Step, 0, sizeof(struct _ExecStep));
+	
+	Step->ArgV = ExecPlan_Alloc(sizeof(char*) * (State->NumWords + 1));
+	memcpy(Step->ArgV, State->Words, sizeof(char*) * State->NumWords);
+	
+	if ((Step->NumRedirects = State->NumRedirects))
+	{
+		Step->Redirects = ExecPlan_Alloc(sizeof(struct _ExecRedirect) * State->NumRedirects);
+		memcpy(Step->Redirects, State->Redirects, sizeof(struct _ExecRedirect) * State->NumRedirects);
+	}
+	
+	Step->Link = Link;
+	State->NumWords = State->NumRedirects = 0;
+	
+	return true;
+}
+
+static Bool CmdLine_Compile(const char *Cmd, char *const *EnvP, struct _ExecPlan *Plan)
+{ /*Fills in the plan's steps. False if it needs a real shell.*/
+	struct _CmdLineState State = { Cmd, 0, EnvP };
+	const size_t MaxTokens = strlen(Cmd) + 1; /*Every token takes at least a character.*/
+	Bool RetVal = false;
+	unsigned Inc = 0;
+	
+	State.Words = malloc(sizeof(char*) * MaxTokens);
+	State.Redirects = malloc(sizeof(struct _ExecRedirect) * MaxTokens);
+	State.Steps = malloc(sizeof(struct _ExecStep) * MaxTokens);
+	
+	for (;;)
+	{
+		const char *const Here = Cmd + (State.Pos += strspn(Cmd + State.Pos, " \t"));
+		enum ExecLink Link = EXECLINK_END;
+		
+		if (!*Here)
+		{
+			RetVal = CmdLine_EndStep(&State, EXECLINK_END);
+			break;
+		}
+		
+		if (*Here == ';') Link = EXECLINK_SEQ;
+		else if (!strncmp(Here, "&&", 2)) Link = EXECLINK_AND;
+		else if (!strncmp(Here, "||", 2)) Link = EXECLINK_OR;
+		else if (*Here == '|' && Here[1] != '&') Link = EXECLINK_PIPE;
+		else if (*Here == '&' || *Here == '|') break; /*Background jobs and |&.*/
+		
+		if (Link != EXECLINK_END)
+		{
+			State.Pos += Link == EXECLINK_AND || Link == EXECLINK_OR ? 2 : 1;
+			
+			if (!CmdLine_EndStep(&State, Link)) break;
+			continue;
+		}
+		
+		if (*Here == '<' || *Here == '>' || (isdigit((unsigned char)*Here) && (Here[1] == '<' || Here[1] == '>')))
+		{
+			if (!CmdLine_Redirect(&State)) break;
+			continue;
+		}
+		
+		if (!State.NumWords && CmdLine_IsNameChar(*Here, true))
+		{ /*NAME=value before a command.*/
+			for (Inc = 1; CmdLine_IsNameChar(Here[Inc], false); ++Inc);
+			
+			if (Here[Inc] == '=') break;
+		}
+		
+		if (!CmdLine_Word(&State)) break;
+		
+		/*An empty unquoted $VAR isn't a word at all.*/
+		if (!State.WordSize && !State.Quoted) continue;
+		
+		if (State.PendingRedirect)
+		{
+			State.Redirects[State.NumRedirects - 1].Path = ExecPlan_StrDup(State.Word);
+			State.PendingRedirect = false;
+		}
+		else State.Words[State.NumWords++] = ExecPlan_StrDup(State.Word);
+	}
+	
+#ifdef NOMMU
+	/*Running more than one needs a real fork().*/
+	if (State.NumSteps > 1) RetVal = false;
+#endif /*NOMMU*/
+	
+	if (RetVal)
+	{
+		Plan->Steps = ExecPlan_Alloc(sizeof(struct _ExecStep) * State.NumSteps);
+		memcpy(Plan->Steps, State.Steps, sizeof(struct _ExecStep) * State.NumSteps);
+		Plan->NumSteps = State.NumSteps;
+		
+		for (Inc = 0; Inc < Plan->NumSteps; ++Inc)
+		{
+			Plan->Steps[Inc].Path = ExecPlan_ResolvePath(*Plan->Steps[Inc].ArgV, EnvP);
+		}
+	}
+	
+	free(State.Word);
+	free(State.Words);
+	free(State.Redirects);
+	free(State.Steps);
+	
+	return RetVal;
+}
+
+static void ExecPlan_BuildBuiltin(const ObjTable *InObj, const char *Args, struct _ExecPlan *Plan)
+{ /*Quoting and $VAR work the same as for any command, but that's it.*/
+	char ErrBuf[MAX_LINE_SIZE / 2], OutBuf[MAX_LINE_SIZE];
+	
+	Plan->IsBuiltin = true;
+	
+	if (!CmdLine_Compile(Args, Plan->EnvP, Plan) || Plan->NumSteps != 1 || Plan->Steps->NumRedirects)
+	{
+		snprintf(ErrBuf, sizeof ErrBuf, "BUILTIN actions can't use pipes, redirection, or anything that needs a shell");
+	}
+	else if (Plan->SetUser)
+	{ /*They run inside Epoch, so there's no way to drop privileges for them.*/
+		snprintf(ErrBuf, sizeof ErrBuf, "BUILTIN actions can't run as ObjectUser");
+	}
+	else if (Builtin_Check(Plan->Steps->ArgV, ErrBuf, sizeof ErrBuf))
+	{
+		return;
+	}
+	
+	Plan->BuiltinError = ExecPlan_StrDup(ErrBuf);
+	
+	snprintf(OutBuf, sizeof OutBuf, "CONFIG: Object %s: %s", InObj->ObjectID, ErrBuf);
+	SpitWarning(OutBuf);
+	WriteLogLine(OutBuf, true);
+}
+
+static struct _ExecPlan *ExecPlan_Build(const ObjTable *InObj, const char *CurCmd, const struct passwd *User)
+{ /*User is only for start commands of objects with ObjectUser.*/
+	extern char **environ;
+	struct _ExecPlan *Plan = ExecPlan_Alloc(sizeof(struct _ExecPlan));
+	const struct _EnvVarList *Worker = NULL;
+	unsigned NumVars = 0, MaxVars = 3, Inc = 0;
+	char **Env = NULL;
+	
+	/*Environment first. What we were started with, then globals, then the object's own.*/
+	for (Env = environ; *Env; ++Env) ++MaxVars;
+	for (Worker = GlobalEnvVars; Worker && Worker->Next; Worker = Worker->Next) ++MaxVars;
+	for (Worker = InObj->EnvVars; Worker && Worker->Next; Worker = Worker->Next) ++MaxVars;
+	
+	Plan->EnvP = ExecPlan_Alloc(sizeof(char*) * (MaxVars + 1));
+	
+	for (Env = environ; *Env; ++Env) ExecPlan_SetEnv(Plan->EnvP, &NumVars, ExecPlan_StrDup(*Env));
+	for (Worker = GlobalEnvVars; Worker && Worker->Next; Worker = Worker->Next) ExecPlan_SetEnv(Plan->EnvP, &NumVars, (char*)Worker->EnvVar);
+	for (Worker = InObj->EnvVars; Worker && Worker->Next; Worker = Worker->Next) ExecPlan_SetEnv(Plan->EnvP, &NumVars, (char*)Worker->EnvVar);
+	
+	Plan->GroupID = CurCmd == InObj->ObjectStartCommand ? InObj->GroupID : 0;
+	
+	if (CurCmd == InObj->ObjectStartCommand && InObj->UserID != 0)
+	{
+		Plan->SetUser = true;
+		
+		if (!User) Plan->NoUser = true;
+		else
+		{
+			int NumGroups = 0;
+			
+			ExecPlan_SetEnv(Plan->EnvP, &NumVars, ExecPlan_EnvString("HOME", User->pw_dir));
+			ExecPlan_SetEnv(Plan->EnvP, &NumVars, ExecPlan_EnvString("USER", User->pw_name));
+			ExecPlan_SetEnv(Plan->EnvP, &NumVars, ExecPlan_EnvString("SHELL", User->pw_shell));
+			
+			Plan->HomeDir = ExecPlan_StrDup(User->pw_dir);
+			if (!Plan->GroupID) Plan->GroupID = User->pw_gid;
+			
+			/*Ask how many there are, then get them.*/
+			getgrouplist(User->pw_name, User->pw_gid, NULL, &NumGroups);
+			Plan->Groups = ExecPlan_Alloc(sizeof(gid_t) * (NumGroups + 1));
+			Plan->NumGroups = NumGroups + 1;
+			
+			if (getgrouplist(User->pw_name, User->pw_gid, Plan->Groups, &Plan->NumGroups) == -1)
+			{ /*It grew in between. Just the primary group then.*/
+				*Plan->Groups = User->pw_gid;
+				Plan->NumGroups = 1;
+			}
+		}
+	}
+	
+	if (!strncmp(CurCmd, "BUILTIN", sizeof "BUILTIN" - 1) && strchr(" \t", CurCmd[sizeof "BUILTIN" - 1]))
+	{
+		ExecPlan_BuildBuiltin(InObj, CurCmd + sizeof "BUILTIN" - 1, Plan);
+		return Plan;
+	}
+	
+	/*Then what to run. Our interpreter if we can, a shell if we have to.*/
+	if (!InObj->Opts.ForceShell && CmdLine_Compile(CurCmd, Plan->EnvP, Plan)) return Plan;
+	
+	Plan->Steps = ExecPlan_Alloc(sizeof(struct _ExecStep));
+	Plan->NumSteps = 1;
+	
+	if (ExecShell.Enabled)
+	{
+		Plan->UsesShell = true;
+		Plan->Steps->Path = ExecShell.Path;
+		Plan->Steps->ArgV = ExecPlan_Alloc(sizeof(char*) * 4);
+		Plan->Steps->ArgV[0] = "sh";
+		Plan->Steps->ArgV[1] = "-c";
+		Plan->Steps->ArgV[2] = (char*)CurCmd; /*Same generation as us, so this is safe.*/
+	}
+	else
+	{ /*No shell at all, so just split it on whitespace and hope.*/
+		unsigned NumArgs = 1, Length = 0;
+		const char *Word = CurCmd;
+		
+		while ((Word = WhitespaceArg(Word))) ++NumArgs;
+		
+		Plan->Steps->ArgV = ExecPlan_Alloc(sizeof(char*) * (NumArgs + 1));
+		
+		for (Word = CurCmd, Inc = 0; Inc < NumArgs && Word != NULL; ++Inc, Word = WhitespaceArg(Word))
+		{
+			for (Length = 0; Word[Length] != ' ' && Word[Length] != '\t' && Word[Length] != '\0'; ++Length);
+			
+			Plan->Steps->ArgV[Inc] = ExecPlan_Alloc(Length + 1);
+			memcpy(Plan->Steps->ArgV[Inc], Word, Length);
+		}
+		
+		Plan->Steps->Path = ExecPlan_ResolvePath(*Plan->Steps->ArgV, Plan->EnvP);
+	}
+	
+	return Plan;
+}
+
+static void ExecPlan_Stamp(void)
+{
+	struct stat FileStat;
+	
+	ExecPlanStamp.Passwd = stat("/etc/passwd", &FileStat) == 0 ? FileStat.st_mtime : 0;
+	ExecPlanStamp.Group = stat("/etc/group", &FileStat) == 0 ? FileStat.st_mtime : 0;
+}
+
+static Bool ExecPlan_CredentialsChanged(void)
+{
+	struct stat FileStat;
+	
+	return (stat("/etc/passwd", &FileStat) == 0 ? FileStat.st_mtime : 0) != ExecPlanStamp.Passwd ||
+			(stat("/etc/group", &FileStat) == 0 ? FileStat.st_mtime : 0) != ExecPlanStamp.Group;
+}
+
+static void ExecPlan_BuildAll(ObjTable *InObj)
+{
+	const char *const Commands[EXECPLAN_MAX] = { InObj->ObjectStartCommand, InObj->ObjectPrestartCommand,
+												InObj->ObjectStopCommand, InObj->ObjectReloadCommand };
+	struct passwd *User = NULL;
+	unsigned Inc = 0;
+	
+	if (InObj->UserID != 0 && InObj->ObjectStartCommand) User = getpwuid(InObj->UserID);
+	
+	for (; Inc < EXECPLAN_MAX; ++Inc)
+	{
+		InObj->ExecPlans[Inc] = Commands[Inc] ? ExecPlan_Build(InObj, Commands[Inc], User) : NULL;
+	}
+}
+
+void ExecPlan_Prepare(void)
+{ /*Called whenever a configuration is loaded, and again if /etc/passwd or /etc/group changes.*/
+	ObjTable *Worker = ObjectTable;
+	
+	ExecPlan_PickShell();
+	ExecPlan_Stamp();
+	
+	for (; Worker && Worker->ObjectID; ++Worker)
+	{
+		ExecPlan_BuildAll(Worker);
+	}
+	
+	endpwent();
+	endgrent();
+	
+	/*Nothing points at the rebuilt ones now.*/
+	ExecPlan_FreeHeap(ExecPlanHeap.Blocks, ExecPlanHeap.NumBlocks);
+	ExecPlanHeap.Blocks = NULL;
+	ExecPlanHeap.NumBlocks = ExecPlanHeap.Capacity = 0;
+}
+
+void ExecPlan_PrepareObject(ObjTable *InObj)
+{ /*For an object a reload replaced in place. Everyone else keeps the plans they have.*/
+	ExecPlan_BuildAll(InObj);
+	
+	endpwent();
+	endgrent();
+}
+
+static void ExecPlan_Rebuild(void)
+{ /*Someone edited the user databases. Only start commands with ObjectUser use them,
+	* so only those get new plans, and whatever the last rebuild gave them is freed.*/
+	void **const OldBlocks = ExecPlanHeap.Blocks;
+	const unsigned NumOldBlocks = ExecPlanHeap.NumBlocks;
+	ObjTable *Worker = ObjectTable;
+	
+	ExecPlanHeap.Blocks = NULL;
+	ExecPlanHeap.NumBlocks = ExecPlanHeap.Capacity = 0;
+	ExecPlanHeap.Active = true;
+	
+	ExecPlan_Stamp();
+	
+	for (; Worker && Worker->ObjectID; ++Worker)
+	{
+		if (!Worker->ExecPlans[EXECPLAN_START] || !Worker->ExecPlans[EXECPLAN_START]->SetUser) continue;
+		
+		Worker->ExecPlans[EXECPLAN_START] = ExecPlan_Build(Worker, Worker->ObjectStartCommand, getpwuid(Worker->UserID));
+	}
+	
+	ExecPlanHeap.Active = false;
+	
+	endpwent();
+	endgrent();
+	
+	ExecPlan_FreeHeap(OldBlocks, NumOldBlocks);
+}
+
+static const struct _ExecPlan *ExecPlan_Get(ObjTable *InObj, const char *CurCmd)
+{
+	const char *const Commands[EXECPLAN_MAX] = { InObj->ObjectStartCommand, InObj->ObjectPrestartCommand,
+												InObj->ObjectStopCommand, InObj->ObjectReloadCommand };
+	unsigned Inc = 0;
+	
+	for (; Inc < EXECPLAN_MAX && Commands[Inc] != CurCmd; ++Inc);
+	
+	if (Inc == EXECPLAN_MAX) return NULL;
+	
+	if (!InObj->ExecPlans[Inc])
+	{ /*Whoever loaded this table didn't prepare it.*/
+		ExecPlan_Prepare();
+	}
+	else if (InObj->ExecPlans[Inc]->SetUser && ExecPlan_CredentialsChanged())
+	{
+		WriteLogLine("CONFIG: User or group database changed. Recomputing object credentials.", true);
+		ExecPlan_Rebuild();
+	}
+	
+	return InObj->ExecPlans[Inc];
+}
+
+/**Everything the child calls between (v)fork() and exec has to be async-signal-safe.
+ * Under vfork() it is also running on PID 1's memory, so nothing here may allocate or touch stdio.**/
+static void Spawn_Complain(const char *const *Parts)
+{ /*NULL terminated. Goes to whatever stderr is at the time.*/
+	for (; *Parts; ++Parts) write(STDERR_FILENO, *Parts, strlen(*Parts));
+}
+
+static Bool Spawn_Redirect(const char *Path, int Flags, int Target)
+{
+	const int Descriptor = open(Path, Flags, 0666);
+	
+	if (Descriptor == -1) return false;
+	
+	dup2(Descriptor, Target);
+	if (Descriptor != Target) close(Descriptor);
+	
+	return true;
+}
+
+static void Spawn_RotateOutput(const char *Path)
+{ /*The child holds its own output file open, so the only safe time to rotate it is before it starts.
+	* If it's never been rotated, we count its age from the first time we looked.*/
+	static time_t FirstLook;
+	struct stat FileStat;
+	
+	if ((!LogRotate.MaxSize && !LogRotate.MaxAge) || !Path || !strcmp(Path, LogFile) || stat(Path, &FileStat) != 0) return;
+	
+	if (!FirstLook) FirstLook = time(NULL);
+	
+	if (Rotate_Due(&LogRotate, FileStat.st_size, 0, Rotate_Since(Path, FirstLook))) Rotate_Shift(Path, LogRotate.Keep);
+}
+
+static void Spawn_SearchPath(const struct _ExecStep *Step, char *const *EnvP)
+{ /*For when the step's binary wasn't in PATH at load time, or isn't there anymore.*/
+	const char *Worker = ExecPlan_SearchPath(EnvP);
+	const size_t BinaryLength = strlen(*Step->ArgV) + 1;
+	char Candidate[MAX_LINE_SIZE];
+	size_t Length = 0, Used = 0;
+	
+	for (; *Worker; Worker += Length + (Worker[Length] == ':'))
+	{
+		Length = strcspn(Worker, ":");
+		
+		if (Length + BinaryLength + 1 > sizeof Candidate) continue;
+		
+		/*An empty element means the current directory.*/
+		memcpy(Candidate, Worker, Used = Length);
+		if (Used) Candidate[Used++] = '/';
+		memcpy(Candidate + Used, *Step->ArgV, BinaryLength);
+		
+		execve(Candidate, Step->ArgV, EnvP);
+	}
+}
+
+static void Spawn_Step(const ObjTable *InObj, const struct _ExecStep *Step, char *const *EnvP)
+{ /*Redirections, then exec. Never returns.*/
+	unsigned Inc = 0;
+	
+	for (; Inc < Step->NumRedirects; ++Inc)
+	{
+		const struct _ExecRedirect *const Redirect = Step->Redirects + Inc;
+		
+		if (!Redirect->Path)
+		{
+			dup2(Redirect->DupFD, Redirect->FD);
+		}
+		else if (!Spawn_Redirect(Redirect->Path, Redirect->Flags, Redirect->FD))
+		{
+			const char *Parts[] = { "Epoch: Object ", InObj->ObjectID, " cannot open \"", Redirect->Path, "\".\n", NULL };
+			
+			Spawn_Complain(Parts);
+			_exit(1);
+		}
+	}
+	
+	/*I bet you think that a shell is going to return the PID of sh. No.*/
+	if (Step->Path) execve(Step->Path, Step->ArgV, EnvP);
+	
+	if (Step->Path != ExecShell.Path && !strchr(*Step->ArgV, '/') && (!Step->Path || errno == ENOENT))
+	{
+		Spawn_SearchPath(Step, EnvP);
+	}
+	
+	if (Step->Path == ExecShell.Path)
+	{
+		const char *Parts[] = { "Failed to execute ", InObj->ObjectID, ": execve() failure launching \"",
+								Step->Path, "\".\n", NULL };
+		
+		Spawn_Complain(Parts);
+	}
+	
+	/*In this case, it could be a file not found, in which case, just have the child, us, exit gracefully.*/
+	_exit(1);
+}
+
+static void Spawn_Run(const ObjTable *InObj, const struct _ExecPlan *Plan)
+{ /*Runs the plan's steps like sh would. With more than one step, we got here with a real fork(),
+	* and can fork again. The last pipeline runs in place, so its last command keeps the PID we track.*/
+	enum ExecLink Before = EXECLINK_SEQ;
+	unsigned First = 0, Last = 0, Inc = 0;
+	int Status = 0, RawStatus = 0, Input = -1, Pipe[2];
+	pid_t NewPID = 0, LastPID = 0, Reaped = 0;
+	
+	for (; First < Plan->NumSteps; First = Last + 1)
+	{
+		for (Last = First; Plan->Steps[Last].Link == EXECLINK_PIPE; ++Last);
+		
+		/*&& and || skip a pipeline, but we still go on to whatever's after it.*/
+		if ((Before == EXECLINK_AND && Status != 0) || (Before == EXECLINK_OR && Status == 0))
+		{
+			Before = Plan->Steps[Last].Link;
+			continue;
+		}
+		
+		Before = Plan->Steps[Last].Link;
+		
+		for (Input = -1, Inc = First; Inc <= Last; ++Inc)
+		{
+			Pipe[0] = Pipe[1] = -1;
+			
+			if (Inc < Last && pipe(Pipe) == -1) _exit(1);
+			
+			if (Inc == Last && Plan->Steps[Last].Link == EXECLINK_END)
+			{ /*Nothing left after this, so become it.*/
+				if (Input != -1)
+				{
+					dup2(Input, STDIN_FILENO);
+					close(Input);
+				}
+				
+				Spawn_Step(InObj, Plan->Steps + Inc, Plan->EnvP);
+			}
+			
+			if ((NewPID = fork()) == -1) _exit(1);
+			
+			if (NewPID == 0)
+			{
+				if (Input != -1)
+				{
+					dup2(Input, STDIN_FILENO);
+					close(Input);
+				}
+				
+				if (Pipe[1] != -1)
+				{
+					dup2(Pipe[1], STDOUT_FILENO);
+					close(Pipe[1]);
+					close(Pipe[0]);
+				}
+				
+				Spawn_Step(InObj, Plan->Steps + Inc, Plan->EnvP);
+			}
+			
+			if (Input != -1) close(Input);
+			if (Pipe[1] != -1) close(Pipe[1]);
+			
+			Input = Pipe[0];
+			LastPID = NewPID;
+		}
+		
+		/*Everything we have is in this pipeline, so wait for the lot. The last one is its status.*/
+		while ((Reaped = wait(&RawStatus)) != -1 || errno == EINTR)
+		{
+			if (Reaped == LastPID) Status = WIFEXITED(RawStatus) ? WEXITSTATUS(RawStatus) : 128 + WTERMSIG(RawStatus);
+		}
+	}
+	
+	_exit(Status);
+}
+
 static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 { /*Not making static because this is probably going to be useful for other stuff.*/
 #ifdef NOMMU
 #define ForkFunc() vfork()
-#else
-#define ForkFunc() fork()
+#else /*Copying PID 1's page tables for every object gets slow once the config is big, so we vfork() too.
+	* FORK objects and command lines our interpreter runs still need a real fork(), since their child forks again.*/
+#define ForkFunc() ((InObj->Opts.Fork && CurCmd == InObj->ObjectStartCommand) || Plan->NumSteps > 1 ? fork() : vfork())
 #endif
 
 	pid_t LaunchPID;
 	ReturnCode ExitStatus = FAILURE; /*We failed unless we succeeded.*/
-	int RawExitStatus, Inc = 0;
-	sigset_t SigMaker[2];	
-#ifndef NOSHELL
-	Bool ShellEnabled = true; /*If we use shells.*/
-	Bool ShellDissolves = SHELLDISSOLVES;
-	Bool ForceShell = InObj->Opts.ForceShell;
-	static Bool DidWarn = false;
-	const char *ShellPath = "/bin/sh";
+	int RawExitStatus, Inc = 0, CaptureFD;
+	sigset_t SigMaker[2];
+	const struct _ExecPlan *Plan = NULL;
 	
-	if (CurCmd == NULL)
+	if (CurCmd == NULL || !(Plan = ExecPlan_Get(InObj, CurCmd)))
 	{
 		const char *ErrMsg = "NULL value passed to ExecuteConfigObject()! This is likely a bug.";
 		SpitError(ErrMsg);
@@ -72,93 +1049,37 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 		return FAILURE;
 	}
 	
-	/*Check how we should handle PIDs for each shell. In order to get the PID, exit status,
-	* and support shell commands, we need to jump through a bunch of hoops.*/
-	if (ShellEnabled)
-	{
-		if (FileUsable(SHELLPATH))
-		{ /*Try our specified shell first.*/
-			ShellPath = SHELLPATH;
-		}
-		else if (FileUsable("/bin/bash"))
-		{
-			ShellDissolves = true;
-			ShellPath = "/bin/bash";
-		}
-		else if (FileUsable("/bin/dash"))
-		{
-			ShellPath = "/bin/dash";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/zsh"))
-		{
-			ShellPath = "/bin/zsh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/csh"))
-		{
-			ShellPath = "/bin/csh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/tcsh"))
-		{
-			ShellPath = "/bin/tcsh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/ksh"))
-		{
-			ShellPath = "/bin/ksh";
-			ShellDissolves = true;
-		}
-		else if (FileUsable("/bin/busybox"))
-		{ /*This is one of those weird shells that still does the old practice of creating a child for -c.
-			* We can deal with the likes of them. Small chance that for shells like this, another PID could jump in front
-			* and we could end up storing the wrong one. Very small, but possible.*/
-			ShellPath = "/bin/busybox";
-			ShellDissolves = false;
-		}
-		else /*Found no other shells. Assume fossil, spit warning.*/
+	if (Plan->IsBuiltin)
+	{ /*No process at all.*/
+		if (!Plan->BuiltinError) return Builtin_Run(Plan->Steps->ArgV, InObj->ObjectID);
+		else
 		{
-			const char *Errs[2] = { ("Cannot find any functioning shell. /bin/sh is not available.\n"
-									 CONSOLE_COLOR_YELLOW "** Disabling shell support! **" CONSOLE_ENDCOLOR),
-									("No known shell found. Using \"/bin/sh\".\n"
-									"Best if you install one of these: bash, dash, csh, zsh, or busybox.\n") };
-			if (!DidWarn)
-			{
-				
-				if (!FileUsable("/bin/sh"))
-				{
-					SpitWarning(Errs[0]);
-					WriteLogLine(Errs[0], true);
-					
-					ShellEnabled = false; /*Disable shell support.*/
-				}
-				else
-				{
-					ShellDissolves = true; /*Most do.*/
-					SpitWarning(Errs[1]);
-					WriteLogLine(Errs[1], true);
-				}
-				
-				DidWarn = true;
-			}
-		}
-		
-		if (!DidWarn && strcmp(ShellPath, ENVVAR_SHELL) != 0)
-		{ /*Only happens if we are using a known shell, even if it's not ours.*/
 			char ErrBuf[MAX_LINE_SIZE];
 			
-			snprintf(ErrBuf, sizeof ErrBuf, "\"" ENVVAR_SHELL "\" cannot be read. Using \"%s\" instead.", ShellPath);
-			
-			/*Just write to log, because this happens.*/
+			snprintf(ErrBuf, sizeof ErrBuf, "Object %s cannot run its BUILTIN action: %s", InObj->ObjectID, Plan->BuiltinError);
+			SmallError(ErrBuf);
 			WriteLogLine(ErrBuf, true);
-			SpitWarning(ErrBuf);
-			DidWarn = true;
+			
+			return FAILURE;
 		}
 	}
-#endif /*NOSHELL*/
+	
 	/**Here be where we execute commands.---------------**/
 	
+	if ((InObj->ObjectStdout && !strcmp(InObj->ObjectStdout, LogFile)) ||
+		(InObj->ObjectStderr && !strcmp(InObj->ObjectStderr, LogFile)))
+	{ /*Keep our lines ahead of whatever it writes there.*/
+		Log_Flush();
+	}
+	
+	CaptureFD = Capture_Prepare(InObj);
+	
+	if (CurCmd == InObj->ObjectStartCommand)
+	{
+		Spawn_RotateOutput(InObj->ObjectStdout);
+		Spawn_RotateOutput(InObj->ObjectStderr);
+	}
+	
 	/*We need to block all signals until we have executed the process.*/
 	sigemptyset(&SigMaker[0]);
 	
@@ -191,7 +1112,6 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 	
 	if (LaunchPID == 0) /**Child process code.**/
 	{ /*Child does all this.*/
-		char TmpBuf[1024];		
 		int Inc = 0;
 		sigset_t Sig2;
 		
@@ -230,145 +1150,79 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 #endif /*NOMMU*/
 
 		
-		/*Set environment variables.*/
-		/**The thing that always bothered me here is the idea that we are likely duplicating
-		 * the entire process on MMU platforms, and as much as I like the idea of immediately nuking
-		 * all that data (as if exec won't do it for us), I need it for this.*/
-		if (InObj->EnvVars)
-		{
-			struct _EnvVarList *Worker = InObj->EnvVars;
-			
-			for (; Worker->Next; Worker = Worker->Next)
-			{
-				putenv(Worker->EnvVar);
-			}
-		}
-		
 		if (InObj->ObjectWorkingDirectory != NULL && CurCmd == InObj->ObjectStartCommand)
 		{ /*Switch directories if desired.*/
 			if (chdir(InObj->ObjectWorkingDirectory) == -1)
 			{ /*Failed to chdir.*/
-				fprintf(stderr, "Epoch: Object %s " CONSOLE_COLOR_RED "failed" CONSOLE_ENDCOLOR " to chdir to \"%s\".\n",
-						InObj->ObjectID, InObj->ObjectWorkingDirectory);
+				const char *Parts[] = { "Epoch: Object ", InObj->ObjectID, " " CONSOLE_COLOR_RED "failed" CONSOLE_ENDCOLOR
+										" to chdir to \"", InObj->ObjectWorkingDirectory, "\".\n", NULL };
+				
+				Spawn_Complain(Parts);
 				_exit(1);
 			}
 		}
 		
 		
+		/*Captured output goes into a pipe Epoch reads.*/
+		if (InObj->Opts.CaptureStdout) dup2(CaptureFD, STDOUT_FILENO);
+		
+		if (InObj->Opts.CaptureStderr) dup2(CaptureFD, STDERR_FILENO);
+		
 		/*stdout*/
 		if (InObj->ObjectStdout != NULL)
 		{
-			freopen(InObj->ObjectStdout, "a", stdout); /*We don't deal with the return code.*/
+			Spawn_Redirect(InObj->ObjectStdout, O_WRONLY | O_CREAT | O_APPEND, STDOUT_FILENO); /*We don't deal with the return code.*/
 		}
 		
 		/*stderr*/
 		if (InObj->ObjectStderr != NULL)
 		{
-			freopen(InObj->ObjectStderr, "a", stderr);
+			Spawn_Redirect(InObj->ObjectStderr, O_WRONLY | O_CREAT | O_APPEND, STDERR_FILENO);
 		}
 		
 		/**The ordering of this is important to make the file descriptors work for an alternative stdout/stderr.**/
-		if (CurCmd == InObj->ObjectStartCommand)
-		{ /*Set user and group if desired.*/
-
-			if (InObj->GroupID != 0) setgid(InObj->GroupID);
-
-			if (InObj->UserID != 0)
-			{
-				struct passwd *UserStruct = getpwuid(InObj->UserID);
-				
-				if (!UserStruct) _exit(1);
-				
-				initgroups(UserStruct->pw_name, UserStruct->pw_gid);
-				endgrent();
-				
-				if (!InObj->GroupID) setgid(UserStruct->pw_gid);
-
-				setuid(InObj->UserID);
-				
-				setenv("HOME", UserStruct->pw_dir, 1);
-				setenv("USER", UserStruct->pw_name, 1);
-				setenv("SHELL", UserStruct->pw_shell, 1);
-				
-				if (!InObj->ObjectWorkingDirectory) chdir(UserStruct->pw_dir);
-				
-
-			}
-			
-		}
-			
-#ifndef NOSHELL
-		if (ShellEnabled && (strpbrk(CurCmd, "&^$#@!()*%{}`~+|\\<>?;:'[]\"\t") != NULL || ForceShell))
+		if (Plan->NoUser) _exit(1);
+		
+		if (Plan->SetUser) setgroups(Plan->NumGroups, Plan->Groups);
+		
+		if (Plan->GroupID != 0) setgid(Plan->GroupID);
+		
+		if (Plan->SetUser)
 		{
-			execlp(ShellPath, "sh", "-c", CurCmd, NULL); /*I bet you think that this is going to return the PID of sh. No.*/
-			
-			snprintf(TmpBuf, 1024, "Failed to execute %s: execlp() failure launching \"" SHELLPATH "\".", InObj->ObjectID);
-			SpitError(TmpBuf);
-			_exit(1); /*Makes sure that we report failure. This is a problem.*/
-		}
-		else
-#endif
-		{ /*don't worry about the heap stuff, exec() takes care of it you know.*/
-			char **ArgV = NULL;
-			unsigned NumSpaces = 1, Inc = 0, Inc2 = 0;
-			char NCmd[MAX_LINE_SIZE], *Worker = NCmd;
-			
-			strncpy(NCmd, CurCmd, strlen(CurCmd) + 1);
-			
-			while ((Worker = WhitespaceArg(Worker))) ++NumSpaces;
-			
-			ArgV = calloc(NumSpaces + 1, sizeof(char*));
-			
-			for (Worker = NCmd, Inc = 0; Inc < NumSpaces && Worker != NULL; ++Inc)
-			{
-				/*Count how much space we need first.*/
-				for (Inc2 = 0; Worker[Inc2] != ' ' && Worker[Inc2] != '\t' && Worker[Inc2] != '\0'; ++Inc2);
-				
-				/*Then allocate it.*/
-				ArgV[Inc] = malloc(Inc2 + 1);
-				
-				for (Inc2 = 0; Worker[Inc2] != ' ' && Worker[Inc2] != '\t' && Worker[Inc2] != '\0'; ++Inc2)
-				{ /*Then copy the chunk into its cell for execvp().*/
-					ArgV[Inc][Inc2] = Worker[Inc2];
-				}
-				ArgV[Inc][Inc2] = '\0';
-				
-				/*Then jump to the next word.*/
-				Worker = WhitespaceArg(Worker);
-				
-			}
-			
-			/*Set last cell to null as is required by execvp().*/
-			ArgV[NumSpaces] = NULL;
-			
-			execvp(ArgV[0], ArgV);
-			
-			/*In this case, it could be a file not found, in which case, just have the child, us, exit gracefully.*/
-			_exit(1);
+			setuid(InObj->UserID);
 			
+			if (!InObj->ObjectWorkingDirectory) chdir(Plan->HomeDir);
 		}
+		
+		/*The plan already has the environment, paths, and any shell worked out.*/
+		Spawn_Run(InObj, Plan);
+		
 		/*We still around to talk about it? We were supposed to be imaged with the new command!*/
 	}
 	
 	/**Parent code resumes.**/
-	waitpid(LaunchPID, &RawExitStatus, 0); /*Wait for the process to exit.*/
+	if (Capture_Active())
+	{ /*Keep reading captured output while we wait. A chatty child could fill its pipe and never exit otherwise.*/
+		while (waitpid(LaunchPID, &RawExitStatus, WNOHANG) == 0) Capture_Wait(20, false);
+	}
+	else waitpid(LaunchPID, &RawExitStatus, 0); /*Wait for the process to exit.*/
 	
 	if (CurCmd == InObj->ObjectStartCommand)
 	{
-		InObj->ObjectPID = LaunchPID; /*Save our PID.*/
-		if (!ShellDissolves)
+		InObj->State->ObjectPID = LaunchPID; /*Save our PID.*/
+		if (Plan->UsesShell && !ExecShell.Dissolves)
 		{
-			++InObj->ObjectPID; /*This probably won't always work, but 99.9999999% of the time, yes, it will.*/
+			++InObj->State->ObjectPID; /*This probably won't always work, but 99.9999999% of the time, yes, it will.*/
 		}
 
 		if (InObj->Opts.IsService)
 		{ /*If we specify that this is a service, one up the PID again.*/
-			++InObj->ObjectPID;
+			++InObj->State->ObjectPID;
 		}
 
 #ifndef NOMMU
 		/*The PID is obviously going to be one greater.*/
-		if (InObj->Opts.Fork) ++InObj->ObjectPID;
+		if (InObj->Opts.Fork) ++InObj->State->ObjectPID;
 #endif /*NOMMU*/	
 
 		/*Check if the PID we found is accurate and update it if not. This method is very,
@@ -441,6 +1295,205 @@ static ReturnCode ExecuteConfigObject(ObjTable *InObj, const char *CurCmd)
 	return ExitStatus;
 }
 
+/*Start conditions. None of these spawn anything, so an object whose conditions
+ * don't hold costs us a few syscalls at most.*/
+static size_t Cond_ReadFile(const char *Path, char *OutStream, size_t OutSize)
+{ /*Reads a small file into a string. Returns the length, zero if it's missing or empty.*/
+	int Descriptor = open(Path, O_RDONLY | O_CLOEXEC);
+	ssize_t Length = 0;
+	
+	*OutStream = '\0';
+	
+	if (Descriptor == -1) return 0;
+	
+	Length = read(Descriptor, OutStream, OutSize - 1);
+	close(Descriptor);
+	
+	if (Length <= 0) return 0;
+	
+	OutStream[Length] = '\0';
+	
+	/*Drop the trailing newline, everything in /proc and /sys has one.*/
+	while (Length && (OutStream[Length - 1] == '\n' || OutStream[Length - 1] == ' ')) OutStream[--Length] = '\0';
+	
+	return Length;
+}
+
+static Bool Cond_KernelCmdline(const char *Arg)
+{ /*"quiet" matches quiet and quiet=anything, "root=/dev/sda1" has to match exactly.*/
+	static char Cmdline[4096];
+	static Bool Loaded;
+	const Bool WantValue = strchr(Arg, '=') != NULL;
+	const size_t ArgLen = strlen(Arg);
+	const char *Worker = Cmdline;
+	
+	if (!Loaded)
+	{ /*It won't change while we're running.*/
+		Cond_ReadFile("/proc/cmdline", Cmdline, sizeof Cmdline);
+		Loaded = true;
+	}
+	
+	while (*Worker)
+	{
+		size_t Len = 0;
+		
+		for (; *Worker == ' ' || *Worker == '\t' || *Worker == '\n'; ++Worker);
+		for (; Worker[Len] && Worker[Len] != ' ' && Worker[Len] != '\t' && Worker[Len] != '\n'; ++Len);
+		
+		if (Len >= ArgLen && !strncmp(Worker, Arg, ArgLen) &&
+			(Len == ArgLen || (!WantValue && Worker[ArgLen] == '=')))
+		{
+			return true;
+		}
+		
+		Worker += Len;
+	}
+	
+	return false;
+}
+
+static const char *Cond_Virtualization(Bool *OutContainer)
+{ /*Names whatever we're running under, like systemd-detect-virt would. NULL on bare metal.*/
+	static const struct { const char *Vendor, *ID; } DMIVendors[] = {
+		{ "QEMU", "qemu" }, { "KVM", "kvm" }, { "VMware", "vmware" }, { "VMW", "vmware" },
+		{ "innotek GmbH", "oracle" }, { "VirtualBox", "oracle" }, { "Xen", "xen" }, { "Bochs", "bochs" },
+		{ "Parallels", "parallels" }, { "Microsoft Corporation", "microsoft" }, { "Amazon EC2", "amazon" }
+	};
+	static char ID[64];
+	static Bool Detected, Container;
+	
+	if (!Detected)
+	{ /*Nothing here changes short of a reboot, so look once.*/
+		const char *Env = getenv("container"); /*lxc, nspawn and podman set this for their init.*/
+		char Buf[1024];
+		
+		Detected = true;
+		
+		if (Env && *Env) snprintf(ID, sizeof ID, "%s", Env);
+		else if (!access("/.dockerenv", F_OK)) snprintf(ID, sizeof ID, "docker");
+		else if (!access("/run/.containerenv", F_OK)) snprintf(ID, sizeof ID, "podman");
+		else if (!access("/proc/vz", F_OK) && access("/proc/bc", F_OK) != 0) snprintf(ID, sizeof ID, "openvz");
+		
+		Container = *ID != '\0';
+		
+		if (!Container)
+		{
+			FILE *CPUInfo = fopen("/proc/cpuinfo", "r");
+			Bool Hypervisor = false;
+			
+			while (CPUInfo && !Hypervisor && fgets(Buf, sizeof Buf, CPUInfo))
+			{ /*Real hardware can carry any DMI vendor string it likes, so we only trust them inside a guest.*/
+				Hypervisor = !strncmp(Buf, "flags", sizeof "flags" - 1) && strstr(Buf, " hypervisor");
+			}
+			
+			if (CPUInfo) fclose(CPUInfo);
+			
+			if (Hypervisor)
+			{
+				unsigned Inc = 0, File = 0;
+				const char *const DMIFiles[] = { "/sys/class/dmi/id/sys_vendor", "/sys/class/dmi/id/product_name" };
+				
+				for (; File < sizeof DMIFiles / sizeof *DMIFiles && !*ID; ++File)
+				{
+					Cond_ReadFile(DMIFiles[File], Buf, sizeof Buf);
+					
+					for (Inc = 0; Inc < sizeof DMIVendors / sizeof *DMIVendors; ++Inc)
+					{
+						if (!strncmp(Buf, DMIVendors[Inc].Vendor, strlen(DMIVendors[Inc].Vendor)))
+						{
+							snprintf(ID, sizeof ID, "%s", DMIVendors[Inc].ID);
+							break;
+						}
+					}
+				}
+				
+				if (!*ID) snprintf(ID, sizeof ID, "vm-other");
+			}
+			else if (!access("/proc/xen", F_OK)) snprintf(ID, sizeof ID, "xen"); /*Paravirtualized guests don't set the flag.*/
+		}
+	}
+	
+	*OutContainer = Container;
+	return *ID ? ID : NULL;
+}
+
+static Bool Cond_FirstBoot(void)
+{ /*Until something writes a machine ID, this is a fresh image.*/
+	char Buf[64];
+	
+	return !Cond_ReadFile("/etc/machine-id", Buf, sizeof Buf) || !strcmp(Buf, "uninitialized");
+}
+
+static Bool Cond_EnvSet(ObjTable *InObj, const char *Arg)
+{ /*Checks against the environment the start command will actually get.*/
+	const struct _ExecPlan *const Plan = ExecPlan_Get(InObj, InObj->ObjectStartCommand);
+	const size_t ArgLen = strlen(Arg);
+	const Bool WantValue = strchr(Arg, '=') != NULL;
+	unsigned Inc = 0;
+	
+	for (; Plan && Plan->EnvP[Inc]; ++Inc)
+	{
+		if (!strncmp(Plan->EnvP[Inc], Arg, ArgLen) &&
+			(WantValue ? Plan->EnvP[Inc][ArgLen] == '\0' : Plan->EnvP[Inc][ArgLen] == '='))
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+static const struct _ObjCondition *ObjCondition_FirstFailed(ObjTable *InObj)
+{ /*Returns the first of an object's conditions that doesn't hold, or NULL if they all do.*/
+	const struct _ObjCondition *Worker = InObj->Conditions;
+	
+	for (; Worker; Worker = Worker->Next)
+	{
+		struct stat FileStat;
+		const char *VirtID = NULL;
+		Bool Container = false, Holds = false;
+		
+		switch (Worker->Type)
+		{
+			case COND_PATHEXISTS:
+				Holds = !access(Worker->Arg, F_OK);
+				break;
+			case COND_PATHISDIRECTORY:
+				Holds = !stat(Worker->Arg, &FileStat) && S_ISDIR(FileStat.st_mode);
+				break;
+			case COND_FILENOTEMPTY:
+				Holds = !stat(Worker->Arg, &FileStat) && S_ISREG(FileStat.st_mode) && FileStat.st_size > 0;
+				break;
+			case COND_KERNELCMDLINE:
+				Holds = Cond_KernelCmdline(Worker->Arg);
+				break;
+			case COND_VIRTUALIZATION:
+			{ /*"yes", "no", "vm", "container", or a name like "kvm" or "docker".*/
+				VirtID = Cond_Virtualization(&Container);
+				
+				if (!strcmp(Worker->Arg, "yes")) Holds = VirtID != NULL;
+				else if (!strcmp(Worker->Arg, "no")) Holds = VirtID == NULL;
+				else if (!strcmp(Worker->Arg, "vm")) Holds = VirtID && !Container;
+				else if (!strcmp(Worker->Arg, "container")) Holds = Container;
+				else Holds = VirtID && !strcasecmp(VirtID, Worker->Arg);
+				break;
+			}
+			case COND_FIRSTBOOT:
+				Holds = Cond_FirstBoot();
+				break;
+			case COND_ENVSET:
+				Holds = Cond_EnvSet(InObj, Worker->Arg);
+				break;
+			default:
+				break;
+		}
+		
+		if (Holds == Worker->Negate) return Worker;
+	}
+	
+	return NULL;
+}
+
 ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool PrintStatus)
 {
 	char PrintOutStream[1024];
@@ -482,6 +1535,29 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 	
 	if (IsStartingMode && CurObj->Opts.HaltCmdOnly) return FAILURE;
 	
+	if (IsStartingMode && CurObj->Conditions)
+	{
+		const struct _ObjCondition *const Failed = ObjCondition_FirstFailed(CurObj);
+		
+		if (Failed)
+		{ /*Not an error. It just isn't for this machine, or this boot.*/
+			char Condition[MAX_LINE_SIZE / 2], LogBuf[MAX_LINE_SIZE];
+			
+			ObjCondition_Describe(Failed, Condition, sizeof Condition);
+			snprintf(LogBuf, sizeof LogBuf, "Not starting object %s: condition \"%s\" not met.", CurObj->ObjectID, Condition);
+			WriteLogLine(LogBuf, true);
+			
+			if (PrintStatus)
+			{
+				snprintf(PrintOutStream, sizeof PrintOutStream, "Skipping %s (condition not met)", CurObj->ObjectDescription);
+				BeginStatusReport(PrintOutStream);
+				CompleteStatusReport(PrintOutStream, SUCCESS, true);
+			}
+			
+			return SUCCESS;
+		}
+	}
+	
 	if (IsStartingMode)
 	{		
 		ReturnCode PrestartExitStatus = SUCCESS;
@@ -534,6 +1610,14 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 		
 		ExitStatus = ExecuteConfigObject(CurObj, CurObj->ObjectStartCommand);
 		
+		if (ExitStatus)
+		{ /*Launched. It's READY below, once its PID file shows up if it has one.*/
+			char PIDBuf[32];
+			
+			snprintf(PIDBuf, sizeof PIDBuf, "%u", CurObj->State->ObjectPID);
+			Control_Event("STARTED", CurObj->ObjectID, PIDBuf);
+		}
+		
 		if (PrestartExitStatus != SUCCESS && ExitStatus)
 		{
 			char TBuf[MAX_LINE_SIZE];
@@ -580,17 +1664,21 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 			CurrentTask.PID = 0;
 		}
 		
-		CurObj->Started = (ExitStatus ? true : false); /*Mark the process dead or alive.*/
+		CurObj->State->Started = (ExitStatus ? true : false); /*Mark the process dead or alive.*/
+		
+		Control_Event(ExitStatus ? "READY" : "FAILED", CurObj->ObjectID, ExitStatus == WARNING ? "warning" : NULL);
 		
 		if (ExitStatus)
 		{
-			CurObj->StartedSince = time(NULL);
+			CurObj->State->StartedSince = time(NULL);
 			
 			/*RunOnce objects are supposed to run once, so disable them after a successful run.*/
 			if (CurObj->Opts.RunOnce && CurrentBootMode != BOOT_NEUTRAL) /*Don't disable if doing a manual start.*/
 			{
-				EditConfigValue(CurObj->ConfigFile, CurObj->ObjectID, "ObjectEnabled", "false");
-				CurObj->Enabled = false;
+				const Bool WasEnabled = CurObj->State->Enabled;
+				
+				CurObj->State->Enabled = false;
+				Overlay_RecordEnabled(CurObj, WasEnabled);
 			}
 		}
 		
@@ -609,9 +1697,9 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 	}
 	else
 	{	
-		Bool LastAutoRestartState = CurObj->Opts.AutoRestart;
+		Bool LastAutoRestartState = CurObj->State->AutoRestart;
 		/*We need to do this so objects that are stopped have no chance of restarting themselves.*/
-		CurObj->Opts.AutoRestart = false;
+		CurObj->State->AutoRestart = false;
 		
 		switch (CurObj->Opts.StopMode)
 		{
@@ -718,7 +1806,7 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 					
 					for (; ObjectProcessRunning(CurObj) && Inc < CurObj->Opts.StopTimeout * 10000 && !Abort; ++Inc)
 					{
-						CurPID = CurObj->Opts.HasPIDFile ? ReadPIDFile(CurObj) : CurObj->ObjectPID;
+						CurPID = CurObj->Opts.HasPIDFile ? ReadPIDFile(CurObj) : CurObj->State->ObjectPID;
 						
 						if (!CurPID) break; /*No PID? No point.*/
 						
@@ -740,17 +1828,17 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 					
 				if (ExitStatus)
 				{
-					CurObj->ObjectPID = 0;
-					CurObj->Started = false;
-					CurObj->StartedSince = 0;
+					CurObj->State->ObjectPID = 0;
+					CurObj->State->Started = false;
+					CurObj->State->StartedSince = 0;
 					
 					/*We place this here and not the others because HALTONLY only supports commands.*/
-					if (CurrentBootMode != BOOT_NEUTRAL && CurObj->Opts.RunOnce && CurObj->Opts.HaltCmdOnly && CurObj->Enabled)
+					if (CurrentBootMode != BOOT_NEUTRAL && CurObj->Opts.RunOnce && CurObj->Opts.HaltCmdOnly && CurObj->State->Enabled)
 					{  /* Disable HaltCmdOnly objects with RunOnce set. We don't disable non-haltonly here for two reasons.
 						* First, it's usually unnecessary since the start command did it, and second, if someone turned it on again before the reboot,
 						* they probably want it to start again next boot.*/
-						CurObj->Enabled = false;
-						EditConfigValue(CurObj->ConfigFile, CurObj->ObjectID, "ObjectEnabled", "false");
+						CurObj->State->Enabled = false;
+						Overlay_RecordEnabled(CurObj, true); /*We checked it was enabled above.*/
 					}
 				}
 				
@@ -763,10 +1851,10 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 			case STOP_INVALID:
 				break;
 			case STOP_NONE:
-				CurObj->Started = false; /*Just say we did it even if nothing to do.*/
-				CurObj->StartedSince = 0;
+				CurObj->State->Started = false; /*Just say we did it even if nothing to do.*/
+				CurObj->State->StartedSince = 0;
 				ExitStatus = SUCCESS;
-				CurObj->ObjectPID = 0;
+				CurObj->State->ObjectPID = 0;
 				break;
 			case STOP_PID:
 			{
@@ -775,7 +1863,7 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 					BeginStatusReport(PrintOutStream);
 				}
 				
-				if (!CurObj->ObjectPID)
+				if (!CurObj->State->ObjectPID)
 				{
 					ExitStatus = FAILURE;
 					if (PrintStatus)
@@ -785,7 +1873,7 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 					break;
 				}
 				
-				if (kill(CurObj->ObjectPID, CurObj->TermSignal) == 0)
+				if (kill(CurObj->State->ObjectPID, CurObj->TermSignal) == 0)
 				{ /*Just send SIGTERM.*/
 					if (!CurObj->Opts.NoStopWait)
 					{
@@ -798,10 +1886,10 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 						CurrentTask.Set = true;
 								
 						/*Give it ten seconds to terminate on it's own.*/
-						for (; kill(CurObj->ObjectPID, 0) == 0 && TInc < CurObj->Opts.StopTimeout * 20 && !Abort; ++TInc)
+						for (; kill(CurObj->State->ObjectPID, 0) == 0 && TInc < CurObj->Opts.StopTimeout * 20 && !Abort; ++TInc)
 						{
 							
-							waitpid(CurObj->ObjectPID, NULL, WNOHANG); /*We must harvest the PID since we have occupied the primary loop.*/
+							waitpid(CurObj->State->ObjectPID, NULL, WNOHANG); /*We must harvest the PID since we have occupied the primary loop.*/
 							
 							usleep(50000);
 						}
@@ -836,9 +1924,9 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 				
 				if (ExitStatus)
 				{
-					CurObj->ObjectPID = 0;
-					CurObj->StartedSince = 0;
-					CurObj->Started = false;
+					CurObj->State->ObjectPID = 0;
+					CurObj->State->StartedSince = 0;
+					CurObj->State->Started = false;
 				}
 				
 				if (PrintStatus)
@@ -919,9 +2007,9 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 				
 				if (ExitStatus)
 				{
-					CurObj->Started = false;
-					CurObj->StartedSince = 0;
-					CurObj->ObjectPID = 0;
+					CurObj->State->Started = false;
+					CurObj->State->StartedSince = 0;
+					CurObj->State->ObjectPID = 0;
 				}
 				
 				if (PrintStatus)
@@ -941,13 +2029,99 @@ ReturnCode ProcessConfigObject(ObjTable *CurObj, Bool IsStartingMode, Bool Print
 			EmergencyShell();
 		}
 		
+		if (ExitStatus) Control_Event("STOPPED", CurObj->ObjectID, ExitStatus == WARNING ? "warning" : NULL);
+		
 		/*Now that the object is stopped, we should reset the autorestart to it's previous state.*/
-		CurObj->Opts.AutoRestart = LastAutoRestartState;
+		CurObj->State->AutoRestart = LastAutoRestartState;
 	}
 	
 	return ExitStatus;
 }
 
+void StopObjectGroup(ObjTable **Objects, unsigned NumObjects, ReturnCode *Results)
+{ /*Stops objects that share a stop priority in one go. Those we stop with a signal all get it up front
+	* and are waited on together, so the group takes as long as its slowest member rather than all of them added up.
+	* Anything with a stop command goes through ProcessConfigObject() while those wind down.*/
+	struct _GroupStop { unsigned PID; Bool Signalled, AutoRestart; } *Stops = calloc(NumObjects, sizeof(struct _GroupStop));
+	unsigned Inc = 0, Waiting = 0, Tick = 0;
+	Bool Abort = false;
+	
+	if (!Stops)
+	{ /*One at a time then.*/
+		for (; Inc < NumObjects; ++Inc) Results[Inc] = ProcessConfigObject(Objects[Inc], false, false);
+		return;
+	}
+	
+	for (; Inc < NumObjects; ++Inc)
+	{
+		ObjTable *const CurObj = Objects[Inc];
+		
+		if ((CurObj->Opts.StopMode != STOP_PID && CurObj->Opts.StopMode != STOP_PIDFILE) || CurObj->Opts.NoStopWait) continue;
+		
+		Stops[Inc].Signalled = true;
+		Stops[Inc].AutoRestart = CurObj->State->AutoRestart;
+		CurObj->State->AutoRestart = false; /*Same as ProcessConfigObject(), so it can't come back on its own.*/
+		Stops[Inc].PID = CurObj->Opts.StopMode == STOP_PIDFILE ? ReadPIDFile(CurObj) : CurObj->State->ObjectPID;
+		Results[Inc] = FAILURE;
+		
+		if (!Stops[Inc].PID || kill(Stops[Inc].PID, CurObj->TermSignal) != 0) Stops[Inc].PID = 0;
+		else ++Waiting;
+	}
+	
+	for (Inc = 0; Inc < NumObjects; ++Inc)
+	{
+		if (!Stops[Inc].Signalled) Results[Inc] = ProcessConfigObject(Objects[Inc], false, false);
+	}
+	
+	CurrentTask.Node = (void*)&Abort;
+	CurrentTask.PID = 0;
+	CurrentTask.TaskName = Objects[0]->ObjectID;
+	CurrentTask.Set = true;
+	
+	for (; Waiting && !Abort; ++Tick, usleep(50000))
+	{
+		for (Inc = 0; Inc < NumObjects; ++Inc)
+		{
+			if (!Stops[Inc].PID) continue;
+			
+			waitpid(Stops[Inc].PID, NULL, WNOHANG); /*Nobody else is harvesting while we're in here.*/
+			
+			if (kill(Stops[Inc].PID, 0) != 0) Results[Inc] = SUCCESS;
+			else if (Tick >= Objects[Inc]->Opts.StopTimeout * 20) Results[Inc] = FAILURE;
+			else continue;
+			
+			Stops[Inc].PID = 0;
+			--Waiting;
+		}
+	}
+	
+	CurrentTask.Set = false;
+	CurrentTask.Node = NULL;
+	CurrentTask.TaskName = NULL;
+	
+	for (Inc = 0; Inc < NumObjects; ++Inc)
+	{
+		ObjTable *const CurObj = Objects[Inc];
+		
+		if (!Stops[Inc].Signalled) continue;
+		
+		if (Stops[Inc].PID) Results[Inc] = WARNING; /*Aborted while we were waiting on it.*/
+		
+		if (Results[Inc])
+		{
+			CurObj->State->ObjectPID = 0;
+			CurObj->State->Started = false;
+			CurObj->State->StartedSince = 0;
+			
+			Control_Event("STOPPED", CurObj->ObjectID, Results[Inc] == WARNING ? "warning" : NULL);
+		}
+		
+		CurObj->State->AutoRestart = Stops[Inc].AutoRestart;
+	}
+	
+	free(Stops);
+}
+
 /*This function does what it sounds like. It's not the entire boot sequence, we gotta display a message and stuff.*/
 ReturnCode RunAllObjects(Bool IsStartingMode)
 {
@@ -977,12 +2151,12 @@ ReturnCode RunAllObjects(Bool IsStartingMode)
 			}
 			
 			//Disabled in config but enabled from kernel cli
-			if (!CurObj->Enabled && IsStartingMode && CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(CurObj->ObjectID, true))
+			if (!CurObj->State->Enabled && IsStartingMode && CurrentBootMode == BOOT_BOOTUP && KCmdLineObjCmd_Check(CurObj->ObjectID, true))
 			{
 				goto NextLogic;
 			}
 			
-			if (!CurObj->Enabled && (IsStartingMode || CurObj->Opts.HaltCmdOnly))
+			if (!CurObj->State->Enabled && (IsStartingMode || CurObj->Opts.HaltCmdOnly))
 			{ /*Stop even disabled objects, but not disabled HALTONLY objects.*/
 				continue;
 			}
@@ -999,7 +2173,7 @@ ReturnCode RunAllObjects(Bool IsStartingMode)
 				continue;
 			}
 			
-			if ((IsStartingMode ? !CurObj->Started : CurObj->Started))
+			if ((IsStartingMode ? !CurObj->State->Started : CurObj->State->Started))
 			{
 				if (InteractiveBoot && CurrentBootMode == BOOT_BOOTUP && CurObj->Opts.Interactive)
 				{ //We are being requested to prompt for everything we do on bootup.
@@ -1052,7 +2226,7 @@ ReturnCode ProcessReloadCommand(ObjTable *CurObj, Bool PrintStatus)
 	
 	if (CurObj->ReloadCommandSignal != 0)
 	{
-		const unsigned PID = CurObj->Opts.HasPIDFile ? ReadPIDFile(CurObj) : CurObj->ObjectPID;
+		const unsigned PID = CurObj->Opts.HasPIDFile ? ReadPIDFile(CurObj) : CurObj->State->ObjectPID;
 
 		if (!PID) return FAILURE;
 		
@@ -1078,11 +2252,11 @@ ReturnCode SwitchRunlevels(const char *Runlevel)
 	ObjTable *LastNode = NULL;
 	/*Check the runlevel has objects first.*/
 	
-	for (; TObj->Next != NULL; TObj = TObj->Next)
+	for (; TObj->ObjectID != NULL; ++TObj)
 	{ /*I think a while loop would look much better, but if I did that,
 		* I'd get folks asking "why didn't you use a for loop?", so here!*/
 		if (!TObj->Opts.HaltCmdOnly && ObjRL_CheckRunlevel(Runlevel, TObj, true) &&
-			TObj->Enabled && TObj->ObjectStartPriority > 0)
+			TObj->State->Enabled && TObj->State->ObjectStartPriority > 0)
 		{
 			++NumInRunlevel;
 		}
@@ -1103,7 +2277,7 @@ ReturnCode SwitchRunlevels(const char *Runlevel)
 				return FAILURE;
 			}
 			
-			if (TObj->Started && !TObj->Opts.Persistent && !TObj->Opts.HaltCmdOnly &&
+			if (TObj->State->Started && !TObj->Opts.Persistent && !TObj->Opts.HaltCmdOnly &&
 				!ObjRL_CheckRunlevel(Runlevel, TObj, true))
 			{
 				ProcessConfigObject(TObj, false, true);
@@ -1113,6 +2287,7 @@ ReturnCode SwitchRunlevels(const char *Runlevel)
 	
 	/*Good to go, so change us to the new runlevel.*/
 	snprintf(CurRunlevel, MAX_DESCRIPT_SIZE, "%s", Runlevel);
+	Control_Event("RUNLEVEL", NULL, CurRunlevel);
 	MaxPriority = GetHighestPriority(true);
 	
 	/*Now start the things that ARE meant for our runlevel.*/
@@ -1125,7 +2300,7 @@ ReturnCode SwitchRunlevels(const char *Runlevel)
 				return FAILURE;
 			}
 			
-			if (TObj->Enabled && !TObj->Started)
+			if (TObj->State->Enabled && !TObj->State->Started)
 			{
 				ProcessConfigObject(TObj, true, true);
 			}
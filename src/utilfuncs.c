@@ -14,19 +14,298 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "epoch.h"
 
+/*How much log text we hold before writing it out, and how long a line may wait.*/
+#define LOG_BUFFER_SIZE 16384
+#define LOG_FLUSH_DELAY 1
+
 /**Constants**/
 Bool EnableLogging = true;
 Bool LogInMemory = true; /*This is necessary so long as we have a readonly filesystem.*/
 Bool BlankLogOnBoot = true;
-char *MemLogBuffer;
 
 /*Days in the month, for time stuff.*/
 static const unsigned char MDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 char LogFile[MAX_LINE_SIZE] = LOGFILE;
+struct _RotatePolicy LogRotate; /*Nothing by default, like before.*/
+
+/*The log stays open between lines, and lines are written out in batches.*/
+static struct
+{
+	int Descriptor; /*-1 while closed.*/
+	char Path[MAX_LINE_SIZE]; /*What LogFile was when we opened it.*/
+	dev_t Device;
+	ino_t Inode; /*So we notice when someone rotates the file out from under us.*/
+	time_t Oldest; /*When the first line still in Buffer was queued.*/
+	time_t LastCheck;
+	time_t RotateSince; /*When this file was started over, as best we know.*/
+	time_t RotateCheck;
+	size_t Used;
+	char Buffer[LOG_BUFFER_SIZE];
+} LogWriter = { -1 };
+
+static volatile sig_atomic_t LogReopenPending;
+
+/*Every line we log also goes here. Before / is writable this is all we have, and later it's what 'epoch log' reads.*/
+static char EpochLogData[LOGRING_SIZE];
+struct _LogRing EpochLog = { 0, 0, 0, 0, sizeof EpochLogData, EpochLogData };
+
+void LogRing_Append(struct _LogRing *Ring, const char *InStream, size_t Length)
+{ /*Makes room by dropping whole lines off the front. Lines must end in a newline.*/
+	const size_t Offset = Ring->End % Ring->Size;
+	
+	while (Ring->End + Length - Ring->Start > Ring->Size)
+	{
+		while (Ring->Start < Ring->End && Ring->Data[Ring->Start++ % Ring->Size] != '\n');
+		
+		if (Ring->Start > Ring->OnDisk) ++Ring->Lost;
+	}
+	
+	if (Offset + Length <= Ring->Size)
+	{
+		memcpy(Ring->Data + Offset, InStream, Length);
+	}
+	else
+	{
+		memcpy(Ring->Data + Offset, InStream, Ring->Size - Offset);
+		memcpy(Ring->Data, InStream + (Ring->Size - Offset), Length - (Ring->Size - Offset));
+	}
+	
+	Ring->End += Length;
+}
+
+static void LogRing_Splice(struct _LogRing *Ring, int Descriptor)
+{ /*Writes out everything that never made it to disk, in one go.*/
+	const unsigned long long From = Ring->OnDisk > Ring->Start ? Ring->OnDisk : Ring->Start;
+	const size_t Offset = From % Ring->Size, Length = Ring->End - From;
+	char Notice[128];
+	struct iovec Parts[3];
+	int NumParts = 0;
+	
+	if (Ring->Lost)
+	{
+		snprintf(Notice, sizeof Notice, "[Epoch: %lu log lines were dropped before they could be saved.]\n", Ring->Lost);
+		Parts[NumParts].iov_base = Notice;
+		Parts[NumParts++].iov_len = strlen(Notice);
+	}
+	
+	Parts[NumParts].iov_base = Ring->Data + Offset;
+	Parts[NumParts++].iov_len = Offset + Length <= Ring->Size ? Length : Ring->Size - Offset;
+	
+	if (Offset + Length > Ring->Size)
+	{
+		Parts[NumParts].iov_base = Ring->Data;
+		Parts[NumParts++].iov_len = Length - (Ring->Size - Offset);
+	}
+	
+	if (Length || Ring->Lost) writev(Descriptor, Parts, NumParts);
+	
+	Ring->OnDisk = Ring->End;
+	Ring->Lost = 0;
+}
+
+unsigned long long LogRing_Tail(const struct _LogRing *Ring, unsigned Lines)
+{ /*Where the last Lines lines start. Zero gets everything we have.*/
+	unsigned long long Pos = Ring->End;
+	
+	if (!Lines) return Ring->Start;
+	
+	for (; Pos > Ring->Start; --Pos)
+	{
+		if (Pos != Ring->End && Ring->Data[(Pos - 1) % Ring->Size] == '\n' && !--Lines) break;
+	}
+	
+	return Pos;
+}
+
+size_t LogRing_Read(const struct _LogRing *Ring, unsigned long long *Pos, char *OutStream, size_t OutSize)
+{ /*Copies out from *Pos and moves it along. Returns the length, zero once we've caught up.*/
+	size_t Length = 0;
+	
+	if (*Pos < Ring->Start) *Pos = Ring->Start; /*It was overwritten under us.*/
+	
+	for (; *Pos < Ring->End && Length < OutSize - 1; ++*Pos)
+	{
+		OutStream[Length++] = Ring->Data[*Pos % Ring->Size];
+	}
+	
+	OutStream[Length] = '\0';
+	
+	return Length;
+}
+
+static Bool Log_Open(Bool Truncate)
+{
+	struct stat FileStat;
+	
+	if (LogWriter.Descriptor != -1) close(LogWriter.Descriptor);
+	
+	LogWriter.Descriptor = open(LogFile, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (Truncate ? O_TRUNC : 0), 0644);
+	LogReopenPending = false;
+	
+	if (LogWriter.Descriptor == -1) return false;
+	
+	fstat(LogWriter.Descriptor, &FileStat);
+	LogWriter.Device = FileStat.st_dev;
+	LogWriter.Inode = FileStat.st_ino;
+	LogWriter.RotateSince = Rotate_Since(LogFile, time(NULL));
+	snprintf(LogWriter.Path, sizeof LogWriter.Path, "%s", LogFile);
+	
+	return true;
+}
+
+static Bool Log_Stale(void)
+{ /*Asked to reopen, pointed somewhere else, or rotated away. We stat at most once a second.*/
+	struct stat FileStat;
+	const time_t Now = time(NULL);
+	
+	if (LogReopenPending || strcmp(LogWriter.Path, LogFile) != 0) return true;
+	
+	if (Now == LogWriter.LastCheck) return false;
+	
+	LogWriter.LastCheck = Now;
+	
+	return stat(LogFile, &FileStat) != 0 || FileStat.st_ino != LogWriter.Inode || FileStat.st_dev != LogWriter.Device;
+}
+
+const char *Log_Timestamp(void)
+{ /*Lines come in bursts, so only redo localtime() when the second changes.*/
+	static char Stamp[64];
+	static time_t StampTime = -1;
+	const time_t Now = time(NULL);
+	struct tm TimeStruct;
+	
+	if (Now != StampTime)
+	{
+		localtime_r(&Now, &TimeStruct);
+		snprintf(Stamp, sizeof Stamp, "[%02d:%02d:%02d | %02d-%02d-%02d]", TimeStruct.tm_hour, TimeStruct.tm_min,
+				TimeStruct.tm_sec, TimeStruct.tm_year + 1900, TimeStruct.tm_mon + 1, TimeStruct.tm_mday);
+		StampTime = Now;
+	}
+	
+	return Stamp;
+}
+
+void Log_Flush(void)
+{ /*Write out whatever we're holding.*/
+	size_t Written = 0;
+	
+	if (!LogWriter.Used) return;
+	
+	if ((LogWriter.Descriptor == -1 || Log_Stale()) && !Log_Open(false))
+	{ /*Nowhere to put it. Same as a failed fopen() used to be, the lines are gone.*/
+		LogWriter.Used = 0;
+		return;
+	}
+	
+	while (Written < LogWriter.Used)
+	{
+		const ssize_t Chunk = write(LogWriter.Descriptor, LogWriter.Buffer + Written, LogWriter.Used - Written);
+		
+		if (Chunk <= 0)
+		{
+			if (Chunk == -1 && errno == EINTR) continue;
+			break;
+		}
+		
+		Written += Chunk;
+	}
+	
+	LogWriter.Used = 0;
+}
+
+time_t Rotate_Since(const char *Path, time_t Fallback)
+{ /*A file was started over when its last one stopped being written to. We don't keep that anywhere else.*/
+	char OldPath[MAX_LINE_SIZE + 8];
+	struct stat FileStat;
+	
+	snprintf(OldPath, sizeof OldPath, "%s.1", Path);
+	
+	return stat(OldPath, &FileStat) == 0 ? FileStat.st_mtime : Fallback;
+}
+
+Bool Rotate_Due(const struct _RotatePolicy *Policy, unsigned long long Size, unsigned long long Adding, time_t Since)
+{ /*Never for an empty file, however old. Nothing would be gained.*/
+	if (!Size) return false;
+	
+	if (Policy->MaxSize && Size + Adding > Policy->MaxSize) return true;
+	
+	return Policy->MaxAge && time(NULL) - Since >= (time_t)Policy->MaxAge;
+}
+
+void Rotate_Shift(const char *Path, unsigned Keep)
+{ /*Path.N-1 becomes Path.N and so on down, which drops the oldest. Path itself is left gone for the caller to reopen.*/
+	char From[MAX_LINE_SIZE + 16], To[MAX_LINE_SIZE + 16];
+	
+	if (!Keep) Keep = 1;
+	
+	for (; Keep > 1; --Keep)
+	{
+		snprintf(From, sizeof From, "%s.%u", Path, Keep - 1);
+		snprintf(To, sizeof To, "%s.%u", Path, Keep);
+		rename(From, To);
+	}
+	
+	snprintf(To, sizeof To, "%s.1", Path);
+	rename(Path, To);
+}
+
+void Log_Tick(void)
+{ /*From the primary loop. Lines don't wait long once things quiet down, and the file is rotated when it's due.*/
+	const time_t Now = time(NULL);
+	struct stat FileStat;
+	
+	if (LogWriter.Used && Now - LogWriter.Oldest >= LOG_FLUSH_DELAY) Log_Flush();
+	
+	if ((!LogRotate.MaxSize && !LogRotate.MaxAge) || LogWriter.Descriptor == -1 || Now == LogWriter.RotateCheck) return;
+	
+	LogWriter.RotateCheck = Now;
+	
+	if (fstat(LogWriter.Descriptor, &FileStat) != 0 ||
+		!Rotate_Due(&LogRotate, FileStat.st_size + LogWriter.Used, 0, LogWriter.RotateSince))
+	{
+		return;
+	}
+	
+	/*Everything we have goes in the old file first, and nothing can be written between the rename and the reopen.*/
+	Log_Flush();
+	Rotate_Shift(LogWriter.Path, LogRotate.Keep);
+	Log_Open(false);
+	LogWriter.RotateSince = Now;
+}
+
+void Log_Close(void)
+{ /*Before anything that would lose the buffer, or needs the filesystem unmounted.*/
+	Log_Flush();
+	
+	if (LogWriter.Descriptor != -1)
+	{
+		close(LogWriter.Descriptor);
+		LogWriter.Descriptor = -1;
+	}
+}
+
+void Log_Reopen(void)
+{ /*Signal safe. The next flush picks up a new file.*/
+	LogReopenPending = true;
+}
+
+Bool Log_Begin(Bool Truncate)
+{ /*Takes logging out of memory mode, starting the file with what we gathered there.*/
+	LogInMemory = false;
+	
+	if (!Log_Open(Truncate)) return false;
+	
+	LogRing_Splice(&EpochLog, LogWriter.Descriptor);
+	
+	return true;
+}
 
 Bool AllNumeric(const char *InStream)
 { /*Is the string all numbers?*/
@@ -48,16 +327,20 @@ Bool AllNumeric(const char *InStream)
 
 ReturnCode WriteLogLine(const char *InStream, Bool AddDate)
 { /*This is pretty much the entire logging system.*/
-	FILE *Descriptor = NULL;
-	char Hr[16], Min[16], Sec[16], Month[16], Day[16], Year[16], OBuf[MAX_LINE_SIZE + 64] = { '\0' };
+	char OBuf[MAX_LINE_SIZE + 64] = { '\0' };
+	size_t Length = 0;
 	static Bool FailedBefore = false;
 	
+	/*The journal doesn't care whether the text log is on. We only know how bad a line is by its color.*/
+	Journal_Write(NULL, strstr(InStream, CONSOLE_COLOR_RED) ? JOURNAL_ERROR : strstr(InStream, CONSOLE_COLOR_YELLOW) ?
+					JOURNAL_WARNING : JOURNAL_INFO, InStream, strlen(InStream));
+	
 	if (!EnableLogging)
 	{
 		return SUCCESS;
 	}
 	
-	if (!LogInMemory && !(Descriptor = fopen(LogFile, "a")))
+	if (!LogInMemory && LogWriter.Descriptor == -1 && !Log_Open(false))
 	{
 		if (!FailedBefore)
 		{
@@ -68,35 +351,35 @@ ReturnCode WriteLogLine(const char *InStream, Bool AddDate)
 		return FAILURE;
 	}
 	
-	GetCurrentTime(Hr, Min, Sec, Year, Month, Day);
-	
 	if (AddDate)
 	{
-		snprintf(OBuf, MAX_LINE_SIZE + 64, "[%s:%s:%s | %s-%s-%s] %s\n", Hr, Min, Sec, Year, Month, Day, InStream);
+		snprintf(OBuf, MAX_LINE_SIZE + 64, "%s %s\n", Log_Timestamp(), InStream);
 	}
 	else
 	{
 		snprintf(OBuf, MAX_LINE_SIZE, "%s\n", InStream);
 	}
 	
-	if (LogInMemory)
-	{
-		if (MemLogBuffer == NULL)
-		{
-			MemLogBuffer = malloc(1);
-			*MemLogBuffer = '\0';
-		}
-		
-		MemLogBuffer = realloc(MemLogBuffer, strlen(MemLogBuffer) + strlen(OBuf) + 1);
-		
-		strncat(MemLogBuffer, OBuf, strlen(OBuf));
+	Length = strlen(OBuf);
+	OBuf[Length - 1] = '\n'; /*In case it was cut short. The ring needs every line to end in one.*/
+	
+	if (!LogInMemory && EpochLog.OnDisk != EpochLog.End)
+	{ /*Lines from a stretch in memory mode, like a config reload. They go first.*/
+		Log_Flush();
+		LogRing_Splice(&EpochLog, LogWriter.Descriptor);
 	}
-	else
+	
+	LogRing_Append(&EpochLog, OBuf, Length);
+	
+	if (!LogInMemory)
 	{
-		fwrite(OBuf, 1, strlen(OBuf), Descriptor);
+		if (LogWriter.Used + Length > sizeof LogWriter.Buffer) Log_Flush();
+		
+		if (!LogWriter.Used) LogWriter.Oldest = time(NULL);
 		
-		fflush(Descriptor);
-		fclose(Descriptor);
+		memcpy(LogWriter.Buffer + LogWriter.Used, OBuf, Length);
+		LogWriter.Used += Length;
+		EpochLog.OnDisk = EpochLog.End;
 	}
 	
 	return SUCCESS;
@@ -114,7 +397,7 @@ Bool ObjectProcessRunning(const ObjTable *InObj)
 	if (!InObj->Opts.HasPIDFile || !(InPID = ReadPIDFile(InObj)))
 	{ /*We got a PID file requested and present? Get PID from that, otherwise 
 		* get the PID from memory.*/
-		InPID = InObj->ObjectPID;
+		InPID = InObj->State->ObjectPID;
 	}
 	
 	if (InPID == 0) /*This means the object has no PID.*/
@@ -302,7 +585,7 @@ unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID)
 	
 	while ((DirPtr = readdir(ProcDir)))
 	{
-		if (AllNumeric(DirPtr->d_name) && atol(DirPtr->d_name) >= InObj->ObjectPID)
+		if (AllNumeric(DirPtr->d_name) && atol(DirPtr->d_name) >= InObj->State->ObjectPID)
 		{
 			int TChar;
 			
@@ -340,7 +623,7 @@ unsigned AdvancedPIDFind(ObjTable *InObj, Bool UpdatePID)
 				
 				if (UpdatePID)
 				{
-					InObj->ObjectPID = RealPID;
+					InObj->State->ObjectPID = RealPID;
 				}
 				
 				closedir(ProcDir);
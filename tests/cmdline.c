@@ -0,0 +1,186 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**Checks which command lines CmdLine_Compile() runs itself and which it leaves to /bin/sh,
+ * and that plans rebuilt for new credentials don't pile up. It's static, so we pull in parse.c whole. See runtests.sh.**/
+
+#include "../src/parse.c"
+
+static char *TestEnv[] = { "HOME=/home/test", "SPACED=a b", "GLOB=*.c", "EMPTY=", "PATH=/nonexistent", NULL };
+static unsigned Failures;
+
+static void Report(Bool Passed, const char *Cmd, const char *Why)
+{
+	if (Passed) return;
+
+	printf("FAIL: [%s]: %s\n", Cmd, Why);
+	++Failures;
+}
+
+static void ExpectShell(const char *Cmd)
+{ /*Anything we can't do exactly the way sh would.*/
+	struct _ExecPlan Plan;
+
+	memset(&Plan, 0, sizeof Plan);
+	Plan.EnvP = TestEnv;
+
+	Report(!CmdLine_Compile(Cmd, TestEnv, &Plan), Cmd, "compiled, but it needs a shell");
+}
+
+static struct _ExecPlan *ExpectCompiled(const char *Cmd, unsigned NumSteps)
+{
+	static struct _ExecPlan Plan;
+
+	memset(&Plan, 0, sizeof Plan);
+	Plan.EnvP = TestEnv;
+
+	if (!CmdLine_Compile(Cmd, TestEnv, &Plan))
+	{
+		Report(false, Cmd, "fell back to the shell");
+		return NULL;
+	}
+
+	if (Plan.NumSteps != NumSteps)
+	{
+		Report(false, Cmd, "wrong number of steps");
+		return NULL;
+	}
+
+	return &Plan;
+}
+
+static void ExpectArgs(const char *Cmd, const char *const *ArgV)
+{ /*A single step with exactly these arguments.*/
+	const struct _ExecPlan *const Plan = ExpectCompiled(Cmd, 1);
+	unsigned Inc = 0;
+
+	if (!Plan) return;
+
+	for (; ArgV[Inc]; ++Inc)
+	{
+		if (!Plan->Steps->ArgV[Inc] || strcmp(Plan->Steps->ArgV[Inc], ArgV[Inc]) != 0)
+		{
+			Report(false, Cmd, "wrong arguments");
+			return;
+		}
+	}
+
+	Report(!Plan->Steps->ArgV[Inc], Cmd, "extra arguments");
+}
+
+static void CheckCompiled(void)
+{
+	const struct _ExecPlan *Plan = NULL;
+
+	ExpectArgs("/sbin/agetty tty1 38400", (const char*[]){ "/sbin/agetty", "tty1", "38400", NULL });
+	ExpectArgs("  echo\t two  ", (const char*[]){ "echo", "two", NULL });
+	ExpectArgs("echo 'a  b' \"c d\" e\\ f", (const char*[]){ "echo", "a  b", "c d", "e f", NULL });
+	ExpectArgs("echo $HOME ${HOME}/x \"$SPACED\"", (const char*[]){ "echo", "/home/test", "/home/test/x", "a b", NULL });
+	ExpectArgs("echo \"\\$HOME \\\"q\\\" \\n\"", (const char*[]){ "echo", "$HOME \"q\" \\n", NULL });
+	ExpectArgs("echo $EMPTY $UNSET x", (const char*[]){ "echo", "x", NULL }); /*Unquoted and empty, so not a word.*/
+	ExpectArgs("echo \"\" ''", (const char*[]){ "echo", "", "", NULL }); /*Quoted, so they are.*/
+	ExpectArgs("[ -f /etc/fstab ]", (const char*[]){ "[", "-f", "/etc/fstab", "]", NULL });
+	ExpectArgs("echo a=b", (const char*[]){ "echo", "a=b", NULL }); /*Only an assignment before the command.*/
+	ExpectArgs("echo done;", (const char*[]){ "echo", "done", NULL });
+
+	if ((Plan = ExpectCompiled("a && b || c ; d | e", 5)))
+	{
+		Report(Plan->Steps[0].Link == EXECLINK_AND && Plan->Steps[1].Link == EXECLINK_OR &&
+				Plan->Steps[2].Link == EXECLINK_SEQ && Plan->Steps[3].Link == EXECLINK_PIPE &&
+				Plan->Steps[4].Link == EXECLINK_END, "a && b || c ; d | e", "wrong links");
+	}
+
+	if ((Plan = ExpectCompiled("daemon -f >/var/log/d.log 2>&1 </dev/null", 1)))
+	{
+		const struct _ExecRedirect *const R = Plan->Steps->Redirects;
+
+		Report(Plan->Steps->NumRedirects == 3 &&
+				R[0].FD == STDOUT_FILENO && R[0].Path && !strcmp(R[0].Path, "/var/log/d.log") &&
+				R[0].Flags == (O_WRONLY | O_CREAT | O_TRUNC) &&
+				R[1].FD == 2 && !R[1].Path && R[1].DupFD == 1 &&
+				R[2].FD == STDIN_FILENO && !strcmp(R[2].Path, "/dev/null") && R[2].Flags == O_RDONLY,
+				"daemon -f >/var/log/d.log 2>&1 </dev/null", "wrong redirects");
+	}
+
+	if ((Plan = ExpectCompiled("logger hi >> /tmp/log", 1)))
+	{
+		Report(Plan->Steps->NumRedirects == 1 && Plan->Steps->Redirects->Flags == (O_WRONLY | O_CREAT | O_APPEND),
+				"logger hi >> /tmp/log", "not appending");
+	}
+}
+
+static void CheckShell(void)
+{
+	static const char *const Cmds[] = {
+		/*Job control and friends.*/
+		"daemon &", "a |& b", "a & b",
+		/*Assignments, expansions and substitutions we don't do.*/
+		"FOO=1 daemon", "echo $(date)", "echo `date`", "echo \"`date`\"", "echo $1", "echo ${HOME", "echo ${HOME:-x}",
+		"echo ~/x", "echo $SPACED", "echo $GLOB",
+		/*Globs, braces and subshells.*/
+		"ls *.c", "ls file?", "echo {a,b}", "(cd /tmp)", "ls [ab]",
+		/*Keywords and builtins.*/
+		"cd /tmp", "exec daemon", "if true; then x; fi", "while true; do x; done", "! false", ". /etc/rc.conf",
+		"export A=b", "ulimit -n 1024",
+		/*Redirections we leave alone.*/
+		"cat <<EOF", "cat <&3", "cat <>f", "echo >|f", "echo 2>&-", "echo 2>&10", "echo >", "echo > ; x", "echo > >f",
+		/*Things that don't parse, so sh can print the error.*/
+		"echo 'open", "echo \"open", "echo \\", "; echo", "a && && b", "a ||", "| b", "a ; ;", "# comment", "",
+		NULL };
+	unsigned Inc = 0;
+
+	for (; Cmds[Inc]; ++Inc) ExpectShell(Cmds[Inc]);
+}
+
+static void CheckRebuild(void)
+{ /*Each time /etc/passwd or /etc/group changes, only ObjectUser's start plan is redone, and not in the arena.*/
+	static ObjTable Objects[2];
+	struct _ConfigArenaStats Before, After;
+	const struct _ExecPlan *Start = NULL, *Stop = NULL;
+	unsigned NumBlocks = 0, Inc = 0;
+
+	Objects->ObjectID = "daemon";
+	Objects->ObjectStartCommand = "daemon --foreground";
+	Objects->ObjectStopCommand = "daemon --stop";
+	Objects->UserID = 65534;
+	ObjectTable = Objects;
+
+	ExecPlan_Stamp();
+	ExecPlan_PrepareObject(Objects);
+
+	Start = ExecPlan_Get(Objects, Objects->ObjectStartCommand);
+	Stop = ExecPlan_Get(Objects, Objects->ObjectStopCommand);
+	Report(Start && Start->SetUser && ExecPlan_Get(Objects, Objects->ObjectStartCommand) == Start,
+			"ObjectUser", "rebuilt with nothing changed");
+
+	ConfigArena_GetStats(&Before);
+
+	for (; Inc < 3; ++Inc)
+	{
+		ExecPlanStamp.Passwd ^= 1;
+		Report(ExecPlan_Get(Objects, Objects->ObjectStartCommand) != Start, "ObjectUser", "not rebuilt for new credentials");
+		Start = Objects->ExecPlans[EXECPLAN_START];
+		
+		if (Inc) Report(ExecPlanHeap.NumBlocks == NumBlocks, "ObjectUser", "kept the plans it replaced");
+		NumBlocks = ExecPlanHeap.NumBlocks;
+	}
+
+	ConfigArena_GetStats(&After);
+
+	Report(ExecPlan_Get(Objects, Objects->ObjectStopCommand) == Stop, "ObjectUser", "rebuilt a stop command");
+	Report(After.BytesUsed == Before.BytesUsed, "ObjectUser", "rebuilt into the arena");
+
+	ObjectTable = NULL;
+}
+
+int main(void)
+{
+	CheckCompiled();
+	CheckShell();
+	CheckRebuild();
+
+	printf("cmdline: %s\n", Failures ? "FAILED" : "ok");
+	return Failures != 0;
+}
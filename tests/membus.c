@@ -0,0 +1,259 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**Sends long messages through MemBus_WriteLong() and reads them back with MemBus_ReadLong(),
+ * over both the shared memory bus and the control socket. Also feeds the reader pieces that are
+ * out of order or claim to be too big, which it has to turn down. See runtests.sh.**/
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MEMBUS_LONGMSG_TIMEOUT 2 /*So SendTrickle() doesn't take all day.*/
+#include "../src/membus.c"
+
+static unsigned Failures;
+
+/*What the writer sends. It's forked off, so these are set up before that.*/
+static const char *SendData;
+static unsigned SendSize;
+static void (*SendFunc)(void);
+
+static void SendLong(void)
+{
+	MemBus_WriteLong(SendData, SendSize, true);
+}
+
+static void SendShort(void)
+{
+	MemBus_Write(SendData, true);
+}
+
+static void SendFrame(unsigned Sequence, unsigned TotalLength, unsigned Length, unsigned Flags)
+{ /*A piece of our own making, so we can get it wrong on purpose.*/
+	char OutBuf[MEMBUS_MSGSIZE];
+	struct _MemBusChunk Chunk = { Sequence, TotalLength, Length, Flags };
+
+	memcpy(OutBuf, MEMBUS_CODE_CHUNK, sizeof MEMBUS_CODE_CHUNK);
+	memcpy(OutBuf + sizeof MEMBUS_CODE_CHUNK, &Chunk, sizeof Chunk);
+	memset(OutBuf + sizeof MEMBUS_CODE_CHUNK + sizeof Chunk, 'x', MEMBUS_CHUNK_PAYLOAD);
+
+	MemBus_BinWrite(OutBuf, sizeof MEMBUS_CODE_CHUNK + sizeof Chunk + Length, true);
+}
+
+static void SendGap(void)
+{ /*Piece 1 never shows up. The lengths still add up, so only the sequence gives it away.*/
+	SendFrame(0, MEMBUS_CHUNK_PAYLOAD * 2, MEMBUS_CHUNK_PAYLOAD, MEMBUS_CHUNK_MORE);
+	SendFrame(2, MEMBUS_CHUNK_PAYLOAD * 2, MEMBUS_CHUNK_PAYLOAD, 0);
+}
+
+static void SendOverrun(void)
+{ /*The pieces add up to more than the total they claim.*/
+	SendFrame(0, MEMBUS_CHUNK_PAYLOAD + 10, MEMBUS_CHUNK_PAYLOAD, MEMBUS_CHUNK_MORE);
+	SendFrame(1, MEMBUS_CHUNK_PAYLOAD + 10, 20, 0);
+}
+
+static void SendShortfall(void)
+{ /*Says it's done before the total arrived.*/
+	SendFrame(0, MEMBUS_CHUNK_PAYLOAD * 2, MEMBUS_CHUNK_PAYLOAD, 0);
+}
+
+static void SendTotalChanged(void)
+{
+	SendFrame(0, MEMBUS_CHUNK_PAYLOAD * 2, MEMBUS_CHUNK_PAYLOAD, MEMBUS_CHUNK_MORE);
+	SendFrame(1, MEMBUS_CHUNK_PAYLOAD * 3, MEMBUS_CHUNK_PAYLOAD, 0);
+}
+
+static void SendInterrupted(void)
+{ /*A plain message where the next piece should be.*/
+	SendFrame(0, MEMBUS_CHUNK_PAYLOAD * 2, MEMBUS_CHUNK_PAYLOAD, MEMBUS_CHUNK_MORE);
+	MemBus_Write(MEMBUS_CODE_ACKNOWLEDGED, true);
+}
+
+static void SendTrickle(void)
+{ /*Every piece comes well inside the timeout, but the whole message takes twice as long,
+	* which is more than the second that time() can be off by.*/
+	unsigned Inc = 0;
+
+	for (; Inc < 5; ++Inc)
+	{
+		if (Inc) sleep(1);
+		SendFrame(Inc, MEMBUS_CHUNK_PAYLOAD * 5, MEMBUS_CHUNK_PAYLOAD, Inc < 4 ? MEMBUS_CHUNK_MORE : 0);
+	}
+}
+
+static char *Exchange(Bool OverSocket, unsigned *SizeOut)
+{ /*Runs SendFunc in a child as the server, and reads what it sent as the client.*/
+	void *Root = NULL;
+	int Pair[2] = { -1, -1 };
+	char *Result = NULL;
+	pid_t Writer;
+
+	memset(&MemBus, 0, sizeof MemBus);
+
+	if (OverSocket)
+	{
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, Pair) != 0)
+		{
+			perror("socketpair");
+			exit(1);
+		}
+
+		MemBus.OverSocket = true;
+	}
+	else
+	{ /*Shared, so the futexes work across the fork like they do across shmat().*/
+		if ((Root = mmap(NULL, MEMBUS_TOTALSIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		{
+			perror("mmap");
+			exit(1);
+		}
+
+		MemBus.Root = Root;
+		MemBus.Doorbell = (unsigned*)Root;
+		MemBus.NumSlots = MemBus.Doorbell + 1;
+		*MemBus.NumSlots = 1;
+		MemBus_Select(0);
+		*MemBus.Server.Status = *MemBus.Client.Status = MEMBUS_NOMSG;
+	}
+
+	if ((Writer = fork()) == -1)
+	{
+		perror("fork");
+		exit(1);
+	}
+
+	if (!Writer)
+	{
+		if (OverSocket)
+		{
+			close(Pair[0]);
+			MemBus.Socket = Pair[1];
+		}
+
+		SendFunc();
+		_exit(0);
+	}
+
+	if (OverSocket)
+	{
+		close(Pair[1]);
+		MemBus.Socket = Pair[0];
+	}
+
+	Result = MemBus_ReadLong(SizeOut, false);
+
+	/*It might still be waiting for us to take pieces we gave up on.*/
+	kill(Writer, SIGKILL);
+	waitpid(Writer, NULL, 0);
+
+	if (OverSocket) close(Pair[0]);
+	else munmap(Root, MEMBUS_TOTALSIZE);
+
+	return Result;
+}
+
+static void CheckRoundTrip(Bool OverSocket, unsigned Size)
+{
+	const char *const Transport = OverSocket ? "socket" : "membus";
+	char *const Data = malloc(Size + 1);
+	unsigned Inc = 0, GotSize = ~0u;
+	char *Got = NULL;
+
+	for (; Inc < Size; ++Inc) Data[Inc] = (char)(Inc * 7 + Inc / 251); /*NULs and all.*/
+
+	SendData = Data;
+	SendSize = Size;
+	SendFunc = SendLong;
+
+	Got = Exchange(OverSocket, &GotSize);
+
+	if (!Got || GotSize != Size || memcmp(Got, Data, Size) != 0 || Got[Size] != '\0')
+	{
+		printf("FAIL: %s: %u bytes didn't come back the same.\n", Transport, Size);
+		++Failures;
+	}
+
+	free(Got);
+	free(Data);
+}
+
+static void CheckShort(Bool OverSocket)
+{ /*An ordinary message still reads as one.*/
+	unsigned GotSize = 0;
+	char *Got = NULL;
+
+	SendData = "Reply from the other side.";
+	SendFunc = SendShort;
+
+	Got = Exchange(OverSocket, &GotSize);
+
+	if (!Got || GotSize != strlen(SendData) || strcmp(Got, SendData) != 0)
+	{
+		printf("FAIL: %s: short message didn't come back the same.\n", OverSocket ? "socket" : "membus");
+		++Failures;
+	}
+
+	free(Got);
+}
+
+static void CheckRejected(Bool OverSocket, void (*Func)(void), const char *What)
+{
+	char *Got = NULL;
+
+	SendFunc = Func;
+
+	if ((Got = Exchange(OverSocket, NULL)))
+	{
+		printf("FAIL: %s: %s was accepted.\n", OverSocket ? "socket" : "membus", What);
+		++Failures;
+		free(Got);
+	}
+}
+
+static void CheckOversize(Bool OverSocket)
+{ /*Everything else about it is fine, so it's only the limit that stops it.*/
+	char *const Data = calloc(MEMBUS_LONGMSG_MAX + 1, 1);
+	char *Got = NULL;
+
+	SendData = Data;
+	SendSize = MEMBUS_LONGMSG_MAX + 1;
+	SendFunc = SendLong;
+
+	if ((Got = Exchange(OverSocket, NULL)))
+	{
+		printf("FAIL: %s: a total over MEMBUS_LONGMSG_MAX was accepted.\n", OverSocket ? "socket" : "membus");
+		++Failures;
+		free(Got);
+	}
+
+	free(Data);
+}
+
+int main(void)
+{
+	const unsigned Sizes[] = { 0, 1, MEMBUS_MSGSIZE - 1, MEMBUS_CHUNK_PAYLOAD - 1, MEMBUS_CHUNK_PAYLOAD,
+								MEMBUS_CHUNK_PAYLOAD + 1, MEMBUS_CHUNK_PAYLOAD * 3, 1024 * 1024 + 3, MEMBUS_LONGMSG_MAX };
+	unsigned Inc = 0;
+	int Transport = 0;
+
+	for (; Transport < 2; ++Transport)
+	{
+		const Bool OverSocket = Transport;
+
+		for (Inc = 0; Inc < sizeof Sizes / sizeof *Sizes; ++Inc) CheckRoundTrip(OverSocket, Sizes[Inc]);
+
+		CheckShort(OverSocket);
+		CheckRejected(OverSocket, SendGap, "a missing piece");
+		CheckOversize(OverSocket);
+		CheckRejected(OverSocket, SendOverrun, "more than the total");
+		CheckRejected(OverSocket, SendShortfall, "less than the total");
+		CheckRejected(OverSocket, SendTotalChanged, "a total that changed");
+		CheckRejected(OverSocket, SendInterrupted, "a plain message mid-way");
+		CheckRejected(OverSocket, SendTrickle, "a message slower than MEMBUS_LONGMSG_TIMEOUT");
+	}
+
+	printf("membus: %s\n", Failures ? "FAILED" : "ok");
+	return Failures != 0;
+}
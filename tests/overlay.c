@@ -0,0 +1,95 @@
+/*This code is part of the Epoch Init System.
+* The Epoch Init System is maintained by Subsentient.
+* This software is public domain.
+* Please read the file UNLICENSE.TXT for more information.*/
+
+/**Checks that runtime changes saved in the overlay still reach the object table when STATEDIR
+ * only shows up after boot, as when /var is mounted late, and nothing has changed since.
+ * It's all static, so we pull in overlay.c whole, with a STATEDIR of our own. See runtests.sh.**/
+
+#define STATEDIR "/tmp/epoch-overlay-check/"
+#include "../src/overlay.c"
+
+static unsigned Failures;
+
+static void Expect(Bool Passed, const char *What)
+{
+	if (Passed) return;
+
+	printf("FAIL: %s\n", What);
+	++Failures;
+}
+
+static void WriteOverlay(const char *Text)
+{
+	FILE *Descriptor = fopen(OVERLAYFILE, "w");
+
+	if (!Descriptor) return;
+
+	fputs(Text, Descriptor);
+	fclose(Descriptor);
+}
+
+int main(void)
+{
+	static ObjTable Objects[3];
+	static struct _ObjState States[3];
+
+	Objects[0].ObjectID = "early";
+	Objects[1].ObjectID = "late";
+	Objects[0].State = States;
+	Objects[1].State = States + 1;
+	Objects[2].State = States + 2;
+	States[0].Enabled = States[1].Enabled = true;
+
+	ObjectTable = Objects;
+	ObjectStates = States;
+	ObjectTableSize = 2;
+
+	unlink(OVERLAYFILE);
+	rmdir(STATEDIR);
+
+	/*Boot, before STATEDIR is mounted.*/
+	Overlay_Apply();
+	Expect(!Overlay.Loaded, "loaded an overlay from a STATEDIR that isn't there");
+
+	Overlay_Sync(false);
+	Expect(!Overlay.Loaded, "loaded an overlay from a STATEDIR that isn't there");
+
+	/*Now it's mounted, with what we saved before the last shutdown.*/
+	mkdir(STATEDIR, 0755);
+	WriteOverlay("enabled\tearly\tfalse\ttrue\n");
+
+	Overlay_Sync(false);
+	Expect(!Overlay.Loaded, "tried to read the overlay again within a second of the last try");
+
+	Overlay.LastLoad -= OVERLAY_SYNC_INTERVAL;
+	Overlay_Sync(false);
+	Expect(Overlay.Loaded, "never read the overlay once STATEDIR was there");
+	Expect(!States[0].Enabled, "didn't apply the saved change with nothing pending");
+	Expect(States[1].Enabled, "changed an object the overlay doesn't mention");
+
+	/*Shutdown and reexec don't wait for the next second.*/
+	Overlay.Loaded = false;
+	States[0].Enabled = true;
+	Overlay_Sync(true);
+	Expect(Overlay.Loaded && !States[0].Enabled, "didn't read the overlay at once for a final sync");
+
+	/*And what we change here lands in the file as usual.*/
+	States[1].Enabled = false;
+	Overlay_RecordEnabled(Objects + 1, true);
+	Overlay_Sync(true);
+	Expect(!Overlay.PendingSize, "left a runtime change unwritten");
+
+	Overlay.Loaded = false;
+	Overlay.NumEntries = 0;
+	States[0].Enabled = States[1].Enabled = true;
+	Overlay_Apply();
+	Expect(!States[0].Enabled && !States[1].Enabled, "didn't read back what it wrote");
+
+	unlink(OVERLAYFILE);
+	rmdir(STATEDIR);
+
+	printf("overlay: %s\n", Failures ? "FAILED" : "ok");
+	return Failures != 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Builds and runs the host-side checks. None of them need root or a running Epoch.
+# Each test includes the source file it looks inside, so that one is left out of the link.
+
+CC="${CC:-cc}"
+CFLAGS="${CFLAGS:--std=gnu99 -Wall -g -O0}"
+Failed="0"
+
+cd "$(dirname "$0")"
+mkdir -p ../built/tests
+
+RunTest()
+{
+	Sources=""
+	
+	for File in ../src/*.c; do
+		if [ "$File" != "../src/$2" ]; then
+			Sources="$Sources $File"
+		fi
+	done
+	
+	printf "Building %s.\n" $1
+	
+	if ! $CC $CFLAGS -DNOMAINFUNC -o ../built/tests/$1 $1.c $Sources; then
+		printf "Error building %s.\n" $1
+		Failed="1"
+		return
+	fi
+	
+	if ! ../built/tests/$1; then
+		Failed="1"
+	fi
+}
+
+RunTest cmdline parse.c
+RunTest membus membus.c
+RunTest overlay overlay.c
+
+if [ "$Failed" != "0" ]; then
+	printf "Some checks failed.\n"
+	exit 1
+fi
+
+printf "All checks passed.\n"